@@ -21,6 +21,7 @@
 #include<sstream>
 #include<numeric>
 #include<cassert>
+#include<algorithm>
 
 //#define DBUG
 
@@ -65,7 +66,7 @@ template string str(const unsigned long long &x);
 //---------------
 // Constructors --
 //----------------
-ClassEngine::ClassEngine(const ClassParams& pars): cl(0),dofree(true){
+ClassEngine::ClassEngine(const ClassParams& pars): cl(0),dofree(true),_coarse(false),_hasEmulator(false),_emulated(false),_emuTolerance(0.){
 
   //prepare fp structure
   size_t n=pars.size();
@@ -97,6 +98,11 @@ ClassEngine::ClassEngine(const ClassParams& pars): cl(0),dofree(true){
     if (fc.read[i] !=_TRUE_) throw invalid_argument(string("invalid CLASS parameter: ")+fc.name[i]);
   }
 
+  bandpowers_init(&bp);
+
+  //keep large buffers from one model to the next
+  buffer_pool_retain(&_poolGeneration);
+
   //calcul class
   computeCls();
   
@@ -108,7 +114,7 @@ ClassEngine::ClassEngine(const ClassParams& pars): cl(0),dofree(true){
 }
 
 
-ClassEngine::ClassEngine(const ClassParams& pars,const string & precision_file): cl(0),dofree(true){
+ClassEngine::ClassEngine(const ClassParams& pars,const string & precision_file): cl(0),dofree(true),_coarse(false),_hasEmulator(false),_emulated(false),_emuTolerance(0.){
 
   struct file_content fc_precision;
   fc_precision.size = 0;
@@ -153,6 +159,11 @@ ClassEngine::ClassEngine(const ClassParams& pars,const string & precision_file):
     if (fc.read[i] !=_TRUE_) throw invalid_argument(string("invalid CLASS parameter: ")+fc.name[i]);
   }
 
+  bandpowers_init(&bp);
+
+  //keep large buffers from one model to the next
+  buffer_pool_retain(&_poolGeneration);
+
   //calcul class
   computeCls();
   
@@ -174,6 +185,11 @@ ClassEngine::~ClassEngine()
 
   //printFC();
   dofree && freeStructs();
+  bandpowers_free(&bp);
+  if (_hasEmulator) emulator_free(&em);
+  buffer_pool_release(&_poolGeneration);
+  //tables of other engines are kept, only unused ones are freed
+  table_cache_free();
 
   delete [] cl;
 
@@ -183,7 +199,65 @@ ClassEngine::~ClassEngine()
 // Member functions --
 //-----------------
 bool ClassEngine::updateParValues(const std::vector<double>& par){
-  dofree && freeStructs();
+  _coarse=false;
+  return update(par);
+}
+
+bool ClassEngine::updateParValuesCoarse(const std::vector<double>& par){
+  _coarse=true;
+  if (!update(par)) return false;
+  //one-off calibration: the first coarse pass is refined, so that
+  //getClError has an estimate for all the following ones
+  if (_clCoarseRelErr.empty()) return refine();
+  return true;
+}
+
+bool ClassEngine::refine(){
+  //emulated points are refined by running CLASS
+  if (_emulated) return runClass();
+  if (!dofree) return false;
+  if (!_coarse) return true;
+
+  //keep the coarse Cls for calibrating the error estimate
+  vector<double> clCoarse;
+  storeCls(clCoarse);
+
+  if (freeFromPerturb() == _FAILURE_) return false;
+  _coarse=false;
+
+  int status=computeFromPerturb(&pr);
+  if (status!=_SUCCESS_) return false;
+
+  vector<double> clFull;
+  storeCls(clFull);
+  if (_clCoarseRelErr.size()!=clFull.size())
+    _clCoarseRelErr.assign(clFull.size(),0.);
+
+  const Engine::cltype types[]={TT,EE,TE,BB,PP,TP,EP};
+  Engine::cltype t1,t2;
+  for (size_t i=0;i<sizeof(types)/sizeof(types[0]);i++){
+    int index_ct=ctIndex(types[i],t1,t2);
+    if (index_ct<0) continue;
+    for (long l=2;l<=_lmax;l++){
+      double norm=clNorm(clFull,types[i],l);
+      if (norm<=0) continue;
+      size_t k=l*sp.ct_size+index_ct;
+      double err=fabs(clCoarse[k]-clFull[k])/norm;
+      if (err>_clCoarseRelErr[k]) _clCoarseRelErr[k]=err;
+    }
+  }
+
+  return true;
+}
+
+bool ClassEngine::update(const std::vector<double>& par){
+  if (dofree) {
+    freeStructs();
+    dofree=false;
+  }
+  _emulated=false;
+  //give back the buffers which no engine reused since the last trim
+  buffer_pool_trim(&_poolGeneration);
   for (size_t i=0;i<par.size();i++) {
     double val=par[i];
     strcpy(fc.value[i],str(val).c_str());
@@ -192,6 +266,9 @@ bool ClassEngine::updateParValues(const std::vector<double>& par){
     cout << "update par values #" << i << "\t" <<  val << "\t" << str(val).c_str() << endl;
 #endif
   }
+  //serve the model from the emulator when possible
+  if (emulate()) return true;
+
   int status=computeCls();
 #ifdef DBUG
   cout << "update par status=" << status << " succes=" << _SUCCESS_ << endl;
@@ -241,6 +318,33 @@ int ClassEngine::class_main(
     return _FAILURE_;
   }
 
+  //coarse pass: modules after thermodynamics use the coarse profile
+  struct precision * ppr_pt=ppr;
+  if (_coarse) {
+    if (input_coarse_precision(ppr,&pr_coarse,errmsg) == _FAILURE_) {
+      printf("\n\nError in input_coarse_precision \n=>%s\n",errmsg);
+      thermodynamics_free(&th);
+      background_free(&ba);
+      dofree=false;
+      return _FAILURE_;
+    }
+    ppr_pt=&pr_coarse;
+  }
+
+  return computeFromPerturb(ppr_pt);
+}
+
+int ClassEngine::computeFromPerturb(struct precision * ppr){
+
+  struct background * pba=&ba;
+  struct thermo * pth=&th;
+  struct perturbs * ppt=&pt;
+  struct transfers * ptr=&tr;
+  struct primordial * ppm=&pm;
+  struct spectra * psp=&sp;
+  struct nonlinear * pnl=&nl;
+  struct lensing * ple=&le;
+
   if (perturb_init(ppr,pba,pth,ppt) == _FAILURE_) {
     printf("\n\nError in perturb_init \n=>%s\n",ppt->error_message);
     thermodynamics_free(&th);
@@ -268,7 +372,7 @@ int ClassEngine::class_main(
     return _FAILURE_;
   }
 
-  if (transfer_init(ppr,pba,pth,ppt,pnl,ptr) == _FAILURE_) {
+  if (transfer_init(ppr,pba,pth,ppt,ppm,pnl,ptr) == _FAILURE_) {
     printf("\n\nError in transfer_init \n=>%s\n",ptr->error_message);
     nonlinear_free(&nl);
     primordial_free(&pm);
@@ -328,6 +432,24 @@ int ClassEngine::computeCls(){
 int
 ClassEngine::freeStructs(){
   
+  if (freeFromPerturb() == _FAILURE_)
+    return _FAILURE_;
+
+  if (thermodynamics_free(&th) == _FAILURE_) {
+    printf("\n\nError in thermodynamics_free \n=>%s\n",th.error_message);
+    return _FAILURE_;
+  }
+
+  if (background_free(&ba) == _FAILURE_) {
+    printf("\n\nError in background_free \n=>%s\n",ba.error_message);
+    return _FAILURE_;
+  }
+
+  return _SUCCESS_;
+}
+
+int
+ClassEngine::freeFromPerturb(){
   
   if (lensing_free(&le) == _FAILURE_) {
     printf("\n\nError in spectra_free \n=>%s\n",le.error_message);
@@ -359,22 +481,93 @@ ClassEngine::freeStructs(){
     return _FAILURE_;
   }
 
-  if (thermodynamics_free(&th) == _FAILURE_) {
-    printf("\n\nError in thermodynamics_free \n=>%s\n",th.error_message);
-    return _FAILURE_;
-  }
+  return _SUCCESS_;
+}
 
-  if (background_free(&ba) == _FAILURE_) {
-    printf("\n\nError in background_free \n=>%s\n",ba.error_message);
-    return _FAILURE_;
+//index of type t in the Cl arrays (-1 if not computed), and auto-spectra
+//t1,t2 such that |Cl_t| <= sqrt(Cl_t1 Cl_t2)
+int
+ClassEngine::ctIndex(Engine::cltype t,Engine::cltype &t1,Engine::cltype &t2){
+
+  t1=t;
+  t2=t;
+
+  switch(t)
+    {
+    case TT:
+      return (sp.has_tt==_TRUE_) ? sp.index_ct_tt : -1;
+    case TE:
+      t1=TT; t2=EE;
+      return (sp.has_te==_TRUE_) ? sp.index_ct_te : -1;
+    case EE:
+      return (sp.has_ee==_TRUE_) ? sp.index_ct_ee : -1;
+    case BB:
+      return (sp.has_bb==_TRUE_) ? sp.index_ct_bb : -1;
+    case PP:
+      return (sp.has_pp==_TRUE_) ? sp.index_ct_pp : -1;
+    case TP:
+      t1=TT; t2=PP;
+      return (sp.has_tp==_TRUE_) ? sp.index_ct_tp : -1;
+    case EP:
+      t1=EE; t2=PP;
+      return (sp.has_ep==_TRUE_) ? sp.index_ct_ep : -1;
+    }
+
+  return -1;
+}
+
+//all Cls (CLASS units) for 2<=l<=lmax, in cls[l*ct_size+index_ct]
+void
+ClassEngine::storeCls(std::vector<double>& cls){
+
+  cls.assign((_lmax+1)*sp.ct_size,0.);
+
+  for (long l=2;l<=_lmax;l++){
+    if (output_total_cl_at_l(&sp,&le,&op,static_cast<double>(l),&cls[l*sp.ct_size]) == _FAILURE_)
+      throw out_of_range(sp.error_message);
   }
+}
 
-  return _SUCCESS_;
+//scale of Cl_t at l, used for normalising its error
+double
+ClassEngine::clNorm(const std::vector<double>& cls,Engine::cltype t,const long &l){
+
+  Engine::cltype t1,t2;
+  int index_ct=ctIndex(t,t1,t2);
+
+  if (t1==t) return fabs(cls[l*sp.ct_size+index_ct]);
+
+  int index_ct1=ctIndex(t1,t1,t1);
+  int index_ct2=ctIndex(t2,t2,t2);
+  if ((index_ct1<0) || (index_ct2<0)) return fabs(cls[l*sp.ct_size+index_ct]);
+
+  return sqrt(fabs(cls[l*sp.ct_size+index_ct1]*cls[l*sp.ct_size+index_ct2]));
+}
+
+double
+ClassEngine::getClError(Engine::cltype t,const long &l){
+
+  if (_emulated) return _emuError[emuClIndex(t,l)];
+
+  if (!dofree) throw out_of_range("no Cl available because CLASS failed");
+
+  Engine::cltype t1,t2;
+  int index_ct=ctIndex(t,t1,t2);
+  if (index_ct<0) throw invalid_argument("no Cl of this type available");
+
+  if (!_coarse) return 0.;
+  if ((l<2) || (l>_lmax)) throw out_of_range("l outside of computed range");
+
+  double norm= (t1==t) ? fabs(getCl(t,l)) : sqrt(fabs(getCl(t1,l)*getCl(t2,l)));
+
+  return _clCoarseRelErr[l*sp.ct_size+index_ct]*norm;
 }
 
 double
 ClassEngine::getCl(Engine::cltype t,const long &l){
 
+  if (_emulated) return _emuOutput[emuClIndex(t,l)];
+
   if (!dofree) throw out_of_range("no Cl available because CLASS failed");
 
   if (output_total_cl_at_l(&sp,&le,&op,static_cast<double>(l),cl) == _FAILURE_){
@@ -441,6 +634,73 @@ ClassEngine::getCls(const std::vector<unsigned>& lvec, //input
 
 }
  
+bool
+ClassEngine::addBandpowerWindow(const std::string& type,int bin1,int bin2,bool lensed,
+				int lmin,const std::vector<double>& weights){
+
+  if (weights.empty()) return false;
+
+  if (bandpowers_add_window(&bp,const_cast<char*>(type.c_str()),bin1,bin2,
+			    lensed ? _TRUE_ : _FALSE_,lmin,lmin+weights.size()-1,
+			    const_cast<double*>(&weights[0])) == _FAILURE_){
+    cerr << ">>>fail adding bandpower window: " << bp.error_message << endl;
+    return false;
+  }
+  return true;
+}
+
+bool
+ClassEngine::readBandpowerWindows(const std::string& filename){
+
+  if (bandpowers_read_windows(&bp,const_cast<char*>(filename.c_str())) == _FAILURE_){
+    cerr << ">>>fail reading bandpower windows: " << bp.error_message << endl;
+    return false;
+  }
+  return true;
+}
+
+void
+ClassEngine::clearBandpowerWindows(){
+  bandpowers_free(&bp);
+}
+
+bool
+ClassEngine::getBandpowers(std::vector<double>& bandpowers){
+
+  if (!runClass()) throw out_of_range("no Cl available because CLASS failed");
+
+  bandpowers.resize(bp.bp_size);
+  if (bp.bp_size==0) return true;
+
+  if (bandpowers_compute(&sp,&le,&bp,&bandpowers[0]) == _FAILURE_){
+    cerr << ">>>fail computing bandpowers: " << bp.error_message << endl;
+    return false;
+  }
+
+  //same units as getCl
+  double tomuk=1e6*Tcmb();
+  for (int i=0;i<bp.bp_size;i++){
+    switch(bp.type[i])
+      {
+      case bp_tt:
+      case bp_ee:
+      case bp_te:
+      case bp_bb:
+	bandpowers[i]*=tomuk*tomuk;
+	break;
+      case bp_tp:
+      case bp_ep:
+      case bp_td:
+      case bp_tl:
+	bandpowers[i]*=tomuk;
+	break;
+      default:
+	break;
+      }
+  }
+  return true;
+}
+
 bool 
 ClassEngine::getLensing(const std::vector<unsigned>& lvec, //input 
 		std::vector<double>& clpp    , 
@@ -470,6 +730,8 @@ ClassEngine::getLensing(const std::vector<unsigned>& lvec, //input
 
 double ClassEngine::get_f(double z)
 {
+  if (!runClass()) throw out_of_range("no background available because CLASS failed");
+
   double tau;
   int index;
   double *pvecback;
@@ -494,6 +756,8 @@ double ClassEngine::get_f(double z)
 
 double ClassEngine::get_sigma8(double z)
 {
+  if (!runClass()) throw out_of_range("no sigma8 available because CLASS failed");
+
   double tau;
   int index;
   double *pvecback;
@@ -522,11 +786,14 @@ double ClassEngine::get_Az(double z)
   // A(z)=100DV(z)sqrt(~mh2)/cz
   double omega_bidon = 0.12 ;
   double Az = 100.*Dv*sqrt(omega_bidon)/(3.e8*z); // is there speed of light somewhere ? 
+  return Az;
 }
 //      --------------------------
 
 double ClassEngine::get_Dv(double z)
 {
+  if (!runClass()) throw out_of_range("no background available because CLASS failed");
+
   double tau;
   int index;
   double *pvecback;
@@ -558,6 +825,8 @@ double ClassEngine::get_Dv(double z)
 
 double ClassEngine::get_Fz(double z)
 {
+  if (!runClass()) throw out_of_range("no background available because CLASS failed");
+
   double tau;
   int index;
   double *pvecback;
@@ -583,6 +852,8 @@ double ClassEngine::get_Fz(double z)
 
 double ClassEngine::get_Hz(double z)
 {
+  if (!runClass()) throw out_of_range("no background available because CLASS failed");
+
   double tau;
   int index;
   double *pvecback;
@@ -605,6 +876,8 @@ double ClassEngine::get_Hz(double z)
 
 double ClassEngine::get_Da(double z)
 {
+  if (!runClass()) throw out_of_range("no background available because CLASS failed");
+
   double tau;
   int index;
   double *pvecback;
@@ -626,3 +899,491 @@ double ClassEngine::get_Da(double z)
 #endif
   return D_ang;
 }
+
+bool
+ClassEngine::backgroundAtZ(const std::vector<double>& z,int index_bg,std::vector<double>& result){
+
+  if (!runClass()) throw out_of_range("no background available because CLASS failed");
+
+  result.resize(z.size());
+  if (z.empty()) return true;
+
+  //sort the redshifts once, such that the table is walked in one pass
+  vector<pair<double,size_t> > zsort(z.size());
+  for (size_t i=0;i<z.size();i++) zsort[i]=make_pair(z[i],i);
+  sort(zsort.begin(),zsort.end());
+
+  vector<double> zs(z.size()),res(z.size());
+  for (size_t i=0;i<z.size();i++) zs[i]=zsort[i].first;
+
+  if (background_at_z_vector(&ba,&zs[0],zs.size(),index_bg,&res[0]) == _FAILURE_){
+    cerr << ">>>fail interpolating background: " << ba.error_message << endl;
+    return false;
+  }
+
+  for (size_t i=0;i<z.size();i++) result[zsort[i].second]=res[i];
+  return true;
+}
+
+bool
+ClassEngine::getHz(const std::vector<double>& z, std::vector<double>& Hz){
+  return backgroundAtZ(z,ba.index_bg_H,Hz);
+}
+
+bool
+ClassEngine::getDa(const std::vector<double>& z, std::vector<double>& Da){
+  return backgroundAtZ(z,ba.index_bg_ang_distance,Da);
+}
+
+bool
+ClassEngine::getF(const std::vector<double>& z, std::vector<double>& f){
+  return backgroundAtZ(z,ba.index_bg_f,f);
+}
+
+bool
+ClassEngine::getDv(const std::vector<double>& z, std::vector<double>& Dv){
+
+  vector<double> H_z,D_ang;
+  if (!backgroundAtZ(z,ba.index_bg_H,H_z)) return false;
+  if (!backgroundAtZ(z,ba.index_bg_ang_distance,D_ang)) return false;
+
+  //same as get_Dv
+  Dv.resize(z.size());
+  for (size_t i=0;i<z.size();i++)
+    Dv[i]=pow(pow(D_ang[i]*(1+z[i]),2)*z[i]/H_z[i],1./3.);
+  return true;
+}
+
+bool
+ClassEngine::getFz(const std::vector<double>& z, std::vector<double>& Fz){
+
+  vector<double> H_z,D_ang;
+  if (!backgroundAtZ(z,ba.index_bg_H,H_z)) return false;
+  if (!backgroundAtZ(z,ba.index_bg_ang_distance,D_ang)) return false;
+
+  //same as get_Fz
+  Fz.resize(z.size());
+  for (size_t i=0;i<z.size();i++)
+    Fz[i]=(1.+z[i])*D_ang[i]*H_z[i]/(3.e8);
+  return true;
+}
+
+bool
+ClassEngine::getAz(const std::vector<double>& z, std::vector<double>& Az){
+
+  if (!getDv(z,Az)) return false;
+
+  //same as get_Az
+  double omega_bidon = 0.12 ;
+  for (size_t i=0;i<z.size();i++)
+    Az[i]=100.*Az[i]*sqrt(omega_bidon)/(3.e8*z[i]);
+  return true;
+}
+
+bool
+ClassEngine::getSigma8(const std::vector<double>& z, std::vector<double>& sigma8){
+
+  if (!runClass()) throw out_of_range("no sigma8 available because CLASS failed");
+
+  sigma8.resize(z.size());
+  if (z.empty()) return true;
+
+  if (spectra_sigma_at_z_vector(&ba,&pm,&sp,8./ba.h,const_cast<double*>(&z[0]),z.size(),&sigma8[0]) == _FAILURE_){
+    cerr << ">>>fail computing sigma8: " << sp.error_message << endl;
+    return false;
+  }
+  return true;
+}
+
+bool
+ClassEngine::getPk(const std::vector<double>& k,
+		   const std::vector<double>& z,
+		   std::vector<double>& pk,
+		   bool nonlinear){
+
+  if (_emulated && !nonlinear) {
+    vector<double> pkError;
+    return emuPk(k,z,pk,pkError);
+  }
+
+  if (!runClass()) throw out_of_range("no P(k) available because CLASS failed");
+
+  pk.resize(k.size()*z.size());
+  if (pk.empty()) return true;
+
+  if (nonlinear && (nl.method == nl_none)){
+    cerr << ">>>no non-linear P(k) available: set 'non linear' in the parameters" << endl;
+    return false;
+  }
+
+  //P_cb is computed along with P_m when there are massive neutrinos
+  vector<double> pk_cb(ba.has_ncdm==_TRUE_ ? pk.size() : 1);
+
+  if (spectra_fast_pk_at_kvec_and_zvec(&ba,&sp,
+				       const_cast<double*>(&k[0]),k.size(),
+				       const_cast<double*>(&z[0]),z.size(),
+				       &pk[0],&pk_cb[0],
+				       nonlinear ? _TRUE_ : _FALSE_) == _FAILURE_){
+    cerr << ">>>fail computing P(k): " << sp.error_message << endl;
+    return false;
+  }
+  return true;
+}
+
+//-----------------
+// Emulator --
+//-----------------
+
+//same parameter value: numerical comparison when both strings are
+//numbers (values written by updateParValues have 16 digits)
+static bool sameParValue(const char* a,const char* b){
+  char *enda,*endb;
+  double va=strtod(a,&enda);
+  double vb=strtod(b,&endb);
+  if ((enda==a) || (endb==b) || (*enda!='\0') || (*endb!='\0')) return (strcmp(a,b)==0);
+  return (fabs(va-vb) <= 1e-10*max(fabs(va),fabs(vb)));
+}
+
+//conversion of CLASS Cls to the units of getCl
+static double clUnits(Engine::cltype t,double tomuk){
+  switch(t)
+    {
+    case Engine::PP:
+      return 1.;
+    case Engine::TP:
+    case Engine::EP:
+      return tomuk;
+    default:
+      return tomuk*tomuk;
+    }
+}
+
+bool
+ClassEngine::trainEmulator(const std::vector<std::string>& names,
+			   const std::vector<double>& halfWidths,
+			   int nTrain,
+			   const std::vector<double>& k,
+			   const std::vector<double>& z,
+			   const std::string& filename){
+
+  if (names.empty() || (names.size()!=halfWidths.size())) {
+    cerr << ">>>emulator needs one half-width per parameter" << endl;
+    return false;
+  }
+  if (!runClass()) {
+    cerr << ">>>emulator training needs a model computed by CLASS" << endl;
+    return false;
+  }
+  for (size_t i=1;i<k.size();i++)
+    if (k[i]<=k[i-1]) {cerr << ">>>emulator wavenumbers must be increasing" << endl; return false;}
+  for (size_t i=1;i<z.size();i++)
+    if (z[i]<=z[i-1]) {cerr << ">>>emulator redshifts must be increasing" << endl; return false;}
+
+  int n=names.size();
+  vector<int> index(n,-1);
+  for (int i=0;i<n;i++){
+    for (int j=0;j<fc.size;j++)
+      if (names[i]==fc.name[j]) index[i]=j;
+    if (index[i]<0) {
+      cerr << ">>>unknown emulator parameter: " << names[i] << endl;
+      return false;
+    }
+    if (halfWidths[i]<=0) {
+      cerr << ">>>emulator half-width of " << names[i] << " must be positive" << endl;
+      return false;
+    }
+  }
+
+  //types of Cls computed in the fiducial model
+  const Engine::cltype types[]={TT,EE,TE,BB,PP,TP,EP};
+  vector<Engine::cltype> clTypes;
+  Engine::cltype t1,t2;
+  for (size_t i=0;i<sizeof(types)/sizeof(types[0]);i++)
+    if (ctIndex(types[i],t1,t2)>=0) clTypes.push_back(types[i]);
+
+  struct emulator emt;
+  if (emulator_init(&emt,n,fc.size-n,_lmax,clTypes.size(),k.size(),z.size()) == _FAILURE_){
+    cerr << ">>>fail initialising emulator: " << emt.error_message << endl;
+    return false;
+  }
+
+  bool ok=true;
+  vector<string> fiducial(n);
+  for (int i=0;i<n;i++){
+    strcpy(emt.par_name[i],fc.name[index[i]]);
+    fiducial[i]=fc.value[index[i]];
+    char *end;
+    emt.par_fiducial[i]=strtod(fc.value[index[i]],&end);
+    if ((end==fc.value[index[i]]) || (*end!='\0')) {
+      cerr << ">>>emulator parameter " << names[i] << " is not numerical" << endl;
+      ok=false;
+    }
+    emt.par_width[i]=halfWidths[i];
+  }
+  for (int j=0,i=0;j<fc.size;j++){
+    if (find(index.begin(),index.end(),j)!=index.end()) continue;
+    strcpy(emt.fixed_name[i],fc.name[j]);
+    strcpy(emt.fixed_value[i],fc.value[j]);
+    i++;
+  }
+  for (int i=0;i<emt.cl_type_size;i++) emt.cl_type[i]=clTypes[i];
+  for (int i=0;i<emt.k_size;i++) emt.k[i]=k[i];
+  for (int i=0;i<emt.z_size;i++) emt.z[i]=z[i];
+
+  if (nTrain<=0) nTrain=2*emt.term_size;
+  vector<double> design(nTrain*n),outputs(nTrain*emt.out_size);
+
+  if (ok && (emulator_design(&emt,nTrain,&design[0]) == _FAILURE_)){
+    cerr << ">>>fail in emulator design: " << emt.error_message << endl;
+    ok=false;
+  }
+
+  //full runs (the first one, at the fiducial, is the current model)
+  _coarse=false;
+  for (int r=0;ok && (r<nTrain);r++){
+
+    if (r>0) {
+      cout << __FILE__ << " : emulator training run " << r+1 << "/" << nTrain << endl;
+      dofree && freeStructs();
+      buffer_pool_trim(&_poolGeneration);
+      for (int i=0;i<n;i++) strcpy(fc.value[index[i]],str(design[r*n+i]).c_str());
+      if (computeCls()!=_SUCCESS_) {ok=false; break;}
+    }
+
+    double * out=&outputs[r*emt.out_size];
+    try{
+      vector<double> cls;
+      storeCls(cls);
+      for (int it=0;it<emt.cl_type_size;it++){
+	int index_ct=ctIndex(clTypes[it],t1,t2);
+	double units=clUnits(clTypes[it],1e6*Tcmb());
+	for (long l=2;l<=_lmax;l++)
+	  out[it*(_lmax-1)+l-2]=units*cls[l*sp.ct_size+index_ct];
+      }
+    }
+    catch(exception &e){
+      cerr << ">>>fail getting Cls for emulator: " << e.what() << endl;
+      ok=false;
+      break;
+    }
+
+    if (emt.k_size>0) {
+      vector<double> pk;
+      if (!getPk(k,z,pk)) {ok=false; break;}
+      int offset=emt.out_size-emt.k_size*emt.z_size;
+      for (int iz=0;iz<emt.z_size;iz++)
+	for (int ik=0;ik<emt.k_size;ik++){
+	  double p=pk[iz*emt.k_size+ik];
+	  if (p<=0) {
+	    cerr << ">>>non-positive P(k) in emulator training run" << endl;
+	    ok=false;
+	  }
+	  else
+	    out[offset+iz*emt.k_size+ik]=log(p);
+	}
+    }
+  }
+
+  //back to the fiducial model
+  if (nTrain>1) {
+    for (int i=0;i<n;i++) strcpy(fc.value[index[i]],fiducial[i].c_str());
+    dofree && freeStructs();
+    buffer_pool_trim(&_poolGeneration);
+    if (computeCls()!=_SUCCESS_) ok=false;
+  }
+
+  if (ok && (emulator_train(&emt,nTrain,&design[0],&outputs[0]) == _FAILURE_)){
+    cerr << ">>>fail training emulator: " << emt.error_message << endl;
+    ok=false;
+  }
+
+  if (ok && (emulator_write(&emt,const_cast<char*>(filename.c_str())) == _FAILURE_)){
+    cerr << ">>>fail writing emulator: " << emt.error_message << endl;
+    ok=false;
+  }
+
+  emulator_free(&emt);
+  return ok;
+}
+
+bool
+ClassEngine::loadEmulator(const std::string& filename,double tolerance){
+
+  clearEmulator();
+
+  if (emulator_read(&em,const_cast<char*>(filename.c_str())) == _FAILURE_){
+    cerr << ">>>fail reading emulator: " << em.error_message << endl;
+    return false;
+  }
+  _hasEmulator=true;
+
+  //parameters are matched by name, since their order may differ
+  _emuParIndex.assign(em.par_size,-1);
+  _emuFixedIndex.assign(em.fixed_size,-1);
+  for (int j=0;j<fc.size;j++){
+    for (int i=0;i<em.par_size;i++)
+      if (strcmp(em.par_name[i],fc.name[j])==0) _emuParIndex[i]=j;
+    for (int i=0;i<em.fixed_size;i++)
+      if (strcmp(em.fixed_name[i],fc.name[j])==0) _emuFixedIndex[i]=j;
+  }
+  if ((find(_emuParIndex.begin(),_emuParIndex.end(),-1)!=_emuParIndex.end()) ||
+      (find(_emuFixedIndex.begin(),_emuFixedIndex.end(),-1)!=_emuFixedIndex.end())){
+    cerr << ">>>emulator " << filename << " was trained with other parameters" << endl;
+    clearEmulator();
+    return false;
+  }
+
+  _emuTolerance=tolerance;
+  return true;
+}
+
+void
+ClassEngine::clearEmulator(){
+  if (_hasEmulator) emulator_free(&em);
+  _hasEmulator=false;
+  _emuParIndex.clear();
+  _emuFixedIndex.clear();
+  //the current model can no longer be served by the emulator
+  if (_emulated) runClass();
+}
+
+//full CLASS run for the current parameters if the model was emulated;
+//returns whether the CLASS structures are available
+bool
+ClassEngine::runClass(){
+
+  if (_emulated) {
+    _emulated=false;
+    _emuOutput.clear();
+    _emuError.clear();
+    computeCls();
+  }
+  return dofree;
+}
+
+//prediction of the emulator for the parameters in fc, if they are
+//inside its validity domain and within tolerance
+bool
+ClassEngine::emulate(){
+
+  if (!_hasEmulator || _coarse) return false;
+
+  for (int i=0;i<em.fixed_size;i++)
+    if (!sameParValue(fc.value[_emuFixedIndex[i]],em.fixed_value[i])) return false;
+
+  vector<double> par(em.par_size);
+  for (int i=0;i<em.par_size;i++){
+    char *end;
+    par[i]=strtod(fc.value[_emuParIndex[i]],&end);
+    if ((end==fc.value[_emuParIndex[i]]) || (*end!='\0')) return false;
+  }
+
+  short in_range;
+  double max_error;
+  _emuOutput.resize(em.out_size);
+  _emuError.resize(em.out_size);
+  if (emulator_predict(&em,&par[0],&_emuOutput[0],&_emuError[0],&in_range,&max_error) == _FAILURE_){
+    cerr << ">>>fail in emulator: " << em.error_message << endl;
+    return false;
+  }
+  if ((in_range==_FALSE_) || (max_error>_emuTolerance)) return false;
+
+  _emulated=true;
+  return true;
+}
+
+//position of Cl_t at l in the emulator output
+int
+ClassEngine::emuClIndex(Engine::cltype t,const long &l){
+
+  int it=0;
+  while ((it<em.cl_type_size) && (em.cl_type[it]!=(int)t)) it++;
+  if (it==em.cl_type_size) throw invalid_argument("no Cl of this type emulated");
+  if ((l<2) || (l>em.l_max)) throw out_of_range("l outside of emulated range");
+
+  return it*(em.l_max-1)+l-2;
+}
+
+//emulated P(k,z) and its error: cubic spline in ln k at each redshift
+//of the emulator, then linear interpolation in z
+bool
+ClassEngine::emuPk(const std::vector<double>& k,const std::vector<double>& z,
+		   std::vector<double>& pk,std::vector<double>& pkError){
+
+  if (em.k_size==0) {
+    cerr << ">>>no P(k) emulated" << endl;
+    return false;
+  }
+
+  pk.resize(k.size()*z.size());
+  pkError.resize(k.size()*z.size());
+  if (pk.empty()) return true;
+
+  int nk=em.k_size;
+  int nz=em.z_size;
+  int offset=em.out_size-nk*nz;
+
+  //table of ln P and of its error, one line per k
+  vector<double> lnk(nk),table(2*nz*nk),ddtable(2*nz*nk),line(2*nz);
+  for (int ik=0;ik<nk;ik++){
+    lnk[ik]=log(em.k[ik]);
+    for (int iz=0;iz<nz;iz++){
+      table[ik*2*nz+iz]=_emuOutput[offset+iz*nk+ik];
+      table[ik*2*nz+nz+iz]=_emuError[offset+iz*nk+ik];
+    }
+  }
+  if ((nk>1) && (array_spline_table_lines(&lnk[0],nk,&table[0],2*nz,&ddtable[0],_SPLINE_NATURAL_,_errmsg) == _FAILURE_)){
+    cerr << ">>>fail interpolating emulated P(k): " << _errmsg << endl;
+    return false;
+  }
+
+  int last_index=0;
+  for (size_t ik=0;ik<k.size();ik++){
+
+    if (nk>1) {
+      if (array_interpolate_spline(&lnk[0],nk,&table[0],&ddtable[0],2*nz,log(k[ik]),
+				   &last_index,&line[0],2*nz,_errmsg) == _FAILURE_){
+	cerr << ">>>k outside of emulated range: " << _errmsg << endl;
+	return false;
+      }
+    }
+    else {
+      if (k[ik]!=em.k[0]) {
+	cerr << ">>>k outside of emulated range" << endl;
+	return false;
+      }
+      copy(table.begin(),table.end(),line.begin());
+    }
+
+    for (size_t iz=0;iz<z.size();iz++){
+      if ((z[iz]<em.z[0]) || (z[iz]>em.z[nz-1])) {
+	cerr << ">>>z outside of emulated range" << endl;
+	return false;
+      }
+      int jz=0;
+      while ((jz<nz-2) && (z[iz]>em.z[jz+1])) jz++;
+      double w= (nz>1) ? (z[iz]-em.z[jz])/(em.z[jz+1]-em.z[jz]) : 0.;
+      int jz1= (nz>1) ? jz+1 : jz;
+      double lnp=(1.-w)*line[jz]+w*line[jz1];
+      double err=(1.-w)*line[nz+jz]+w*line[nz+jz1];
+      pk[iz*k.size()+ik]=exp(lnp);
+      pkError[iz*k.size()+ik]=exp(lnp)*err;
+    }
+  }
+  return true;
+}
+
+bool
+ClassEngine::getPkError(const std::vector<double>& k,
+			const std::vector<double>& z,
+			std::vector<double>& pkError){
+
+  if (!_emulated) {
+    if (!dofree) throw out_of_range("no P(k) available because CLASS failed");
+    pkError.assign(k.size()*z.size(),0.);
+    return true;
+  }
+
+  vector<double> pk;
+  return emuPk(k,z,pk,pkError);
+}
@@ -80,12 +80,28 @@ public:
   //modfiers: _FAILURE_ returned if CLASS pb:
   bool updateParValues(const std::vector<double>& par);
 
+  //two-level evaluation (e.g. for delayed-acceptance sampling):
+  //cheap pass with the coarse precision profile (see input_coarse_precision).
+  //The first call also refines, to calibrate getClError
+  bool updateParValuesCoarse(const std::vector<double>& par);
+  //recompute perturbations onwards with full precision, reusing the
+  //background, thermodynamics and shooting of the coarse pass
+  bool refine();
+  inline bool isCoarse() const {return _coarse;}
+
 
   //get value at l ( 2<l<lmax): in units = (micro-K)^2
   //don't call if FAILURE returned previously
   //throws std::execption if pb
 
   double getCl(Engine::cltype t,const long &l);  
+
+  //estimated error on getCl(t,l) after a coarse pass (same units):
+  //largest relative difference between coarse and refined Cls seen in
+  //previous refinements (at least the calibration done by the first
+  //coarse pass), times the current Cl (times sqrt(Cl_XX Cl_YY) for
+  //cross-spectra). Returns 0 after a full evaluation
+  double getClError(Engine::cltype t,const long &l);
   void getCls(const std::vector<unsigned>& lVec, //input 
 	      std::vector<double>& cltt, 
 	      std::vector<double>& clte, 
@@ -98,6 +114,16 @@ public:
 	      std::vector<double>& cltphi, 
 	      std::vector<double>& clephi);
 
+  //bandpowers: windows are set once (see bandpowers.h for the types
+  //"tt","te",..."dd","ll","dl" and the file format), then applied
+  //in C to the Cls of each model, in the same units as getCl
+  bool addBandpowerWindow(const std::string& type,int bin1,int bin2,bool lensed,
+			  int lmin,const std::vector<double>& weights);
+  bool readBandpowerWindows(const std::string& filename);
+  void clearBandpowerWindows();
+  inline int numBandpowers() const {return bp.bp_size;}
+  bool getBandpowers(std::vector<double>& bandpowers);
+
  //for BAO
   inline double z_drag() const {return th.z_d;}
   inline double rs_drag() const {return th.rs_d;} 
@@ -113,6 +139,50 @@ public:
 
   double getTauReio() const {return th.tau_reio;}
 
+  //vectorised versions: the redshifts are sorted once and the
+  //background table is walked in a single pass; P(k,z) is read from
+  //the bicubic spline tables without building temporary arrays
+  bool getDv(const std::vector<double>& z, std::vector<double>& Dv);
+  bool getDa(const std::vector<double>& z, std::vector<double>& Da);
+  bool getHz(const std::vector<double>& z, std::vector<double>& Hz);
+  bool getF(const std::vector<double>& z, std::vector<double>& f);
+  bool getFz(const std::vector<double>& z, std::vector<double>& Fz);
+  bool getAz(const std::vector<double>& z, std::vector<double>& Az);
+  bool getSigma8(const std::vector<double>& z, std::vector<double>& sigma8);
+  bool getPk(const std::vector<double>& k,
+	     const std::vector<double>& z,
+	     std::vector<double>& pk,
+	     bool nonlinear=false);
+
+  //local emulator (see emulator.h): trainEmulator() computes a design
+  //of full runs varying the parameters 'names' within +-halfWidths
+  //around their current values (all other parameters fixed), and
+  //writes the trained emulator of the Cls up to l_max_scalars and of
+  //the linear P(k,z) on the grids k (1/Mpc) and z. nTrain=0 chooses
+  //twice the number of polynomial terms.
+  bool trainEmulator(const std::vector<std::string>& names,
+		     const std::vector<double>& halfWidths,
+		     int nTrain,
+		     const std::vector<double>& k,
+		     const std::vector<double>& z,
+		     const std::string& filename);
+  //once loaded, models are served by the emulator when all fixed
+  //parameters match the training runs, the point lies in the training
+  //box and the largest relative error estimate is below tolerance;
+  //otherwise CLASS is run. getCl(s), getLensing, getClError, the
+  //linear getPk and getPkError are served by the emulator; any other
+  //accessor, refine() and clearEmulator() first replace an emulated
+  //model by a full CLASS run. classy does not use the emulator yet.
+  bool loadEmulator(const std::string& filename,double tolerance);
+  void clearEmulator();
+  inline bool isEmulated() const {return _emulated;}
+  //error estimate on getPk(k,z,pk) for emulated models (0 otherwise);
+  //between the nodes of the training grids, P(k,z) is interpolated
+  //(cubic in ln k, linear in z) and this error is not included
+  bool getPkError(const std::vector<double>& k,
+		  const std::vector<double>& z,
+		  std::vector<double>& pkError);
+
   //may need that
   inline int numCls() const {return sp.ct_size;};
   inline double Tcmb() const {return ba.T_cmb;}
@@ -126,6 +196,7 @@ private:
   //structures class en commun
   struct file_content fc;
   struct precision pr;        /* for precision parameters */
+  struct precision pr_coarse; /* for coarse precision parameters */
   struct background ba;       /* for cosmological background */
   struct thermo th;           /* for thermodynamics */
   struct perturbs pt;         /* for source functions */
@@ -135,16 +206,33 @@ private:
   struct nonlinear nl;        /* for non-linear spectra */
   struct lensing le;          /* for lensed spectra */
   struct output op;           /* for output files */
+  struct bandpowers bp;       /* for bandpower windows */
+  struct emulator em;         /* for emulated models */
 
   ErrorMsg _errmsg;            /* for error messages */
   double * cl;
 
   //helpers
-  bool dofree;
+  bool dofree;                /* whether the CLASS structures are allocated */
+  int _poolGeneration;        /* generation of this engine in the pool of large buffers */
   int freeStructs();
+  int freeFromPerturb();
 
   //call once /model
   int computeCls();
+  bool update(const std::vector<double>& par);
+
+  //coarse pass state and calibration of its error
+  bool _coarse;
+  std::vector<double> _clCoarseRelErr;
+  int ctIndex(Engine::cltype t,Engine::cltype &t1,Engine::cltype &t2);
+  void storeCls(std::vector<double>& cls);
+  double clNorm(const std::vector<double>& cls,Engine::cltype t,const long &l);
+
+  int computeFromPerturb(struct precision * ppr);
+
+  //one background quantity at all redshifts, in a single table walk
+  bool backgroundAtZ(const std::vector<double>& z,int index_bg,std::vector<double>& result);
 
   int class_main(
 		 struct file_content *pfc,
@@ -159,6 +247,21 @@ private:
 		 struct lensing * ple,
 		 struct output * pop,
 		 ErrorMsg errmsg);
+  //emulator state: indices in fc of the emulated and fixed
+  //parameters, and prediction for the current model
+  bool _hasEmulator;
+  bool _emulated;
+  double _emuTolerance;
+  std::vector<int> _emuParIndex;
+  std::vector<int> _emuFixedIndex;
+  std::vector<double> _emuOutput;
+  std::vector<double> _emuError;
+  bool emulate();
+  bool runClass();
+  int emuClIndex(Engine::cltype t,const long &l);
+  bool emuPk(const std::vector<double>& k,const std::vector<double>& z,
+	     std::vector<double>& pk,std::vector<double>& pkError);
+
   //parnames
   std::vector<std::string> parNames;
 
@@ -68,3 +68,52 @@ Engine::writeCls(std::ostream &of){
   
 
 }
+
+bool
+Engine::getDv(const std::vector<double>& z, std::vector<double>& Dv){
+  Dv.resize(z.size());
+  for (size_t i=0;i<z.size();i++) Dv[i]=get_Dv(z[i]);
+  return true;
+}
+
+bool
+Engine::getDa(const std::vector<double>& z, std::vector<double>& Da){
+  Da.resize(z.size());
+  for (size_t i=0;i<z.size();i++) Da[i]=get_Da(z[i]);
+  return true;
+}
+
+bool
+Engine::getHz(const std::vector<double>& z, std::vector<double>& Hz){
+  Hz.resize(z.size());
+  for (size_t i=0;i<z.size();i++) Hz[i]=get_Hz(z[i]);
+  return true;
+}
+
+bool
+Engine::getF(const std::vector<double>& z, std::vector<double>& f){
+  f.resize(z.size());
+  for (size_t i=0;i<z.size();i++) f[i]=get_f(z[i]);
+  return true;
+}
+
+bool
+Engine::getFz(const std::vector<double>& z, std::vector<double>& Fz){
+  Fz.resize(z.size());
+  for (size_t i=0;i<z.size();i++) Fz[i]=get_Fz(z[i]);
+  return true;
+}
+
+bool
+Engine::getAz(const std::vector<double>& z, std::vector<double>& Az){
+  Az.resize(z.size());
+  for (size_t i=0;i<z.size();i++) Az[i]=get_Az(z[i]);
+  return true;
+}
+
+bool
+Engine::getSigma8(const std::vector<double>& z, std::vector<double>& sigma8){
+  sigma8.resize(z.size());
+  for (size_t i=0;i<z.size();i++) sigma8[i]=get_sigma8(z[i]);
+  return true;
+}
@@ -60,6 +60,23 @@ public:
 
   virtual double getTauReio() const=0;
 
+  //same quantities for a list of redshifts (one call per observable):
+  //the default implementations loop over the functions above
+  virtual bool getDv(const std::vector<double>& z, std::vector<double>& Dv);
+  virtual bool getDa(const std::vector<double>& z, std::vector<double>& Da);
+  virtual bool getHz(const std::vector<double>& z, std::vector<double>& Hz);
+  virtual bool getF(const std::vector<double>& z, std::vector<double>& f);
+  virtual bool getFz(const std::vector<double>& z, std::vector<double>& Fz);
+  virtual bool getAz(const std::vector<double>& z, std::vector<double>& Az);
+  virtual bool getSigma8(const std::vector<double>& z, std::vector<double>& sigma8);
+
+  //matter power spectrum in Mpc^3 for k in 1/Mpc, linear or
+  //non-linear, stored as pk[iz*k.size()+ik]
+  virtual bool getPk(const std::vector<double>& k,
+		     const std::vector<double>& z,
+		     std::vector<double>& pk,
+		     bool nonlinear=false)=0;
+
   // destructor
   virtual ~Engine(){};
 
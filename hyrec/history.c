@@ -52,11 +52,15 @@ void rec_get_cosmoparam(FILE *fin, FILE *fout, REC_COSMOPARAMS *param) {
   param->fHe = param->Y/(1-param->Y)/3.97153;              /* abundance of helium by number */
 
 
+  param->model = DEFAULT_MODEL;
+
   /* Redshift range */
   param->zstart = 8000.;
   param->zend = 0.;
   param->dlna = 8.49e-5;
   param->nz = (long) floor(2+log((1.+param->zstart)/(1.+param->zend))/param->dlna);
+  param->dlna_max = 0.05;
+  param->tol = 1e-5;
 
   if (fout!=NULL && PROMPT==1) fprintf(fout, "\n");
 }
@@ -99,6 +103,7 @@ double rec_HubbleConstant(REC_COSMOPARAMS *param, double z) {
 
 /*****************************************************************************************
 Matter temperature -- 1st order steady state, from Hirata 2008
+nH is in cm^-3 and energy_rate in eV/cm^3/s (param->nH0 is in m^-3)
 ******************************************************************************************/
 
 double rec_Tmss(double xe, double Tr, double H, double fHe, double nH, double energy_rate) {
@@ -144,236 +149,398 @@ double rec_dTmdlna(double xe, double Tm, double Tr, double H, double fHe, double
 }
 
 /**********************************************************************************************
-Second order integrator using derivative from previous time steps
-Evolves xe only, assumes Tm is given by the steady-state solution
+Derivative of xe with respect to ln(a) during hydrogen recombination, for each model.
+The Peebles and RecFast models use the same rate in all phases. The EMLA models use the effective
+rates down to z = 20, and Peebles' model below (FUNC_PEEBLES), where the temperature leaves the
+range of the rate tables; the full model also includes radiative transfer in the two-photon
+phases (FUNC_H2G).
 ***********************************************************************************************/
 
-void rec_get_xe_next1(REC_COSMOPARAMS *param, double z1, double xe_in, double *xe_out,
-                      HRATEEFF *rate_table, int func_select, unsigned iz, TWO_PHOTON_PARAMS *twog_params,
-		      double **logfminus_hist, double *logfminus_Ly_hist[],
-                      double *z_prev, double *dxedlna_prev, double *z_prev2, double *dxedlna_prev2) {
+double rec_dxedlna_peebles(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                           double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                           TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist, double *logfminus_Ly_hist[], double z) {
+    return rec_HPeebles_dxedlna(xe, nH, H, TM, TR, energy_rate);
+}
 
-  double dxedlna, Tr, nH, ainv, H, Tm;
+double rec_dxedlna_recfast(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                           double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                           TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist, double *logfminus_Ly_hist[], double z) {
+    return rec_HRecFast_dxedlna(xe, nH, H, TM, TR, energy_rate);
+}
 
-    Tr = param->T0 * (ainv=1.+z1);
-    nH = param->nH0 * ainv*ainv*ainv;
-    H = rec_HubbleConstant(param, z1);
-    Tm = rec_Tmss(xe_in, Tr, H, param->fHe, nH*1e-6, energy_injection_rate(param,z1));
-
-    #if (MODEL == PEEBLES)
-        dxedlna = func_select==FUNC_HEI  ? rec_helium_dxedt(xe_in, param->nH0, param->T0, param->fHe, H, z1)/H:
-                                           rec_HPeebles_dxedlna(xe_in, nH*1e-6, H, Tm*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1));
-    #elif (MODEL == RECFAST)
-        dxedlna = func_select==FUNC_HEI  ? rec_helium_dxedt(xe_in, param->nH0, param->T0, param->fHe, H, z1)/H:
-                                           rec_HRecFast_dxedlna(xe_in, nH*1e-6, H, Tm*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1));
-    #elif (MODEL == EMLA2s2p)
-        dxedlna = func_select==FUNC_HEI  ? rec_helium_dxedt(xe_in, param->nH0, param->T0, param->fHe, H, z1)/H:
-                                           rec_HMLA_dxedlna(xe_in, nH*1e-6, H, Tm*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1), rate_table);
-    #else
-        dxedlna = func_select==FUNC_HEI  ? rec_helium_dxedt(xe_in, param->nH0, param->T0, param->fHe, H, z1)/H:
-	  func_select==FUNC_H2G  ? rec_HMLA_2photon_dxedlna(xe_in, nH*1e-6, H, Tm*kBoltz, Tr*kBoltz, rate_table, twog_params,
-							    param->zstart, param->dlna, logfminus_hist, logfminus_Ly_hist, iz, z1, energy_injection_rate(param,z1))
-	  :rec_HMLA_dxedlna(xe_in, nH*1e-6, H, Tm*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1), rate_table);
-    #endif
-
-    *xe_out = xe_in + param->dlna * (1.25 * dxedlna - 0.25 * (*dxedlna_prev2));
-
-    *z_prev2       = *z_prev;
-    *dxedlna_prev2 = *dxedlna_prev;
-    *z_prev        = z1;
-    *dxedlna_prev  = dxedlna;
+double rec_dxedlna_emla2s2p(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                            double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                            TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist, double *logfminus_Ly_hist[], double z) {
+    return func_select==FUNC_PEEBLES ? rec_HPeebles_dxedlna(xe, nH, H, TM, TR, energy_rate) /* below the range of the rate tables */
+                                     : rec_HMLA_dxedlna(xe, nH, H, TM, TR, energy_rate, rate_table);
+}
 
+double rec_dxedlna_full(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                        double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                        TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist, double *logfminus_Ly_hist[], double z) {
+    return func_select==FUNC_H2G  ? rec_HMLA_2photon_dxedlna(xe, nH, H, TM, TR, rate_table, twog_params,
+                                                             param->zstart, param->dlna, logfminus_hist, logfminus_Ly_hist, iz, z,
+                                                             energy_rate):
+           func_select==FUNC_HMLA ? rec_HMLA_dxedlna(xe, nH, H, TM, TR, energy_rate, rate_table)
+                                  : rec_HPeebles_dxedlna(xe, nH, H, TM, TR, energy_rate); /* used for z < 20 only */
 }
 
+const REC_HYDROGEN_DXEDLNA rec_hydrogen_dxedlna[NMODELS] = {
+    rec_dxedlna_peebles,     /* PEEBLES  */
+    rec_dxedlna_recfast,     /* RECFAST  */
+    rec_dxedlna_emla2s2p,    /* EMLA2s2p */
+    rec_dxedlna_full         /* FULL     */
+};
+
 /**********************************************************************************************
-Second order integrator using derivative from previous time steps
-Evolves xe and Tm simultaneously
+Derivatives of xe and Tm with respect to ln(a). If evolve_Tm = 0, Tm is set to its
+steady-state value and dTmdlna is not computed.
 ***********************************************************************************************/
 
-void rec_get_xe_next2(REC_COSMOPARAMS *param, double z1, double xe_in, double Tm_in, double *xe_out, double *Tm_out,
-                      HRATEEFF *rate_table, int func_select, unsigned iz, TWO_PHOTON_PARAMS *twog_params,
-		      double **logfminus_hist, double *logfminus_Ly_hist[],
-                      double *z_prev, double *dxedlna_prev, double *dTmdlna_prev,
-                      double *z_prev2, double *dxedlna_prev2, double *dTmdlna_prev2) {
+void rec_get_derivatives(REC_COSMOPARAMS *param, double z, double xe, double *Tm, int evolve_Tm,
+                         HRATEEFF *rate_table, int func_select, unsigned iz, TWO_PHOTON_PARAMS *twog_params,
+                         double **logfminus_hist, double *logfminus_Ly_hist[],
+                         double *dxedlna, double *dTmdlna) {
 
-    double dxedlna, dTmdlna, Tr, nH, ainv, H;
+    double Tr, nH, ainv, H, energy_rate;
 
-    Tr = param->T0 * (ainv=1.+z1);
+    Tr = param->T0 * (ainv=1.+z);
     nH = param->nH0 * ainv*ainv*ainv;
-    H = rec_HubbleConstant(param, z1);
-
-    #if (MODEL == PEEBLES)
-         dxedlna = func_select==FUNC_HEI  ? rec_helium_dxedt(xe_in, param->nH0, param->T0, param->fHe, H, z1)/H:
-                                            rec_HPeebles_dxedlna(xe_in, nH*1e-6, H, Tm_in*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1));
-    #elif (MODEL == RECFAST)
-         dxedlna = func_select==FUNC_HEI  ? rec_helium_dxedt(xe_in, param->nH0, param->T0, param->fHe, H, z1)/H:
-                                            rec_HRecFast_dxedlna(xe_in, nH*1e-6, H, Tm_in*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1));
-    #elif (MODEL == EMLA2s2p)
-         dxedlna = func_select==FUNC_HEI  ? rec_helium_dxedt(xe_in, param->nH0, param->T0, param->fHe, H, z1)/H:
-                                            rec_HMLA_dxedlna(xe_in, nH*1e-6, H, Tm_in*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1), rate_table);
-    #else
-         dxedlna = func_select==FUNC_HEI  ? rec_helium_dxedt(xe_in, param->nH0, param->T0, param->fHe, H, z1)/H:
-                   func_select==FUNC_H2G  ? rec_HMLA_2photon_dxedlna(xe_in, nH*1e-6, H, Tm_in*kBoltz, Tr*kBoltz, rate_table, twog_params,
-                                                                     param->zstart, param->dlna, logfminus_hist, logfminus_Ly_hist, iz, z1,
-																	 energy_injection_rate(param,z1)):
-	           func_select==FUNC_HMLA ? rec_HMLA_dxedlna(xe_in, nH*1e-6, H, Tm_in*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1), rate_table)
-                                           :rec_HPeebles_dxedlna(xe_in, nH*1e-6, H, Tm_in*kBoltz, Tr*kBoltz, energy_injection_rate(param,z1)); /* used for z < 20 only */
-    #endif
-
-	 dTmdlna = rec_dTmdlna(xe_in, Tm_in, Tr, H, param->fHe, nH*1e-6, energy_injection_rate(param,z1));
-
-    *xe_out = xe_in + param->dlna * (1.25 * dxedlna - 0.25 * (*dxedlna_prev2));
-    *Tm_out = Tm_in + param->dlna * (1.25 * dTmdlna - 0.25 * (*dTmdlna_prev2));
-
-    *z_prev2       = *z_prev;
-    *dxedlna_prev2 = *dxedlna_prev;
-    *dTmdlna_prev2 = *dTmdlna_prev;
-    *z_prev        = z1;
-    *dxedlna_prev  = dxedlna;
-    *dTmdlna_prev  = dTmdlna;
+    H = rec_HubbleConstant(param, z);
+    energy_rate = energy_injection_rate(param,z);
 
+    if (evolve_Tm == 0) *Tm = rec_Tmss(xe, Tr, H, param->fHe, nH*1e-6, energy_rate);
 
+    *dxedlna = func_select==FUNC_HEI ? rec_helium_dxedt(xe, param->nH0, param->T0, param->fHe, H, z)/H:
+                                       rec_hydrogen_dxedlna[param->model](param, xe, nH*1e-6, H, (*Tm)*kBoltz, Tr*kBoltz,
+                                                                          energy_rate, rate_table, func_select, iz, twog_params,
+                                                                          logfminus_hist, logfminus_Ly_hist, z);
+
+    if (evolve_Tm != 0) *dTmdlna = rec_dTmdlna(xe, *Tm, Tr, H, param->fHe, nH*1e-6, energy_rate);
 }
 
 /****************************************************************************************************
-Builds a recombination history
+Stores a new point of the recombination history, and fills all output redshifts which have been
+reached: outputs are either on this point, or obtained by cubic interpolation in ln(a) over the
+last four points (only needed when the output redshifts are not all points of the history)
 ****************************************************************************************************/
 
-void rec_build_history(REC_COSMOPARAMS *param, HRATEEFF *rate_table, TWO_PHOTON_PARAMS *twog_params,
-                       double *xe_output, double *Tm_output) {
+void rec_history_point(REC_HISTORY_OUTPUT *out, double lna, double xe, double Tm) {
 
+   int i, j;
+   double lna_out, weight;
 
-   long iz;
-   double **logfminus_hist;
-   double *logfminus_Ly_hist[3];
-   double H, z, z_prev, dxedlna_prev, z_prev2, dxedlna_prev2, dTmdlna_prev, dTmdlna_prev2;
-   double Delta_xe;
+   for (i = 3; i > 0; i--) {
+      out->lna[i] = out->lna[i-1];
+      out->xe[i]  = out->xe[i-1];
+      out->Tm[i]  = out->Tm[i-1];
+   }
+   out->lna[0] = lna;
+   out->xe[0]  = xe;
+   out->Tm[0]  = Tm;
+   if (out->npoints < 4) out->npoints++;
+
+   for (; out->iout < out->nz_output && (lna_out = -log(1.+out->z_output[out->iout])) <= lna; out->iout++) {
+      if (lna_out == lna) {
+         out->xe_output[out->iout] = xe;
+         out->Tm_output[out->iout] = Tm;
+      }
+      else {
+         out->xe_output[out->iout] = 0.;
+         out->Tm_output[out->iout] = 0.;
+         for (i = 0; i < out->npoints; i++) {
+            weight = 1.;
+            for (j = 0; j < out->npoints; j++)
+               if (j != i) weight *= (lna_out - out->lna[j])/(out->lna[i] - out->lna[j]);
+            out->xe_output[out->iout] += weight*out->xe[i];
+            out->Tm_output[out->iout] += weight*out->Tm[i];
+         }
+      }
+   }
+}
 
-   /* history of photon occupation numbers */
-   logfminus_hist = create_2D_array(NVIRT, param->nz);
-   logfminus_Ly_hist[0] = create_1D_array(param->nz);   /* Ly-alpha */
-   logfminus_Ly_hist[1] = create_1D_array(param->nz);   /* Ly-beta  */
-   logfminus_Ly_hist[2] = create_1D_array(param->nz);   /* Ly-gamma */
+/****************************************************************************************************
+Next point in a phase where xe is given by a Saha or post-Saha approximation: the next output
+redshift if it is closer than 2 param->dlna, otherwise a step of param->dlna
+****************************************************************************************************/
 
+void rec_next_point_saha(REC_COSMOPARAMS *param, REC_HISTORY_OUTPUT *out, double *lna, double *z) {
 
-   z = param->zstart;
+   double lna_out;
 
+   if (out->iout >= out->nz_output) return;
 
-   /********* He II + III Saha phase *********/
-   Delta_xe = 1.;   /* Delta_xe = xHeIII */
+   lna_out = -log(1.+out->z_output[out->iout]);
 
-   for(iz=0; iz<param->nz && Delta_xe > 1e-9; iz++) {
-      z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
-      xe_output[iz] = rec_sahaHeII(param->nH0,param->T0,param->fHe,z, &Delta_xe);
-      Tm_output[iz] = param->T0 * (1.+z);
+   if (lna_out - *lna <= 2.*param->dlna) {
+      *lna = lna_out;
+      *z = out->z_output[out->iout];
+   }
+   else {
+      *lna += param->dlna;
+      *z = exp(-*lna) - 1.;
    }
+}
 
-   /******* He I + II post-Saha phase *********/
-   Delta_xe = 0.;     /* Delta_xe = xe - xe(Saha) */
+/****************************************************************************************************
+Integrates xe (and Tm if evolve_Tm = 1, otherwise Tm is given by its steady-state value) from the
+current point, as long as the conditions of the phase defined by (func_select, evolve_Tm) hold.
+
+The integrator is second order, using the derivative at the current point and two points before.
+If fixed_grid = 1, steps are exactly param->dlna, on the uniform grid on which the photon
+occupation numbers are followed. Otherwise, steps are
+adapted such that the estimated local error remains below param->tol relative to xe (and Tm) per
+unit ln(a), and that the integration remains stable (Compton coupling of Tm, and linearised
+evolution of xe); they are bounded by param->dlna and param->dlna_max, and end exactly on the
+output redshifts and on the redshift z_stop at which the phase ends.
+****************************************************************************************************/
 
-   for (; iz<param->nz && Delta_xe < 5e-4; iz++) {
-      z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
-      xe_output[iz] = xe_PostSahaHe(param->nH0,param->T0,param->fHe, rec_HubbleConstant(param,z), z, &Delta_xe);
-      Tm_output[iz] = param->T0 * (1.+z);
+void rec_integrate_phase(REC_COSMOPARAMS *param, HRATEEFF *rate_table, TWO_PHOTON_PARAMS *twog_params,
+                         double **logfminus_hist, double *logfminus_Ly_hist[], int func_select, int evolve_Tm,
+                         int fixed_grid, double z_stop, REC_HISTORY_OUTPUT *out,
+                         long *iz, double *lna, double *z, double *xe, double *Tm) {
+
+   double lna_prev[3], dxedlna[3], dTmdlna[3];
+   int npoints, i, iold;
+   double h, h_try, h_try_prev, lna_next, lna_stop, lna_out, d2, slope, Tr, H, Tm_pert, dxedlna_pert, dTmdlna_pert;
+
+   npoints = 0;
+   h_try_prev = param->dlna;
+   lna_stop = -log(1.+z_stop);
+
+   while (out->iout < out->nz_output &&
+          (func_select == FUNC_HEI  ? (fabs(*xe - rec_saha_xe_H(param->nH0, param->T0, *z)) > 1e-4 || *z > 1650.) :
+           evolve_Tm == 0           ? (1.-*Tm/param->T0/(1.+*z) < 5e-4 && *z > z_stop) :
+                                      *z > z_stop)) {
+
+      /* derivatives at the current point */
+      for (i = 2; i > 0; i--) {
+         lna_prev[i] = lna_prev[i-1];
+         dxedlna[i] = dxedlna[i-1];
+         dTmdlna[i] = dTmdlna[i-1];
+      }
+      lna_prev[0] = *lna;
+      rec_get_derivatives(param, *z, *xe, Tm, evolve_Tm, rate_table, func_select, *iz, twog_params,
+                          logfminus_hist, logfminus_Ly_hist, dxedlna, dTmdlna);
+      if (npoints < 3) npoints++;
+
+      /* step size */
+      if (fixed_grid != 0) {
+         (*iz)++;
+         lna_next = -log(1.+param->zstart) + param->dlna*(*iz);
+      }
+      else {
+         h_try = param->dlna;
+
+         if (npoints == 3) {
+
+            /* local error of the second-order integrator, (2/3) h^3 |d2 x/dlna2| for steps of h */
+            h_try = param->dlna_max;
+            d2 = 2.*((dxedlna[0]-dxedlna[1])/(lna_prev[0]-lna_prev[1]) - (dxedlna[1]-dxedlna[2])/(lna_prev[1]-lna_prev[2]))
+               /(lna_prev[0]-lna_prev[2]);
+            if (d2 != 0.) h_try = fmin(h_try, sqrt(1.5*param->tol*fabs(*xe/d2)));
+            if (evolve_Tm != 0) {
+               d2 = 2.*((dTmdlna[0]-dTmdlna[1])/(lna_prev[0]-lna_prev[1]) - (dTmdlna[1]-dTmdlna[2])/(lna_prev[1]-lna_prev[2]))
+                  /(lna_prev[0]-lna_prev[2]);
+               if (d2 != 0.) h_try = fmin(h_try, sqrt(1.5*param->tol*fabs(*Tm/d2)));
+
+               /* stability: inverse Compton coupling time of Tm, in units of the Hubble time */
+               Tr = param->T0*(1.+*z);
+               H = rec_HubbleConstant(param, *z);
+               h_try = fmin(h_try, 1./(2. + 4.91466895548409e-22*Tr*Tr*Tr*Tr*(*xe)/(1.+*xe+param->fHe)/H));
+            }
+
+            /* stability: linearised evolution of xe around the current point */
+            Tm_pert = *Tm;
+            rec_get_derivatives(param, *z, *xe*(1.+1e-4), &Tm_pert, evolve_Tm, rate_table, func_select, *iz, twog_params,
+                                logfminus_hist, logfminus_Ly_hist, &dxedlna_pert, &dTmdlna_pert);
+            if (dxedlna_pert != dxedlna[0])
+               h_try = fmin(h_try, fabs(1e-4*(*xe)/(dxedlna_pert-dxedlna[0])));
+
+            h_try = fmax(fmin(h_try, 2.*h_try_prev), param->dlna);
+         }
+
+         h_try_prev = h_try;
+         lna_next = *lna + h_try;
+
+         /* end exactly on the next output redshift or on z_stop if they are reached within 1.1 steps */
+         if (out->iout < out->nz_output) {
+            lna_out = -log(1.+out->z_output[out->iout]);
+            if (*lna + 1.1*h_try >= lna_out) lna_next = lna_out;
+         }
+         if (*z > z_stop && *lna + 1.1*h_try >= lna_stop && lna_stop < lna_next) lna_next = lna_stop;
+      }
+
+      /* step */
+      h = lna_next - *lna;
+      iold = npoints-1;
+      slope = iold > 0 ? (dxedlna[0]-dxedlna[iold])/(lna_prev[0]-lna_prev[iold]) : 0.;
+      *xe += h*(dxedlna[0] + 0.5*h*slope);
+      if (evolve_Tm != 0) {
+         slope = iold > 0 ? (dTmdlna[0]-dTmdlna[iold])/(lna_prev[0]-lna_prev[iold]) : 0.;
+         *Tm += h*(dTmdlna[0] + 0.5*h*slope);
+      }
+
+      *lna = lna_next;
+      if (fixed_grid != 0)
+         *z = (1.+param->zstart)*exp(-param->dlna*(*iz)) - 1.;
+      else if (out->iout < out->nz_output && lna_next == -log(1.+out->z_output[out->iout]))
+         *z = out->z_output[out->iout];
+      else if (lna_next == lna_stop)
+         *z = z_stop;
+      else
+         *z = exp(-*lna) - 1.;
+
+      if (evolve_Tm == 0)
+         *Tm = rec_Tmss(*xe, param->T0*(1.+*z), rec_HubbleConstant(param, *z), param->fHe, param->nH0*cube(1.+*z)*1e-6,
+                        energy_injection_rate(param,*z));
+
+      rec_history_point(out, *lna, *xe, *Tm);
    }
+}
 
-   /****** Segment where we follow the helium recombination evolution, Tm fixed to steady state *******/
+/****************************************************************************************************
+Builds a recombination history, and returns xe and Tm at the nz_output redshifts z_output, in
+decreasing order between param->zstart and param->zend.
+
+Phases where xe follows a Saha or post-Saha approximation are evaluated directly at the output
+redshifts. In other phases, xe (and Tm) are integrated with adaptive steps, large where they vary
+slowly, which end on the output redshifts (see rec_integrate_phase). Hence no interpolation is
+needed on output, except with the full radiative transfer model (param->model == FULL): the photon
+occupation numbers are then followed on a uniform grid with step param->dlna, which is used for
+the phases where they are needed (H post-Saha and two-photon phases), and on which their
+thermal values are resampled at the end of the helium recombination phase.
+****************************************************************************************************/
 
-   z_prev2 = (1.+param->zstart)*exp(-param->dlna*(iz-3)) - 1.;
-   dxedlna_prev2 = (xe_output[iz-2] - xe_output[iz-4])/2./param->dlna;
+void rec_build_history(REC_COSMOPARAMS *param, HRATEEFF *rate_table, TWO_PHOTON_PARAMS *twog_params,
+                       long nz_output, double *z_output, double *xe_output, double *Tm_output) {
 
-   z_prev = (1.+param->zstart)*exp(-param->dlna*(iz-2)) - 1.;
-   dxedlna_prev = (xe_output[iz-1] - xe_output[iz-3])/2./param->dlna;
 
-   Delta_xe = 1.;  /* Difference between xe and H-Saha value */
+   long iz, iz_He;
+   double **logfminus_hist = NULL;
+   double *logfminus_Ly_hist[3] = {NULL, NULL, NULL};
+   double H, z, lna, xe, Tm, z_He;
+   double Delta_xe;
+   int radiative_transfer;
+   REC_HISTORY_OUTPUT out;
+
+   out.nz_output = nz_output;
+   out.z_output  = z_output;
+   out.xe_output = xe_output;
+   out.Tm_output = Tm_output;
+   out.iout      = 0;
+   out.npoints   = 0;
+
+   /* history of photon occupation numbers, on a uniform grid in ln(a) with step param->dlna */
+   radiative_transfer = (param->model == FULL);
+   if (radiative_transfer) {
+      logfminus_hist = create_2D_array(NVIRT, param->nz);
+      logfminus_Ly_hist[0] = create_1D_array(param->nz);   /* Ly-alpha */
+      logfminus_Ly_hist[1] = create_1D_array(param->nz);   /* Ly-beta  */
+      logfminus_Ly_hist[2] = create_1D_array(param->nz);   /* Ly-gamma */
+   }
 
-   for(; iz<param->nz && (Delta_xe > 1e-4 || z > 1650.); iz++) {
+   iz = 0;
+   z = param->zstart;
+   lna = -log(1.+z);
 
-      rec_get_xe_next1(param, z, xe_output[iz-1], xe_output+iz, rate_table, FUNC_HEI, iz-1, twog_params,
-		     logfminus_hist, logfminus_Ly_hist, &z_prev, &dxedlna_prev, &z_prev2, &dxedlna_prev2);
+   /********* He II + III Saha phase *********/
+   Delta_xe = 1.;   /* Delta_xe = xHeIII */
 
-      z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
-      Tm_output[iz] = rec_Tmss(xe_output[iz], param->T0*(1.+z), rec_HubbleConstant(param, z), param->fHe, param->nH0*cube(1.+z), energy_injection_rate(param,z));
+   for(; out.iout<nz_output && Delta_xe > 1e-9; rec_next_point_saha(param, &out, &lna, &z)) {
+      xe = rec_sahaHeII(param->nH0,param->T0,param->fHe,z, &Delta_xe);
+      Tm = param->T0 * (1.+z);
+      rec_history_point(&out, lna, xe, Tm);
+   }
 
-      /* Starting to populate the photon occupation number with thermal values */
-      update_fminus_Saha(logfminus_hist, logfminus_Ly_hist, xe_output[iz], param->T0*(1.+z)*kBoltz,
-                         param->nH0*cube(1.+z)*1e-6, twog_params, param->zstart, param->dlna, iz, z, 0);
+   /******* He I + II post-Saha phase *********/
+   Delta_xe = 0.;     /* Delta_xe = xe - xe(Saha) */
 
-      Delta_xe = fabs(xe_output[iz]- rec_saha_xe_H(param->nH0, param->T0, z));
-    }
+   while (out.iout<nz_output) {
+      xe = xe_PostSahaHe(param->nH0,param->T0,param->fHe, rec_HubbleConstant(param,z), z, &Delta_xe);
+      Tm = param->T0 * (1.+z);
+      rec_history_point(&out, lna, xe, Tm);
+      if (Delta_xe >= 5e-4) break;
+      rec_next_point_saha(param, &out, &lna, &z);
+   }
 
+   /****** Segment where we follow the helium recombination evolution, Tm fixed to steady state *******/
+
+   z_He = z;
+   rec_integrate_phase(param, rate_table, twog_params, logfminus_hist, logfminus_Ly_hist, FUNC_HEI, 0, 0, 1650.,
+                       &out, &iz, &lna, &z, &xe, &Tm);
+
+   /* Thermal photon occupation numbers on the uniform grid during helium recombination,
+      and first point of this grid after the current one. Without radiative transfer,
+      next output redshift (or step of param->dlna) */
+   if (radiative_transfer) {
+      iz_He = (long) ceil(log((1.+param->zstart)/(1.+z_He))/param->dlna);
+      iz = (long) floor(log((1.+param->zstart)/(1.+z))/param->dlna) + 1;
+      for (; iz_He < iz; iz_He++) {
+         z_He = (1.+param->zstart)*exp(-param->dlna*iz_He) - 1.;
+         update_fminus_Saha(logfminus_hist, logfminus_Ly_hist, xe, param->T0*(1.+z_He)*kBoltz,
+                            param->nH0*cube(1.+z_He)*1e-6, twog_params, param->zstart, param->dlna, iz_He, z_He, 0);
+      }
+      z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
+      lna = -log(1.+param->zstart) + param->dlna*iz;
+   }
+   else {
+      rec_next_point_saha(param, &out, &lna, &z);
+   }
 
    /******* Hydrogen post-Saha equilibrium phase *********/
    Delta_xe = 0.;  /*Difference between xe and Saha value */
 
-   for(; iz<param->nz && Delta_xe < 5e-5; iz++) {
-      z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
+   while (out.iout<nz_output) {
       H = rec_HubbleConstant(param,z);
-      xe_output[iz] =  xe_PostSahaH(param->nH0*cube(1.+z)*1e-6, H, kBoltz*param->T0*(1.+z), rate_table, twog_params,
-				    param->zstart, param->dlna, logfminus_hist, logfminus_Ly_hist, iz, z, &Delta_xe, MODEL, energy_injection_rate(param,z));
-      Tm_output[iz] = rec_Tmss(xe_output[iz], param->T0*(1.+z), H, param->fHe, param->nH0*cube(1.+z), energy_injection_rate(param,z));
-    }
-
-    /******* Segment where we follow the hydrogen recombination evolution with two-photon processes
-             Tm fixed to steady state ******/
-
-    z_prev2 = (1.+param->zstart)*exp(-param->dlna*(iz-3)) - 1.;
-    dxedlna_prev2 = (xe_output[iz-2] - xe_output[iz-4])/2./param->dlna;
-
-    z_prev = (1.+param->zstart)*exp(-param->dlna*(iz-2)) - 1.;
-    dxedlna_prev = (xe_output[iz-1] - xe_output[iz-3])/2./param->dlna;
+      xe =  xe_PostSahaH(param->nH0*cube(1.+z)*1e-6, H, kBoltz*param->T0*(1.+z), rate_table, twog_params,
+                         param->zstart, param->dlna, logfminus_hist, logfminus_Ly_hist, iz, z, &Delta_xe, param->model, energy_injection_rate(param,z));
+      Tm = rec_Tmss(xe, param->T0*(1.+z), H, param->fHe, param->nH0*cube(1.+z)*1e-6, energy_injection_rate(param,z));
+      rec_history_point(&out, lna, xe, Tm);
+      if (Delta_xe >= 5e-5) break;
+      if (radiative_transfer) {
+         iz++;
+         z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
+         lna = -log(1.+param->zstart) + param->dlna*iz;
+      }
+      else {
+         rec_next_point_saha(param, &out, &lna, &z);
+      }
+   }
 
-    for(; iz<param->nz && 1.-Tm_output[iz-1]/param->T0/(1.+z) < 5e-4 && z > 700.; iz++) {
+   /******* Segment where we follow the hydrogen recombination evolution with two-photon processes
+            Tm fixed to steady state ******/
 
-       rec_get_xe_next1(param, z, xe_output[iz-1], xe_output+iz, rate_table, FUNC_H2G, iz-1, twog_params,
-               	      logfminus_hist, logfminus_Ly_hist, &z_prev, &dxedlna_prev, &z_prev2, &dxedlna_prev2);
-       z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
-       Tm_output[iz] = rec_Tmss(xe_output[iz], param->T0*(1.+z), rec_HubbleConstant(param, z), param->fHe, param->nH0*cube(1.+z)*1e-6, energy_injection_rate(param,z));
-    }
+   rec_integrate_phase(param, rate_table, twog_params, logfminus_hist, logfminus_Ly_hist, FUNC_H2G, 0, radiative_transfer, 700.,
+                       &out, &iz, &lna, &z, &xe, &Tm);
 
    /******* Segment where we follow the hydrogen recombination evolution with two-photon processes
             AND Tm evolution ******/
 
-    dTmdlna_prev2 = rec_dTmdlna(xe_output[iz-3], Tm_output[iz-3], param->T0*(1.+z_prev2),
-                                rec_HubbleConstant(param, z_prev2), param->fHe, param->nH0*cube(1.+z_prev2), energy_injection_rate(param,z_prev2));
-    dTmdlna_prev  = rec_dTmdlna(xe_output[iz-2], Tm_output[iz-2], param->T0*(1.+z_prev),
-                                rec_HubbleConstant(param, z_prev), param->fHe, param->nH0*cube(1.+z_prev), energy_injection_rate(param,z_prev));
+   rec_integrate_phase(param, rate_table, twog_params, logfminus_hist, logfminus_Ly_hist, FUNC_H2G, 1, radiative_transfer, 700.,
+                       &out, &iz, &lna, &z, &xe, &Tm);
 
-    for(; iz<param->nz && z > 700.; iz++) {
+   /***** Segment where we follow Tm as well as xe *****/
+   /* Radiative transfer effects switched off here */
 
-        rec_get_xe_next2(param, z, xe_output[iz-1], Tm_output[iz-1], xe_output+iz, Tm_output+iz, rate_table, FUNC_H2G,
-                        iz-1, twog_params, logfminus_hist, logfminus_Ly_hist, &z_prev, &dxedlna_prev, &dTmdlna_prev,
-                        &z_prev2, &dxedlna_prev2, &dTmdlna_prev2);
-        z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
-     }
+   rec_integrate_phase(param, rate_table, twog_params, logfminus_hist, logfminus_Ly_hist, FUNC_HMLA, 1, 0, 20.,
+                       &out, &iz, &lna, &z, &xe, &Tm);
 
-    /***** Segment where we follow Tm as well as xe *****/
-    /* Radiative transfer effects switched off here */
-    for(; iz<param->nz && z>20.; iz++) {
-
-        rec_get_xe_next2(param, z, xe_output[iz-1], Tm_output[iz-1], xe_output+iz, Tm_output+iz, rate_table, FUNC_HMLA,
-                        iz-1, twog_params, logfminus_hist, logfminus_Ly_hist, &z_prev, &dxedlna_prev, &dTmdlna_prev,
-                        &z_prev2, &dxedlna_prev2, &dTmdlna_prev2);
-        z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
-    }
-
-    /*** For z < 20 use Peeble's model. The precise model does not metter much here as
+   /*** For z < 20 use Peeble's model. The precise model does not metter much here as
             1) the free electron fraction is basically zero (~1e-4) in any case and
             2) the universe is going to be reionized around that epoch
          Tm is still evolved explicitly ***/
-    for(; iz<param->nz; iz++) {
 
-        rec_get_xe_next2(param, z, xe_output[iz-1], Tm_output[iz-1], xe_output+iz, Tm_output+iz, rate_table, FUNC_PEEBLES,
-                        iz-1, twog_params, logfminus_hist, logfminus_Ly_hist, &z_prev, &dxedlna_prev, &dTmdlna_prev,
-                        &z_prev2, &dxedlna_prev2, &dTmdlna_prev2);
-        z = (1.+param->zstart)*exp(-param->dlna*iz) - 1.;
-    }
+   rec_integrate_phase(param, rate_table, twog_params, logfminus_hist, logfminus_Ly_hist, FUNC_PEEBLES, 1, 0, param->zend,
+                       &out, &iz, &lna, &z, &xe, &Tm);
 
-    /* Cleanup */
-    free_2D_array(logfminus_hist, NVIRT);
-    free(logfminus_Ly_hist[0]);
-    free(logfminus_Ly_hist[1]);
-    free(logfminus_Ly_hist[2]);
+   /* Cleanup */
+   if (radiative_transfer) {
+      free_2D_array(logfminus_hist, NVIRT);
+      free(logfminus_Ly_hist[0]);
+      free(logfminus_Ly_hist[1]);
+      free(logfminus_Ly_hist[2]);
+   }
 
 }
 
@@ -8,16 +8,21 @@
 
 #define PROMPT 1      /* Set to zero to suppress initial prompts */
 
-/**** Switch to choose the physical model used for hydrogen ****/ 
+/**** Physical models used for hydrogen, chosen at run time with param->model ****/
 
 /* definitions*/
 #define PEEBLES   0    /* Peebles effective three-level atom */
 #define RECFAST   1    /* Effective three-level atom for hydrogen with fudge factor F = 1.14 */
 #define EMLA2s2p  2    /* Correct EMLA model, with standard decay rates from 2s and 2p only */
 #define FULL      3    /* All radiative transfer effects included. Additional switches in header file hydrogen.h */
+#define NMODELS   4    /* number of models */
 
-/** here is the switch **/
-#define MODEL RECFAST     /* default setting: FULL */
+#define DEFAULT_MODEL RECFAST     /* default setting of rec_get_cosmoparam */
+
+/* Which tables does each model need? The effective rates (Alpha_inf, R_inf) for EMLA2s2p and FULL,
+   the two-photon rates only for FULL */
+#define MODEL_NEEDS_RATES(model)      ((model) == EMLA2s2p || (model) == FULL)
+#define MODEL_NEEDS_TWO_PHOTON(model) ((model) == FULL)
 
 /***** Switches for derivative d(xe)/dt *****/
 
@@ -40,8 +45,12 @@ typedef struct {
    double nH0;                  /* density of hydrogen today in m^{-3} */  
    double fHe;                  /* Helium fraction by number */
 
+   int model;                   /* physical model for hydrogen: PEEBLES, RECFAST, EMLA2s2p or FULL */
+
    double zstart, zend, dlna;   /* initial and final redshift and step size in log a */
    long nz;                     /* total number of redshift steps */
+   double dlna_max;             /* maximum step size in log a where xe is integrated with adaptive steps (no larger than dlna: fixed steps) */
+   double tol;                  /* local error aimed at by adaptive steps, relative to xe and Tm, per unit log a */
 
    /** parameters for energy injection */
 
@@ -79,20 +88,57 @@ typedef struct {
 
 } REC_COSMOPARAMS;
 
+/**** Output of a recombination history at given redshifts,
+      and last points computed (most recent first) for interpolating between them ****/
+
+typedef struct {
+   long nz_output;              /* number of output redshifts */
+   double *z_output;            /* output redshifts, in decreasing order */
+   double *xe_output;           /* xe at output redshifts */
+   double *Tm_output;           /* Tm at output redshifts */
+   long iout;                   /* index of the next output redshift to be filled */
+   double lna[4], xe[4], Tm[4]; /* last points of the history */
+   int npoints;                 /* number of points stored in lna, xe, Tm */
+} REC_HISTORY_OUTPUT;
+
+/**** Derivative d(xe)/dln(a) of hydrogen recombination in each model, for all phases except helium
+      recombination (func_select = FUNC_H2G, FUNC_HMLA or FUNC_PEEBLES) ****/
+
+typedef double (*REC_HYDROGEN_DXEDLNA)(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                                       double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                                       TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist,
+                                       double *logfminus_Ly_hist[], double z);
+
+double rec_dxedlna_peebles(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                           double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                           TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist, double *logfminus_Ly_hist[], double z);
+double rec_dxedlna_recfast(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                           double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                           TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist, double *logfminus_Ly_hist[], double z);
+double rec_dxedlna_emla2s2p(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                            double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                            TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist, double *logfminus_Ly_hist[], double z);
+double rec_dxedlna_full(REC_COSMOPARAMS *param, double xe, double nH, double H, double TM, double TR,
+                        double energy_rate, HRATEEFF *rate_table, int func_select, unsigned iz,
+                        TWO_PHOTON_PARAMS *twog_params, double **logfminus_hist, double *logfminus_Ly_hist[], double z);
+
+extern const REC_HYDROGEN_DXEDLNA rec_hydrogen_dxedlna[NMODELS];  /* indexed by param->model */
+
 void rec_get_cosmoparam(FILE *fin, FILE *fout, REC_COSMOPARAMS *param);
 double rec_HubbleConstant(REC_COSMOPARAMS *param, double z);
 double rec_Tmss(double xe, double Tr, double H, double fHe, double nH, double energy_rate);
 double rec_dTmdlna(double xe, double Tm, double Tr, double H, double fHe , double nH, double energy_rate);
-void rec_get_xe_next1(REC_COSMOPARAMS *param, double z1, double xe_in, double *xe_out,
-                      HRATEEFF *rate_table, int func_select, unsigned iz, TWO_PHOTON_PARAMS *twog_params,
-		      double **logfminus_hist, double *logfminus_Ly_hist[], 
-                      double *z_prev, double *dxedlna_prev, double *z_prev2, double *dxedlna_prev2);
-void rec_get_xe_next2(REC_COSMOPARAMS *param, double z1, double xe_in, double Tm_in, double *xe_out, double *Tm_out,
-                      HRATEEFF *rate_table, int func_select, unsigned iz, TWO_PHOTON_PARAMS *twog_params,
-		      double **logfminus_hist, double *logfminus_Ly_hist[], 
-                      double *z_prev, double *dxedlna_prev, double *dTmdlna_prev, 
-                      double *z_prev2, double *dxedlna_prev2, double *dTmdlna_prev2);
+void rec_get_derivatives(REC_COSMOPARAMS *param, double z, double xe, double *Tm, int evolve_Tm,
+                         HRATEEFF *rate_table, int func_select, unsigned iz, TWO_PHOTON_PARAMS *twog_params,
+                         double **logfminus_hist, double *logfminus_Ly_hist[],
+                         double *dxedlna, double *dTmdlna);
+void rec_history_point(REC_HISTORY_OUTPUT *out, double lna, double xe, double Tm);
+void rec_next_point_saha(REC_COSMOPARAMS *param, REC_HISTORY_OUTPUT *out, double *lna, double *z);
+void rec_integrate_phase(REC_COSMOPARAMS *param, HRATEEFF *rate_table, TWO_PHOTON_PARAMS *twog_params,
+                         double **logfminus_hist, double *logfminus_Ly_hist[], int func_select, int evolve_Tm,
+                         int fixed_grid, double z_stop, REC_HISTORY_OUTPUT *out,
+                         long *iz, double *lna, double *z, double *xe, double *Tm);
 void rec_build_history(REC_COSMOPARAMS *param, HRATEEFF *rate_table, TWO_PHOTON_PARAMS *twog_params,
-                       double *xe_output, double *Tm_output);
+                       long nz_output, double *z_output, double *xe_output, double *Tm_output);
 
 double energy_injection_rate(REC_COSMOPARAMS *param, double z);
@@ -25,45 +25,47 @@ int main(void) {
    REC_COSMOPARAMS param;
    HRATEEFF rate_table;
    TWO_PHOTON_PARAMS twog_params;
-   double *xe_output, *Tm_output;
+   double *z_output, *xe_output, *Tm_output;
    long iz;
 
    double dz = -1;
    unsigned nz = 8001;
    double z, xe, Tm;
 
-      
-    /* Build effective rate table */
+
+   /* Get cosmological parameters */
+   rec_get_cosmoparam(stdin, stderr, &param);
+
+    /* Build effective rate table (only read if the model uses it) */
    rate_table.logTR_tab = create_1D_array(NTR);
    rate_table.TM_TR_tab = create_1D_array(NTM);
    rate_table.logAlpha_tab[0] = create_2D_array(NTM, NTR);
    rate_table.logAlpha_tab[1] = create_2D_array(NTM, NTR);
    rate_table.logR2p2s_tab = create_1D_array(NTR);
-   read_rates(&rate_table);
+   if (MODEL_NEEDS_RATES(param.model)) read_rates(&rate_table);
   
    /* Read two-photon rate tables */
-   read_twog_params(&twog_params);
+   if (MODEL_NEEDS_TWO_PHOTON(param.model)) read_twog_params(&twog_params);
 
+   /* Compute the recombination history at the desired output redshifts */
+   z_output = (double*)malloc((size_t)(nz*sizeof(double)));
+   xe_output = (double*)malloc((size_t)(nz*sizeof(double)));
+   Tm_output = (double*)malloc((size_t)(nz*sizeof(double)));
 
-   /* Get cosmological parameters */
-   rec_get_cosmoparam(stdin, stderr, &param);
+   for(iz=0; iz<nz; iz++) z_output[iz] = param.zstart + dz * iz;    /* print output every dz */
 
-   /* Compute the recombination history */
-   xe_output = (double*)malloc((size_t)(param.nz*sizeof(double)));
-   Tm_output = (double*)malloc((size_t)(param.nz*sizeof(double)));
-  
-   rec_build_history(&param, &rate_table, &twog_params, xe_output, Tm_output);
+   rec_build_history(&param, &rate_table, &twog_params, nz, z_output, xe_output, Tm_output);
 
-   /* Interpolate at the desired output redshifts */
    for(iz=0; iz<nz; iz++) {
-       z = param.zstart + dz * iz;    /* print output every dz */
-       xe = rec_interp1d(-log(1.+param.zstart), param.dlna, xe_output, param.nz, -log(1.+z));
-       Tm = rec_interp1d(-log(1.+param.zstart), param.dlna, Tm_output, param.nz, -log(1.+z));
+       z = z_output[iz];
+       xe = xe_output[iz];
+       Tm = Tm_output[iz];
        printf("%7.2lf %15.13lf %15.13lf\n", z, xe, Tm/param.T0/(1.+z));
    }
    
  
     /* Cleanup */
+    free((char*)z_output);
     free((char*)xe_output);
     free((char*)Tm_output);
     free(rate_table.logTR_tab);
@@ -6,6 +6,7 @@
 #define __ARRAYS__
 
 #include "common.h"
+#include "buffer_pool.h"
 
 #define _SPLINE_NATURAL_ 0 /**< natural spline: ddy0=ddyn=0 */
 #define _SPLINE_EST_DERIV_ 1 /**< spline with estimation of first derivative on both edges */
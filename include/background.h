@@ -10,6 +10,7 @@
 #include "dei_rkck.h"
 #include "parser.h"
 #include "rootfinder.h"
+#include "table_cache.h"
 
 /** list of possible types of spatial curvature */
 
@@ -172,6 +173,10 @@ struct background
   int tuning_index_2_smg;     /**< index in scf_parameters used for tuning (the Planck mass) */
   double M_pl_today_smg;
 
+  short has_sensitivity_smg; /**< integrate the sensitivities of the {B} variables to parameters_smg[sensitivity_index_smg] along with the background (used by the shooting) */
+  int sensitivity_index_smg; /**< index in parameters_smg of the parameter of the sensitivities */
+  double * sensitivity_today_smg; /**< if has_sensitivity_smg: derivative of each background quantity depending only on the {B} variables, evaluated today, with respect to the parameter, sensitivity_today_smg[index_bg] */
+
   short output_background_smg; /**< flag regulating the amount of information printed onbackground.dat output */
 
   //some thermo parameters: little cheat to be able to call sigma(rs_d), etc..
@@ -396,6 +401,7 @@ struct background
   int index_bi_tau;     /**< {C} conformal time in Mpc */
   int index_bi_D;       /**< {C} scale independent growth factor D(a) for CDM perturbations. */
   int index_bi_D_prime; /**< {C} D satisfies \f$ [D''(\tau)=-aHD'(\tau)+3/2 a^2 \rho_M D(\tau) \f$ */
+  int index_bi_sensitivity_smg; /**< {C} first of the bi_B_size sensitivities \f$ \partial y_B/\partial p \f$ (if has_sensitivity_smg) */
 
   int bi_B_size;        /**< Number of {B} parameters */
   int bi_size;          /**< Number of {B}+{C} parameters */
@@ -466,6 +472,8 @@ struct background
 
   short shooting_failed;  /**< flag is set to true if shooting failed. */
 
+  int shooting_fevals;  /**< number of computations used by the shooting (zero if no shooting). */
+
   ErrorMsg shooting_error; /**< Error message from shooting failed. */
 
   short background_verbose; /**< flag regulating the amount of information sent to standard output (none if set to zero) */
@@ -487,6 +495,17 @@ struct background_parameters_and_workspace {
   /* workspace */
   double * pvecback;
 
+  /* for the sensitivities (if pba->has_sensitivity_smg): step in the
+     parameter, copy of the background structure (without
+     sensitivities) in which this parameter can be shifted, its own
+     parameters and workspace, and workspace for the variables and
+     their derivatives */
+  double sensitivity_step;
+  struct background * pba_sensitivity;
+  struct background_parameters_and_workspace * pbpaw_sensitivity;
+  double * y_sensitivity;
+  double * dy_sensitivity;
+
 };
 
 /**
@@ -536,6 +555,22 @@ extern "C" {
                           double * tau
                           );
 
+  int background_at_tau_vector(
+                               struct background *pba,
+                               double * tau_array,
+                               int tau_size,
+                               int index_bg,
+                               double * result
+                               );
+
+  int background_at_z_vector(
+                             struct background *pba,
+                             double * z_array,
+                             int z_size,
+                             int index_bg,
+                             double * result
+                             );
+
   int background_functions(
 			   struct background *pba,
 			   double * pvecback_B,
@@ -583,6 +618,12 @@ extern "C" {
 				     double * test
 				     );
 
+  int background_read_ncdm_psd_table(
+                                     char * filename,
+                                     struct file_table * table,
+                                     ErrorMsg error_message
+                                     );
+
   int background_ncdm_init(
 			    struct precision *ppr,
 			    struct background *pba
@@ -633,6 +674,23 @@ extern "C" {
 				    double * pvecback_integration
 				    );
 
+  int background_initial_conditions_sensitivity_smg(
+                                                    struct precision *ppr,
+                                                    struct background *pba,
+                                                    struct background_parameters_and_workspace * pbpaw,
+                                                    double * pvecback_integration
+                                                    );
+
+  int background_free_sensitivity_smg(
+                                      struct background_parameters_and_workspace * pbpaw
+                                      );
+
+  int background_sensitivity_today_smg(
+                                       struct background *pba,
+                                       double * pvecback_integration,
+                                       struct background_parameters_and_workspace * pbpaw
+                                       );
+
   int background_find_equality(
                                struct precision *ppr,
                                struct background *pba
@@ -655,6 +713,14 @@ extern "C" {
 			 ErrorMsg error_message
 			 );
 
+  int background_derivs_sensitivity_smg(
+                                        double tau,
+                                        double * y,
+                                        double * dy,
+                                        struct background_parameters_and_workspace * pbpaw,
+                                        ErrorMsg error_message
+                                        );
+
   /** Scalar field potential and its derivatives **/
   double V_scf(
                struct background *pba,
@@ -737,6 +803,8 @@ extern "C" {
 #define _PSD_DERIVATIVE_EXP_MIN_ -30 /**< for ncdm, for accurate computation of dlnf0/dlnq, q step is varied in range specified by these parameters */
 #define _PSD_DERIVATIVE_EXP_MAX_ 2  /**< for ncdm, for accurate computation of dlnf0/dlnq, q step is varied in range specified by these parameters */
 
+#define _SENSITIVITY_STEP_SMG_ 1.e-5 /**< relative step in the parameter for the directional derivatives of the background equations giving the sensitivities */
+
 #define _zeta3_ 1.2020569031595942853997381615114499907649862923404988817922 /**< for quandrature test function */
 #define _zeta5_ 1.0369277551433699263313654864570341680570809195019128119741 /**< for quandrature test function */
 
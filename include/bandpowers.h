@@ -0,0 +1,108 @@
+/** @file bandpowers.h Documented includes for bandpowers module */
+
+#ifndef __BANDPOWERS__
+#define __BANDPOWERS__
+
+#include "lensing.h"
+
+/**
+ * List of C_l types which can be binned into bandpowers. For the
+ * number count (d) and galaxy lensing (l) types, the bandpower also
+ * refers to one or two redshift bins.
+ */
+
+enum bandpower_type {bp_tt, bp_ee, bp_te, bp_bb, bp_pp, bp_tp, bp_ep, bp_dd, bp_td, bp_pd, bp_ll, bp_tl, bp_dl};
+
+/**
+ * Structure containing a list of window functions, each of them
+ * defining a bandpower as a weighted sum of C_l's of a given type over
+ * a range of multipoles.
+ *
+ * The windows are set once with bandpowers_add_window() or
+ * bandpowers_read_windows(), and can then be applied with
+ * bandpowers_compute() to the spectra and lensing structures of any
+ * number of cosmological models. Only the non-zero range
+ * [l_min,l_max] of each window is stored.
+ */
+
+struct bandpowers {
+
+  int bp_size;                /**< number of bandpowers */
+
+  enum bandpower_type * type; /**< type of C_l's for each bandpower */
+  int * bin1;                 /**< first redshift bin for each bandpower (number count and galaxy lensing types only) */
+  int * bin2;                 /**< second redshift bin for each bandpower (dd, ll and dl types only) */
+  short * lensed;             /**< for each bandpower, _TRUE_ if it applies to lensed C_l's */
+
+  int * l_min;                /**< first multipole with non-zero weight, for each bandpower */
+  int * l_max;                /**< last multipole with non-zero weight, for each bandpower */
+  int * offset;               /**< for each bandpower, index of the weight at l_min in the array weight */
+  double * weight;            /**< weights of all bandpowers, weight[offset[index_bp]+l-l_min[index_bp]] */
+  int weight_size;            /**< size of the array weight */
+
+  short bandpowers_verbose;   /**< flag regulating the amount of information sent to standard output (none if set to zero) */
+
+  ErrorMsg error_message;     /**< zone for writing error messages */
+
+};
+
+/*************************************************************************************************************/
+/* @cond INCLUDE_WITH_DOXYGEN */
+/*
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  int bandpowers_init(
+                      struct bandpowers * pbp
+                      );
+
+  int bandpowers_free(
+                      struct bandpowers * pbp
+                      );
+
+  int bandpowers_type_from_name(
+                                char * name,
+                                enum bandpower_type * type,
+                                ErrorMsg error_message
+                                );
+
+  int bandpowers_add_window(
+                            struct bandpowers * pbp,
+                            char * type_name,
+                            int bin1,
+                            int bin2,
+                            short lensed,
+                            int l_min,
+                            int l_max,
+                            double * weight
+                            );
+
+  int bandpowers_read_windows(
+                              struct bandpowers * pbp,
+                              char * filename
+                              );
+
+  int bandpowers_index_ct(
+                          struct spectra * psp,
+                          struct lensing * ple,
+                          struct bandpowers * pbp,
+                          int index_bp,
+                          int * index_ct
+                          );
+
+  int bandpowers_compute(
+                         struct spectra * psp,
+                         struct lensing * ple,
+                         struct bandpowers * pbp,
+                         double * bandpower
+                         );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* @endcond */
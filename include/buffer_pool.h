@@ -0,0 +1,79 @@
+/** @file buffer_pool.h Documented includes for the pool of large buffers reused across runs */
+
+#ifndef __BUFFER_POOL__
+#define __BUFFER_POOL__
+
+#include "common.h"
+
+/** buffers smaller than this size (in bytes) are never kept in the pool */
+#define _BUFFER_POOL_MIN_SIZE_ 1048576
+
+/**
+ * Header stored in front of each buffer returned by
+ * buffer_pool_malloc(). Its size is rounded up to _BUFFER_POOL_ALIGN_
+ * bytes, such that the buffers keep the alignment of malloc().
+ */
+
+struct buffer_pool_header {
+
+  size_t capacity;                  /**< usable size of the buffer in bytes */
+  int generation;                   /**< value of the pool generation when the buffer was returned to the pool */
+  struct buffer_pool_header * next; /**< next free buffer in the pool */
+
+};
+
+#define _BUFFER_POOL_ALIGN_ 16
+#define _BUFFER_POOL_HEADER_SIZE_ (((sizeof(struct buffer_pool_header)+_BUFFER_POOL_ALIGN_-1)/_BUFFER_POOL_ALIGN_)*_BUFFER_POOL_ALIGN_)
+
+/**
+ * Allocate a buffer which can be taken from the pool, with the same
+ * syntax as class_alloc(). Buffers allocated in this way must be
+ * freed with buffer_pool_free(), and their content is not
+ * initialised.
+ */
+
+#define class_alloc_pooled(pointer, size, error_message_output)  {                          \
+    pointer = buffer_pool_malloc(size);                                                     \
+    if (pointer == NULL) {                                                                  \
+      int size_int;                                                                         \
+      size_int = size;                                                                      \
+      class_alloc_message(error_message_output,#pointer, size_int);                         \
+      return _FAILURE_;                                                                     \
+    }                                                                                       \
+  }
+
+/*************************************************************************************************************/
+/* @cond INCLUDE_WITH_DOXYGEN */
+/*
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  void * buffer_pool_malloc(
+                            size_t size
+                            );
+
+  void buffer_pool_free(
+                        void * pointer
+                        );
+
+  int buffer_pool_retain(
+                         int * client_generation
+                         );
+
+  int buffer_pool_release(
+                          int * client_generation
+                          );
+
+  int buffer_pool_trim(
+                       int * client_generation
+                       );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* @endcond */
@@ -17,6 +17,10 @@
 #include "arrays.h"
 #include "dei_rkck.h"
 #include "parser.h"
+#include "table_cache.h"
+#include "buffer_pool.h"
+#include "emulator.h"
+#include "fftlog.h"
 
 /* class modules */
 #include "common.h"
@@ -29,6 +33,7 @@
 #include "transfer.h"
 #include "spectra.h"
 #include "lensing.h"
+#include "bandpowers.h"
 #include "output.h"
 
 #endif
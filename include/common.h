@@ -485,6 +485,8 @@ struct precision
   FileName hyrec_R_inf_file;
   FileName hyrec_two_photon_tables_file;
 /* @endcond */
+  double hyrec_dlna_max;   /**< maximum step in ln(a) of HyRec where the ionization fraction is integrated with adaptive steps (no larger than 8.49e-5: fixed steps, like in the original HyRec) */
+  double hyrec_tolerance;  /**< local error of HyRec adaptive steps, relative to x_e and T_b, per unit ln(a) */
   /* - for reionization */
 
   double reionization_z_start_max; /**< maximum redshift at which reionization should start. If not, return an error. */
@@ -569,6 +571,8 @@ struct precision
    */
   double perturb_sampling_stepsize;
 
+  int perturb_omp_chunk; /**< number of consecutive wavenumbers handed out at once to each thread in the parallel loop over k of the perturbation module */
+
   /**
    * control parameter for the precision of the perturbation integration
    */
@@ -649,6 +653,10 @@ struct precision
 
   double k_per_decade_primordial; /**< logarithmic sampling for primordial spectra (number of points per decade in k space) */
 
+  double primordial_feature_tol; /**< tolerance on ln P(k) for resolving features (e.g. oscillations) in the primordial spectra: the table is refined where cubic interpolation between neighbouring points misses a tabulated value by more than this, and so is the q grid of the transfer functions (flat case only) where it misses the table. Zero to disable */
+
+  int primordial_feature_max_refinement; /**< maximum number of bisections of the initial step in ln(k) when refining the table of primordial spectra around features */
+
   double primordial_inflation_ratio_min; /**< for each k, start following wavenumber when aH = k/primordial_inflation_ratio_min */
   double primordial_inflation_ratio_max; /**< for each k, stop following wavenumber, at the latest, when aH = k/primordial_inflation_ratio_max */
   int primordial_inflation_phi_ini_maxit;      /**< maximum number of iteration when searching a suitable initial field value phi_ini (value reached when no long-enough slow-roll period before the pivot scale) */
@@ -721,6 +729,13 @@ struct precision
                                  q_logstep_spline steps (transition
                                  must be smooth for spline) */
 
+  int q_feature_max_refinement; /**< in the flat case, maximum factor
+                                   (as a power of two) by which the
+                                   density of q values is increased
+                                   around features of the primordial
+                                   spectra (see
+                                   primordial_feature_tol) */
+
   double transfer_neglect_delta_k_S_t0; /**< for temperature source function T0 of scalar mode, range of k values (in 1/Mpc) taken into account in transfer function: for l < (k-delta_k)*tau0, ie for k > (l/tau0 + delta_k), the transfer function is set to zero */
   double transfer_neglect_delta_k_S_t1; /**< same for temperature source function T1 of scalar mode */
   double transfer_neglect_delta_k_S_t2; /**< same for temperature source function T2 of scalar mode */
@@ -735,6 +750,22 @@ struct precision
 
   double transfer_neglect_late_source;  /**< value of l below which the CMB source functions can be neglected at late time, excepted when there is a Late ISW contribution */
 
+  double transfer_pruning_tolerance; /**< if positive (flat case only), skip the line-of-sight integrals of the (q,l) pairs with the smallest predicted contributions to the C_l's (relative to the work saved), as long as the sum of their contributions remains below this fraction of the C_l's */
+  int transfer_pruning_stride; /**< when pruning is enabled, transfer functions are first computed at every transfer_pruning_stride wavenumber, for predicting their amplitude at other wavenumbers */
+
+  int transfer_omp_chunk; /**< number of consecutive wavenumbers handed out at once to each thread in the parallel loop over q of the transfer module (each of them computing the transfer functions for all l) */
+
+  int fftlog_lss; /**< if 1 (flat case only, number counts with the density term only), compute the C_l's of density number counts and galaxy lensing up to fftlog_l_max without the Limber approximation, with an FFTLog decomposition of the sources in k and analytic integrals over pairs of Bessel functions (see spectra_cls_fftlog()). The line-of-sight integrals of these types are then skipped up to fftlog_l_max, unless cross-correlations with the CMB are requested */
+  int fftlog_l_max; /**< largest multipole for which these C_l's are computed with FFTLog */
+  int fftlog_k_size; /**< number of logarithmically spaced wavenumbers in the FFTLog decomposition (power of two); the range of wavenumbers of the sources is zero-padded up to this number */
+  double fftlog_dlnk; /**< step in ln(k) of the FFTLog decomposition */
+  double fftlog_bias_density; /**< real part of the power-law exponents of the FFTLog decomposition for pairs of windows involving density (between -4 and 2, not an integer); the integrand should decrease at both ends of the range in k once divided by k^bias */
+  double fftlog_bias_lensing; /**< same for pairs of lensing windows, whose integrand is much steeper at small k */
+  double fftlog_taper; /**< width in ln(k) of the smooth window taking the sources to zero, centered on both ends of the range of the C_l's */
+  int fftlog_t_sampling; /**< number of intervals of the uniform grid in the ratio of the two comoving distances, between 0 and 1 */
+  int fftlog_chi_sampling; /**< number of points of the uniform grid in comoving distance over each window function */
+  double fftlog_kernel_tolerance; /**< relative tolerance below which the Bessel kernel is neglected at small ratios of the comoving distances */
+
   /** when to use the Limber approximation for project gravitational potential cl's */
   double l_switch_limber;
 
@@ -813,6 +844,14 @@ struct precision
   double tol_gauss_legendre; /**< tolerance with which quadrature points are found: must be very small for an accurate integration (if not entered manually, set automatically to match machine precision) */
   //@}
 
+  /** @name - parameters of the coarse precision profile (see input_coarse_precision()) */
+
+  //@{
+
+  double coarse_sampling_factor; /**< in the coarse profile, the steps in k and l are multiplied by this factor */
+  double coarse_tolerance_factor; /**< in the coarse profile, tol_perturb_integration is multiplied by this factor */
+  //@}
+
   /** @name - general precision parameters */
 
   //@{
@@ -7,6 +7,7 @@ struct generic_integrator_workspace
 {
 
   int n;
+  int n_error; /**< number of first components entering the error test (n by default; the others follow the steps chosen for them) */
 
   double * yscal;
   double * y;
@@ -0,0 +1,186 @@
+/** @file emulator.h Documented includes for the local emulator of C_l's and P(k) */
+
+#ifndef __EMULATOR__
+#define __EMULATOR__
+
+#include "common.h"
+#include "parser.h"
+
+/**
+ * Types of C_l's which can be emulated, in the same order as
+ * Engine::cltype in the C++ wrapper (p stands for the lensing
+ * potential phi)
+ */
+
+enum emulator_cl_type {emu_tt, emu_ee, emu_te, emu_bb, emu_pp, emu_tp, emu_ep};
+
+/** maximum number of types of C_l's */
+#define _EMULATOR_CL_TYPES_ 7
+
+/** value identifying emulator files */
+#define _EMULATOR_MAGIC_ 0x554d4543
+
+/** version of the emulator file format */
+#define _EMULATOR_VERSION_ 1
+
+/**
+ * Surrogate model of the C_l's and of the linear P(k,z) of CLASS, as
+ * a function of a few parameters varied in a box around a fiducial
+ * model, all other parameters being fixed.
+ *
+ * The emulated quantities are gathered in one output vector: first
+ * the C_l's of each type for l=2...l_max, then ln P(k,z) for each z
+ * and each k of the grids. Each element is rescaled into a
+ * dimensionless deviation from the fiducial model: (C_l -
+ * C_l^fid)/|C_l^fid| for auto-spectra, the same divided by
+ * sqrt(|C_l^XX,fid C_l^YY,fid|) for cross-spectra, and ln P - ln
+ * P^fid. These deviations are compressed with a principal component
+ * analysis of a design of full runs, and the coefficient of each
+ * component is fitted by a quadratic polynomial in the parameters
+ * (by least squares, with more runs than polynomial terms).
+ *
+ * The error estimate combines the residual variance of each fit,
+ * amplified by the leverage of the requested point (larger near the
+ * edges of the box), and the error due to the truncation of the
+ * principal components.
+ */
+
+struct emulator {
+
+  /** @name - parameters */
+
+  //@{
+
+  int par_size;            /**< number of emulated parameters */
+  FileArg * par_name;      /**< names of the emulated parameters */
+  double * par_fiducial;   /**< fiducial values of the parameters (center of the box) */
+  double * par_width;      /**< half-width of the box in each parameter */
+
+  int fixed_size;          /**< number of other parameters, fixed in the training runs */
+  FileArg * fixed_name;    /**< names of these parameters */
+  FileArg * fixed_value;   /**< values of these parameters */
+
+  //@}
+
+  /** @name - emulated quantities */
+
+  //@{
+
+  int l_max;               /**< largest emulated multipole (no C_l's if smaller than 2) */
+  int cl_type_size;        /**< number of types of C_l's */
+  int * cl_type;           /**< types of C_l's (see enum emulator_cl_type), in the order of the output vector */
+
+  int k_size;              /**< number of wavenumbers for P(k,z) (no P(k,z) if zero) */
+  double * k;              /**< wavenumbers in 1/Mpc, in increasing order */
+  int z_size;              /**< number of redshifts for P(k,z) */
+  double * z;              /**< redshifts, in increasing order */
+
+  int out_size;            /**< size of the output vector */
+  double * out_fiducial;   /**< output vector of the fiducial model */
+  double * out_scale;      /**< scale of each element of the output vector, converting it into a dimensionless deviation */
+
+  //@}
+
+  /** @name - surrogate model */
+
+  //@{
+
+  int train_size;          /**< number of training runs */
+  int term_size;           /**< number of terms of the quadratic polynomial */
+  int pc_size;             /**< number of principal components kept */
+
+  double * mean;           /**< mean of the rescaled deviations over the training runs */
+  double * pc;             /**< principal components, pc[index_pc*out_size+index_out] */
+  double * coefficient;    /**< polynomial coefficients of each component, coefficient[index_pc*term_size+index_term] */
+  double * sigma2;         /**< residual variance of the fit of each component */
+  double * leverage;       /**< inverse of the normal matrix of the fits, leverage[index_term*term_size+index_term2] */
+  double * truncation2;    /**< mean square error on each rescaled output due to the truncation of the components */
+
+  //@}
+
+  ErrorMsg error_message;  /**< zone for writing error messages */
+
+};
+
+/*************************************************************************************************************/
+/* @cond INCLUDE_WITH_DOXYGEN */
+/*
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  int emulator_init(
+                    struct emulator * pem,
+                    int par_size,
+                    int fixed_size,
+                    int l_max,
+                    int cl_type_size,
+                    int k_size,
+                    int z_size
+                    );
+
+  int emulator_free(
+                    struct emulator * pem
+                    );
+
+  int emulator_design(
+                      struct emulator * pem,
+                      int train_size,
+                      double * design
+                      );
+
+  int emulator_train(
+                     struct emulator * pem,
+                     int train_size,
+                     double * design,
+                     double * outputs
+                     );
+
+  int emulator_predict(
+                       struct emulator * pem,
+                       double * par,
+                       double * output,
+                       double * error,
+                       short * in_range,
+                       double * max_error
+                       );
+
+  int emulator_terms(
+                     struct emulator * pem,
+                     double * par,
+                     double * terms
+                     );
+
+  int emulator_symmetric_eigen(
+                               double * matrix,
+                               int size,
+                               double * eigenvalue,
+                               double * eigenvector,
+                               ErrorMsg error_message
+                               );
+
+  int emulator_matrix_inverse(
+                              double * matrix,
+                              int size,
+                              double * inverse,
+                              ErrorMsg error_message
+                              );
+
+  int emulator_write(
+                     struct emulator * pem,
+                     char * filename
+                     );
+
+  int emulator_read(
+                    struct emulator * pem,
+                    char * filename
+                    );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* @endcond */
@@ -0,0 +1,109 @@
+/** @file fftlog.h Documented includes for FFTLog decompositions and Bessel kernels */
+
+#ifndef __FFTLOG__
+#define __FFTLOG__
+
+#include "common.h"
+#include "quadrature.h"
+
+/** largest number of Gauss-Legendre points per interval of t in kernel weights */
+#define _FFTLOG_GAUSS_MAX_ 16
+
+/** largest value of (1-t^2)(l+|s|+1) for which the kernel is computed from series in 1-t^2 */
+#define _FFTLOG_TRANSFORM_ 8.
+
+/** largest number of terms in the hypergeometric series */
+#define _FFTLOG_SERIES_MAX_ 100000
+
+/**
+ * Table of integrals of the kernel \f$ I_l(s,t) \f$ (see
+ * fftlog_bessel_kernel()) against the cubic interpolation polynomials
+ * of a function sampled on a uniform grid in t over [0,1], for the
+ * power-law exponents \f$ s_m = b + i \eta_m \f$ of an FFTLog
+ * decomposition and for a list of multipoles. These weights only
+ * depend on the grids, not on the cosmology: they are computed once
+ * by fftlog_kernel_get() and kept for the rest of the process.
+ */
+
+struct fftlog_kernel {
+
+  int k_size;            /**< number of sampled wavenumbers (power of two) */
+  double dlnk;           /**< step in ln(k) */
+  double bias;           /**< real part b of the power-law exponents */
+  int m_size;            /**< number of exponents, k_size/2+1 */
+
+  int t_size;            /**< number of intervals of the grid in t */
+  double tol;            /**< relative tolerance below which contributions of small t are neglected */
+
+  int l_size;            /**< number of multipoles */
+  int * l;               /**< list of multipoles */
+  int * index_t_min;     /**< for each multipole, first node in t with non-zero weights */
+
+  double * weight;       /**< weights (real and imaginary parts), weight[(((index_l*(t_size+1)+index_t)*m_size)+index_m)*2+0,1] */
+
+  struct fftlog_kernel * next; /**< next table in the list of the cache */
+
+};
+
+/*************************************************************************************************************/
+/* @cond INCLUDE_WITH_DOXYGEN */
+/*
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  int fftlog_fft(
+                 double * data,
+                 int n,
+                 int sign,
+                 ErrorMsg error_message
+                 );
+
+  int fftlog_coefficients(
+                          double * f,
+                          int n,
+                          double dlnk,
+                          double ln_k0,
+                          double bias,
+                          double * work,
+                          double * coef,
+                          ErrorMsg error_message
+                          );
+
+  int fftlog_lngamma(
+                     double re,
+                     double im,
+                     double * result
+                     );
+
+  int fftlog_bessel_kernel(
+                           int l,
+                           double s_re,
+                           double s_im,
+                           double t,
+                           double * kernel,
+                           ErrorMsg error_message
+                           );
+
+  int fftlog_kernel_get(
+                        int k_size,
+                        double dlnk,
+                        double bias,
+                        int t_size,
+                        double tol,
+                        int l_size,
+                        int * l,
+                        struct fftlog_kernel ** kernel,
+                        ErrorMsg error_message
+                        );
+
+  int fftlog_kernel_free();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* @endcond */
@@ -6,6 +6,7 @@
 #define __HYPERSPHERICAL__
 
 #include "common.h"
+#include "buffer_pool.h"
 #define _HYPER_OVERFLOW_ 1e200
 #define _ONE_OVER_HYPER_OVERFLOW_ 1e-200
 #define _HYPER_SAFETY_ 1e-5
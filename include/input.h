@@ -138,6 +138,7 @@ enum target_names {theta_s, Omega_dcdmdr, omega_dcdmdr, Omega_scf, Omega_smg, M_
 enum computation_stage {cs_background, cs_thermodynamics, cs_perturbations,
                         cs_primordial, cs_nonlinear, cs_transfer, cs_spectra};
 #define _NUM_TARGETS_ 9 //Keep this number as number of target_names
+#define _NEWTON_MAX_ITER_ 20 //Largest number of iterations of input_find_root_newton()
 
 struct input_pprpba {
   struct precision * ppr;
@@ -151,6 +152,7 @@ struct fzerofun_workspace {
   double * target_value;
   int target_size;
   enum computation_stage required_computation_stage;
+  double * output_derivative; /* if not NULL, derivative of each output with respect to its unknown parameter (for smg, from the sensitivities integrated with the background) */
 };
 
 
@@ -225,6 +227,12 @@ extern "C" {
 			      struct precision * ppp
 			      );
 
+  int input_coarse_precision(
+                             struct precision * ppr,
+                             struct precision * ppr_coarse,
+                             ErrorMsg errmsg
+                             );
+
   int get_machine_precision(double * smallest_allowed_variation);
 
   int class_fzero_ridder(int (*func)(double x, void *param, double *y, ErrorMsg error_message),
@@ -264,6 +272,11 @@ extern "C" {
                       struct fzerofun_workspace *pfzw,
                       ErrorMsg errmsg);
 
+  int input_find_root_newton(double *xzero,
+                             int *fevals,
+                             struct fzerofun_workspace *pfzw,
+                             ErrorMsg errmsg);
+
   int file_exists(const char *fname);
 
   int input_auxillary_target_conditions(struct file_content * pfc,
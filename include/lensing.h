@@ -231,93 +231,39 @@ extern "C" {
                    double ** X242
                    );
 
-  int lensing_d00(
+  int lensing_dxx(
                   double * mu,
                   int num_mu,
                   int lmax,
-                  double ** d00
+                  double ** d00,
+                  double ** d11,
+                  double ** d1m1,
+                  double ** d2m2,
+                  double ** d20,
+                  double ** d3m1,
+                  double ** d4m2,
+                  double ** d22,
+                  double ** d31,
+                  double ** d3m3,
+                  double ** d40,
+                  double ** d4m4,
+                  ErrorMsg errmsg
                   );
 
-  int lensing_d11(
-                  double * mu,
-                  int num_mu,
-                  int lmax,
-                  double ** d11
-                  );
-
-  int lensing_d1m1(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d1m1
-                   );
-
-  int lensing_d2m2(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d2m2
-                   );
-
-  int lensing_d22(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d22
-                   );
-
-  int lensing_d20(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d20
-                   );
-
-  int lensing_d31(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d3m1
-                   );
-
-  int lensing_d3m1(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d3m1
-                   );
-
-  int lensing_d3m3(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d3m3
-                   );
+#ifdef __cplusplus
+}
+#endif
 
-  int lensing_d40(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d40
-                   );
+/**
+ * @name Some numbers useful in numerical algorithms - but not
+ * affecting precision, otherwise would be in precision structure
+ */
 
-  int lensing_d4m2(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d4m2
-                   );
+//@{
 
-  int lensing_d4m4(
-                   double * mu,
-                   int num_mu,
-                   int lmax,
-                   double ** d4m4
-                   );
+#define _LENSING_MU_BLOCK_ 4 /**< number of mu values for which lensing_dxx() advances each d^l_{mm'} recurrence together */
 
-#ifdef __cplusplus
-}
-#endif
+//@}
 
 #endif
 /* @endcond */
\ No newline at end of file
@@ -56,6 +56,25 @@ struct nonlinear {
 
   //@}
 
+  /** @name - table of linear spectra \f$ P_L(k,\tau) \f$, computed once
+      for the spectra module */
+
+  //@{
+
+  short has_pk_l;          /**< has the table of linear spectra been computed? */
+  int ic_ic_size;          /**< number of pairs of initial conditions */
+  int index_tau_min_l;     /**< index in ppt->tau_sampling of the first time in the table */
+  int tau_l_size;          /**< number of times in the table, ppt->tau_size-index_tau_min_l */
+
+  double * ln_k_l;         /**< ln_k_l[index_k] = log of the wavenumbers ppt->k of the scalar mode */
+
+  double ** ln_pk_ic_l;    /**< ln_pk_ic_l[index_pk][(index_tau * ppt->k_size + index_k) * ic_ic_size + index_ic1_ic2]:
+                                spectrum of each pair of initial conditions, with the same conventions as psp->ln_pk
+                                (index_tau counted from index_tau_min_l) */
+  double ** ln_pk_l;       /**< ln_pk_l[index_pk][index_tau * ppt->k_size + index_k]: log of the total linear spectrum */
+
+  //@}
+
   /** @name - parameters for the pk_eq method */
 
   short has_pk_eq;               /**< flag: will we use the pk_eq method? */
@@ -116,6 +135,33 @@ extern "C" {
                      struct nonlinear *pnl
                      );
 
+  int nonlinear_pk_l_index_tau_min(
+                                    struct background *pba,
+                                    struct perturbs *ppt,
+                                    double z_max_pk,
+                                    int *index_tau_min,
+                                    ErrorMsg error_message
+                                    );
+
+  int nonlinear_pk_linear(
+                          struct background *pba,
+                          struct perturbs *ppt,
+                          struct primordial *ppm,
+                          struct nonlinear *pnl
+                          );
+
+  int nonlinear_pk_linear_at_tau_index(
+                                       struct perturbs *ppt,
+                                       struct nonlinear *pnl,
+                                       int index_pk,
+                                       int index_tau,
+                                       double *primordial_pk,
+                                       double *exp_primordial_pk,
+                                       double *pk_factor,
+                                       short *is_non_zero,
+                                       double *pk_tot
+                                       );
+
   int nonlinear_pk_l(struct background *pba,
                      struct perturbs *ppt,
                      struct primordial *ppm,
@@ -13,6 +13,13 @@
 
 #define _Z_PK_NUM_MAX_ 100
 
+/**
+ * Number of lines of a table formatted together by one thread in
+ * output_print_table()
+ */
+
+#define _OUTPUT_BLOCK_ROWS_ 256
+
 /**
  * Structure containing various informations on the output format,
  * all of them initialized by user in input module.
@@ -79,6 +86,15 @@ extern "C" {
                            double * cl
                            );
 
+  int output_total_cl_at_l_with_workspace(
+                                          struct spectra * psp,
+                                          struct lensing * ple,
+                                          struct output * pop,
+                                          struct spectra_workspace * psw,
+                                          int l,
+                                          double * cl
+                                          );
+
   int output_init(
                   struct background * pba,
                   struct thermo * pth,
@@ -143,10 +159,12 @@ extern "C" {
                         struct output * pop
                         );
 
-  int output_print_data(FILE *out,
+  int output_print_data(struct output * pop,
+                        FILE *out,
                         char titles[_MAXTITLESTRINGLENGTH_],
                         double *dataptr,
                         int tau_size);
+
   int output_open_cl_file(
                           struct spectra * psp,
                           struct output * pop,
@@ -160,7 +178,7 @@ extern "C" {
                             struct background * pba,
                             struct spectra * psp,
                             struct output * pop,
-                            FILE * clfile,
+                            double * line,
                             double l,
                             double * cl,
                             int ct_size
@@ -176,11 +194,15 @@ extern "C" {
                           double z
                           );
 
-  int output_one_line_of_pk(
-                            FILE * tkfile,
-                            double one_k,
-                            double one_pk
-                            );
+  int output_all_lines_of_pk(
+                             struct background * pba,
+                             struct spectra * psp,
+                             struct output * pop,
+                             FILE * pkfile,
+                             double * pk,
+                             int pk_stride,
+                             double * pk_table
+                             );
 
   int output_open_pk_nl_file(
                              struct background * pba,
@@ -193,6 +215,14 @@ extern "C" {
                              int k_size
                              );
 
+  int output_print_table(
+                         struct output * pop,
+                         FILE * out,
+                         double * data,
+                         int number_of_rows,
+                         int number_of_columns,
+                         short first_column_is_l
+                         );
 
 #ifdef __cplusplus
 }
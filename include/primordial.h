@@ -366,11 +366,40 @@ extern "C" {
                               double k_per_decade
                               );
 
+  int primordial_feature_points(
+                                struct primordial * ppm,
+                                double tol,
+                                short * is_feature,
+                                int * number
+                                );
+
+  int primordial_refine_features(
+                                 struct perturbs * ppt,
+                                 struct primordial * ppm,
+                                 struct precision * ppr,
+                                 double * y_ini
+                                 );
+
+  int primordial_k_sampling(
+                            struct primordial * ppm,
+                            double * k,
+                            int k_size,
+                            double tol,
+                            int max_refinement,
+                            int * sub_steps
+                            );
+
   int primordial_analytic_spectrum_init(
                                         struct perturbs   * ppt,
                                         struct primordial * ppm
                                         );
 
+  int primordial_analytic_spectrum_at_index(
+                                            struct perturbs   * ppt,
+                                            struct primordial * ppm,
+                                            int index_k
+                                            );
+
   int primordial_analytic_spectrum(
                                    struct primordial * ppm,
                                    int index_md,
@@ -4,6 +4,7 @@
 #define __SPECTRA__
 
 #include "transfer.h"
+#include "fftlog.h"
 
 /**
  * Structure containing everything about anisotropy and Fourier power spectra that other modules need to know.
@@ -32,6 +33,17 @@ struct spectra {
                    and number of bins minus one means all
                    correlations */
 
+  double non_diag_min_overlap; /**< among the cross-correlation
+                                  spectra allowed by non_diag, only
+                                  compute the number count ones for
+                                  which the selection functions of the
+                                  two bins overlap by more than this
+                                  (see transfer_selection_overlap());
+                                  0 means all of them. Ignored when
+                                  number counts include lensing or
+                                  gravitational terms, which correlate
+                                  distant bins */
+
   //@}
 
   /** @name - information on number of modes and pairs of initial conditions */
@@ -72,7 +84,7 @@ struct spectra {
   int index_ct_pp; /**< index for type \f$ C_l^{\phi\phi} \f$*/
   int index_ct_tp; /**< index for type \f$ C_l^{T\phi} \f$*/
   int index_ct_ep; /**< index for type \f$ C_l^{E\phi} \f$*/
-  int index_ct_dd; /**< first index for type \f$ C_l^{dd} \f$((d_size*d_size-(d_size-non_diag)*(d_size-non_diag-1)/2) values) */
+  int index_ct_dd; /**< first index for type \f$ C_l^{dd} \f$(dd_size values) */
   int index_ct_td; /**< first index for type \f$ C_l^{Td} \f$(d_size values) */
   int index_ct_pd; /**< first index for type \f$ C_l^{pd} \f$(d_size values) */
   int index_ct_ll; /**< first index for type \f$ C_l^{ll} \f$((d_size*d_size-(d_size-non_diag)*(d_size-non_diag-1)/2) values) */
@@ -81,6 +93,10 @@ struct spectra {
 
   int d_size;      /**< number of bins for which density Cl's are computed */
 
+  short * has_dd_pair; /**< has_dd_pair[index_d1*d_size+index_d2] is _TRUE_ if \f$ C_l^{dd} \f$ is computed for this pair of bins (symmetric matrix) */
+
+  int dd_size;     /**< number of \f$ C_l^{dd} \f$ types, i.e. of pairs index_d1 <= index_d2 for which has_dd_pair is _TRUE_ */
+
   int ct_size; /**< number of \f$ C_l \f$ types requested */
 
   //@}
@@ -225,6 +241,24 @@ struct spectra {
   double * ln_pk_cb_nl;        /**< same as ln_pk_nl for baryon+cdm component only */
   double * ddln_pk_cb_nl;      /**< same as ddln_pk_nl for baryon+cdm component only */
 
+  double * ddkln_pk;     /**< second derivative of ln_pk with respect to ln(k) at each tau, same indexing as ln_pk. Together with ddln_pk and ddkddln_pk, defines a bicubic spline of ln_pk over (ln(k),ln(tau)) used for point queries */
+  double * ddkddln_pk;   /**< second derivative of ddkln_pk with respect to ln(tau) (only if ln_tau_size > 1) */
+
+  double * ddkln_pk_l;   /**< same as ddkln_pk for ln_pk_l */
+  double * ddkddln_pk_l; /**< same as ddkddln_pk for ln_pk_l */
+
+  double * ddkln_pk_nl;   /**< same as ddkln_pk for ln_pk_nl (on the ln_tau_nl grid) */
+  double * ddkddln_pk_nl; /**< same as ddkddln_pk for ln_pk_nl (only if ln_tau_nl_size > 1) */
+
+  double * ddkln_pk_cb;     /**< same as ddkln_pk for baryon+cdm component only */
+  double * ddkddln_pk_cb;   /**< same as ddkddln_pk for baryon+cdm component only */
+
+  double * ddkln_pk_cb_l;   /**< same as ddkln_pk_l for baryon+cdm component only */
+  double * ddkddln_pk_cb_l; /**< same as ddkddln_pk_l for baryon+cdm component only */
+
+  double * ddkln_pk_cb_nl;   /**< same as ddkln_pk_nl for baryon+cdm component only */
+  double * ddkddln_pk_cb_nl; /**< same as ddkddln_pk_nl for baryon+cdm component only */
+
   int index_tr_delta_g;        /**< index of gamma density transfer function */
   int index_tr_delta_b;        /**< index of baryon density transfer function */
   int index_tr_delta_cdm;      /**< index of cold dark matter density transfer function */
@@ -272,11 +306,93 @@ struct spectra {
 
   short spectra_verbose; /**< flag regulating the amount of information sent to standard output (none if set to zero) */
 
+  int workspace_stamp; /**< number identifying this computation of the tables, for the caches of the workspaces (see struct spectra_workspace) */
+
   ErrorMsg error_message; /**< zone for writing error messages */
 
   //@}
 };
 
+/**
+ * Scratch space for the functions interpolating in the tables of the
+ * spectra structure (spectra_tk_at_k_and_z(), spectra_pk_at_k_and_z(),
+ * output_total_cl_at_l()), so that repeated calls do not allocate
+ * memory. A caller can own one (initialized with
+ * spectra_workspace_init() and freed with spectra_workspace_free()),
+ * or pass NULL to use a default workspace private to the calling
+ * thread. spectra_free() only releases the buffers of the default
+ * workspace of the calling thread; the default workspaces of all
+ * threads are freed by spectra_workspace_default_free_all(), once no
+ * thread uses the module anymore. Buffers only grow, so that a
+ * workspace can serve several spectra structures.
+ *
+ * The matter transfer functions at the last requested z are kept,
+ * together with their spline in k, such that successive calls of
+ * spectra_tk_at_k_and_z_with_workspace() at the same z only
+ * interpolate in k.
+ */
+
+struct spectra_workspace {
+
+  int tk_size;                /**< allocated size of tks_at_z and ddtks_at_z */
+  double * tks_at_z;          /**< matter transfer functions at a given z, for all k */
+  double * ddtks_at_z;        /**< their second derivatives with respect to ln(k) */
+  int tk_stamp;               /**< workspace_stamp of the spectra structure for which tks_at_z and ddtks_at_z are filled (0 if they are not) */
+  double tk_z;                /**< redshift at which they are filled */
+
+  int ic_ic_size;             /**< allocated size of pk_primordial_k and pk_primordial_kmin */
+  double * pk_primordial_k;   /**< primordial spectrum at a given k, for all pairs of initial conditions */
+  double * pk_primordial_kmin;/**< same at kmin */
+
+  int md_size;                /**< allocated size of cl_md and cl_md_ic */
+  int cl_md_size;             /**< allocated size of cl_md_data */
+  int cl_md_ic_size;          /**< allocated size of cl_md_ic_data */
+  double ** cl_md;            /**< C_l's for each mode, pointing into cl_md_data */
+  double ** cl_md_ic;         /**< C_l's for each mode and pair of initial conditions, pointing into cl_md_ic_data */
+  double * cl_md_data;        /**< storage for cl_md */
+  double * cl_md_ic_data;     /**< storage for cl_md_ic */
+
+};
+
+/**
+ * Tables shared by the computation of the C_l's of density number
+ * counts and galaxy lensing with FFTLog (see spectra_cls_fftlog()),
+ * only allocated inside this function.
+ *
+ * The sources are sampled at the wavenumbers \f$ k_n = k_0 e^{n \Delta} \f$
+ * of the FFTLog decomposition which fall inside the range of the
+ * perturbation module, the others being set to zero. Each window
+ * function (one per bin of density number count, then one per bin of
+ * galaxy lensing) is sampled on a uniform grid in comoving distance
+ * chi, and multiplied by chi, which keeps the lensing kernel finite
+ * at chi=0.
+ */
+
+struct spectra_fftlog {
+
+  struct fftlog_kernel * pfk[2]; /**< weights of the Bessel kernel for pairs of windows involving density [0] or of lensing windows [1] (owned by the cache of the fftlog tool) */
+
+  int k_size;            /**< number of FFTLog wavenumbers (power of two) */
+  double dlnk;           /**< step in ln(k) */
+  double ln_k0;          /**< logarithm of the first FFTLog wavenumber */
+  int index_k_min;       /**< index of the first FFTLog wavenumber inside the range of the sources */
+  int k_in_size;         /**< number of FFTLog wavenumbers inside this range */
+
+  double * pk;           /**< primordial spectrum times a smooth window vanishing at both ends of the range, pk[index_ic1_ic2*k_in_size+index_k] */
+
+  int source_size;       /**< number of types of sources (density, then lensing potential phi+psi) */
+  double ** source;      /**< sources (with non-linear corrections) at the FFTLog wavenumbers, source[index_source*ic_size+index_ic][index_tau*k_in_size+index_k] */
+
+  int chi_size;          /**< number of points of the grid of each window */
+  int window_size;       /**< number of windows */
+  int * window_source;   /**< type of source multiplied by each window */
+  double * chi_min;      /**< smallest comoving distance of each window */
+  double * dchi;         /**< step in comoving distance of each window */
+  double * window;       /**< chi times window function, window[index_w*chi_size+index_chi] */
+  double * ddwindow;     /**< second derivative of the previous array with respect to chi */
+
+};
+
 /*************************************************************************************************************/
 /* @cond INCLUDE_WITH_DOXYGEN */
 /*
@@ -303,6 +419,13 @@ extern "C" {
                       double ** cl_md_ic
                       );
 
+  int spectra_ln_tau_at_z(
+                          struct background * pba,
+                          struct spectra * psp,
+                          double z,
+                          double * ln_tau
+                          );
+
   int spectra_pk_at_z(
                       struct background * pba,
                       struct spectra * psp,
@@ -326,6 +449,19 @@ extern "C" {
                             double * pk_cb_ic
                             );
 
+  int spectra_pk_at_k_and_z_with_workspace(
+                                           struct background * pba,
+                                           struct primordial * ppm,
+                                           struct spectra * psp,
+                                           struct spectra_workspace * psw,
+                                           double k,
+                                           double z,
+                                           double * pk,
+                                           double * pk_ic,
+                                           double * pk_cb,
+                                           double * pk_cb_ic
+                                           );
+
   int spectra_pk_nl_at_z(
                          struct background * pba,
                          struct spectra * psp,
@@ -360,6 +496,38 @@ extern "C" {
                             double * output
                             );
 
+  int spectra_tk_at_k_and_z_with_workspace(
+                                           struct background * pba,
+                                           struct spectra * psp,
+                                           struct spectra_workspace * psw,
+                                           double k,
+                                           double z,
+                                           double * output
+                                           );
+
+  int spectra_workspace_init(
+                             struct spectra * psp,
+                             struct spectra_workspace * psw
+                             );
+
+  int spectra_workspace_reserve(
+                                struct spectra * psp,
+                                struct spectra_workspace * psw
+                                );
+
+  int spectra_workspace_free(
+                             struct spectra_workspace * psw
+                             );
+
+  int spectra_workspace_default(
+                                struct spectra * psp,
+                                struct spectra_workspace ** psw
+                                );
+
+  int spectra_workspace_default_free();
+
+  int spectra_workspace_default_free_all();
+
   int spectra_init(
                    struct precision * ppr,
                    struct background * pba,
@@ -375,6 +543,7 @@ extern "C" {
                    );
 
   int spectra_indices(
+                      struct precision * ppr,
                       struct background * pba,
                       struct perturbs * ppt,
                       struct transfers * ptr,
@@ -383,13 +552,62 @@ extern "C" {
                       );
 
   int spectra_cls(
+                  struct precision * ppr,
                   struct background * pba,
                   struct perturbs * ppt,
+                  struct nonlinear * pnl,
                   struct transfers * ptr,
                   struct primordial * ppm,
                   struct spectra * psp
                   );
 
+  int spectra_cls_fftlog(
+                         struct precision * ppr,
+                         struct background * pba,
+                         struct perturbs * ppt,
+                         struct nonlinear * pnl,
+                         struct transfers * ptr,
+                         struct primordial * ppm,
+                         struct spectra * psp
+                         );
+
+  int spectra_fftlog_sources(
+                             struct perturbs * ppt,
+                             struct nonlinear * pnl,
+                             struct spectra * psp,
+                             struct spectra_fftlog * psf,
+                             int index_md,
+                             int index_ic,
+                             int index_tp,
+                             double * source
+                             );
+
+  int spectra_fftlog_window(
+                            struct precision * ppr,
+                            struct background * pba,
+                            struct perturbs * ppt,
+                            struct transfers * ptr,
+                            struct spectra * psp,
+                            struct spectra_fftlog * psf,
+                            int bin,
+                            short is_lensing,
+                            int index_w
+                            );
+
+  int spectra_fftlog_region(
+                            struct background * pba,
+                            struct perturbs * ppt,
+                            struct spectra * psp,
+                            struct spectra_fftlog * psf,
+                            int index_md,
+                            int index_w_out,
+                            int index_ic_out,
+                            int index_w_in,
+                            int index_ic_in,
+                            int index_ic1_ic2,
+                            double * result
+                            );
+
   int spectra_compute_cl(
                          struct background * pba,
                          struct perturbs * ppt,
@@ -422,6 +640,30 @@ extern "C" {
                  struct spectra * psp
                  );
 
+  int spectra_pk_bicubic_table(
+                               struct spectra * psp,
+                               double * ln_tau,
+                               int ln_tau_size,
+                               double * ln_pk,
+                               int y_size,
+                               double ** ddkln_pk,
+                               double ** ddkddln_pk
+                               );
+
+  int spectra_pk_bicubic_at_k_and_tau(
+                                      struct spectra * psp,
+                                      double * ln_tau,
+                                      int ln_tau_size,
+                                      double * ln_pk,
+                                      double * ddln_pk,
+                                      double * ddkln_pk,
+                                      double * ddkddln_pk,
+                                      int y_size,
+                                      double ln_k,
+                                      double ln_tau_value,
+                                      double * result
+                                      );
+
   int spectra_sigma(
                     struct background * pba,
                     struct primordial * ppm,
@@ -440,12 +682,31 @@ extern "C" {
                     double *sigma_cb
                     );
 
+  int spectra_sigma_at_z_vector(
+                                struct background * pba,
+                                struct primordial * ppm,
+                                struct spectra * psp,
+                                double R,
+                                double * z_array,
+                                int z_size,
+                                double * sigma
+                                );
+
   int spectra_matter_transfers(
                                struct background * pba,
                                struct perturbs * ppt,
                                struct spectra * psp
                                );
 
+  int spectra_matter_transfers_at_tau_index(
+                                            struct background * pba,
+                                            struct perturbs * ppt,
+                                            struct spectra * psp,
+                                            int index_tau,
+                                            double w_fld,
+                                            double * pvecback_sp_long
+                                            );
+
   int spectra_output_tk_titles(struct background *pba,
                                struct perturbs *ppt,
                                enum file_format output_format,
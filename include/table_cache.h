@@ -0,0 +1,80 @@
+/** @file table_cache.h Documented includes for the cache of tables read from files */
+
+#ifndef __TABLE_CACHE__
+#define __TABLE_CACHE__
+
+#include "common.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/**
+ * Table read from a file, together with derived quantities (typically
+ * spline coefficients), as built once by a reading function and
+ * shared by all later runs of the same process. Tables are immutable:
+ * their content must never be modified by the callers.
+ */
+
+struct file_table {
+
+  int shape[2];     /**< dimensions of the table, whose meaning is defined by the reading function */
+  int data_size;    /**< size of data */
+  double * data;    /**< all numbers of the table, in an order defined by the reading function */
+
+};
+
+/**
+ * Function reading a file into a table. It must allocate table->data
+ * and fill table->shape, table->data_size and table->data.
+ */
+
+typedef int (*file_table_reader)(char * filename, struct file_table * table, ErrorMsg error_message);
+
+/**
+ * Entry of the process-wide list of tables, identified by the
+ * reading function, the file name, and the modification time and
+ * size of the file when it was read. An entry is stale once the file
+ * has changed; it is then removed as soon as it has no users.
+ */
+
+struct table_cache_entry {
+
+  file_table_reader reader;        /**< function which built the table */
+  char * filename;                 /**< name of the file */
+  time_t mtime;                    /**< modification time of the file */
+  off_t size;                      /**< size of the file in bytes */
+  struct file_table table;         /**< the table */
+  int users;                       /**< number of table_cache_get() calls not yet followed by table_cache_release() */
+  short stale;                     /**< _TRUE_ if the file was modified after being read */
+  struct table_cache_entry * next; /**< next entry in the list */
+
+};
+
+/*************************************************************************************************************/
+/* @cond INCLUDE_WITH_DOXYGEN */
+/*
+ * Boilerplate for C++
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+  int table_cache_get(
+                      char * filename,
+                      file_table_reader reader,
+                      struct file_table ** table,
+                      ErrorMsg error_message
+                      );
+
+  int table_cache_release(
+                          struct file_table * table,
+                          ErrorMsg error_message
+                          );
+
+  int table_cache_free();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* @endcond */
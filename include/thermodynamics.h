@@ -17,6 +17,18 @@ enum recombination_algorithm {
   hyrec
 };
 
+/**
+ * List of possible models for hydrogen recombination in HyRec, from
+ * the cheapest to the most accurate.
+ */
+
+enum hyrec_model {
+  hyrec_peebles,  /**< Peebles effective three-level atom */
+  hyrec_recfast,  /**< effective three-level atom with fudge factor F = 1.14 */
+  hyrec_emla2s2p, /**< effective multi-level atom, with decays from 2s and 2p only (reads the effective rate tables) */
+  hyrec_full      /**< all radiative transfer effects, including two-photon processes (also reads the two-photon tables) */
+};
+
 /**
  * List of possible reionization schemes.
  */
@@ -67,6 +79,8 @@ struct thermo
 
   enum recombination_algorithm recombination; /**< recombination code */
 
+  enum hyrec_model hyrec_model; /**< model for hydrogen recombination, if recombination = hyrec */
+
   enum reionization_parametrization reio_parametrization; /**< reionization scheme */
 
   enum reionization_z_or_tau reio_z_or_tau; /**< is the input parameter the reionization redshift or optical depth? */
@@ -470,6 +484,15 @@ extern "C" {
 			  double * pvecthermo
 			  );
 
+  int thermodynamics_at_z_vector(
+                                 struct background * pba,
+                                 struct thermo * pth,
+                                 double * z_array,
+                                 int z_size,
+                                 int index_th,
+                                 double * result
+                                 );
+
   int thermodynamics_init(
 			  struct precision * ppr,
 			  struct background * pba,
@@ -486,6 +509,12 @@ extern "C" {
 			     struct reionization * preio
 			     );
 
+  int thermodynamics_read_bbn_table(
+                                    char * filename,
+                                    struct file_table * table,
+                                    ErrorMsg error_message
+                                    );
+
   int thermodynamics_helium_from_bbn(
 				     struct precision * ppr,
 				     struct background * pba,
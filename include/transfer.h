@@ -12,6 +12,12 @@
 /* macro: test if index_tt is in the range between index and index+num, while the flag is true */
 #define _index_tt_in_range_(index,num,flag) (flag == _TRUE_) && (index_tt >= index) && (index_tt < index+num)
 
+/* macro: test if index_tt is a type whose C_l's can be computed with FFTLog by the spectra module (density number count and galaxy lensing) */
+#define _index_tt_fftlog_ ((_index_tt_in_range_(ptr->index_tt_density, ppt->selection_num, ppt->has_nc_density)) || (_index_tt_in_range_(ptr->index_tt_lensing, ppt->selection_num, ppt->has_cl_lensing_potential)))
+
+/* when pruning negligible (q,l) pairs, number of wavenumbers computed first on each side used for predicting transfer functions at other wavenumbers */
+#define _TRANSFER_PRUNING_WINDOW_ 3
+
 /**
  * Structure containing everything about transfer functions in
  * harmonic space \f$ \Delta_l^{X} (q) \f$ that other modules need to
@@ -59,18 +65,20 @@ struct transfers {
   short has_nz_analytic; /**< Use analytic form for dN/dz (selection function) distribution? */
   FileName nz_file_name; /**< dN/dz (selection function) input file name */
   int nz_size;           /**< number of redshift values in input tabulated selection function */
-  double * nz_z;         /**< redshift values in input tabulated selection function */
+  double * nz_z;         /**< redshift values in input tabulated selection function (points to the table cache) */
   double * nz_nz;        /**< input tabulated values of selection function */
   double * nz_ddnz;      /**< second derivatives in splined selection function*/
+  struct file_table * nz_table; /**< table of the table cache holding nz_z, nz_nz and nz_ddnz */
 
   short has_nz_evo_file;      /**< Has dN/dz (evolution function) input file? */
   short has_nz_evo_analytic;  /**< Use analytic form for dN/dz (evolution function) distribution? */
   FileName nz_evo_file_name;  /**< dN/dz (evolution function) input file name */
   int nz_evo_size;            /**< number of redshift values in input tabulated evolution function */
-  double * nz_evo_z;          /**< redshift values in input tabulated evolution function */
+  double * nz_evo_z;          /**< redshift values in input tabulated evolution function (points to the table cache) */
   double * nz_evo_nz;         /**< input tabulated values of evolution function */
   double * nz_evo_dlog_nz;    /**< log of tabulated values of evolution function */
   double * nz_evo_dd_dlog_nz; /**< second derivatives in splined log of evolution function */
+  struct file_table * nz_evo_table; /**< table of the table cache holding the nz_evo arrays */
 
   //@}
 
@@ -149,6 +157,18 @@ struct transfers {
 
   double ** transfer; /**< table of transfer functions for each mode, initial condition, type, multipole and wavenumber, with argument transfer[index_md][((index_ic * ptr->tt_size[index_md] + index_tt) * ptr->l_size[index_md] + index_l) * ptr->q_size + index_q] */
 
+  short ** pruned; /**< when pruning is enabled (precision parameter transfer_pruning_tolerance), flags pruned[index_md][same index as transfer] set to _TRUE_ for (q,l) pairs whose transfer function is set to zero without computing it; only allocated inside transfer_init(), NULL otherwise */
+
+  double pruned_fraction; /**< fraction of line-of-sight integrals skipped by the pruning */
+
+  double pruned_cl_error; /**< estimated maximum relative error on diagonal C_l's due to the pruning (over all modes, initial conditions, types and multipoles) */
+
+  short has_cl_fftlog; /**< are the C_l's of density number counts and galaxy lensing computed up to l_fftlog_max by the spectra module with FFTLog (see precision parameter fftlog_lss)? */
+
+  int l_fftlog_max; /**< largest multipole for which these C_l's are computed with FFTLog */
+
+  short fftlog_skip; /**< if _TRUE_, the transfer functions of these types are set to zero without being computed up to l_fftlog_max, since no other C_l's need them */
+
   //@}
 
   /** @name - technical parameters */
@@ -272,6 +292,7 @@ extern "C" {
                     struct background * pba,
                     struct thermo * pth,
                     struct perturbs * ppt,
+                    struct primordial * ppm,
                     struct nonlinear * pnl,
                     struct transfers * ptr
                     );
@@ -283,6 +304,7 @@ extern "C" {
   int transfer_indices_of_transfers(
                                     struct precision * ppr,
                                     struct perturbs * ppt,
+                                    struct primordial * ppm,
                                     struct transfers * ptr,
                                     double q_period,
                                     double K,
@@ -325,6 +347,7 @@ extern "C" {
   int transfer_get_q_list(
                           struct precision * ppr,
                           struct perturbs * ppt,
+                          struct primordial * ppm,
                           struct transfers * ptr,
                           double q_period,
                           double K,
@@ -436,6 +459,15 @@ extern "C" {
                                   double z,
                                   double * selection);
 
+  int transfer_selection_overlap(
+                                 struct precision * ppr,
+                                 struct perturbs * ppt,
+                                 struct transfers * ptr,
+                                 int bin1,
+                                 int bin2,
+                                 double * overlap
+                                 );
+
   int transfer_dNdz_analytic(
                              struct transfers * ptr,
                              double z,
@@ -593,6 +625,21 @@ extern "C" {
                                             double l,
                                             short * neglect);
 
+  int transfer_pruning_select(
+                              struct precision * ppr,
+                              struct background * pba,
+                              struct perturbs * ppt,
+                              struct primordial * ppm,
+                              struct transfers * ptr,
+                              double tau_rec,
+                              HyperInterpStruct * pBIS
+                              );
+
+  int transfer_pruning_compare(
+                               const void * a,
+                               const void * b
+                               );
+
   int transfer_select_radial_function(
                                       struct perturbs * ppt,
                                       struct transfers * ptr,
@@ -618,6 +665,18 @@ extern "C" {
                                     HyperInterpStruct *pHIS
                                     );
 
+  int transfer_read_nz_table(
+                             char * filename,
+                             struct file_table * table,
+                             ErrorMsg error_message
+                             );
+
+  int transfer_read_nz_evo_table(
+                                 char * filename,
+                                 struct file_table * table,
+                                 ErrorMsg error_message
+                                 );
+
   int transfer_global_selection_read(
                                      struct transfers * ptr
                                      );
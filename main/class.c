@@ -48,7 +48,7 @@ int main(int argc, char **argv) {
     return _FAILURE_;
   }
 
-  if (transfer_init(&pr,&ba,&th,&pt,&nl,&tr) == _FAILURE_) {
+  if (transfer_init(&pr,&ba,&th,&pt,&pm,&nl,&tr) == _FAILURE_) {
     printf("\n\nError in transfer_init \n=>%s\n",tr.error_message);
     return _FAILURE_;
   }
@@ -110,6 +110,10 @@ int main(int argc, char **argv) {
     return _FAILURE_;
   }
 
+  spectra_workspace_default_free_all();
+
+  table_cache_free();
+
   return _SUCCESS_;
 
 }
@@ -184,6 +184,8 @@ cdef extern from "class.h":
         int md_size
         int d_size
         int non_diag
+        short * has_dd_pair
+        int dd_size
         int index_ct_tt
         int index_ct_te
         int index_ct_ee
@@ -256,6 +258,10 @@ cdef extern from "class.h":
         int method
         ErrorMsg error_message
 
+    cdef struct bandpowers:
+        int bp_size
+        ErrorMsg error_message
+
     cdef struct file_content:
         char * filename
         int size
@@ -278,21 +284,25 @@ cdef extern from "class.h":
 
     int input_init(void*, void*, void*, void*, void*, void*, void*, void*, void*,
         void*, void*, char*)
+    int input_coarse_precision(void*, void*, char*)
     int background_init(void*,void*)
     int thermodynamics_init(void*,void*,void*)
     int perturb_init(void*,void*,void*,void*)
     int primordial_init(void*,void*,void*)
     int nonlinear_init(void*,void*,void*,void*,void*,void*)
-    int transfer_init(void*,void*,void*,void*,void*,void*)
+    int transfer_init(void*,void*,void*,void*,void*,void*,void*)
     int spectra_init(void*,void*,void*,void*,void*,void*,void*)
     int lensing_init(void*,void*,void*,void*,void*)
 
     int background_tau_of_z(void* pba, double z,double* tau)
     int background_at_tau(void* pba, double tau, short return_format, short inter_mode, int * last_index, double *pvecback)
+    int background_at_tau_vector(void* pba, double* tau_array, int tau_size, int index_bg, double* result) nogil
+    int background_at_z_vector(void* pba, double* z_array, int z_size, int index_bg, double* result) nogil
     int background_output_titles(void * pba, char titles[_MAXTITLESTRINGLENGTH_])
     int background_output_data(void *pba, int number_of_titles, double *data)
 
     int thermodynamics_at_z(void * pba, void * pth, double z, short inter_mode, int * last_index, double *pvecback, double *pvecthermo)
+    int thermodynamics_at_z_vector(void * pba, void * pth, double* z_array, int z_size, int index_th, double* result) nogil
     int thermodynamics_output_titles(void * pba, void *pth, char titles[_MAXTITLESTRINGLENGTH_])
     int thermodynamics_output_data(void *pba, void *pth, int number_of_titles, double *data)
 
@@ -304,6 +314,12 @@ cdef extern from "class.h":
 
     int spectra_cl_at_l(void* psp,double l,double * cl,double * * cl_md,double * * cl_md_ic)
     int lensing_cl_at_l(void * ple,int l,double * cl_lensed)
+    int bandpowers_init(void * pbp)
+    int bandpowers_free(void * pbp)
+    int bandpowers_add_window(void * pbp, char * type_name, int bin1, int bin2, short lensed, int l_min, int l_max, double * weight)
+    int bandpowers_read_windows(void * pbp, char * filename)
+    int bandpowers_compute(void * psp, void * ple, void * pbp, double * bandpower)
+    int table_cache_free()
     int spectra_pk_at_z(
         void * pba,
         void * psp,
@@ -75,6 +75,7 @@ cdef class Class:
     # List of used structures, defined in the header file. They have to be
     # "cdefined", because they correspond to C structures
     cdef precision pr
+    cdef precision pr_coarse
     cdef background ba
     cdef thermo th
     cdef perturbs pt
@@ -84,12 +85,15 @@ cdef class Class:
     cdef spectra sp
     cdef output op
     cdef lensing le
+    cdef bandpowers bp
     cdef file_content fc
 
     cpdef int ready # Flag to see if classy can currently compute
     cpdef int allocated # Flag to see if classy structs are allocated already
     cpdef object _pars # Dictionary of the parameters
     cpdef object ncp   # Keeps track of the structures initialized, in view of cleaning.
+    cpdef int coarse # Flag to see if the modules after thermodynamics used the coarse precision profile
+    cpdef object _coarse_rel_err # Relative error of the coarse C_l's, calibrated by refine()
 
     # Defining two new properties to recover, respectively, the parameters used
     # or the age (set after computation). Follow this syntax if you want to
@@ -117,6 +121,8 @@ cdef class Class:
         cpdef char* dumc
         self.ready = False
         self.allocated = False
+        self.coarse = False
+        self._coarse_rel_err = None
         self._pars = {}
         self.fc.size=0
         self.fc.filename = <char*>malloc(sizeof(char)*30)
@@ -124,8 +130,13 @@ cdef class Class:
         dumc = "NOFILE"
         sprintf(self.fc.filename,"%s",dumc)
         self.ncp = set()
+        bandpowers_init(&self.bp)
         if default: self.set_default()
 
+    def __dealloc__(self):
+        bandpowers_free(&self.bp)
+        table_cache_free()
+
     # Set up the dictionary
     def set(self,*pars,**kars):
         if len(pars)==1:
@@ -176,6 +187,16 @@ cdef class Class:
     def struct_cleanup(self):
         if self.ready == _FALSE_:
              return
+        self._struct_cleanup_from_perturb()
+        if "thermodynamics" in self.ncp:
+            thermodynamics_free(&self.th)
+        if "background" in self.ncp:
+            background_free(&self.ba)
+        self.ready = False
+        self.allocated = False
+
+    # Free the modules after thermodynamics only (see refine)
+    def _struct_cleanup_from_perturb(self):
         if "lensing" in self.ncp:
             lensing_free(&self.le)
         if "spectra" in self.ncp:
@@ -188,12 +209,8 @@ cdef class Class:
             primordial_free(&self.pm)
         if "perturb" in self.ncp:
             perturb_free(&self.pt)
-        if "thermodynamics" in self.ncp:
-            thermodynamics_free(&self.th)
-        if "background" in self.ncp:
-            background_free(&self.ba)
-        self.ready = False
-        self.allocated = False
+        for module in ["lensing", "spectra", "transfer", "nonlinear", "primordial", "perturb"]:
+            self.ncp.discard(module)
 
     def _check_task_dependency(self, level):
         """
@@ -276,6 +293,164 @@ cdef class Class:
             level default value should be left as an array (it was creating
             problem when casting as a set later on, in _check_task_dependency)
 
+        """
+        # A coarse run of the same model only needs to be refined
+        if self.ready and self.coarse and self.ncp.issuperset(
+                self._check_task_dependency(list(level))):
+            self.refine()
+            return
+
+        level = self._compute_until_thermodynamics(level)
+        if level is None:
+            return
+
+        self._compute_thermodynamics(level)
+
+        self._compute_from_perturb(level)
+
+        # At this point, the cosmological instance contains everything needed. The
+        # following functions are only to output the desired numbers
+        return
+
+    def compute_coarse(self, level=["lensing"]):
+        """
+        compute_coarse(level=["lensing"])
+
+        Cheap version of :meth:`compute`, for the first stage of a
+        two-level evaluation (e.g. in a delayed-acceptance sampler). The
+        input (including the shooting for unknown parameters),
+        background and thermodynamics modules are run as in
+        :meth:`compute`, but the following ones use the coarse precision
+        profile: steps in k and l multiplied by coarse_sampling_factor,
+        tol_perturb_integration multiplied by coarse_tolerance_factor,
+        and no accurate lensing.
+
+        The result can then be completed at full precision with
+        :meth:`refine`, and its error estimated with
+        :meth:`coarse_cl_error`.
+
+        Parameters
+        ----------
+        level : list
+                list of the last module desired, as in :meth:`compute`
+        """
+        cdef ErrorMsg errmsg
+
+        level = self._compute_until_thermodynamics(level)
+        if level is None:
+            return
+
+        self._compute_thermodynamics(level)
+
+        if input_coarse_precision(&self.pr, &self.pr_coarse, errmsg) == _FAILURE_:
+            self.struct_cleanup()
+            raise CosmoSevereError(errmsg)
+        self.coarse = True
+
+        self._compute_from_perturb(level)
+        return
+
+    def refine(self):
+        """
+        refine()
+
+        Complete a run of :meth:`compute_coarse` at full precision. Only
+        the modules after thermodynamics are computed again: the
+        background, thermodynamics and shooting results of the coarse
+        run are kept. The difference between the coarse and refined
+        C_l's is used to calibrate :meth:`coarse_cl_error`.
+        """
+        if not (self.ready and self.coarse):
+            return
+
+        level = [module for module in ["perturb", "primordial", "nonlinear",
+                                       "transfer", "spectra", "lensing"]
+                 if module in self.ncp]
+        coarse_cl = self._calibration_cl()
+
+        self._struct_cleanup_from_perturb()
+        self.coarse = False
+        self._compute_from_perturb(level)
+
+        full_cl = self._calibration_cl()
+        if coarse_cl is None or full_cl is None:
+            return
+        if self._coarse_rel_err is None:
+            self._coarse_rel_err = {}
+        for name in full_cl:
+            if name == 'ell':
+                continue
+            rel_err = np.abs(coarse_cl[name]-full_cl[name])
+            norm = self._cl_norm(full_cl, name)
+            rel_err[norm > 0] /= norm[norm > 0]
+            rel_err[norm <= 0] = 0.
+            if name in self._coarse_rel_err and len(self._coarse_rel_err[name]) == len(rel_err):
+                rel_err = np.maximum(rel_err, self._coarse_rel_err[name])
+            self._coarse_rel_err[name] = rel_err
+        return
+
+    def coarse_cl_error(self):
+        """
+        coarse_cl_error()
+
+        Estimated absolute error on the C_l's (lensed ones if the
+        lensing module was computed, raw ones otherwise) of the last run
+        of :meth:`compute_coarse`: largest relative difference between
+        coarse and refined C_l's found by the previous calls to
+        :meth:`refine`, times the current C_l (times sqrt(C_l^XX C_l^YY)
+        for cross-spectra). Zero after a full computation.
+
+        Returns
+        -------
+        cl_error : dict
+                Same keys as the output of :meth:`lensed_cl`
+        """
+        cl = self._calibration_cl()
+        if cl is None:
+            raise CosmoSevereError("No Cl computed")
+        error = {'ell': cl['ell']}
+        for name in cl:
+            if name == 'ell':
+                continue
+            if not self.coarse:
+                error[name] = np.zeros_like(cl[name])
+                continue
+            if self._coarse_rel_err is None or name not in self._coarse_rel_err or len(
+                    self._coarse_rel_err[name]) != len(cl[name]):
+                raise CosmoSevereError(
+                    "The error of the coarse Cl's has not been calibrated yet: call refine() at least once")
+            error[name] = self._coarse_rel_err[name]*self._cl_norm(cl, name)
+        return error
+
+    def _calibration_cl(self):
+        if "lensing" in self.ncp:
+            return self.lensed_cl()
+        if "spectra" in self.ncp and (self.sp.has_tt or self.sp.has_ee or self.sp.has_te or
+                                      self.sp.has_bb or self.sp.has_pp or self.sp.has_tp):
+            return self.raw_cl()
+        return None
+
+    def _cl_norm(self, cl, name):
+        cross = {'te': ('tt', 'ee'), 'tp': ('tt', 'pp')}
+        if name in cross and cross[name][0] in cl and cross[name][1] in cl:
+            return np.sqrt(np.abs(cl[cross[name][0]]*cl[cross[name][1]]))
+        return np.abs(cl[name])
+
+    def _compute_thermodynamics(self, level):
+        if "thermodynamics" in level:
+            if thermodynamics_init(&(self.pr), &(self.ba),
+                                   &(self.th)) == _FAILURE_:
+                self.struct_cleanup()
+                raise CosmoComputationError(self.th.error_message)
+            self.ncp.add("thermodynamics")
+
+    def _compute_until_thermodynamics(self, level):
+        """
+        First stage of :meth:`compute`: run the input and background
+        modules if required by level.
+
+        Returns the completed list of modules to compute, or None if
+        nothing remains to be done.
         """
         cdef ErrorMsg errmsg
 
@@ -287,7 +462,7 @@ cdef class Class:
         # equivalent to) level. If it is the case, simply stop the execution of
         # the function.
         if self.ready and self.ncp.issuperset(level):
-            return
+            return None
 
         # Check if already allocated to prevent memory leaks
         if self.allocated:
@@ -295,6 +470,7 @@ cdef class Class:
 
         # Otherwise, proceed with the normal computation.
         self.ready = False
+        self.coarse = False
 
         # Equivalent of writing a parameter file
         self._fillparfile()
@@ -337,43 +513,49 @@ cdef class Class:
                 raise CosmoComputationError(self.ba.error_message)
             self.ncp.add("background")
 
-        if "thermodynamics" in level:
-            if thermodynamics_init(&(self.pr), &(self.ba),
-                                   &(self.th)) == _FAILURE_:
-                self.struct_cleanup()
-                raise CosmoComputationError(self.th.error_message)
-            self.ncp.add("thermodynamics")
+        return level
+
+    def _compute_from_perturb(self, level):
+        """
+        Last stage of :meth:`compute`: run all the modules after
+        thermodynamics required by level, and mark the instance as ready.
+        These modules use the coarse precision profile if self.coarse is set.
+        """
+        cdef precision * ppr = &self.pr
+        if self.coarse:
+            ppr = &self.pr_coarse
 
         if "perturb" in level:
-            if perturb_init(&(self.pr), &(self.ba),
+            if perturb_init(ppr, &(self.ba),
                             &(self.th), &(self.pt)) == _FAILURE_:
                 self.struct_cleanup()
                 raise CosmoComputationError(self.pt.error_message)
             self.ncp.add("perturb")
 
         if "primordial" in level:
-            if primordial_init(&(self.pr), &(self.pt),
+            if primordial_init(ppr, &(self.pt),
                                &(self.pm)) == _FAILURE_:
                 self.struct_cleanup()
                 raise CosmoComputationError(self.pm.error_message)
             self.ncp.add("primordial")
 
         if "nonlinear" in level:
-            if nonlinear_init(&self.pr, &self.ba, &self.th,
+            if nonlinear_init(ppr, &self.ba, &self.th,
                               &self.pt, &self.pm, &self.nl) == _FAILURE_:
                 self.struct_cleanup()
                 raise CosmoComputationError(self.nl.error_message)
             self.ncp.add("nonlinear")
 
         if "transfer" in level:
-            if transfer_init(&(self.pr), &(self.ba), &(self.th),
-                             &(self.pt), &(self.nl), &(self.tr)) == _FAILURE_:
+            if transfer_init(ppr, &(self.ba), &(self.th),
+                             &(self.pt), &(self.pm), &(self.nl),
+                             &(self.tr)) == _FAILURE_:
                 self.struct_cleanup()
                 raise CosmoComputationError(self.tr.error_message)
             self.ncp.add("transfer")
 
         if "spectra" in level:
-            if spectra_init(&(self.pr), &(self.ba), &(self.pt),
+            if spectra_init(ppr, &(self.ba), &(self.pt),
                             &(self.pm), &(self.nl), &(self.tr),
                             &(self.sp)) == _FAILURE_:
                 self.struct_cleanup()
@@ -381,7 +563,7 @@ cdef class Class:
             self.ncp.add("spectra")
 
         if "lensing" in level:
-            if lensing_init(&(self.pr), &(self.pt), &(self.sp),
+            if lensing_init(ppr, &(self.pt), &(self.sp),
                             &(self.nl), &(self.le)) == _FAILURE_:
                 self.struct_cleanup()
                 raise CosmoComputationError(self.le.error_message)
@@ -389,9 +571,6 @@ cdef class Class:
 
         self.ready = True
         self.allocated = True
-
-        # At this point, the cosmological instance contains everything needed. The
-        # following functions are only to output the desired numbers
         return
 
     def raw_cl(self, lmax=-1, nofail=False):
@@ -553,6 +732,79 @@ cdef class Class:
         free(lcl)
         return cl
 
+    def add_bandpower_window(self, cl_type, weights, l_min, bin1=0, bin2=0, lensed=False):
+        """
+        add_bandpower_window(cl_type, weights, l_min, bin1=0, bin2=0, lensed=False)
+
+        Append a window function to the list of bandpowers returned by
+        bandpowers(). The list is kept when parameters change, so
+        that windows need to be set only once.
+
+        Parameters
+        ----------
+        cl_type : str
+                Type of C_l's: 'tt', 'ee', 'te', 'bb', 'pp', 'tp', 'ep', or
+                for number counts (d) and galaxy lensing (l): 'dd', 'pd',
+                'll', 'dl'
+        weights : array
+                Weights W(l) for l=l_min, ..., l_min+len(weights)-1
+        l_min : int
+                First multipole of the window (at least 2)
+        bin1, bin2 : int, optional
+                Redshift bins (starting from 0) for number count and galaxy
+                lensing types
+        lensed : bool, optional
+                Bin the lensed instead of the unlensed C_l's
+        """
+        cdef np.ndarray[DTYPE_t, ndim=1] w = np.ascontiguousarray(weights, dtype=np.double)
+        if w.shape[0] == 0:
+            raise CosmoSevereError("empty bandpower window")
+        cl_type_bytes = cl_type.encode()
+        if bandpowers_add_window(&self.bp, cl_type_bytes, bin1, bin2, lensed,
+                                 l_min, l_min+w.shape[0]-1, &w[0]) == _FAILURE_:
+            raise CosmoSevereError(self.bp.error_message)
+
+    def read_bandpower_windows(self, filename):
+        """
+        read_bandpower_windows(filename)
+
+        Append to the list of bandpowers the windows found in a file,
+        with one record per window:
+        type bin1 bin2 lensed l_min l_max W(l_min) ... W(l_max)
+        """
+        filename_bytes = filename.encode()
+        if bandpowers_read_windows(&self.bp, filename_bytes) == _FAILURE_:
+            raise CosmoSevereError(self.bp.error_message)
+
+    def clear_bandpower_windows(self):
+        """
+        clear_bandpower_windows()
+
+        Remove all windows set with add_bandpower_window() or
+        read_bandpower_windows()
+        """
+        bandpowers_free(&self.bp)
+
+    def bandpowers(self):
+        """
+        bandpowers()
+
+        Return the bandpowers sum_l W(l) C_l for all windows, computed in C
+        (and in parallel) from the C_l tables of the current model, in
+        dimensionless units like raw_cl() and lensed_cl().
+
+        Returns
+        -------
+        bandpowers : numpy array
+                One value per window, in the order in which they were added
+        """
+        if not "lensing" in self.ncp:
+            raise CosmoSevereError("bandpowers require the computation of the spectra and lensing modules")
+        cdef np.ndarray[DTYPE_t, ndim=1] result = np.zeros(max(self.bp.bp_size, 1), dtype=np.double)
+        if bandpowers_compute(&self.sp, &self.le, &self.bp, &result[0]) == _FAILURE_:
+            raise CosmoSevereError(self.bp.error_message)
+        return result[:self.bp.bp_size]
+
     def density_cl(self, lmax=-1, nofail=False):
         """
         density_cl(lmax=-1, nofail=False)
@@ -572,7 +824,9 @@ cdef class Class:
             Array that contains the list (in this order) of self correlation of
             1st bin, then successive correlations (set by non_diagonal) to the
             following bins, then self correlation of 2nd bin, etc. The array
-            starts at index_ct_dd.
+            starts at index_ct_dd. For 'dd', pairs of bins skipped because of
+            non_diagonal_min_overlap are absent from the list; the key
+            'dd_pairs' gives the pair of bins of each entry.
         """
         cdef int lmaxR
         cdef double *dcl = <double*> calloc(self.sp.ct_size,sizeof(double))
@@ -623,13 +877,20 @@ cdef class Class:
         # For density Cls, the size is bigger (different redshfit bins)
         # computes the size, given the number of correlations needed to be computed
         size = (self.sp.d_size*(self.sp.d_size+1)-(self.sp.d_size-self.sp.non_diag)*
-                (self.sp.d_size-1-self.sp.non_diag))/2;
+                (self.sp.d_size-1-self.sp.non_diag))//2
+        sizes = {'dd': self.sp.dd_size, 'll': size,
+                 'dl': self.sp.d_size*self.sp.d_size-(self.sp.d_size-self.sp.non_diag)*(self.sp.d_size-1-self.sp.non_diag)}
         for elem in ['dd', 'll', 'dl']:
             if elem in spectra:
                 cl[elem] = {}
-                for index in range(size):
+                for index in range(sizes[elem]):
                     cl[elem][index] = np.zeros(
                         lmax+1, dtype=np.double)
+        if 'dd' in spectra:
+            cl['dd_pairs'] = [(index_d1, index_d2)
+                              for index_d1 in range(self.sp.d_size)
+                              for index_d2 in range(index_d1, self.sp.d_size)
+                              if self.sp.has_dd_pair[index_d1*self.sp.d_size+index_d2]]
         for elem in ['td', 'tl']:
             if elem in spectra:
                 cl[elem] = np.zeros(lmax+1, dtype=np.double)
@@ -638,13 +899,13 @@ cdef class Class:
             if spectra_cl_at_l(&self.sp, ell, dcl, cl_md, cl_md_ic) == _FAILURE_:
                 raise CosmoSevereError(self.sp.error_message)
             if 'dd' in spectra:
-                for index in range(size):
+                for index in range(sizes['dd']):
                     cl['dd'][index][ell] = dcl[self.sp.index_ct_dd+index]
             if 'll' in spectra:
-                for index in range(size):
+                for index in range(sizes['ll']):
                     cl['ll'][index][ell] = dcl[self.sp.index_ct_ll+index]
             if 'dl' in spectra:
-                for index in range(size):
+                for index in range(sizes['dl']):
                     cl['dl'][index][ell] = dcl[self.sp.index_ct_dl+index]
             if 'td' in spectra:
                 cl['td'][ell] = dcl[self.sp.index_ct_td]
@@ -691,20 +952,10 @@ cdef class Class:
     def luminosity_distance(self, z):
         """
         luminosity_distance(z)
-        """
-        cdef double tau=0.0
-        cdef int last_index = 0  # junk
-        pvecback = <double*> calloc(self.ba.bg_size,sizeof(double))
 
-        if background_tau_of_z(&self.ba, z, &tau)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        if background_at_tau(&self.ba, tau, self.ba.long_info,
-                self.ba.inter_normal, &last_index, pvecback)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-        lum_distance = pvecback[self.ba.index_bg_lum_distance]
-        free(pvecback)
-        return lum_distance
+        z can be a float or an array (see angular_distance)
+        """
+        return self._background_at_z(z, self.ba.index_bg_lum_distance)
 
     # Gives the pk for a given (k,z)
     def pk(self,double k,double z):
@@ -1046,35 +1297,89 @@ cdef class Class:
         self.compute(["thermodynamics"])
         return self.th.rs_d
 
-    def angular_distance(self, z):
+    def _background_at_z(self, z, int index_bg):
         """
-        angular_distance(z)
+        Interpolate one column of the background table at one or several redshifts
 
-        Return the angular diameter distance (exactly, the quantity defined by Class
-        as index_bg_ang_distance in the background module)
+        Returns a float for a scalar z, and otherwise an array with the shape of z.
+        The redshifts are sorted once, so that the tables are walked through
+        a single time (see background_at_z_vector() in the background module).
+        """
+        cdef np.ndarray[DTYPE_t, ndim=1] z_sorted
+        cdef np.ndarray[DTYPE_t, ndim=1] result
+        cdef double * z_pointer
+        cdef double * result_pointer
+        cdef int z_size, status
+        z_flat = np.atleast_1d(np.asarray(z, dtype='float64')).ravel()
+        if z_flat.size == 0:
+            return np.zeros(np.shape(z),'float64')
+        order = np.argsort(-z_flat, kind='mergesort')
+        z_sorted = np.ascontiguousarray(z_flat[order])
+        result = np.zeros(len(z_sorted),'float64')
+        z_pointer = &z_sorted[0]
+        result_pointer = &result[0]
+        z_size = len(z_sorted)
+
+        with nogil:
+            status = background_at_z_vector(&self.ba,z_pointer,z_size,index_bg,result_pointer)
+        if status == _FAILURE_:
+            raise CosmoSevereError(self.ba.error_message)
 
-        Parameters
-        ----------
-        z : float
-                Desired redshift
+        return self._unsort(z, order, result)
+
+    def _thermodynamics_at_z(self, z, int index_th):
         """
-        cdef double tau
-        cdef int last_index #junk
-        cdef double * pvecback
+        Interpolate one column of the thermodynamics table at one or several redshifts
 
-        pvecback = <double*> calloc(self.ba.bg_size,sizeof(double))
+        Same conventions as _background_at_z()
+        (see thermodynamics_at_z_vector() in the thermodynamics module).
+        """
+        cdef np.ndarray[DTYPE_t, ndim=1] z_sorted
+        cdef np.ndarray[DTYPE_t, ndim=1] result
+        cdef double * z_pointer
+        cdef double * result_pointer
+        cdef int z_size, status
+        z_flat = np.atleast_1d(np.asarray(z, dtype='float64')).ravel()
+        if z_flat.size == 0:
+            return np.zeros(np.shape(z),'float64')
+        order = np.argsort(z_flat, kind='mergesort')
+        z_sorted = np.ascontiguousarray(z_flat[order])
+        result = np.zeros(len(z_sorted),'float64')
+        z_pointer = &z_sorted[0]
+        result_pointer = &result[0]
+        z_size = len(z_sorted)
+
+        with nogil:
+            status = thermodynamics_at_z_vector(&self.ba,&self.th,z_pointer,z_size,index_th,result_pointer)
+        if status == _FAILURE_:
+            raise CosmoSevereError(self.th.error_message)
 
-        if background_tau_of_z(&self.ba,z,&tau)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
+        return self._unsort(z, order, result)
 
-        if background_at_tau(&self.ba,tau,self.ba.long_info,self.ba.inter_normal,&last_index,pvecback)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
+    def _unsort(self, x, order, sorted_result):
+        """
+        Put back in the original order (and shape) of x a result computed on sorted(x)
+        """
+        if np.ndim(x) == 0:
+            return float(sorted_result[0])
+        result = np.empty_like(sorted_result)
+        result[order] = sorted_result
+        return result.reshape(np.shape(x))
 
-        D_A = pvecback[self.ba.index_bg_ang_distance]
+    def angular_distance(self, z):
+        """
+        angular_distance(z)
 
-        free(pvecback)
+        Return the angular diameter distance (exactly, the quantity defined by Class
+        as index_bg_ang_distance in the background module)
 
-        return D_A
+        Parameters
+        ----------
+        z : float or array
+                Desired redshift(s). For an array, the result has the same shape,
+                and all values are obtained in a single walk through the tables
+        """
+        return self._background_at_z(z, self.ba.index_bg_ang_distance)
 
     def scale_independent_growth_factor(self, z):
         """
@@ -1085,26 +1390,11 @@ cdef class Class:
 
         Parameters
         ----------
-        z : float
-                Desired redshift
+        z : float or array
+                Desired redshift(s). For an array, the result has the same shape,
+                and all values are obtained in a single walk through the tables
         """
-        cdef double tau
-        cdef int last_index #junk
-        cdef double * pvecback
-
-        pvecback = <double*> calloc(self.ba.bg_size,sizeof(double))
-
-        if background_tau_of_z(&self.ba,z,&tau)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        if background_at_tau(&self.ba,tau,self.ba.long_info,self.ba.inter_normal,&last_index,pvecback)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        D = pvecback[self.ba.index_bg_D]
-
-        free(pvecback)
-
-        return D
+        return self._background_at_z(z, self.ba.index_bg_D)
 
     def scale_independent_growth_factor_f(self, z):
         """
@@ -1115,26 +1405,11 @@ cdef class Class:
 
         Parameters
         ----------
-        z : float
-                Desired redshift
+        z : float or array
+                Desired redshift(s). For an array, the result has the same shape,
+                and all values are obtained in a single walk through the tables
         """
-        cdef double tau
-        cdef int last_index #junk
-        cdef double * pvecback
-
-        pvecback = <double*> calloc(self.ba.bg_size,sizeof(double))
-
-        if background_tau_of_z(&self.ba,z,&tau)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        if background_at_tau(&self.ba,tau,self.ba.long_info,self.ba.inter_normal,&last_index,pvecback)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        f = pvecback[self.ba.index_bg_f]
-
-        free(pvecback)
-
-        return f
+        return self._background_at_z(z, self.ba.index_bg_f)
 
     def z_of_tau(self, tau):
         """
@@ -1142,23 +1417,31 @@ cdef class Class:
 
         Parameters
         ----------
-        tau : float
-                Conformal time
+        tau : float or array
+                Conformal time(s). For an array, the result has the same shape
         """
-        cdef double z
-        cdef int last_index #junk
-        cdef double * pvecback
-
-        pvecback = <double*> calloc(self.ba.bg_size,sizeof(double))
-
-        if background_at_tau(&self.ba,tau,self.ba.long_info,self.ba.inter_normal,&last_index,pvecback)==_FAILURE_:
+        cdef np.ndarray[DTYPE_t, ndim=1] tau_sorted
+        cdef np.ndarray[DTYPE_t, ndim=1] a
+        cdef double * tau_pointer
+        cdef double * a_pointer
+        cdef int tau_size, index_bg_a, status
+        tau_flat = np.atleast_1d(np.asarray(tau, dtype='float64')).ravel()
+        if tau_flat.size == 0:
+            return np.zeros(np.shape(tau),'float64')
+        order = np.argsort(tau_flat, kind='mergesort')
+        tau_sorted = np.ascontiguousarray(tau_flat[order])
+        a = np.zeros(len(tau_sorted),'float64')
+        tau_pointer = &tau_sorted[0]
+        a_pointer = &a[0]
+        tau_size = len(tau_sorted)
+        index_bg_a = self.ba.index_bg_a
+
+        with nogil:
+            status = background_at_tau_vector(&self.ba,tau_pointer,tau_size,index_bg_a,a_pointer)
+        if status == _FAILURE_:
             raise CosmoSevereError(self.ba.error_message)
 
-        z = 1./pvecback[self.ba.index_bg_a]-1.
-
-        free(pvecback)
-
-        return z
+        return self._unsort(tau, order, 1./a-1.)
 
     def Hubble(self, z):
         """
@@ -1169,26 +1452,11 @@ cdef class Class:
 
         Parameters
         ----------
-        z : float
-                Desired redshift
+        z : float or array
+                Desired redshift(s). For an array, the result has the same shape,
+                and all values are obtained in a single walk through the tables
         """
-        cdef double tau
-        cdef int last_index #junk
-        cdef double * pvecback
-
-        pvecback = <double*> calloc(self.ba.bg_size,sizeof(double))
-
-        if background_tau_of_z(&self.ba,z,&tau)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        if background_at_tau(&self.ba,tau,self.ba.long_info,self.ba.inter_normal,&last_index,pvecback)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        H = pvecback[self.ba.index_bg_H]
-
-        free(pvecback)
-
-        return H
+        return self._background_at_z(z, self.ba.index_bg_H)
 
     def ionization_fraction(self, z):
         """
@@ -1198,32 +1466,11 @@ cdef class Class:
 
         Parameters
         ----------
-        z : float
-                Desired redshift
+        z : float or array
+                Desired redshift(s). For an array, the result has the same shape,
+                and all values are obtained in a single walk through the tables
         """
-        cdef double tau
-        cdef int last_index #junk
-        cdef double * pvecback
-        cdef double * pvecthermo
-
-        pvecback = <double*> calloc(self.ba.bg_size,sizeof(double))
-        pvecthermo = <double*> calloc(self.th.th_size,sizeof(double))
-
-        if background_tau_of_z(&self.ba,z,&tau)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        if background_at_tau(&self.ba,tau,self.ba.long_info,self.ba.inter_normal,&last_index,pvecback)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        if thermodynamics_at_z(&self.ba,&self.th,z,self.th.inter_normal,&last_index,pvecback,pvecthermo) == _FAILURE_:
-            raise CosmoSevereError(self.th.error_message)
-
-        xe = pvecthermo[self.th.index_th_xe]
-
-        free(pvecback)
-        free(pvecthermo)
-
-        return xe
+        return self._thermodynamics_at_z(z, self.th.index_th_xe)
 
     def baryon_temperature(self, z):
         """
@@ -1233,32 +1480,11 @@ cdef class Class:
 
         Parameters
         ----------
-        z : float
-                Desired redshift
+        z : float or array
+                Desired redshift(s). For an array, the result has the same shape,
+                and all values are obtained in a single walk through the tables
         """
-        cdef double tau
-        cdef int last_index #junk
-        cdef double * pvecback
-        cdef double * pvecthermo
-
-        pvecback = <double*> calloc(self.ba.bg_size,sizeof(double))
-        pvecthermo = <double*> calloc(self.th.th_size,sizeof(double))
-
-        if background_tau_of_z(&self.ba,z,&tau)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        if background_at_tau(&self.ba,tau,self.ba.long_info,self.ba.inter_normal,&last_index,pvecback)==_FAILURE_:
-            raise CosmoSevereError(self.ba.error_message)
-
-        if thermodynamics_at_z(&self.ba,&self.th,z,self.th.inter_normal,&last_index,pvecback,pvecthermo) == _FAILURE_:
-            raise CosmoSevereError(self.th.error_message)
-
-        Tb = pvecthermo[self.th.index_th_Tb]
-
-        free(pvecback)
-        free(pvecthermo)
-
-        return Tb
+        return self._thermodynamics_at_z(z, self.th.index_th_Tb)
 
     def T_cmb(self):
         """
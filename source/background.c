@@ -224,6 +224,149 @@ int background_tau_of_z(
   return _SUCCESS_;
 }
 
+/**
+ * One background quantity at a list of conformal times.
+ *
+ * Evaluates only the column index_bg of the interpolation table, for
+ * each value in tau_array, walking through the table with the closeby
+ * interpolation mode. The values of tau can be given in any order,
+ * but the walk is fastest when they are sorted (in either direction),
+ * since each interval is then searched starting from the previous one.
+ *
+ * @param pba        Input: pointer to background structure (containing pre-computed table)
+ * @param tau_array  Input: values of conformal time
+ * @param tau_size   Input: number of values
+ * @param index_bg   Input: index of the requested background quantity (e.g. pba->index_bg_H)
+ * @param result     Output: array of size tau_size (must be already allocated)
+ * @return the error status
+ */
+
+int background_at_tau_vector(
+                             struct background *pba,
+                             double * tau_array,
+                             int tau_size,
+                             int index_bg,
+                             double * result
+                             ) {
+
+  int index_tau;
+  int last_index=0;
+
+  class_test((index_bg < 0) || (index_bg >= pba->bg_size),
+             pba->error_message,
+             "index_bg=%d out of range [0:%d]",index_bg,pba->bg_size-1);
+
+  for (index_tau=0; index_tau<tau_size; index_tau++) {
+
+    class_test(tau_array[index_tau] < pba->tau_table[0],
+               pba->error_message,
+               "out of range: tau=%e < tau_min=%e, you should decrease the precision parameter a_ini_over_a_today_default\n",tau_array[index_tau],pba->tau_table[0]);
+
+    class_test(tau_array[index_tau] > pba->tau_table[pba->bt_size-1],
+               pba->error_message,
+               "out of range: tau=%e > tau_max=%e\n",tau_array[index_tau],pba->tau_table[pba->bt_size-1]);
+
+    class_call(array_interpolate_spline_growing_closeby(pba->tau_table,
+                                                        pba->bt_size,
+                                                        pba->background_table+index_bg,
+                                                        pba->d2background_dtau2_table+index_bg,
+                                                        pba->bg_size,
+                                                        tau_array[index_tau],
+                                                        &last_index,
+                                                        result+index_tau,
+                                                        1,
+                                                        pba->error_message),
+               pba->error_message,
+               pba->error_message);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * One background quantity at a list of redshifts.
+ *
+ * Same as calling background_tau_of_z() and then background_at_tau()
+ * for each redshift, but the tables are walked from one point to
+ * the next instead of being bisected each time, and only the
+ * column index_bg is interpolated. The redshifts can be given in any
+ * order, but the walk is fastest when they are sorted.
+ *
+ * @param pba      Input: pointer to background structure (containing pre-computed table)
+ * @param z_array  Input: values of redshift
+ * @param z_size   Input: number of values
+ * @param index_bg Input: index of the requested background quantity (e.g. pba->index_bg_ang_distance)
+ * @param result   Output: array of size z_size (must be already allocated)
+ * @return the error status
+ */
+
+int background_at_z_vector(
+                           struct background *pba,
+                           double * z_array,
+                           int z_size,
+                           int index_bg,
+                           double * result
+                           ) {
+
+  int index_z;
+  int inf,sup;
+  int last_index_tau=0;
+  double z,tau,h,a,b;
+
+  class_test((index_bg < 0) || (index_bg >= pba->bg_size),
+             pba->error_message,
+             "index_bg=%d out of range [0:%d]",index_bg,pba->bg_size-1);
+
+  /* z_table is in decreasing order: inf is such that z_table[inf] >= z >= z_table[inf+1] */
+  inf = pba->bt_size-2;
+
+  for (index_z=0; index_z<z_size; index_z++) {
+
+    z = z_array[index_z];
+
+    /** - check that \f$ z \f$ is in the pre-computed range */
+    class_test(z < pba->z_table[pba->bt_size-1],
+               pba->error_message,
+               "out of range: z=%e < z_min=%e\n",z,pba->z_table[pba->bt_size-1]);
+
+    class_test(z > pba->z_table[0],
+               pba->error_message,
+               "out of range: a=%e > a_max=%e\n",z,pba->z_table[0]);
+
+    /** - find tau(z) with the same spline as in background_tau_of_z(), starting the search from the previous interval */
+    while ((inf > 0) && (z > pba->z_table[inf])) inf--;
+    while ((inf < pba->bt_size-2) && (z < pba->z_table[inf+1])) inf++;
+    sup = inf+1;
+
+    h = pba->z_table[sup] - pba->z_table[inf];
+    b = (z-pba->z_table[inf])/h;
+    a = 1.-b;
+
+    tau = a * pba->tau_table[inf] + b * pba->tau_table[sup]
+      + ((a*a*a-a) * pba->d2tau_dz2_table[inf] + (b*b*b-b) * pba->d2tau_dz2_table[sup])*h*h/6.;
+
+    /** - interpolate the requested column only, starting the search from the previous time */
+    class_test((tau < pba->tau_table[0]) || (tau > pba->tau_table[pba->bt_size-1]),
+               pba->error_message,
+               "out of range: tau=%e not in [%e:%e]\n",tau,pba->tau_table[0],pba->tau_table[pba->bt_size-1]);
+
+    class_call(array_interpolate_spline_growing_closeby(pba->tau_table,
+                                                        pba->bt_size,
+                                                        pba->background_table+index_bg,
+                                                        pba->d2background_dtau2_table+index_bg,
+                                                        pba->bg_size,
+                                                        tau,
+                                                        &last_index_tau,
+                                                        result+index_z,
+                                                        1,
+                                                        pba->error_message),
+               pba->error_message,
+               pba->error_message);
+  }
+
+  return _SUCCESS_;
+}
+
 /**
  * Background quantities at given \f$ a \f$.
  *
@@ -772,6 +915,8 @@ int background_free(
   free(pba->d2tau_dz2_table);
   free(pba->background_table);
   free(pba->d2background_dtau2_table);
+  if (pba->has_sensitivity_smg == _TRUE_)
+    free(pba->sensitivity_today_smg);
 
   err = background_free_input(pba);
 
@@ -793,6 +938,8 @@ int background_free_noinput(
   free(pba->d2tau_dz2_table);
   free(pba->background_table);
   free(pba->d2background_dtau2_table);
+  if (pba->has_sensitivity_smg == _TRUE_)
+    free(pba->sensitivity_today_smg);
 
   return _SUCCESS_;
 }
@@ -1128,6 +1275,9 @@ int background_indices(
   class_define_index(pba->index_bi_D,_TRUE_,index_bi,1);
   class_define_index(pba->index_bi_D_prime,_TRUE_,index_bi,1);
 
+  /* -> sensitivities of the {B} variables to one parameter of the smg model (used by the shooting) */
+  class_define_index(pba->index_bi_sensitivity_smg,pba->has_sensitivity_smg,index_bi,pba->bi_B_size);
+
   /* -> index for conformal time in vector of variables to integrate */
   class_define_index(pba->index_bi_tau,_TRUE_,index_bi,1);
 
@@ -1317,6 +1467,76 @@ int background_ncdm_test_function(
   return _SUCCESS_;
 }
 
+/**
+ * Read the phase-space distribution of a non-cold relic from a file
+ * with two columns (q, f0), and spline it. This is the reading
+ * function passed to table_cache_get(), such that the file is read
+ * only once per process.
+ *
+ * The table is stored as shape[0] = number of rows and data = [q, f0,
+ * second derivative of f0] (shape[0] values each).
+ *
+ * @param filename      Input: name of the file
+ * @param table         Output: table to be filled
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int background_read_ncdm_psd_table(
+                                   char * filename,
+                                   struct file_table * table,
+                                   ErrorMsg error_message
+                                   ) {
+
+  FILE *psdfile;
+  int row,status,tablesize;
+  double tmp1,tmp2;
+  double * q;
+  double * f0;
+
+  class_open(psdfile,filename,"r",error_message);
+
+  // Find size of table:
+  for (row=0,status=2; status==2; row++){
+    status = fscanf(psdfile,"%lf %lf",&tmp1,&tmp2);
+  }
+  rewind(psdfile);
+  tablesize = row-1;
+
+  class_test(tablesize < 2,
+             error_message,
+             "could not read at least two lines (q, f0) in file %s",filename);
+
+  /*Allocate room for interpolation table: */
+  table->shape[0] = tablesize;
+  table->shape[1] = 3;
+  table->data_size = 3*tablesize;
+  class_alloc(table->data,sizeof(double)*table->data_size,error_message);
+  q = table->data;
+  f0 = q+tablesize;
+
+  for (row=0; row<tablesize; row++){
+    status = fscanf(psdfile,"%lf %lf",
+                    &q[row],&f0[row]);
+    //		printf("(q,f0) = (%g,%g)\n",q[row],f0[row]);
+  }
+  fclose(psdfile);
+
+  /* Call spline interpolation: */
+  class_call_except(array_spline_table_lines(q,
+                                             tablesize,
+                                             f0,
+                                             1,
+                                             f0+tablesize,
+                                             _SPLINE_EST_DERIV_,
+                                             error_message),
+                    error_message,
+                    error_message,
+                    free(table->data));
+
+  return _SUCCESS_;
+}
+
 /**
  * This function finds optimal quadrature weights for each ncdm
  * species
@@ -1330,10 +1550,10 @@ int background_ncdm_init(
                          struct background *pba
                          ) {
 
-  int index_q, k,tolexp,row,status,filenum;
-  double f0m2,f0m1,f0,f0p1,f0p2,dq,q,df0dq,tmp1,tmp2;
+  int index_q, k,tolexp,filenum;
+  double f0m2,f0m1,f0,f0p1,f0p2,dq,q,df0dq;
   struct background_parameters_for_distributions pbadist;
-  FILE *psdfile;
+  struct file_table * psd_table;
 
   pbadist.pba = pba;
 
@@ -1355,36 +1575,18 @@ int background_ncdm_init(
     pbadist.tablesize = 0;
     /*Do we need to read in a file to interpolate the distribution function? */
     if ((pba->got_files!=NULL)&&(pba->got_files[k]==_TRUE_)){
-      psdfile = fopen(pba->ncdm_psd_files+filenum*_ARGUMENT_LENGTH_MAX_,"r");
-      class_test(psdfile == NULL,pba->error_message,
-                 "Could not open file %s!",pba->ncdm_psd_files+filenum*_ARGUMENT_LENGTH_MAX_);
-      // Find size of table:
-      for (row=0,status=2; status==2; row++){
-        status = fscanf(psdfile,"%lf %lf",&tmp1,&tmp2);
-      }
-      rewind(psdfile);
-      pbadist.tablesize = row-1;
-
-      /*Allocate room for interpolation table: */
-      class_alloc(pbadist.q,sizeof(double)*pbadist.tablesize,pba->error_message);
-      class_alloc(pbadist.f0,sizeof(double)*pbadist.tablesize,pba->error_message);
-      class_alloc(pbadist.d2f0,sizeof(double)*pbadist.tablesize,pba->error_message);
-      for (row=0; row<pbadist.tablesize; row++){
-        status = fscanf(psdfile,"%lf %lf",
-                        &pbadist.q[row],&pbadist.f0[row]);
-        //		printf("(q,f0) = (%g,%g)\n",pbadist.q[row],pbadist.f0[row]);
-      }
-      fclose(psdfile);
-      /* Call spline interpolation: */
-      class_call(array_spline_table_lines(pbadist.q,
-                                          pbadist.tablesize,
-                                          pbadist.f0,
-                                          1,
-                                          pbadist.d2f0,
-                                          _SPLINE_EST_DERIV_,
-                                          pba->error_message),
+      /* read and spline the table, or get it from the table cache if
+         this file was already read in this process */
+      class_call(table_cache_get(pba->ncdm_psd_files+filenum*_ARGUMENT_LENGTH_MAX_,
+                                 background_read_ncdm_psd_table,
+                                 &psd_table,
+                                 pba->error_message),
                  pba->error_message,
                  pba->error_message);
+      pbadist.tablesize = psd_table->shape[0];
+      pbadist.q = psd_table->data;
+      pbadist.f0 = pbadist.q+pbadist.tablesize;
+      pbadist.d2f0 = pbadist.f0+pbadist.tablesize;
       filenum++;
     }
 
@@ -1522,15 +1724,15 @@ int background_ncdm_init(
         pba->dlnf0_dlnq_ncdm[k][index_q] = q/f0*df0dq;
     }
 
+    /* the table of the p.s.d. is not needed anymore */
+    if (pbadist.q != NULL) {
+      class_call(table_cache_release(psd_table,pba->error_message),
+                 pba->error_message,
+                 pba->error_message);
+    }
+
     pba->factor_ncdm[k]=pba->deg_ncdm[k]*4*_PI_*pow(pba->T_cmb*pba->T_ncdm[k]*_k_B_,4)*8*_PI_*_G_
       /3./pow(_h_P_/2./_PI_,3)/pow(_c_,7)*_Mpc_over_m_*_Mpc_over_m_;
-
-    /* If allocated, deallocate interpolation table:  */
-    if ((pba->got_files!=NULL)&&(pba->got_files[k]==_TRUE_)){
-      free(pbadist.q);
-      free(pbadist.f0);
-      free(pbadist.d2f0);
-    }
   }
 
 
@@ -1737,6 +1939,13 @@ int background_solve(
              pba->error_message,
              pba->error_message);
 
+  /** - if needed, prepare the workspace of the sensitivities and impose their initial conditions with background_initial_conditions_sensitivity_smg() */
+  if (pba->has_sensitivity_smg == _TRUE_) {
+    class_call(background_initial_conditions_sensitivity_smg(ppr,pba,&bpaw,pvecback_integration),
+               pba->error_message,
+               pba->error_message);
+  }
+
   /** - initialize generic integrator with initialize_generic_integrator() */
 
   /* Size of vector to integrate is (pba->bi_size-1) rather than
@@ -1746,6 +1955,14 @@ int background_solve(
              gi.error_message,
              pba->error_message);
 
+  /* The sensitivities start from zero or from tiny values, and their
+     derivatives carry the round-off of one-sided differences: they
+     follow the steps chosen for the other variables, without entering
+     the error test (index_bi_sensitivity_smg comes after all {B} and {C}
+     variables) */
+  if (pba->has_sensitivity_smg == _TRUE_)
+    gi.n_error = pba->index_bi_sensitivity_smg;
+
   /* here tau_end is in fact the initial time (in the next loop
      tau_start = tau_end) */
   tau_end=pvecback_integration[pba->index_bi_tau];
@@ -1845,6 +2062,16 @@ int background_solve(
   for (i=0; i<pba->bi_size; i++)
     pData[(pba->bt_size-1)*pba->bi_size+i]=pvecback_integration[i];
 
+  /** - if needed, deduce the derivatives of the background quantities today with background_sensitivity_today_smg() */
+  if (pba->has_sensitivity_smg == _TRUE_) {
+    class_call(background_sensitivity_today_smg(pba,pvecback_integration,&bpaw),
+               pba->error_message,
+               pba->error_message);
+    class_call(background_free_sensitivity_smg(&bpaw),
+               pba->error_message,
+               pba->error_message);
+  }
+
   /** - deduce age of the Universe */
   /* -> age in Gyears */
   pba->age = pvecback_integration[pba->index_bi_time]/_Gyr_over_Mpc_;
@@ -2892,6 +3119,194 @@ int background_initial_conditions(
 
 }
 
+/**
+ * Initial conditions of the sensitivities \f$ s = \partial y_B /
+ * \partial p \f$ of the {B} variables to the parameter \f$ p \f$ =
+ * parameters_smg[sensitivity_index_smg], and workspace of
+ * background_derivs_sensitivity_smg().
+ *
+ * The workspace contains a copy of the background structure, with
+ * its own parameters_smg and without sensitivities, in which p can be
+ * shifted: pba itself is never modified while the background is
+ * integrated. The initial conditions are a one-sided difference of
+ * those computed by background_initial_conditions() with p and p+h.
+ *
+ * The initial conformal time depends slightly on p, so that this is
+ * the derivative at fixed a rather than at fixed tau. The difference
+ * is proportional to \f$ y_B' \f$, a solution of the equations of the
+ * sensitivities, which is removed at the end by
+ * background_sensitivity_today_smg().
+ *
+ * Must be called after background_initial_conditions(). The
+ * workspace is freed by background_free_sensitivity_smg().
+ *
+ * @param ppr                  Input: pointer to precision structure
+ * @param pba                  Input: pointer to background structure
+ * @param pbpaw                Input/Output: pointer to parameters and workspace of background_derivs(), in which the workspace of the sensitivities is allocated
+ * @param pvecback_integration Input/Output: initial conditions, in which those of the sensitivities are written
+ * @return the error status
+ */
+
+int background_initial_conditions_sensitivity_smg(
+                                                  struct precision *ppr,
+                                                  struct background *pba,
+                                                  struct background_parameters_and_workspace * pbpaw,
+                                                  double * pvecback_integration
+                                                  ) {
+
+  struct background * pba_sensitivity;
+  double p,h;
+  int i;
+
+  p = pba->parameters_smg[pba->sensitivity_index_smg];
+  h = _SENSITIVITY_STEP_SMG_*fabs(p);
+  if (h == 0.)
+    h = _SENSITIVITY_STEP_SMG_;
+  pbpaw->sensitivity_step = h;
+
+  /** - copy of the background structure, with its own parameters */
+  class_alloc(pbpaw->pba_sensitivity,sizeof(struct background),pba->error_message);
+  pba_sensitivity = pbpaw->pba_sensitivity;
+  *pba_sensitivity = *pba;
+  pba_sensitivity->has_sensitivity_smg = _FALSE_;
+  pba_sensitivity->background_verbose = 0;
+  class_alloc(pba_sensitivity->parameters_smg,pba->parameters_size_smg*sizeof(double),pba->error_message);
+  for (i=0; i<pba->parameters_size_smg; i++)
+    pba_sensitivity->parameters_smg[i] = pba->parameters_smg[i];
+
+  class_alloc(pbpaw->pbpaw_sensitivity,sizeof(struct background_parameters_and_workspace),pba->error_message);
+  pbpaw->pbpaw_sensitivity->pba = pba_sensitivity;
+  class_alloc(pbpaw->pbpaw_sensitivity->pvecback,pba->bg_size*sizeof(double),pba->error_message);
+
+  class_alloc(pbpaw->y_sensitivity,pba->bi_size*sizeof(double),pba->error_message);
+  class_alloc(pbpaw->dy_sensitivity,pba->bi_size*sizeof(double),pba->error_message);
+
+  /** - initial conditions for the parameter shifted by h */
+  pba_sensitivity->parameters_smg[pba->sensitivity_index_smg] = p+h;
+
+  class_call(background_initial_conditions(ppr,pba_sensitivity,pbpaw->pbpaw_sensitivity->pvecback,pbpaw->y_sensitivity),
+             pba_sensitivity->error_message,
+             pba->error_message);
+
+  pba_sensitivity->parameters_smg[pba->sensitivity_index_smg] = p;
+
+  for (i=0; i<pba->bi_B_size; i++)
+    pvecback_integration[pba->index_bi_sensitivity_smg+i] = (pbpaw->y_sensitivity[i]-pvecback_integration[i])/h;
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Free the workspace of the sensitivities allocated by
+ * background_initial_conditions_sensitivity_smg().
+ *
+ * @param pbpaw Input: pointer to parameters and workspace of background_derivs()
+ * @return the error status
+ */
+
+int background_free_sensitivity_smg(
+                                    struct background_parameters_and_workspace * pbpaw
+                                    ) {
+
+  free(pbpaw->pba_sensitivity->parameters_smg);
+  free(pbpaw->pba_sensitivity);
+  free(pbpaw->pbpaw_sensitivity->pvecback);
+  free(pbpaw->pbpaw_sensitivity);
+  free(pbpaw->y_sensitivity);
+  free(pbpaw->dy_sensitivity);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Derivatives with respect to the parameter \f$ p \f$ =
+ * parameters_smg[sensitivity_index_smg] of the background quantities
+ * today, stored in pba->sensitivity_today_smg.
+ *
+ * The sensitivities s integrated up to today are derivatives at fixed
+ * conformal time. They are first turned into derivatives at fixed
+ * scale factor, \f$ s - y_B' s_a / a' \f$. The derivatives of all
+ * quantities computed by background_functions() from the {B}
+ * variables then follow from a one-sided difference along this
+ * direction (with the parameter shifted in the copy of the background
+ * structure of the workspace), without integrating the background
+ * again. Quantities depending on the {C} variables (age, distances,
+ * growth factor) are not differentiated, their derivative is left to
+ * zero.
+ *
+ * @param pba                  Input/Output: pointer to background structure
+ * @param pvecback_integration Input: variables today (including the sensitivities)
+ * @param pbpaw                Input: pointer to parameters and workspace of background_derivs()
+ * @return the error status
+ */
+
+int background_sensitivity_today_smg(
+                                     struct background *pba,
+                                     double * pvecback_integration,
+                                     struct background_parameters_and_workspace * pbpaw
+                                     ) {
+
+  struct background * pba_sensitivity;
+  double * s;
+  double * dy;
+  double * y_shifted;
+  double * pvecback;
+  double * pvecback_shifted;
+  double h,p,s_a_over_a_prime;
+  int i;
+
+  pba_sensitivity = pbpaw->pba_sensitivity;
+  s = pvecback_integration+pba->index_bi_sensitivity_smg;
+  dy = pbpaw->dy_sensitivity;
+  y_shifted = pbpaw->y_sensitivity;
+  h = pbpaw->sensitivity_step;
+  p = pba->parameters_smg[pba->sensitivity_index_smg];
+
+  class_calloc(pvecback,pba->bg_size,sizeof(double),pba->error_message);
+  class_calloc(pvecback_shifted,pba->bg_size,sizeof(double),pba->error_message);
+  class_alloc(pba->sensitivity_today_smg,pba->bg_size*sizeof(double),pba->error_message);
+
+  class_call(background_derivs(pvecback_integration[pba->index_bi_tau],
+                               pvecback_integration,
+                               dy,
+                               pbpaw->pbpaw_sensitivity,
+                               pba->error_message),
+             pba->error_message,
+             pba->error_message);
+
+  /** - {B} variables today shifted by h times the sensitivities at fixed a */
+  s_a_over_a_prime = s[pba->index_bi_a]/dy[pba->index_bi_a];
+
+  for (i=0; i<pba->bi_size; i++)
+    y_shifted[i] = pvecback_integration[i];
+  for (i=0; i<pba->bi_B_size; i++)
+    y_shifted[i] += h*(s[i]-dy[i]*s_a_over_a_prime);
+
+  /** - background quantities for the two sets of variables and parameters */
+  class_call(background_functions(pba,pvecback_integration,pba->long_info,pvecback),
+             pba->error_message,
+             pba->error_message);
+
+  pba_sensitivity->parameters_smg[pba->sensitivity_index_smg] = p+h;
+
+  class_call(background_functions(pba_sensitivity,y_shifted,pba->long_info,pvecback_shifted),
+             pba_sensitivity->error_message,
+             pba->error_message);
+
+  pba_sensitivity->parameters_smg[pba->sensitivity_index_smg] = p;
+
+  for (i=0; i<pba->bg_size; i++)
+    pba->sensitivity_today_smg[i] = (pvecback_shifted[i]-pvecback[i])/h;
+
+  free(pvecback);
+  free(pvecback_shifted);
+
+  return _SUCCESS_;
+
+}
+
 /**
  * Find the time of radiation/matter equality and store characteristic
  * quantitites at that time in the background structure..
@@ -3278,6 +3693,92 @@ int background_derivs(
        + y[pba->index_bi_a]*dV_scf(pba,y[pba->index_bi_phi_scf])) ;
   }
 
+  /** - sensitivities of the {B} variables with background_derivs_sensitivity_smg() */
+  if (pba->has_sensitivity_smg == _TRUE_) {
+    class_call(background_derivs_sensitivity_smg(tau,y,dy,pbpaw,error_message),
+               error_message,
+               error_message);
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Derivative with respect to conformal time of the sensitivities of
+ * the {B} variables to the parameter \f$ p \f$ =
+ * parameters_smg[sensitivity_index_smg].
+ *
+ * Differentiating \f$ y_B' = f(y_B,p) \f$ gives the forward
+ * sensitivity equations \f$ s' = J s + \partial f/\partial p \f$ for
+ * \f$ s = \partial y_B / \partial p \f$, with the Jacobian \f$ J =
+ * \partial f/\partial y_B \f$. Since the equations of the general
+ * Horndeski models are only known through
+ * background_gravity_functions(), J is not formed: the right-hand
+ * side is the derivative of f along the direction (s,1), taken as a
+ * one-sided difference of background_derivs() with a step h in p
+ * (as the difference-quotient sensitivity right-hand side of
+ * CVODES). Forming J column by column costs bi_B_size more calls of
+ * background_derivs(), and made the shooting slower than bracketing.
+ *
+ * The shifted point is evaluated with the copy of the background
+ * structure in the workspace, so that pba is not modified. Must be
+ * called at the end of background_derivs(), since the unperturbed
+ * \f$ f(y_B,p) \f$ is read in dy.
+ *
+ * @param tau                      Input: conformal time
+ * @param y                        Input: vector of variables
+ * @param dy                       Input/Output: its derivative, in which the derivatives of the sensitivities are written
+ * @param pbpaw                    Input: pointer to fixed parameters and workspace
+ * @param error_message            Output: error message
+ * @return the error status
+ */
+
+int background_derivs_sensitivity_smg(
+                                      double tau,
+                                      double * y,
+                                      double * dy,
+                                      struct background_parameters_and_workspace * pbpaw,
+                                      ErrorMsg error_message
+                                      ) {
+
+  struct background * pba;
+  struct background * pba_sensitivity;
+  double * y_sensitivity;
+  double * dy_sensitivity;
+  double * s;
+  double * ds;
+  double h,p;
+  int i;
+
+  pba = pbpaw->pba;
+  pba_sensitivity = pbpaw->pba_sensitivity;
+  y_sensitivity = pbpaw->y_sensitivity;
+  dy_sensitivity = pbpaw->dy_sensitivity;
+  s = y+pba->index_bi_sensitivity_smg;
+  ds = dy+pba->index_bi_sensitivity_smg;
+  h = pbpaw->sensitivity_step;
+  p = pba->parameters_smg[pba->sensitivity_index_smg];
+
+  /** - variables shifted by h times the sensitivities, and parameter shifted by h */
+  for (i=0; i<pba->bi_size; i++)
+    y_sensitivity[i] = y[i];
+  for (i=0; i<pba->bi_B_size; i++)
+    y_sensitivity[i] += h*s[i];
+
+  pba_sensitivity->parameters_smg[pba->sensitivity_index_smg] = p+h;
+
+  class_call_except(background_derivs(tau,y_sensitivity,dy_sensitivity,pbpaw->pbpaw_sensitivity,error_message),
+                    error_message,
+                    error_message,
+                    pba_sensitivity->parameters_smg[pba->sensitivity_index_smg] = p);
+
+  pba_sensitivity->parameters_smg[pba->sensitivity_index_smg] = p;
+
+  /** - \f$ J s + \partial f/\partial p \f$ */
+  for (i=0; i<pba->bi_B_size; i++)
+    ds[i] = (dy_sensitivity[i]-dy[i])/h;
+
   return _SUCCESS_;
 
 }
@@ -0,0 +1,535 @@
+/** @file bandpowers.c Documented bandpowers module
+ *
+ * This module bins the unlensed or lensed \f$ C_l\f$'s of any type
+ * (TT, EE, TE, BB, phi-phi, T-phi, E-phi, and number count or galaxy
+ * lensing auto- and cross-spectra) into bandpowers,
+ *
+ * \f$ B_b = \sum_{l=l_{min}(b)}^{l_{max}(b)} W_b(l) C_l^{X(b)} \f$,
+ *
+ * for a list of window functions \f$ W_b(l) \f$ set once by the user
+ * (e.g. by a likelihood code). The \f$ C_l\f$'s are interpolated
+ * directly in the tables of the spectra and lensing structures, so
+ * that they never need to be copied multipole by multipole.
+ *
+ * The following functions can be called from other modules:
+ *
+ * -# bandpowers_init() once, before adding windows
+ * -# bandpowers_add_window() or bandpowers_read_windows() for defining the windows
+ * -# bandpowers_compute() for each model, after spectra_init() and lensing_init()
+ * -# bandpowers_free() at the end
+ */
+
+#include "bandpowers.h"
+
+/**
+ * Initialize an empty list of window functions.
+ *
+ * @param pbp Output: pointer to bandpowers structure
+ * @return the error status
+ */
+
+int bandpowers_init(
+                    struct bandpowers * pbp
+                    ) {
+
+  pbp->bp_size = 0;
+  pbp->type = NULL;
+  pbp->bin1 = NULL;
+  pbp->bin2 = NULL;
+  pbp->lensed = NULL;
+  pbp->l_min = NULL;
+  pbp->l_max = NULL;
+  pbp->offset = NULL;
+  pbp->weight = NULL;
+  pbp->weight_size = 0;
+  pbp->bandpowers_verbose = 0;
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Free all memory space allocated by bandpowers_add_window(), and
+ * leave an empty list of window functions.
+ *
+ * @param pbp Input/Output: pointer to bandpowers structure
+ * @return the error status
+ */
+
+int bandpowers_free(
+                    struct bandpowers * pbp
+                    ) {
+
+  free(pbp->type);
+  free(pbp->bin1);
+  free(pbp->bin2);
+  free(pbp->lensed);
+  free(pbp->l_min);
+  free(pbp->l_max);
+  free(pbp->offset);
+  free(pbp->weight);
+
+  class_call(bandpowers_init(pbp),
+             pbp->error_message,
+             pbp->error_message);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Find the type of C_l's with a given name: tt, ee, te, bb, pp, tp,
+ * ep, dd, td, pd, ll, tl or dl (p standing for the CMB lensing
+ * potential, d for number counts and l for galaxy lensing).
+ *
+ * @param name          Input: name of the type
+ * @param type          Output: type
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int bandpowers_type_from_name(
+                              char * name,
+                              enum bandpower_type * type,
+                              ErrorMsg error_message
+                              ) {
+
+  const char * names[] = {"tt","ee","te","bb","pp","tp","ep","dd","td","pd","ll","tl","dl"};
+  const enum bandpower_type types[] = {bp_tt,bp_ee,bp_te,bp_bb,bp_pp,bp_tp,bp_ep,bp_dd,bp_td,bp_pd,bp_ll,bp_tl,bp_dl};
+  int index_name;
+
+  for (index_name=0; index_name<(int)(sizeof(types)/sizeof(types[0])); index_name++) {
+    if (strcmp(name,names[index_name]) == 0) {
+      *type = types[index_name];
+      return _SUCCESS_;
+    }
+  }
+
+  class_stop(error_message,
+             "unknown bandpower type '%s': should be one of tt, ee, te, bb, pp, tp, ep, dd, td, pd, ll, tl, dl",
+             name);
+
+}
+
+/**
+ * Append one window function to the list.
+ *
+ * @param pbp       Input/Output: pointer to bandpowers structure
+ * @param type_name Input: type of C_l's (see bandpowers_type_from_name())
+ * @param bin1      Input: first redshift bin, starting from zero (ignored for CMB types)
+ * @param bin2      Input: second redshift bin (ignored for all types but dd, ll and dl)
+ * @param lensed    Input: _TRUE_ for binning the lensed C_l's
+ * @param l_min     Input: first multipole with non-zero weight (at least 2)
+ * @param l_max     Input: last multipole with non-zero weight
+ * @param weight    Input: array of l_max-l_min+1 weights, starting at l_min
+ * @return the error status
+ */
+
+int bandpowers_add_window(
+                          struct bandpowers * pbp,
+                          char * type_name,
+                          int bin1,
+                          int bin2,
+                          short lensed,
+                          int l_min,
+                          int l_max,
+                          double * weight
+                          ) {
+
+  enum bandpower_type type;
+  int index_bp;
+
+  class_call(bandpowers_type_from_name(type_name,&type,pbp->error_message),
+             pbp->error_message,
+             pbp->error_message);
+
+  class_test((l_min < 2) || (l_max < l_min),
+             pbp->error_message,
+             "window of bandpower %d has a wrong multipole range [%d,%d]",pbp->bp_size,l_min,l_max);
+
+  class_test((bin1 < 0) || (bin2 < 0),
+             pbp->error_message,
+             "window of bandpower %d refers to negative redshift bins (%d,%d)",pbp->bp_size,bin1,bin2);
+
+  index_bp = pbp->bp_size;
+
+  class_realloc(pbp->type,pbp->type,(index_bp+1)*sizeof(enum bandpower_type),pbp->error_message);
+  class_realloc(pbp->bin1,pbp->bin1,(index_bp+1)*sizeof(int),pbp->error_message);
+  class_realloc(pbp->bin2,pbp->bin2,(index_bp+1)*sizeof(int),pbp->error_message);
+  class_realloc(pbp->lensed,pbp->lensed,(index_bp+1)*sizeof(short),pbp->error_message);
+  class_realloc(pbp->l_min,pbp->l_min,(index_bp+1)*sizeof(int),pbp->error_message);
+  class_realloc(pbp->l_max,pbp->l_max,(index_bp+1)*sizeof(int),pbp->error_message);
+  class_realloc(pbp->offset,pbp->offset,(index_bp+1)*sizeof(int),pbp->error_message);
+  class_realloc(pbp->weight,pbp->weight,(pbp->weight_size+l_max-l_min+1)*sizeof(double),pbp->error_message);
+
+  pbp->type[index_bp] = type;
+  pbp->bin1[index_bp] = bin1;
+  pbp->bin2[index_bp] = bin2;
+  pbp->lensed[index_bp] = lensed;
+  pbp->l_min[index_bp] = l_min;
+  pbp->l_max[index_bp] = l_max;
+  pbp->offset[index_bp] = pbp->weight_size;
+
+  memcpy(pbp->weight+pbp->weight_size,weight,(l_max-l_min+1)*sizeof(double));
+
+  pbp->weight_size += l_max-l_min+1;
+  pbp->bp_size++;
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Append to the list the window functions found in a file. Each
+ * window is given by a record of white-space separated fields,
+ *
+ * type bin1 bin2 lensed l_min l_max W(l_min) ... W(l_max)
+ *
+ * with lensed equal to 0 or 1. Records may span several lines, and
+ * lines starting with # are ignored.
+ *
+ * @param pbp      Input/Output: pointer to bandpowers structure
+ * @param filename Input: name of the file
+ * @return the error status
+ */
+
+int bandpowers_read_windows(
+                            struct bandpowers * pbp,
+                            char * filename
+                            ) {
+
+  FILE * input;
+  char type_name[_ARGUMENT_LENGTH_MAX_];
+  int bin1,bin2,lensed,l_min,l_max,l;
+  double * weight;
+  int c;
+
+  class_open(input,filename,"r",pbp->error_message);
+
+  while (_TRUE_) {
+
+    /* skip white spaces and comment lines */
+    c = fgetc(input);
+    while ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r') || (c == '#')) {
+      if (c == '#') {
+        while ((c != '\n') && (c != EOF))
+          c = fgetc(input);
+      }
+      else {
+        c = fgetc(input);
+      }
+    }
+    if (c == EOF)
+      break;
+    ungetc(c,input);
+
+    class_test_except(fscanf(input,"%1023s %d %d %d %d %d",type_name,&bin1,&bin2,&lensed,&l_min,&l_max) != 6,
+                      pbp->error_message,
+                      fclose(input),
+                      "could not read the header of window %d in file %s",pbp->bp_size,filename);
+
+    class_test_except((l_min < 2) || (l_max < l_min),
+                      pbp->error_message,
+                      fclose(input),
+                      "window %d in file %s has a wrong multipole range [%d,%d]",pbp->bp_size,filename,l_min,l_max);
+
+    class_alloc(weight,(l_max-l_min+1)*sizeof(double),pbp->error_message);
+
+    for (l=l_min; l<=l_max; l++) {
+      class_test_except(fscanf(input,"%lf",weight+l-l_min) != 1,
+                        pbp->error_message,
+                        fclose(input);free(weight),
+                        "could not read the weight at l=%d of window %d in file %s",l,pbp->bp_size,filename);
+    }
+
+    class_call_except(bandpowers_add_window(pbp,type_name,bin1,bin2,(short)lensed,l_min,l_max,weight),
+                      pbp->error_message,
+                      pbp->error_message,
+                      fclose(input);free(weight));
+
+    free(weight);
+  }
+
+  fclose(input);
+
+  if (pbp->bandpowers_verbose > 0)
+    printf("Read %d bandpower windows from %s\n",pbp->bp_size,filename);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Find the index of the C_l's binned by a given bandpower in the
+ * tables of the spectra structure (or, identically, of the lensing
+ * structure), and check that they have been computed over the whole
+ * range of the window.
+ *
+ * @param psp      Input: pointer to spectra structure
+ * @param ple      Input: pointer to lensing structure
+ * @param pbp      Input: pointer to bandpowers structure
+ * @param index_bp Input: index of the bandpower
+ * @param index_ct Output: index of the C_l type
+ * @return the error status
+ */
+
+int bandpowers_index_ct(
+                        struct spectra * psp,
+                        struct lensing * ple,
+                        struct bandpowers * pbp,
+                        int index_bp,
+                        int * index_ct
+                        ) {
+
+  int bin1,bin2,index_d1,index_d2,offset;
+  short has_type=_FALSE_;
+  short has_lensed_type=_FALSE_;
+
+  bin1 = pbp->bin1[index_bp];
+  bin2 = pbp->bin2[index_bp];
+
+  /* auto- and cross-spectra of a single field are symmetric */
+  if ((pbp->type[index_bp] == bp_dd) || (pbp->type[index_bp] == bp_ll)) {
+    bin1 = MIN(pbp->bin1[index_bp],pbp->bin2[index_bp]);
+    bin2 = MAX(pbp->bin1[index_bp],pbp->bin2[index_bp]);
+  }
+
+  switch (pbp->type[index_bp]) {
+
+  case bp_tt:
+    has_type = psp->has_tt; has_lensed_type = ple->has_tt; *index_ct = psp->index_ct_tt;
+    break;
+  case bp_ee:
+    has_type = psp->has_ee; has_lensed_type = ple->has_ee; *index_ct = psp->index_ct_ee;
+    break;
+  case bp_te:
+    has_type = psp->has_te; has_lensed_type = ple->has_te; *index_ct = psp->index_ct_te;
+    break;
+  case bp_bb:
+    has_type = psp->has_bb; has_lensed_type = ple->has_bb; *index_ct = psp->index_ct_bb;
+    break;
+  case bp_pp:
+    has_type = psp->has_pp; has_lensed_type = ple->has_pp; *index_ct = psp->index_ct_pp;
+    break;
+  case bp_tp:
+    has_type = psp->has_tp; has_lensed_type = ple->has_tp; *index_ct = psp->index_ct_tp;
+    break;
+  case bp_ep:
+    has_type = psp->has_ep; *index_ct = psp->index_ct_ep;
+    break;
+
+  case bp_td:
+  case bp_pd:
+  case bp_tl:
+
+    class_test(bin1 >= psp->d_size,
+               pbp->error_message,
+               "bandpower %d refers to redshift bin %d, but only %d bins were computed",index_bp,bin1,psp->d_size);
+
+    if (pbp->type[index_bp] == bp_td) {
+      has_type = psp->has_td; has_lensed_type = ple->has_td; *index_ct = psp->index_ct_td+bin1;
+    }
+    else if (pbp->type[index_bp] == bp_pd) {
+      has_type = psp->has_pd; *index_ct = psp->index_ct_pd+bin1;
+    }
+    else {
+      has_type = psp->has_tl; has_lensed_type = ple->has_tl; *index_ct = psp->index_ct_tl+bin1;
+    }
+    break;
+
+  case bp_dd:
+  case bp_ll:
+  case bp_dl:
+
+    class_test((bin1 >= psp->d_size) || (bin2 >= psp->d_size),
+               pbp->error_message,
+               "bandpower %d refers to redshift bins (%d,%d), but only %d bins were computed",index_bp,bin1,bin2,psp->d_size);
+
+    class_test(abs(bin2-bin1) > psp->non_diag,
+               pbp->error_message,
+               "bandpower %d refers to redshift bins (%d,%d), but cross-spectra were computed only up to non_diag=%d",index_bp,bin1,bin2,psp->non_diag);
+
+    /* same ordering of the pairs of bins as in spectra_compute_cl() */
+    offset = 0;
+    for (index_d1=0; index_d1<psp->d_size; index_d1++) {
+      if (pbp->type[index_bp] == bp_dl) {
+        for (index_d2=MAX(index_d1-psp->non_diag,0); index_d2<=MIN(index_d1+psp->non_diag,psp->d_size-1); index_d2++) {
+          if ((index_d1 == bin1) && (index_d2 == bin2)) break;
+          offset++;
+        }
+      }
+      else {
+        for (index_d2=index_d1; index_d2<=MIN(index_d1+psp->non_diag,psp->d_size-1); index_d2++) {
+          if ((pbp->type[index_bp] == bp_dd) && (psp->has_dd_pair[index_d1*psp->d_size+index_d2] == _FALSE_))
+            continue;
+          if ((index_d1 == bin1) && (index_d2 == bin2)) break;
+          offset++;
+        }
+      }
+      if (index_d1 == bin1) break;
+    }
+
+    if (pbp->type[index_bp] == bp_dd) {
+      class_test(psp->has_dd_pair[bin1*psp->d_size+bin2] == _FALSE_,
+                 pbp->error_message,
+                 "bandpower %d refers to redshift bins (%d,%d), whose number count cross-spectrum was not computed because they do not overlap",index_bp,bin1,bin2);
+      has_type = psp->has_dd; has_lensed_type = ple->has_dd; *index_ct = psp->index_ct_dd+offset;
+    }
+    else if (pbp->type[index_bp] == bp_ll) {
+      has_type = psp->has_ll; has_lensed_type = ple->has_ll; *index_ct = psp->index_ct_ll+offset;
+    }
+    else {
+      has_type = psp->has_dl; *index_ct = psp->index_ct_dl+offset;
+    }
+    break;
+  }
+
+  if (pbp->lensed[index_bp] == _TRUE_) {
+
+    class_test((ple->has_lensed_cls == _FALSE_) || (has_lensed_type == _FALSE_),
+               pbp->error_message,
+               "bandpower %d requires lensed C_l's of a type which was not computed",index_bp);
+
+    class_test(pbp->l_max[index_bp] > ple->l_lensed_max,
+               pbp->error_message,
+               "window of bandpower %d extends to l=%d, but lensed C_l's were computed only up to l=%d",index_bp,pbp->l_max[index_bp],ple->l_lensed_max);
+  }
+  else {
+
+    class_test(has_type == _FALSE_,
+               pbp->error_message,
+               "bandpower %d requires C_l's of a type which was not computed",index_bp);
+
+    class_test(pbp->l_max[index_bp] > psp->l_max_tot,
+               pbp->error_message,
+               "window of bandpower %d extends to l=%d, but C_l's were computed only up to l=%d",index_bp,pbp->l_max[index_bp],psp->l_max_tot);
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Compute all bandpowers for the current model, by interpolating the
+ * tables of the spectra and lensing structures at each multipole of
+ * each window. Unlensed C_l's are summed over modes and initial
+ * conditions like in spectra_cl_at_l(). Bandpowers are computed in
+ * parallel.
+ *
+ * @param psp       Input: pointer to spectra structure
+ * @param ple       Input: pointer to lensing structure
+ * @param pbp       Input: pointer to bandpowers structure
+ * @param bandpower Output: array of pbp->bp_size bandpowers (must be already allocated)
+ * @return the error status
+ */
+
+int bandpowers_compute(
+                       struct spectra * psp,
+                       struct lensing * ple,
+                       struct bandpowers * pbp,
+                       double * bandpower
+                       ) {
+
+  int index_bp,index_ct,index_md,index_ic1,index_ic2,index_ic1_ic2;
+  int * index_ct_bp;
+  int l,l_max,last_index;
+  double cl,factor,sum;
+  double * weight;
+  int abort;
+
+  /** - find the C_l type of each bandpower, and check that it is available */
+
+  class_alloc(index_ct_bp,MAX(1,pbp->bp_size)*sizeof(int),pbp->error_message);
+
+  for (index_bp=0; index_bp<pbp->bp_size; index_bp++) {
+    class_call_except(bandpowers_index_ct(psp,ple,pbp,index_bp,index_ct_bp+index_bp),
+                      pbp->error_message,
+                      pbp->error_message,
+                      free(index_ct_bp));
+  }
+
+  /** - sum the weighted C_l's of each window */
+
+  abort = _FALSE_;
+
+#pragma omp parallel for schedule (dynamic) private(index_bp,index_ct,index_md,index_ic1,index_ic2,index_ic1_ic2,l,l_max,last_index,cl,factor,sum,weight)
+  for (index_bp=0; index_bp<pbp->bp_size; index_bp++) {
+
+    index_ct = index_ct_bp[index_bp];
+    weight = pbp->weight+pbp->offset[index_bp]-pbp->l_min[index_bp];
+    sum = 0.;
+
+    if (pbp->lensed[index_bp] == _TRUE_) {
+
+      l_max = MIN(pbp->l_max[index_bp],ple->l_max_lt[index_ct]);
+      last_index = 0;
+
+      for (l=pbp->l_min[index_bp]; l<=l_max; l++) {
+
+        class_call_parallel(array_interpolate_spline_growing_closeby(ple->l,
+                                                                     ple->l_size,
+                                                                     ple->cl_lens+index_ct,
+                                                                     ple->ddcl_lens+index_ct,
+                                                                     ple->lt_size,
+                                                                     (double)l,
+                                                                     &last_index,
+                                                                     &cl,
+                                                                     1,
+                                                                     pbp->error_message),
+                            pbp->error_message,
+                            pbp->error_message);
+
+        sum += weight[l]*cl;
+      }
+    }
+
+    else {
+
+      for (index_md=0; index_md<psp->md_size; index_md++) {
+
+        l_max = MIN(pbp->l_max[index_bp],psp->l_max_ct[index_md][index_ct]);
+        l_max = MIN(l_max,(int)psp->l[psp->l_size[index_md]-1]);
+
+        for (index_ic1=0; index_ic1<psp->ic_size[index_md]; index_ic1++) {
+          for (index_ic2=index_ic1; index_ic2<psp->ic_size[index_md]; index_ic2++) {
+
+            index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,psp->ic_size[index_md]);
+
+            if (psp->is_non_zero[index_md][index_ic1_ic2] == _FALSE_)
+              continue;
+
+            factor = (index_ic1 == index_ic2) ? 1. : 2.;
+            last_index = 0;
+
+            for (l=pbp->l_min[index_bp]; l<=l_max; l++) {
+
+              class_call_parallel(array_interpolate_spline_growing_closeby(psp->l,
+                                                                           psp->l_size[index_md],
+                                                                           psp->cl[index_md]+index_ic1_ic2*psp->ct_size+index_ct,
+                                                                           psp->ddcl[index_md]+index_ic1_ic2*psp->ct_size+index_ct,
+                                                                           psp->ic_ic_size[index_md]*psp->ct_size,
+                                                                           (double)l,
+                                                                           &last_index,
+                                                                           &cl,
+                                                                           1,
+                                                                           pbp->error_message),
+                                  pbp->error_message,
+                                  pbp->error_message);
+
+              sum += factor*weight[l]*cl;
+            }
+          }
+        }
+      }
+    }
+
+    bandpower[index_bp] = sum;
+  }
+
+  free(index_ct_bp);
+
+  if (abort == _TRUE_) return _FAILURE_;
+
+  return _SUCCESS_;
+
+}
@@ -235,8 +235,18 @@ int input_init(
                                         cs_background, cs_background, cs_background, cs_background, cs_spectra};
 
   int input_verbose = 0, int1, aux_flag, shooting_failed=_FALSE_;
+  short shooting_sensitivity_smg = _FALSE_;
+  double output_derivative;
 
   class_read_int("input_verbose",input_verbose);
+
+  /* for smg: Newton's method with the derivative of the target from the background sensitivities? */
+  class_call(parser_read_string(pfc,"shooting_sensitivity_smg",&string1,&flag1,errmsg),
+             errmsg,
+             errmsg);
+  if ((flag1 == _TRUE_) && ((strstr(string1,"y") != NULL) || (strstr(string1,"Y") != NULL)))
+    shooting_sensitivity_smg = _TRUE_;
+
   if (input_verbose >0) printf("Reading input parameters\n");
 
   /* for smg: no tuned parameters yet */
@@ -293,6 +303,7 @@ int input_init(
                 unknown_parameters_size*sizeof(int),
                 errmsg);
     fzw.target_size = unknown_parameters_size;
+    fzw.output_derivative = NULL;
     class_alloc(fzw.target_name,
                 fzw.target_size*sizeof(enum target_names),
                 errmsg);
@@ -323,6 +334,11 @@ int input_init(
 
     if (unknown_parameters_size == 1){
       /* We can do 1 dimensional root finding */
+      /* For smg, the derivative of the target can be computed together with the background
+         (only for Omega_smg: M_pl_today_smg is not supported, see input_find_root_newton()) */
+      if ((shooting_sensitivity_smg == _TRUE_) && (fzw.target_name[0] == Omega_smg)) {
+        fzw.output_derivative = &output_derivative;
+      }
       /* If shooting fails, postpone error to background module to play nice with MontePython. */
       class_call_try(input_find_root(&xzero,
                                      &fevals,
@@ -407,6 +423,7 @@ int input_init(
 
     /** - --> Set status of shooting */
     pba->shooting_failed = shooting_failed;
+    pba->shooting_fevals = fevals;
 
     /* all parameters read in fzw must be considered as read in
        pfc. At the same time the parameters read before in pfc (like
@@ -1856,6 +1873,33 @@ if (strcmp(string1,"nkgb") == 0 || strcmp(string1,"n-kgb") == 0 || strcmp(string
 
   }
 
+  class_call(parser_read_string(pfc,"hyrec_model",&string1,&flag1,errmsg),
+             errmsg,
+             errmsg);
+
+  if (flag1 == _TRUE_) {
+    flag2=_FALSE_;
+    if ((strcmp(string1,"PEEBLES") == 0) || (strcmp(string1,"peebles") == 0)) {
+      pth->hyrec_model = hyrec_peebles;
+      flag2=_TRUE_;
+    }
+    if ((strcmp(string1,"RECFAST") == 0) || (strcmp(string1,"recfast") == 0)) {
+      pth->hyrec_model = hyrec_recfast;
+      flag2=_TRUE_;
+    }
+    if ((strcmp(string1,"EMLA2s2p") == 0) || (strcmp(string1,"emla2s2p") == 0) || (strcmp(string1,"EMLA2S2P") == 0)) {
+      pth->hyrec_model = hyrec_emla2s2p;
+      flag2=_TRUE_;
+    }
+    if ((strcmp(string1,"FULL") == 0) || (strcmp(string1,"full") == 0)) {
+      pth->hyrec_model = hyrec_full;
+      flag2=_TRUE_;
+    }
+    class_test(flag2==_FALSE_,
+               errmsg,
+               "could not identify hyrec_model, check that it is one of 'PEEBLES', 'RECFAST', 'EMLA2s2p', 'FULL'.");
+  }
+
   /** - reionization parametrization */
   class_call(parser_read_string(pfc,"reio_parametrization",&string1,&flag1,errmsg),
              errmsg,
@@ -3071,6 +3115,7 @@ if (strcmp(string1,"nkgb") == 0 || strcmp(string1,"n-kgb") == 0 || strcmp(string
         class_stop(errmsg,
                    "Input for non_diagonal is %d, while it is expected to be between 0 and %d\n",
                    psp->non_diag,ppt->selection_num-1);
+      class_read_double("non_diagonal_min_overlap",psp->non_diag_min_overlap);
     }
 
     class_call(parser_read_string(pfc,
@@ -3307,6 +3352,8 @@ if (strcmp(string1,"nkgb") == 0 || strcmp(string1,"n-kgb") == 0 || strcmp(string
   class_read_string("Alpha_inf hyrec file",ppr->hyrec_Alpha_inf_file);
   class_read_string("R_inf hyrec file",ppr->hyrec_R_inf_file);
   class_read_string("two_photon_tables hyrec file",ppr->hyrec_two_photon_tables_file);
+  class_read_double("hyrec_dlna_max",ppr->hyrec_dlna_max);
+  class_read_double("hyrec_tolerance",ppr->hyrec_tolerance);
 
   class_read_double("reionization_z_start_max",ppr->reionization_z_start_max);
   class_read_double("reionization_sampling",ppr->reionization_sampling);
@@ -3383,6 +3430,12 @@ if (strcmp(string1,"nkgb") == 0 || strcmp(string1,"n-kgb") == 0 || strcmp(string
   class_read_double("tol_tau_approx",ppr->tol_tau_approx);
   class_read_double("tol_perturb_integration",ppr->tol_perturb_integration);
   class_read_double("perturb_sampling_stepsize",ppr->perturb_sampling_stepsize);
+  class_read_int("perturb_omp_chunk",ppr->perturb_omp_chunk);
+
+  class_test(ppr->perturb_omp_chunk < 1,
+             errmsg,
+             "perturb_omp_chunk=%d should be at least 1",
+             ppr->perturb_omp_chunk);
 
   class_read_int("radiation_streaming_approximation",ppr->radiation_streaming_approximation);
   class_read_double("radiation_streaming_trigger_tau_over_tau_k",ppr->radiation_streaming_trigger_tau_over_tau_k);
@@ -3414,6 +3467,8 @@ if (strcmp(string1,"nkgb") == 0 || strcmp(string1,"n-kgb") == 0 || strcmp(string
   /** - (h.4.) parameter related to the primordial spectra */
 
   class_read_double("k_per_decade_primordial",ppr->k_per_decade_primordial);
+  class_read_double("primordial_feature_tol",ppr->primordial_feature_tol);
+  class_read_int("primordial_feature_max_refinement",ppr->primordial_feature_max_refinement);
   class_read_double("primordial_inflation_ratio_min",ppr->primordial_inflation_ratio_min);
   class_read_double("primordial_inflation_ratio_max",ppr->primordial_inflation_ratio_max);
   class_read_int("primordial_inflation_phi_ini_maxit",ppr->primordial_inflation_phi_ini_maxit);
@@ -3450,6 +3505,7 @@ if (strcmp(string1,"nkgb") == 0 || strcmp(string1,"n-kgb") == 0 || strcmp(string
   class_read_double("q_logstep_open",ppr->q_logstep_open);
   class_read_double("q_logstep_trapzd",ppr->q_logstep_trapzd);
   class_read_double("q_numstep_transition",ppr->q_numstep_transition);
+  class_read_int("q_feature_max_refinement",ppr->q_feature_max_refinement);
 
   class_read_double("k_step_trans_scalars",ppr->q_linstep); // obsolete precision parameter: read for compatibility with old precision files
   class_read_double("k_step_trans_tensors",ppr->q_linstep); // obsolete precision parameter: read for compatibility with old precision files
@@ -3471,6 +3527,57 @@ if (strcmp(string1,"nkgb") == 0 || strcmp(string1,"n-kgb") == 0 || strcmp(string
 
   class_read_double("transfer_neglect_late_source",ppr->transfer_neglect_late_source);
 
+  class_read_double("transfer_pruning_tolerance",ppr->transfer_pruning_tolerance);
+  class_read_int("transfer_pruning_stride",ppr->transfer_pruning_stride);
+
+  class_test(ppr->transfer_pruning_stride < 2,
+             errmsg,
+             "transfer_pruning_stride=%d should be at least 2",
+             ppr->transfer_pruning_stride);
+
+  class_read_int("transfer_omp_chunk",ppr->transfer_omp_chunk);
+
+  class_test(ppr->transfer_omp_chunk < 1,
+             errmsg,
+             "transfer_omp_chunk=%d should be at least 1",
+             ppr->transfer_omp_chunk);
+
+  class_read_int("fftlog_lss",ppr->fftlog_lss);
+  class_read_int("fftlog_l_max",ppr->fftlog_l_max);
+  class_read_int("fftlog_k_size",ppr->fftlog_k_size);
+  class_read_double("fftlog_dlnk",ppr->fftlog_dlnk);
+  class_read_double("fftlog_bias_density",ppr->fftlog_bias_density);
+  class_read_double("fftlog_bias_lensing",ppr->fftlog_bias_lensing);
+  class_read_double("fftlog_taper",ppr->fftlog_taper);
+  class_read_int("fftlog_t_sampling",ppr->fftlog_t_sampling);
+  class_read_int("fftlog_chi_sampling",ppr->fftlog_chi_sampling);
+  class_read_double("fftlog_kernel_tolerance",ppr->fftlog_kernel_tolerance);
+
+  class_test((ppr->fftlog_k_size < 2) || ((ppr->fftlog_k_size & (ppr->fftlog_k_size-1)) != 0),
+             errmsg,
+             "fftlog_k_size=%d should be a power of two",
+             ppr->fftlog_k_size);
+
+  class_test((ppr->fftlog_bias_density <= -4.) || (ppr->fftlog_bias_density >= 2.) || (ppr->fftlog_bias_density == floor(ppr->fftlog_bias_density)),
+             errmsg,
+             "fftlog_bias_density=%e should be between -4 and 2, and not an integer",
+             ppr->fftlog_bias_density);
+
+  class_test((ppr->fftlog_bias_lensing <= -4.) || (ppr->fftlog_bias_lensing >= 2.) || (ppr->fftlog_bias_lensing == floor(ppr->fftlog_bias_lensing)),
+             errmsg,
+             "fftlog_bias_lensing=%e should be between -4 and 2, and not an integer",
+             ppr->fftlog_bias_lensing);
+
+  class_test(ppr->fftlog_t_sampling < 3,
+             errmsg,
+             "fftlog_t_sampling=%d should be at least 3",
+             ppr->fftlog_t_sampling);
+
+  class_test(ppr->fftlog_chi_sampling < 2,
+             errmsg,
+             "fftlog_chi_sampling=%d should be at least 2",
+             ppr->fftlog_chi_sampling);
+
   class_read_double("l_switch_limber",ppr->l_switch_limber);
 
   class_call(parser_read_string(pfc,
@@ -3513,6 +3620,18 @@ if (strcmp(string1,"nkgb") == 0 || strcmp(string1,"n-kgb") == 0 || strcmp(string
     class_read_int("tol_gauss_legendre",ppr->tol_gauss_legendre);
   }
 
+  /** - (h.7.bis) parameters of the coarse precision profile */
+
+  class_read_double("coarse_sampling_factor",ppr->coarse_sampling_factor);
+  class_read_double("coarse_tolerance_factor",ppr->coarse_tolerance_factor);
+
+  class_test(ppr->coarse_sampling_factor < 1.,
+             errmsg,
+             "coarse_sampling_factor=%e should be larger than or equal to one",ppr->coarse_sampling_factor);
+  class_test(ppr->coarse_tolerance_factor < 1.,
+             errmsg,
+             "coarse_tolerance_factor=%e should be larger than or equal to one",ppr->coarse_tolerance_factor);
+
   /** h.8. parameter related to the quasi-static approximation scheme (qs_smg) */
 
   class_read_double("n_min_qs_smg",ppr->n_min_qs_smg);
@@ -3760,6 +3879,9 @@ int input_default_params(
   pba->parameters_size_smg = 0;
   pba->tuning_index_smg = 0;
   pba->tuning_dxdy_guess_smg = 1;
+  pba->has_sensitivity_smg = _FALSE_;
+  pba->sensitivity_index_smg = 0;
+  pba->sensitivity_today_smg = NULL;
 
   pba->output_background_smg = 1; /**< amount of information printed onbackground.dat output */
 
@@ -3780,6 +3902,7 @@ int input_default_params(
   pba->has_smg= _FALSE_;
   pba->parameters_tuned_smg = _FALSE_;
   pba->shooting_failed = _FALSE_;
+  pba->shooting_fevals = 0;
   pba->is_quintessence_smg = _FALSE_;
   pba->attractor_ic_smg = _TRUE_;  /* only read for those models in which it is implemented */
   pba->initial_conditions_set_smg = _FALSE_;
@@ -3788,6 +3911,7 @@ int input_default_params(
 
   pth->YHe=_BBN_;
   pth->recombination=recfast;
+  pth->hyrec_model=hyrec_recfast;
   pth->reio_parametrization=reio_camb;
   pth->reio_z_or_tau=reio_z;
   pth->z_reio=11.357;
@@ -4002,6 +4126,7 @@ int input_default_params(
 
   psp->z_max_pk = pop->z_pk[0];
   psp->non_diag=0;
+  psp->non_diag_min_overlap=0.;
 
   /** - nonlinear structure */
 
@@ -4110,6 +4235,8 @@ int input_default_precision ( struct precision * ppr ) {
   strcat(ppr->hyrec_R_inf_file,"/hyrec/R_inf.dat");
   sprintf(ppr->hyrec_two_photon_tables_file,__CLASSDIR__);
   strcat(ppr->hyrec_two_photon_tables_file,"/hyrec/two_photon_tables.dat");
+  ppr->hyrec_dlna_max = 0.05;
+  ppr->hyrec_tolerance = 1.e-5;
 
   /* for reionization */
 
@@ -4165,6 +4292,8 @@ int input_default_precision ( struct precision * ppr ) {
   ppr->tol_perturb_integration=1.e-5;
   ppr->perturb_sampling_stepsize=0.05;
 
+  ppr->perturb_omp_chunk=1;
+
   ppr->radiation_streaming_approximation = rsa_MD_with_reio;
   ppr->radiation_streaming_trigger_tau_over_tau_k = 45.;
   ppr->radiation_streaming_trigger_tau_c_over_tau = 5.;
@@ -4204,6 +4333,8 @@ int input_default_precision ( struct precision * ppr ) {
    */
 
   ppr->k_per_decade_primordial = 10.;
+  ppr->primordial_feature_tol = 1.e-4;
+  ppr->primordial_feature_max_refinement = 8;
 
   ppr->primordial_inflation_ratio_min=100.;
   ppr->primordial_inflation_ratio_max=1/50.;
@@ -4243,6 +4374,7 @@ int input_default_precision ( struct precision * ppr ) {
   ppr->q_logstep_open=6.;
   ppr->q_logstep_trapzd=20.;
   ppr->q_numstep_transition=250.;
+  ppr->q_feature_max_refinement=3;
 
   ppr->transfer_neglect_delta_k_S_t0 = 0.15;
   ppr->transfer_neglect_delta_k_S_t1 = 0.04;
@@ -4258,6 +4390,22 @@ int input_default_precision ( struct precision * ppr ) {
 
   ppr->transfer_neglect_late_source = 400.;
 
+  ppr->transfer_pruning_tolerance = 0.;
+  ppr->transfer_pruning_stride = 4;
+
+  ppr->transfer_omp_chunk = 1;
+
+  ppr->fftlog_lss = 0;
+  ppr->fftlog_l_max = 200;
+  ppr->fftlog_k_size = 256;
+  ppr->fftlog_dlnk = 0.1;
+  ppr->fftlog_bias_density = 0.9;
+  ppr->fftlog_bias_lensing = -0.6;
+  ppr->fftlog_taper = 1.;
+  ppr->fftlog_t_sampling = 200;
+  ppr->fftlog_chi_sampling = 100;
+  ppr->fftlog_kernel_tolerance = 1.e-10;
+
   ppr->l_switch_limber=10.;
   // For density Cl, we recommend not to use the Limber approximation
   // at all, and hence to put here a very large number (e.g. 10000); but
@@ -4303,6 +4451,13 @@ int input_default_precision ( struct precision * ppr ) {
   ppr->num_mu_minus_lmax=70;
   ppr->delta_l_max=500; // 750 for 0.2% near l_max, 1000 for 0.1%
 
+  /**
+   * - parameters of the coarse precision profile
+   */
+
+  ppr->coarse_sampling_factor=1.5;
+  ppr->coarse_tolerance_factor=10.;
+
   /**
    * - automatic estimate of machine precision
    */
@@ -4320,6 +4475,56 @@ int input_default_precision ( struct precision * ppr ) {
 
 }
 
+/**
+ * Derive the coarse precision profile from a given set of precision
+ * parameters, for a cheap first evaluation of the spectra (e.g. in a
+ * delayed-acceptance sampler). The sampling steps in k and l are
+ * enlarged by coarse_sampling_factor, the tolerance of the
+ * perturbation integrator is loosened by coarse_tolerance_factor, and
+ * the simple quadrature is used in the lensing module. The step
+ * q_linstep is kept: the C_l's are much more sensitive to it (a few
+ * percent error when it is multiplied by 1.3).
+ *
+ * Only parameters used from the perturbation module onwards are
+ * changed: the background and thermodynamics computed with ppr can be
+ * used together with ppr_coarse, such that a coarse run can later be
+ * refined by running again only the modules after thermodynamics.
+ *
+ * @param ppr        Input: pointer to precision structure
+ * @param ppr_coarse Output: pointer to coarse precision structure
+ * @param errmsg     Input/Output: error message
+ * @return the error status
+ */
+
+int input_coarse_precision(
+                           struct precision * ppr,
+                           struct precision * ppr_coarse,
+                           ErrorMsg errmsg
+                           ) {
+
+  double factor;
+
+  factor = ppr->coarse_sampling_factor;
+
+  class_test(factor < 1.,
+             errmsg,
+             "coarse_sampling_factor=%e should be larger than or equal to one",factor);
+
+  memcpy(ppr_coarse,ppr,sizeof(struct precision));
+
+  ppr_coarse->k_step_sub *= factor;
+  ppr_coarse->k_step_super *= factor;
+  ppr_coarse->l_logstep = 1.+(ppr->l_logstep-1.)*factor;
+  ppr_coarse->l_linstep = (int)(ppr->l_linstep*factor+0.5);
+
+  ppr_coarse->tol_perturb_integration *= ppr->coarse_tolerance_factor;
+
+  ppr_coarse->accurate_lensing = _FALSE_;
+
+  return _SUCCESS_;
+
+}
+
 int class_version(
                   char * version
                   ) {
@@ -4537,6 +4742,12 @@ int input_try_unknown_parameters(double * unknown_parameter,
 
   }
 
+  /** - Integrate the sensitivity to the unknown parameter with the background if its derivative is needed */
+  if (pfzw->output_derivative != NULL) {
+    ba.has_sensitivity_smg = _TRUE_;
+    ba.sensitivity_index_smg = ba.tuning_index_smg;
+  }
+
   /** - Do computations */
   if (pfzw->required_computation_stage >= cs_background){
     if (input_verbose>2)
@@ -4578,7 +4789,7 @@ int input_try_unknown_parameters(double * unknown_parameter,
     if (input_verbose>2)
       printf("Stage 6: transfer\n");
     tr.transfer_verbose = 0;
-    class_call(transfer_init(&pr,&ba,&th,&pt,&nl,&tr), tr.error_message, errmsg);
+    class_call(transfer_init(&pr,&ba,&th,&pt,&pm,&nl,&tr), tr.error_message, errmsg);
   }
 
   if (pfzw->required_computation_stage >= cs_spectra){
@@ -4618,6 +4829,8 @@ int input_try_unknown_parameters(double * unknown_parameter,
     case Omega_smg:
       output[i] = ba.background_table[(ba.bt_size-1)*ba.bg_size+ba.index_bg_rho_smg]/pow(ba.H0,2)
 		  -ba.Omega0_smg;
+      if (pfzw->output_derivative != NULL)
+        pfzw->output_derivative[i] = ba.sensitivity_today_smg[ba.index_bg_rho_smg]/pow(ba.H0,2);
       if (input_verbose > 2)
 	printf(" param[%i] = %e, Omega_smg = %.3e, %.3e, target = %.2e \n",ba.tuning_index_smg, ba.parameters_smg[ba.tuning_index_smg],
 	       ba.background_table[(ba.bt_size-1)*ba.bg_size+ba.index_bg_rho_smg]
@@ -4846,6 +5059,14 @@ int input_find_root(double *xzero,
   int return_function;
   /** Summary: */
 
+  /** - If the derivative of the target is computed with it, try Newton's method first */
+  if (pfzw->output_derivative != NULL) {
+    if (input_find_root_newton(xzero, fevals, pfzw, errmsg) == _SUCCESS_)
+      return _SUCCESS_;
+    /* otherwise, go on without computing the derivative */
+    pfzw->output_derivative = NULL;
+  }
+
   /** - Fisrt we do our guess */
   class_call(input_get_guess(&x1, &dxdy, pfzw, errmsg),
              errmsg, errmsg);
@@ -4942,6 +5163,90 @@ int input_find_root(double *xzero,
   return _SUCCESS_;
 }
 
+/**
+ * Find the unknown parameter with Newton's method, using the
+ * derivative of the target returned by input_try_unknown_parameters()
+ * in pfzw->output_derivative (for smg, from the sensitivities
+ * integrated together with the background). Each iteration costs a
+ * single computation, against at least two for bracketing the root
+ * in input_find_root().
+ *
+ * If a computation fails, the step is halved (up to twice). The
+ * method fails if the computation at the guess fails, or if it does
+ * not converge within _NEWTON_MAX_ITER_ iterations: input_find_root()
+ * then falls back to bracketing. Once the step is below tolerance,
+ * the target is computed once more at the new point, which is
+ * returned only if this succeeds and does not increase the
+ * difference to the target; otherwise the previous point is returned.
+ *
+ * Only the single target Omega_smg is supported. M_pl_today_smg is
+ * not: in the Brans-Dicke model it comes together with Omega_smg, and
+ * the two parameters are found by fzero_Newton() with a
+ * finite-difference Jacobian (10 computations, with or without
+ * shooting_sensitivity_smg).
+ *
+ * @param xzero   Output: unknown parameter
+ * @param fevals  Input/Output: number of computations
+ * @param pfzw    Input: workspace of input_try_unknown_parameters()
+ * @param errmsg  Output: error message
+ * @return the error status
+ */
+
+int input_find_root_newton(double *xzero,
+                           int *fevals,
+                           struct fzerofun_workspace *pfzw,
+                           ErrorMsg errmsg){
+  double x, x_old, f, f_old, dfdx, dx=0., dxdy;
+  int iter, iter2;
+  int return_function;
+
+  class_call(input_get_guess(&x, &dxdy, pfzw, errmsg),
+             errmsg, errmsg);
+  x_old = x;
+
+  for (iter=1; iter<=_NEWTON_MAX_ITER_; iter++){
+
+    for (iter2=1; iter2 <= 3; iter2++) {
+      return_function = input_try_unknown_parameters(&x,1,pfzw,&f,errmsg);
+      (*fevals)++;
+
+      if (return_function == _SUCCESS_)
+        break;
+      else if ((iter > 1) && (iter2 < 3)) {
+        dx *= 0.5;
+        x = x_old+dx;
+      }
+      else
+        return _FAILURE_;
+    }
+
+    dfdx = pfzw->output_derivative[0];
+
+    class_test((dfdx == 0.) || (isnan(dfdx)),
+               errmsg,
+               "derivative of the target with respect to the unknown parameter is %e",dfdx);
+
+    dx = -f/dfdx;
+    x_old = x;
+    f_old = f;
+    x += dx;
+
+    /* same tolerance as class_fzero_ridder() in input_find_root() */
+    if (fabs(dx) <= 1e-5*fabs(x)) {
+      return_function = input_try_unknown_parameters(&x,1,pfzw,&f,errmsg);
+      (*fevals)++;
+      if ((return_function == _SUCCESS_) && (fabs(f) <= fabs(f_old)))
+        *xzero = x;
+      else
+        *xzero = x_old;
+      return _SUCCESS_;
+    }
+  }
+
+  class_stop(errmsg,
+             "Newton's method did not converge after %d iterations",_NEWTON_MAX_ITER_);
+}
+
 int file_exists(const char *fname){
   FILE *file = fopen(fname, "r");
   if (file != NULL){
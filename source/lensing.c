@@ -295,9 +295,9 @@ int lensing_init(
   icount += 5*(ple->l_unlensed_max+1); /* for arrays sqrt1[l] to sqrt5[l] */
 
   /** - Allocate main contiguous buffer **/
-  class_alloc(buf_dxx,
-              icount * sizeof(double),
-              ple->error_message);
+  class_alloc_pooled(buf_dxx,
+                     icount * sizeof(double),
+                     ple->error_message);
 
   icount = 0;
   for (index_mu=0; index_mu<num_mu; index_mu++) {
@@ -341,66 +341,16 @@ int lensing_init(
   sqrt5 = &(buf_dxx[icount]);
   icount += ple->l_unlensed_max+1;
 
-  //debut = omp_get_wtime();
-  class_call(lensing_d00(mu,num_mu,ple->l_unlensed_max,d00),
-             ple->error_message,
-             ple->error_message);
-
-  class_call(lensing_d11(mu,num_mu,ple->l_unlensed_max,d11),
+  /* d20, d3m1, d4m2 (resp. d22, d31, d3m3, d40, d4m4) are NULL when
+     TE (resp. EE and BB) are not requested, and then not computed */
+  class_call(lensing_dxx(mu,num_mu,ple->l_unlensed_max,
+                         d00,d11,d1m1,d2m2,
+                         d20,d3m1,d4m2,
+                         d22,d31,d3m3,d40,d4m4,
+                         ple->error_message),
              ple->error_message,
              ple->error_message);
 
-  class_call(lensing_d1m1(mu,num_mu,ple->l_unlensed_max,d1m1),
-             ple->error_message,
-             ple->error_message);
-
-  class_call(lensing_d2m2(mu,num_mu,ple->l_unlensed_max,d2m2),
-             ple->error_message,
-             ple->error_message);
-  //fin = omp_get_wtime();
-  //cpu_time = (fin-debut);
-  //printf("time in lensing_dxx=%4.3f s\n",cpu_time);
-
-
-  if (ple->has_te==_TRUE_) {
-
-    class_call(lensing_d20(mu,num_mu,ple->l_unlensed_max,d20),
-               ple->error_message,
-               ple->error_message);
-
-    class_call(lensing_d3m1(mu,num_mu,ple->l_unlensed_max,d3m1),
-               ple->error_message,
-               ple->error_message);
-
-    class_call(lensing_d4m2(mu,num_mu,ple->l_unlensed_max,d4m2),
-               ple->error_message,
-               ple->error_message);
-
-  }
-
-  if (ple->has_ee==_TRUE_ || ple->has_bb==_TRUE_) {
-
-    class_call(lensing_d22(mu,num_mu,ple->l_unlensed_max,d22),
-               ple->error_message,
-               ple->error_message);
-
-    class_call(lensing_d31(mu,num_mu,ple->l_unlensed_max,d31),
-               ple->error_message,
-               ple->error_message);
-
-    class_call(lensing_d3m3(mu,num_mu,ple->l_unlensed_max,d3m3),
-               ple->error_message,
-               ple->error_message);
-
-    class_call(lensing_d40(mu,num_mu,ple->l_unlensed_max,d40),
-               ple->error_message,
-               ple->error_message);
-
-    class_call(lensing_d4m4(mu,num_mu,ple->l_unlensed_max,d4m4),
-               ple->error_message,
-               ple->error_message);
-  }
-
   /** - compute \f$ Cgl(\mu)\f$, \f$ Cgl2(\mu) \f$ and sigma2(\f$\mu\f$) */
 
   class_alloc(Cgl,
@@ -741,7 +691,7 @@ int lensing_init(
              ple->error_message);
 
   /** - Free lots of stuff **/
-  free(buf_dxx);
+  buffer_pool_free(buf_dxx);
 
   free(d00);
   free(d11);
@@ -1227,690 +1177,299 @@ int lensing_addback_cl_ee_bb(
 }
 
 /**
- * This routine computes the d00 term
+ * This routine computes together all the \f$ d^l_{mm'} \f$ terms
+ * needed by lensing_init().
  *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d00    Input/output: Result is stored here
+ * The recurrences for each term are run in a single parallel loop
+ * over blocks of _LENSING_MU_BLOCK_ values of mu, instead of one loop
+ * over mu per term. Within a block, each
+ * recurrence is advanced l by l for all the mu values together: the
+ * coefficients are loaded once per l for the whole block, and the
+ * independent recurrences of the block hide the latency of each
+ * step (the innermost loop over mu can also be vectorised). The
+ * coefficients are computed once for all terms.
  *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
-
-int lensing_d00(
-                double * mu,
-                int num_mu,
-                int lmax,
-                double ** d00
-                ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3;
-  ErrorMsg erreur;
-
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  for (l=1; l<lmax; l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)/(2*ll+1))*(2*ll+1)/(ll+1);
-    fac2[l] = sqrt((2*ll+3)/(2*ll-1))*ll/(ll+1);
-    fac3[l] = sqrt(2./(2*ll+3));
-  }
-
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
-
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    dlm1=1.0/sqrt(2.); /* l=0 */
-    d00[index_mu][0]=dlm1*sqrt(2.);
-    dl=mu[index_mu] * sqrt(3./2.); /*l=1*/
-    d00[index_mu][1]=dl*sqrt(2./3.);
-    for(l=1;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d00 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*mu[index_mu]*dl - fac2[l]*dlm1;
-      d00[index_mu][l+1] = dlp1 * fac3[l];
-      dlm1 = dl;
-      dl = dlp1;
-    }
-  }
-  free(fac1); free(fac2); free(fac3);
-  return _SUCCESS_;
-}
-
-
-/**
- * This routine computes the d11 term
+ * The terms which are not needed can be passed as NULL: d20, d3m1,
+ * d4m2 are only needed for TE, and d22, d31, d3m3, d40, d4m4 for EE
+ * and BB. The first four are always computed.
  *
  * @param mu     Input: Vector of cos(beta) values
  * @param num_mu Input: Number of cos(beta) values
  * @param lmax   Input: maximum multipole
+ * @param d00    Input/output: Result is stored here
  * @param d11    Input/output: Result is stored here
+ * @param d1m1   Input/output: Result is stored here
+ * @param d2m2   Input/output: Result is stored here
+ * @param d20    Input/output: Result is stored here (or NULL)
+ * @param d3m1   Input/output: Result is stored here (or NULL)
+ * @param d4m2   Input/output: Result is stored here (or NULL)
+ * @param d22    Input/output: Result is stored here (or NULL)
+ * @param d31    Input/output: Result is stored here (or NULL)
+ * @param d3m3   Input/output: Result is stored here (or NULL)
+ * @param d40    Input/output: Result is stored here (or NULL)
+ * @param d4m4   Input/output: Result is stored here (or NULL)
+ * @param errmsg Output: error message
+ * @return the error status
  *
  * Wigner d-functions, computed by recurrence
  * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
  * Formulae from Kostelec & Rockmore 2003
  **/
 
-int lensing_d11(
+int lensing_dxx(
                 double * mu,
                 int num_mu,
                 int lmax,
-                double ** d11
+                double ** d00,
+                double ** d11,
+                double ** d1m1,
+                double ** d2m2,
+                double ** d20,
+                double ** d3m1,
+                double ** d4m2,
+                double ** d22,
+                double ** d31,
+                double ** d3m3,
+                double ** d40,
+                double ** d4m4,
+                ErrorMsg errmsg
                 ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=2;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)/(2*ll+1))*(ll+1)*(2*ll+1)/(ll*(ll+2));
-    fac2[l] = 1.0/(ll*(ll+1.));
-    fac3[l] = sqrt((2*ll+3)/(2*ll-1))*(ll-1)*(ll+1)/(ll*(ll+2))*(ll+1)/ll;
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
 
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d11[index_mu][0]=0;
-    dlm1=(1.0+mu[index_mu])/2. * sqrt(3./2.); /*l=1*/
-    d11[index_mu][1]=dlm1 * sqrt(2./3.);
-    dl=(1.0+mu[index_mu])/2.*(2.0*mu[index_mu]-1.0) * sqrt(5./2.); /*l=2*/
-    d11[index_mu][2] = dl * sqrt(2./5.);
-    for(l=2;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d11 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]-fac2[l])*dl - fac3[l]*dlm1;
-      d11[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
+  /* All terms obey a recurrence of the form
+       dlp1 = fac1[l]*(mu+fac2[l])*dl - fac3[l]*dlm1,
+       d[l+1] = dlp1*fac4[l],
+     for l >= lmin (with fac2 = 0 for d00, d20, d40). The terms are
+     numbered in the order of the arguments. */
+
+  double ** dxx[12] = {d00,d11,d1m1,d2m2,d20,d3m1,d4m2,d22,d31,d3m3,d40,d4m4};
+  int lmin_all[12] = {1,2,2,2,2,3,4,2,3,3,4,4};
+  double ** d[12];
+  int type[12];
+  int lmin[12];
+  double * fac1[12];
+  double * fac2[12];
+  double * fac3[12];
+  double * fac4;
+  double * buffer;
+  double ll;
+  int index_d,d_size,l;
+  int index_block,num_block;
+
+  /** - list the requested terms */
+
+  d_size = 0;
+  for (index_d=0; index_d<12; index_d++) {
+    if (dxx[index_d] != NULL) {
+      d[d_size] = dxx[index_d];
+      type[d_size] = index_d;
+      lmin[d_size] = lmin_all[index_d];
+      d_size++;
     }
   }
-  free(fac1); free(fac2); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
 
-/**
- * This routine computes the d1m1 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d1m1    Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
+  /** - compute the recurrence coefficients */
 
-int lensing_d1m1(
-                 double * mu,
-                 int num_mu,
-                 int lmax,
-                 double ** d1m1
-                 ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=2;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)/(2*ll+1))*(ll+1)*(2*ll+1)/(ll*(ll+2));
-    fac2[l] = 1.0/(ll*(ll+1.));
-    fac3[l] = sqrt((2*ll+3)/(2*ll-1))*(ll-1)*(ll+1)/(ll*(ll+2))*(ll+1)/ll;
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
+  class_calloc(buffer,(3*d_size+1)*(lmax+1),sizeof(double),errmsg);
 
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d1m1[index_mu][0]=0;
-    dlm1=(1.0-mu[index_mu])/2. * sqrt(3./2.); /*l=1*/
-    d1m1[index_mu][1]=dlm1 * sqrt(2./3.);
-    dl=(1.0-mu[index_mu])/2.*(2.0*mu[index_mu]+1.0) * sqrt(5./2.); /*l=2*/
-    d1m1[index_mu][2] = dl * sqrt(2./5.);
-    for(l=2;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d1m1 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]+fac2[l])*dl - fac3[l]*dlm1;
-      d1m1[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
-    }
+  fac4 = buffer;
+  for (index_d=0; index_d<d_size; index_d++) {
+    fac1[index_d] = buffer+(3*index_d+1)*(lmax+1);
+    fac2[index_d] = buffer+(3*index_d+2)*(lmax+1);
+    fac3[index_d] = buffer+(3*index_d+3)*(lmax+1);
   }
-  free(fac1); free(fac2); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
 
-/**
- * This routine computes the d2m2 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d2m2   Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
-
-int lensing_d2m2(
-                 double * mu,
-                 int num_mu,
-                 int lmax,
-                 double ** d2m2
-                 ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=2;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)/(2*ll+1))*(ll+1)*(2*ll+1)/((ll-1)*(ll+3));
-    fac2[l] = 4.0/(ll*(ll+1));
-    fac3[l] = sqrt((2*ll+3)/(2*ll-1))*(ll-2)*(ll+2)/((ll-1)*(ll+3))*(ll+1)/ll;
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
-
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d2m2[index_mu][0]=0;
-    dlm1=0.; /*l=1*/
-    d2m2[index_mu][1]=0;
-    dl=(1.0-mu[index_mu])*(1.0-mu[index_mu])/4. * sqrt(5./2.); /*l=2*/
-    d2m2[index_mu][2] = dl * sqrt(2./5.);
-    for(l=2;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d2m2 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]+fac2[l])*dl - fac3[l]*dlm1;
-      d2m2[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
-    }
-  }
-  free(fac1); free(fac2); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
-
-/**
- * This routine computes the d22 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d22    Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
+  for (l=1; l<lmax; l++) {
 
-int lensing_d22(
-                double * mu,
-                int num_mu,
-                int lmax,
-                double ** d22
-                ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=2;l<lmax;l++) {
     ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)/(2*ll+1))*(ll+1)*(2*ll+1)/((ll-1)*(ll+3));
-    fac2[l] = 4.0/(ll*(ll+1));
-    fac3[l] = sqrt((2*ll+3)/(2*ll-1))*(ll-2)*(ll+2)/((ll-1)*(ll+3))*(ll+1)/ll;
     fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
-
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d22[index_mu][0]=0;
-    dlm1=0.; /*l=1*/
-    d22[index_mu][1]=0;
-    dl=(1.0+mu[index_mu])*(1.0+mu[index_mu])/4. * sqrt(5./2.); /*l=2*/
-    d22[index_mu][2] = dl * sqrt(2./5.);
-    for(l=2;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d22 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]-fac2[l])*dl - fac3[l]*dlm1;
-      d22[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
-    }
-  }
-  free(fac1); free(fac2); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
-
-/**
- * This routine computes the d20 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d20    Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
 
-int lensing_d20(
-                double * mu,
-                int num_mu,
-                int lmax,
-                double ** d20
-                ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=2;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)*(2*ll+1)/((ll-1)*(ll+3)));
-    fac3[l] = sqrt((2*ll+3)*(ll-2)*(ll+2)/((2*ll-1)*(ll-1)*(ll+3)));
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
+    for (index_d=0; index_d<d_size; index_d++) {
+
+      if (l < lmin[index_d])
+        continue;
+
+      switch (type[index_d]) {
+      case 0: /* d00 */
+        fac1[index_d][l] = sqrt((2*ll+3)/(2*ll+1))*(2*ll+1)/(ll+1);
+        fac3[index_d][l] = sqrt((2*ll+3)/(2*ll-1))*ll/(ll+1);
+        break;
+      case 1: /* d11 */
+      case 2: /* d1m1 */
+        fac1[index_d][l] = sqrt((2*ll+3)/(2*ll+1))*(ll+1)*(2*ll+1)/(ll*(ll+2));
+        fac2[index_d][l] = 1.0/(ll*(ll+1.));
+        fac3[index_d][l] = sqrt((2*ll+3)/(2*ll-1))*(ll-1)*(ll+1)/(ll*(ll+2))*(ll+1)/ll;
+        break;
+      case 3: /* d2m2 */
+      case 7: /* d22 */
+        fac1[index_d][l] = sqrt((2*ll+3)/(2*ll+1))*(ll+1)*(2*ll+1)/((ll-1)*(ll+3));
+        fac2[index_d][l] = 4.0/(ll*(ll+1));
+        fac3[index_d][l] = sqrt((2*ll+3)/(2*ll-1))*(ll-2)*(ll+2)/((ll-1)*(ll+3))*(ll+1)/ll;
+        break;
+      case 4: /* d20 */
+        fac1[index_d][l] = sqrt((2*ll+3)*(2*ll+1)/((ll-1)*(ll+3)));
+        fac3[index_d][l] = sqrt((2*ll+3)*(ll-2)*(ll+2)/((2*ll-1)*(ll-1)*(ll+3)));
+        break;
+      case 5: /* d3m1 */
+      case 8: /* d31 */
+        fac1[index_d][l] = sqrt((2*ll+3)*(2*ll+1)/((ll-2)*(ll+4)*ll*(ll+2))) * (ll+1);
+        fac2[index_d][l] = 3.0/(ll*(ll+1));
+        fac3[index_d][l] = sqrt((2*ll+3)/(2*ll-1)*(ll-3)*(ll+3)*(ll-1)*(ll+1)/((ll-2)*(ll+4)*ll*(ll+2)))*(ll+1)/ll;
+        break;
+      case 6: /* d4m2 */
+        fac1[index_d][l] = sqrt((2*ll+3)*(2*ll+1)/((ll-3)*(ll+5)*(ll-1)*(ll+3))) * (ll+1.);
+        fac2[index_d][l] = 8./(ll*(ll+1));
+        fac3[index_d][l] = sqrt((2*ll+3)*(ll-4)*(ll+4)*(ll-2)*(ll+2)/((2*ll-1)*(ll-3)*(ll+5)*(ll-1)*(ll+3)))*(ll+1)/ll;
+        break;
+      case 9: /* d3m3 */
+        fac1[index_d][l] = sqrt((2*ll+3)*(2*ll+1))*(ll+1)/((ll-2)*(ll+4));
+        fac2[index_d][l] = 9.0/(ll*(ll+1));
+        fac3[index_d][l] = sqrt((2*ll+3)/(2*ll-1))*(ll-3)*(ll+3)*(l+1)/((ll-2)*(ll+4)*ll);
+        break;
+      case 10: /* d40 */
+        fac1[index_d][l] = sqrt((2*ll+3)*(2*ll+1)/((ll-3)*(ll+5)));
+        fac3[index_d][l] = sqrt((2*ll+3)*(ll-4)*(ll+4)/((2*ll-1)*(ll-3)*(ll+5)));
+        break;
+      case 11: /* d4m4 */
+        fac1[index_d][l] = sqrt((2*ll+3)*(2*ll+1))*(ll+1)/((ll-3)*(ll+5));
+        fac2[index_d][l] = 16./(ll*(ll+1));
+        fac3[index_d][l] = sqrt((2*ll+3)/(2*ll-1))*(ll-4)*(ll+4)*(ll+1)/((ll-3)*(ll+5)*ll);
+        break;
+      }
 
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d20[index_mu][0]=0;
-    dlm1=0.; /*l=1*/
-    d20[index_mu][1]=0;
-    dl=sqrt(15.)/4.*(1-mu[index_mu]*mu[index_mu]); /*l=2*/
-    d20[index_mu][2] = dl * sqrt(2./5.);
-    for(l=2;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d22 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*mu[index_mu]*dl - fac3[l]*dlm1;
-      d20[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
+      /* the terms d_{m,m'} with m'=m>0 have mu - m m'/(l(l+1)) in the recurrence */
+      if ((type[index_d] == 1) || (type[index_d] == 7) || (type[index_d] == 8))
+        fac2[index_d][l] = -fac2[index_d][l];
     }
   }
-  free(fac1); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
 
-/**
- * This routine computes the d31 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d31    Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
+  /** - run all the recurrences, for each block of mu values */
 
-int lensing_d31(
-                double * mu,
-                int num_mu,
-                int lmax,
-                double ** d31
-                ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=3;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)*(2*ll+1)/((ll-2)*(ll+4)*ll*(ll+2))) * (ll+1);
-    fac2[l] = 3.0/(ll*(ll+1));
-    fac3[l] = sqrt((2*ll+3)/(2*ll-1)*(ll-3)*(ll+3)*(ll-1)*(ll+1)/((ll-2)*(ll+4)*ll*(ll+2)))*(ll+1)/ll;
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
-
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d31[index_mu][0]=0;
-    d31[index_mu][1]=0;
-    dlm1=0.; /*l=2*/
-    d31[index_mu][2]=0;
-    dl=sqrt(105./2.)*(1+mu[index_mu])*(1+mu[index_mu])*(1-mu[index_mu])/8.; /*l=3*/
-    d31[index_mu][3] = dl * sqrt(2./7.);
-    for(l=3;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d22 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]-fac2[l])*dl - fac3[l]*dlm1;
-      d31[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
-    }
-  }
-  free(fac1); free(fac2); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
-
-/**
- * This routine computes the d3m1 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d3m1   Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
+  num_block = (num_mu+_LENSING_MU_BLOCK_-1)/_LENSING_MU_BLOCK_;
 
-int lensing_d3m1(
-                 double * mu,
-                 int num_mu,
-                 int lmax,
-                 double ** d3m1
-                 ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=3;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)*(2*ll+1)/((ll-2)*(ll+4)*ll*(ll+2))) * (ll+1);
-    fac2[l] = 3.0/(ll*(ll+1));
-    fac3[l] = sqrt((2*ll+3)/(2*ll-1)*(ll-3)*(ll+3)*(ll-1)*(ll+1)/((ll-2)*(ll+4)*ll*(ll+2)))*(ll+1)/ll;
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
 #pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
+  private (index_block,index_d,l)               \
   schedule (static)
 
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d3m1[index_mu][0]=0;
-    d3m1[index_mu][1]=0;
-    dlm1=0.; /*l=2*/
-    d3m1[index_mu][2]=0;
-    dl=sqrt(105./2.)*(1+mu[index_mu])*(1-mu[index_mu])*(1-mu[index_mu])/8.; /*l=3*/
-    d3m1[index_mu][3] = dl * sqrt(2./7.);
-    for(l=3;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d22 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]+fac2[l])*dl - fac3[l]*dlm1;
-      d3m1[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
-    }
-  }
-  free(fac1); free(fac2); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
-
-/**
- * This routine computes the d3m3 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d3m3   Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
-
-int lensing_d3m3(
-                 double * mu,
-                 int num_mu,
-                 int lmax,
-                 double ** d3m3
-                 ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=3;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)*(2*ll+1))*(ll+1)/((ll-2)*(ll+4));
-    fac2[l] = 9.0/(ll*(ll+1));
-    fac3[l] = sqrt((2*ll+3)/(2*ll-1))*(ll-3)*(ll+3)*(l+1)/((ll-2)*(ll+4)*ll);
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
+  for (index_block=0; index_block<num_block; index_block++) {
+
+    double x[_LENSING_MU_BLOCK_];
+    double dlm1[12][_LENSING_MU_BLOCK_];
+    double dl[12][_LENSING_MU_BLOCK_];
+    double dlp1,f1,f2,f3,f4;
+    double ** out;
+    int index_mu,block_size,b;
+
+    index_mu = index_block*_LENSING_MU_BLOCK_;
+    block_size = MIN(_LENSING_MU_BLOCK_,num_mu-index_mu);
+
+    for (b=0; b<block_size; b++)
+      x[b] = mu[index_mu+b];
+
+    /** - --> values at l <= lmin */
+
+    for (index_d=0; index_d<d_size; index_d++) {
+
+      out = d[index_d]+index_mu;
+
+      for (b=0; b<block_size; b++) {
+
+        for (l=0; l<lmin[index_d]-1; l++)
+          out[b][l]=0;
+
+        switch (type[index_d]) {
+        case 0: /* d00 */
+          dlm1[index_d][b]=1.0/sqrt(2.); /* l=0 */
+          out[b][0]=dlm1[index_d][b]*sqrt(2.);
+          dl[index_d][b]=x[b] * sqrt(3./2.); /*l=1*/
+          out[b][1]=dl[index_d][b]*sqrt(2./3.);
+          break;
+        case 1: /* d11 */
+          dlm1[index_d][b]=(1.0+x[b])/2. * sqrt(3./2.); /*l=1*/
+          out[b][1]=dlm1[index_d][b] * sqrt(2./3.);
+          dl[index_d][b]=(1.0+x[b])/2.*(2.0*x[b]-1.0) * sqrt(5./2.); /*l=2*/
+          break;
+        case 2: /* d1m1 */
+          dlm1[index_d][b]=(1.0-x[b])/2. * sqrt(3./2.); /*l=1*/
+          out[b][1]=dlm1[index_d][b] * sqrt(2./3.);
+          dl[index_d][b]=(1.0-x[b])/2.*(2.0*x[b]+1.0) * sqrt(5./2.); /*l=2*/
+          break;
+        case 3: /* d2m2 */
+          dlm1[index_d][b]=0.; /*l=1*/
+          out[b][1]=0;
+          dl[index_d][b]=(1.0-x[b])*(1.0-x[b])/4. * sqrt(5./2.); /*l=2*/
+          break;
+        case 4: /* d20 */
+          dlm1[index_d][b]=0.; /*l=1*/
+          out[b][1]=0;
+          dl[index_d][b]=sqrt(15.)/4.*(1-x[b]*x[b]); /*l=2*/
+          break;
+        case 5: /* d3m1 */
+          dlm1[index_d][b]=0.; /*l=2*/
+          out[b][2]=0;
+          dl[index_d][b]=sqrt(105./2.)*(1+x[b])*(1-x[b])*(1-x[b])/8.; /*l=3*/
+          break;
+        case 6: /* d4m2 */
+          dlm1[index_d][b]=0.; /*l=3*/
+          out[b][3]=0;
+          dl[index_d][b]=sqrt(126.)*(1+x[b])*(1-x[b])*(1-x[b])*(1-x[b])/16.; /*l=4*/
+          break;
+        case 7: /* d22 */
+          dlm1[index_d][b]=0.; /*l=1*/
+          out[b][1]=0;
+          dl[index_d][b]=(1.0+x[b])*(1.0+x[b])/4. * sqrt(5./2.); /*l=2*/
+          break;
+        case 8: /* d31 */
+          dlm1[index_d][b]=0.; /*l=2*/
+          out[b][2]=0;
+          dl[index_d][b]=sqrt(105./2.)*(1+x[b])*(1+x[b])*(1-x[b])/8.; /*l=3*/
+          break;
+        case 9: /* d3m3 */
+          dlm1[index_d][b]=0.; /*l=2*/
+          out[b][2]=0;
+          dl[index_d][b]=sqrt(7./2.)*(1-x[b])*(1-x[b])*(1-x[b])/8.; /*l=3*/
+          break;
+        case 10: /* d40 */
+          dlm1[index_d][b]=0.; /*l=3*/
+          out[b][3]=0;
+          dl[index_d][b]=sqrt(315.)*(1+x[b])*(1+x[b])*(1-x[b])*(1-x[b])/16.; /*l=4*/
+          break;
+        case 11: /* d4m4 */
+          dlm1[index_d][b]=0.; /*l=3*/
+          out[b][3]=0;
+          dl[index_d][b]=sqrt(9./2.)*(1-x[b])*(1-x[b])*(1-x[b])*(1-x[b])/16.; /*l=4*/
+          break;
+        }
 
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d3m3[index_mu][0]=0;
-    d3m3[index_mu][1]=0;
-    dlm1=0.; /*l=2*/
-    d3m3[index_mu][2]=0;
-    dl=sqrt(7./2.)*(1-mu[index_mu])*(1-mu[index_mu])*(1-mu[index_mu])/8.; /*l=3*/
-    d3m3[index_mu][3] = dl * sqrt(2./7.);
-    for(l=3;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d22 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]+fac2[l])*dl - fac3[l]*dlm1;
-      d3m3[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
+        if (type[index_d] != 0)
+          out[b][lmin[index_d]] = dl[index_d][b] * sqrt(2./(2*lmin[index_d]+1));
+      }
     }
-  }
-  free(fac1); free(fac2); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
 
-/**
- * This routine computes the d40 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d40    Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
+    /** - --> recurrences */
 
-int lensing_d40(
-                double * mu,
-                int num_mu,
-                int lmax,
-                double ** d40
-                ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=4;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)*(2*ll+1)/((ll-3)*(ll+5)));
-    fac3[l] = sqrt((2*ll+3)*(ll-4)*(ll+4)/((2*ll-1)*(ll-3)*(ll+5)));
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
+    for (index_d=0; index_d<d_size; index_d++) {
 
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d40[index_mu][0]=0;
-    d40[index_mu][1]=0;
-    d40[index_mu][2]=0;
-    dlm1=0.; /*l=3*/
-    d40[index_mu][3]=0;
-    dl=sqrt(315.)*(1+mu[index_mu])*(1+mu[index_mu])*(1-mu[index_mu])*(1-mu[index_mu])/16.; /*l=4*/
-    d40[index_mu][4] = dl * sqrt(2./9.);
-    for(l=4;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d22 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*mu[index_mu]*dl - fac3[l]*dlm1;
-      d40[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
-    }
-  }
-  free(fac1); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
+      out = d[index_d]+index_mu;
 
-/**
- * This routine computes the d4m2 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d4m2   Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
+      for (l=lmin[index_d]; l<lmax; l++) {
 
-int lensing_d4m2(
-                 double * mu,
-                 int num_mu,
-                 int lmax,
-                 double ** d4m2
-                 ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=4;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)*(2*ll+1)/((ll-3)*(ll+5)*(ll-1)*(ll+3))) * (ll+1.);
-    fac2[l] = 8./(ll*(ll+1));
-    fac3[l] = sqrt((2*ll+3)*(ll-4)*(ll+4)*(ll-2)*(ll+2)/((2*ll-1)*(ll-3)*(ll+5)*(ll-1)*(ll+3)))*(ll+1)/ll;
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
+        f1 = fac1[index_d][l];
+        f2 = fac2[index_d][l];
+        f3 = fac3[index_d][l];
+        f4 = fac4[l];
 
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d4m2[index_mu][0]=0;
-    d4m2[index_mu][1]=0;
-    d4m2[index_mu][2]=0;
-    dlm1=0.; /*l=3*/
-    d4m2[index_mu][3]=0;
-    dl=sqrt(126.)*(1+mu[index_mu])*(1-mu[index_mu])*(1-mu[index_mu])*(1-mu[index_mu])/16.; /*l=4*/
-    d4m2[index_mu][4] = dl * sqrt(2./9.);
-    for(l=4;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d22 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]+fac2[l])*dl - fac3[l]*dlm1;
-      d4m2[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
+        for (b=0; b<block_size; b++) {
+          /* sqrt((2l+1)/2)*dxx recurrence, supposed to be more stable */
+          dlp1 = f1*(x[b]+f2)*dl[index_d][b] - f3*dlm1[index_d][b];
+          out[b][l+1] = dlp1 * f4;
+          dlm1[index_d][b] = dl[index_d][b];
+          dl[index_d][b] = dlp1;
+        }
+      }
     }
   }
-  free(fac1); free(fac2); free(fac3); free(fac4);
-  return _SUCCESS_;
-}
 
-/**
- * This routine computes the d4m4 term
- *
- * @param mu     Input: Vector of cos(beta) values
- * @param num_mu Input: Number of cos(beta) values
- * @param lmax   Input: maximum multipole
- * @param d4m4   Input/output: Result is stored here
- *
- * Wigner d-functions, computed by recurrence
- * actual recurrence on \f$ \sqrt{(2l+1)/2} d^l_{mm'} \f$ for stability
- * Formulae from Kostelec & Rockmore 2003
- **/
+  free(buffer);
 
-int lensing_d4m4(
-                 double * mu,
-                 int num_mu,
-                 int lmax,
-                 double ** d4m4
-                 ) {
-  double ll, dlm1, dl, dlp1;
-  int index_mu, l;
-  double *fac1, *fac2, *fac3, *fac4;
-  ErrorMsg erreur;
-  class_alloc(fac1,lmax*sizeof(double),erreur);
-  class_alloc(fac2,lmax*sizeof(double),erreur);
-  class_alloc(fac3,lmax*sizeof(double),erreur);
-  class_alloc(fac4,lmax*sizeof(double),erreur);
-  for (l=4;l<lmax;l++) {
-    ll = (double) l;
-    fac1[l] = sqrt((2*ll+3)*(2*ll+1))*(ll+1)/((ll-3)*(ll+5));
-    fac2[l] = 16./(ll*(ll+1));
-    fac3[l] = sqrt((2*ll+3)/(2*ll-1))*(ll-4)*(ll+4)*(ll+1)/((ll-3)*(ll+5)*ll);
-    fac4[l] = sqrt(2./(2*ll+3));
-  }
-#pragma omp parallel for                        \
-  private (index_mu,dlm1,dl,dlp1,l,ll)          \
-  schedule (static)
-
-  for (index_mu=0;index_mu<num_mu;index_mu++) {
-    d4m4[index_mu][0]=0;
-    d4m4[index_mu][1]=0;
-    d4m4[index_mu][2]=0;
-    dlm1=0.; /*l=3*/
-    d4m4[index_mu][3]=0;
-    dl=sqrt(9./2.)*(1-mu[index_mu])*(1-mu[index_mu])*(1-mu[index_mu])*(1-mu[index_mu])/16.; /*l=4*/
-    d4m4[index_mu][4] = dl * sqrt(2./9.);
-    for(l=4;l<lmax;l++){
-      ll=(double) l;
-      /* sqrt((2l+1)/2)*d22 recurrence, supposed to be more stable */
-      dlp1 = fac1[l]*(mu[index_mu]+fac2[l])*dl - fac3[l]*dlm1;
-      d4m4[index_mu][l+1] = dlp1 * fac4[l];
-      dlm1 = dl;
-      dl = dlp1;
-    }
-  }
-  free(fac1); free(fac2); free(fac3); free(fac4);
   return _SUCCESS_;
 }
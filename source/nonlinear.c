@@ -148,6 +148,18 @@ int nonlinear_init(
   class_define_index(pnl->index_pk_cb, pnl->has_pk_cb, index_pk,1);
   pnl->pk_size = index_pk;
 
+  /** Compute the table of linear spectra, used by the spectra module
+      for the output P(k,z) */
+
+  if (ppt->has_pk_matter == _TRUE_) {
+    class_call(nonlinear_pk_linear(pba,ppt,ppm,pnl),
+               pnl->error_message,
+               pnl->error_message);
+  }
+  else {
+    pnl->has_pk_l = _FALSE_;
+  }
+
   /** (a) First deal with the case where non non-linear corrections requested */
 
   if (pnl->method == nl_none) {
@@ -343,6 +355,16 @@ int nonlinear_free(
     }
   }
 
+  if (pnl->has_pk_l == _TRUE_) {
+    for(index_pk=0;index_pk<pnl->pk_size;++index_pk){
+      free(pnl->ln_pk_ic_l[index_pk]);
+      free(pnl->ln_pk_l[index_pk]);
+    }
+    free(pnl->ln_pk_ic_l);
+    free(pnl->ln_pk_l);
+    free(pnl->ln_k_l);
+  }
+
   if (pnl->has_pk_eq == _TRUE_) {
     free(pnl->pk_eq_tau);
     free(pnl->pk_eq_w_and_Omega);
@@ -353,12 +375,357 @@ int nonlinear_free(
 
 }
 
+/**
+ * Find the first time of ppt->tau_sampling at which the linear matter
+ * power spectrum must be stored, such that \f$ P(k,z) \f$ can be
+ * interpolated for all \f$ 0 \leq z \leq z_{max,pk} \f$: the last
+ * value before \f$ \tau(z_{max,pk}) \f$, with a few more values (when
+ * possible) to avoid boundary effects in the interpolation. If
+ * z_max_pk=0, only today is needed.
+ *
+ * @param pba           Input: pointer to background structure
+ * @param ppt           Input: pointer to perturbation structure
+ * @param z_max_pk      Input: maximum redshift
+ * @param index_tau_min Output: index of the first time in ppt->tau_sampling
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int nonlinear_pk_l_index_tau_min(
+                                 struct background *pba,
+                                 struct perturbs *ppt,
+                                 double z_max_pk,
+                                 int *index_tau_min,
+                                 ErrorMsg error_message
+                                 ) {
+
+  int index_tau;
+  double tau_min;
+
+  /* if z_max_pk<0, return error */
+  class_test((z_max_pk < 0),
+             error_message,
+             "asked for negative redshift z=%e",z_max_pk);
+
+  /* if z_max_pk=0, there is just one value to store */
+  if (z_max_pk == 0.) {
+    *index_tau_min = ppt->tau_size-1;
+    return _SUCCESS_;
+  }
+
+  /* find the first relevant value of tau (last value in the table tau_ampling before tau(z_max)) */
+
+  class_call(background_tau_of_z(pba,z_max_pk,&tau_min),
+             pba->error_message,
+             error_message);
+
+  index_tau=0;
+  class_test((tau_min <= ppt->tau_sampling[index_tau]),
+             error_message,
+             "you asked for zmax=%e, i.e. taumin=%e, smaller than or equal to the first possible value =%e; it should be strictly bigger for a successfull interpolation",z_max_pk,tau_min,ppt->tau_sampling[0]);
+
+  while (ppt->tau_sampling[index_tau] < tau_min){
+    index_tau++;
+  }
+  index_tau --;
+  class_test(index_tau<0,
+             error_message,
+             "by construction, this should never happen, a bug must have been introduced somewhere");
+
+  /* whenever possible, take a few more values in to avoid boundary effects in the interpolation */
+  if (index_tau>0) index_tau--;
+  if (index_tau>0) index_tau--;
+  if (index_tau>0) index_tau--;
+  if (index_tau>0) index_tau--;
+
+  *index_tau_min = index_tau;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Compute the table of linear matter power spectra
+ * \f$ P_L(k,\tau) \f$ for each pair of initial conditions and in
+ * total, for all wavenumbers of the perturbation module and for all
+ * times needed by the spectra module (times up to ppt->z_max_pk). The
+ * table is then read by spectra_pk(). Halofit computes its own linear
+ * spectrum in nonlinear_pk_l().
+ *
+ * The primordial spectrum does not depend on time: it is evaluated
+ * once for each wavenumber, together with the factor
+ * \f$ 2 \pi^2/k^3 \f$, before the loop over times.
+ *
+ * @param pba Input: pointer to background structure
+ * @param ppt Input: pointer to perturbation structure (contain source functions)
+ * @param ppm Input: pointer to primordial structure
+ * @param pnl Input/Output: pointer to nonlinear structure
+ * @return the error status
+ */
+
+int nonlinear_pk_linear(
+                        struct background *pba,
+                        struct perturbs *ppt,
+                        struct primordial *ppm,
+                        struct nonlinear *pnl
+                        ) {
+
+  int index_md;
+  int index_ic1,index_ic1_ic1;
+  int index_k;
+  int index_tau;
+  int index_pk;
+  int k_size;
+  double * primordial_pk;     /* array with argument primordial_pk[index_k * pnl->ic_ic_size + index_ic_ic] */
+  double * exp_primordial_pk; /* idem, exponential of primordial_pk for diagonal coefficients */
+  double * pk_factor;         /* array with argument pk_factor[index_k] */
+  double * pk_tot;            /* workspace pk_tot[index_k] */
+  int abort;
+
+  class_test((ppt->has_scalars == _FALSE_),
+             pnl->error_message,
+             "you cannot ask for matter power spectrum since you turned off scalar modes");
+
+  index_md = ppt->index_md_scalars;
+  k_size = ppt->k_size[index_md];
+
+  pnl->ic_ic_size = ppm->ic_ic_size[index_md];
+
+  /** - range of times: those needed for P(k,z) up to z_max_pk */
+
+  class_call(nonlinear_pk_l_index_tau_min(pba,ppt,ppt->z_max_pk,&(pnl->index_tau_min_l),pnl->error_message),
+             pnl->error_message,
+             pnl->error_message);
+  pnl->tau_l_size = ppt->tau_size-pnl->index_tau_min_l;
+
+  class_alloc(pnl->ln_pk_ic_l,pnl->pk_size*sizeof(double *),pnl->error_message);
+  class_alloc(pnl->ln_pk_l,pnl->pk_size*sizeof(double *),pnl->error_message);
+
+  for (index_pk=0; index_pk<pnl->pk_size; index_pk++) {
+    class_alloc(pnl->ln_pk_ic_l[index_pk],pnl->tau_l_size*k_size*pnl->ic_ic_size*sizeof(double),pnl->error_message);
+    class_alloc(pnl->ln_pk_l[index_pk],pnl->tau_l_size*k_size*sizeof(double),pnl->error_message);
+  }
+
+  /** - primordial spectrum and k-dependent factor, once for all times */
+
+  class_alloc(primordial_pk,k_size*pnl->ic_ic_size*sizeof(double),pnl->error_message);
+  class_alloc(exp_primordial_pk,k_size*pnl->ic_ic_size*sizeof(double),pnl->error_message);
+  class_alloc(pk_factor,k_size*sizeof(double),pnl->error_message);
+
+  class_alloc(pnl->ln_k_l,k_size*sizeof(double),pnl->error_message);
+
+  for (index_k=0; index_k<k_size; index_k++) {
+
+    pnl->ln_k_l[index_k] = log(ppt->k[index_md][index_k]);
+
+    class_call(primordial_spectrum_at_k(ppm,index_md,logarithmic,pnl->ln_k_l[index_k],primordial_pk+index_k*pnl->ic_ic_size),
+               ppm->error_message,
+               pnl->error_message);
+
+    /* for diagonal coefficients, primordial_spectrum_at_k() returns the logarithm of the spectrum */
+    for (index_ic1 = 0; index_ic1 < ppm->ic_size[index_md]; index_ic1++) {
+      index_ic1_ic1 = index_symmetric_matrix(index_ic1,index_ic1,ppm->ic_size[index_md]);
+      exp_primordial_pk[index_k*pnl->ic_ic_size+index_ic1_ic1] = exp(primordial_pk[index_k*pnl->ic_ic_size+index_ic1_ic1]);
+    }
+
+    pk_factor[index_k] = 2.*_PI_*_PI_/exp(3.*pnl->ln_k_l[index_k]);
+  }
+
+  /** - fill the tables for each time. Different times are
+      independent and can be computed in parallel. */
+
+  abort = _FALSE_;
+
+#pragma omp parallel                                                    \
+  shared(ppt,ppm,pnl,primordial_pk,exp_primordial_pk,pk_factor,k_size,index_md,abort) \
+  private(index_tau,index_pk,pk_tot)
+
+  {
+
+    class_alloc_parallel(pk_tot,k_size*sizeof(double),pnl->error_message);
+
+#pragma omp for schedule (dynamic)
+
+    for (index_tau=0; index_tau < pnl->tau_l_size; index_tau++) {
+
+#pragma omp flush(abort)
+
+      for (index_pk=0; index_pk<pnl->pk_size; index_pk++) {
+
+        class_call_parallel(nonlinear_pk_linear_at_tau_index(ppt,
+                                                             pnl,
+                                                             index_pk,
+                                                             index_tau,
+                                                             primordial_pk,
+                                                             exp_primordial_pk,
+                                                             pk_factor,
+                                                             ppm->is_non_zero[index_md],
+                                                             pk_tot),
+                            pnl->error_message,
+                            pnl->error_message);
+      }
+    }
+
+    free(pk_tot);
+
+  } /* end of parallel region */
+
+  free(primordial_pk);
+  free(exp_primordial_pk);
+  free(pk_factor);
+
+  if (abort == _TRUE_) return _FAILURE_;
+
+  pnl->has_pk_l = _TRUE_;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Fill the table of linear spectra for one time and all wavenumbers.
+ *
+ * The inner loops run over wavenumbers, which are contiguous in the
+ * source functions, and can be vectorised by the compiler.
+ *
+ * @param ppt               Input: pointer to perturbation structure (contain source functions)
+ * @param pnl               Input/Output: pointer to nonlinear structure
+ * @param index_pk          Input: index of the spectrum (total matter or cdm+baryons)
+ * @param index_tau         Input: index of time in the table, counted from pnl->index_tau_min_l
+ * @param primordial_pk     Input: primordial spectrum primordial_pk[index_k * pnl->ic_ic_size + index_ic_ic], as returned by primordial_spectrum_at_k() in logarithmic mode
+ * @param exp_primordial_pk Input: exponential of primordial_pk for diagonal coefficients
+ * @param pk_factor         Input: factor \f$ 2 \pi^2/k^3 \f$ for each wavenumber
+ * @param is_non_zero       Input: flags of correlated pairs of initial conditions, ppm->is_non_zero[ppt->index_md_scalars]
+ * @param pk_tot            Input: workspace of size ppt->k_size[ppt->index_md_scalars]
+ * @return the error status
+ */
+
+int nonlinear_pk_linear_at_tau_index(
+                                     struct perturbs *ppt,
+                                     struct nonlinear *pnl,
+                                     int index_pk,
+                                     int index_tau,
+                                     double *primordial_pk,
+                                     double *exp_primordial_pk,
+                                     double *pk_factor,
+                                     short *is_non_zero,
+                                     double *pk_tot
+                                     ) {
+
+  int index_md;
+  int index_delta;
+  int index_ic1,index_ic2,index_ic1_ic1,index_ic2_ic2,index_ic1_ic2;
+  int index_k;
+  int k_size;
+  int ic_size;
+  int ic_ic_size;
+  double * source_ic1;
+  double * source_ic2;
+  double * ln_pk;
+
+  index_md = ppt->index_md_scalars;
+  k_size = ppt->k_size[index_md];
+  ic_size = ppt->ic_size[index_md];
+  ic_ic_size = pnl->ic_ic_size;
+
+  if ((pnl->has_pk_m == _TRUE_) && (index_pk == pnl->index_pk_m)) {
+    index_delta = ppt->index_tp_delta_m;
+  }
+  else if ((pnl->has_pk_cb == _TRUE_) && (index_pk == pnl->index_pk_cb)) {
+    index_delta = ppt->index_tp_delta_cb;
+  }
+  else {
+    class_stop(pnl->error_message,"P(k) is set neither to total matter nor to cold dark matter + baryons");
+  }
+
+  ln_pk = pnl->ln_pk_ic_l[index_pk] + index_tau * k_size * ic_ic_size;
+
+  /* curvature primordial spectrum:
+     P_R(k) = 1/(2pi^2) k^3 <R R>
+     so, primordial curvature correlator:
+     <R R> = (2pi^2) k^-3 P_R(k)
+     so, delta_m correlator:
+     P(k) = <delta_m delta_m> = (2pi^2) k^-3 (source_m)^2 P_R(k)
+
+     For isocurvature or cross adiabatic-isocurvature parts,
+     replace one or two 'R' by 'S_i's */
+
+  for (index_k=0; index_k<k_size; index_k++) {
+    pk_tot[index_k] = 0.;
+  }
+
+  /* part diagonal in initial conditions */
+  for (index_ic1 = 0; index_ic1 < ic_size; index_ic1++) {
+
+    index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic1,ic_size);
+
+    source_ic1 = ppt->sources[index_md]
+      [index_ic1 * ppt->tp_size[index_md] + index_delta]
+      + (index_tau + pnl->index_tau_min_l) * k_size;
+
+    for (index_k=0; index_k<k_size; index_k++) {
+
+      ln_pk[index_k * ic_ic_size + index_ic1_ic2] =
+        log(pk_factor[index_k]
+            *source_ic1[index_k]*source_ic1[index_k]
+            *exp_primordial_pk[index_k * ic_ic_size + index_ic1_ic2]);
+
+      pk_tot[index_k] += exp(ln_pk[index_k * ic_ic_size + index_ic1_ic2]);
+    }
+  }
+
+  /* part non-diagonal in initial conditions: the table contains the
+     correlation coefficient, with the sign of the product of the
+     sources */
+  for (index_ic1 = 0; index_ic1 < ic_size; index_ic1++) {
+    for (index_ic2 = index_ic1+1; index_ic2 < ic_size; index_ic2++) {
+
+      index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,ic_size);
+      index_ic1_ic1 = index_symmetric_matrix(index_ic1,index_ic1,ic_size);
+      index_ic2_ic2 = index_symmetric_matrix(index_ic2,index_ic2,ic_size);
+
+      if (is_non_zero[index_ic1_ic2] == _TRUE_) {
+
+        source_ic1 = ppt->sources[index_md]
+          [index_ic1 * ppt->tp_size[index_md] + index_delta]
+          + (index_tau + pnl->index_tau_min_l) * k_size;
+
+        source_ic2 = ppt->sources[index_md]
+          [index_ic2 * ppt->tp_size[index_md] + index_delta]
+          + (index_tau + pnl->index_tau_min_l) * k_size;
+
+        for (index_k=0; index_k<k_size; index_k++) {
+
+          ln_pk[index_k * ic_ic_size + index_ic1_ic2] =
+            primordial_pk[index_k * ic_ic_size + index_ic1_ic2]*SIGN(source_ic1[index_k])*SIGN(source_ic2[index_k]);
+
+          pk_tot[index_k] += 2. * ln_pk[index_k * ic_ic_size + index_ic1_ic2]
+            * sqrt(exp(ln_pk[index_k * ic_ic_size + index_ic1_ic1])
+                   * exp(ln_pk[index_k * ic_ic_size + index_ic2_ic2]));
+        }
+      }
+      else {
+        for (index_k=0; index_k<k_size; index_k++) {
+          ln_pk[index_k * ic_ic_size + index_ic1_ic2] = 0.;
+        }
+      }
+    }
+  }
+
+  /* total linear spectrum */
+
+  for (index_k=0; index_k<k_size; index_k++) {
+    pnl->ln_pk_l[index_pk][index_tau * k_size + index_k] = log(pk_tot[index_k]);
+  }
+
+  return _SUCCESS_;
+}
+
 /**
  * Calculation of the linear matter power spectrum, used to get the
- * nonlinear one.  This is partially redundent with a more elaborate
- * version of this calculation performed later in the spectra
- * module. At some point the organisation will change to avoid this
- * redundency.
+ * nonlinear one.  The spectrum is computed here from the sources and
+ * the primordial spectrum in linear mode, rather than read from the
+ * table pnl->ln_pk_l of nonlinear_pk_linear(): this keeps the
+ * arithmetic that Halofit has always used, so that the non-linear
+ * spectrum does not depend on the rounding of that table.
  *
  * @param pba       Input: pointer to background structure
  * @param ppt       Input: pointer to perturbation structure
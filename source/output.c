@@ -23,13 +23,36 @@ int output_total_cl_at_l(
                          double * cl
                          ){
 
-  double ** cl_md_ic; /* array with argument
-                         cl_md_ic[index_md][index_ic1_ic2*psp->ct_size+index_ct] */
+  class_call(output_total_cl_at_l_with_workspace(psp,ple,pop,NULL,l,cl),
+             pop->error_message,
+             pop->error_message);
 
-  double ** cl_md;    /* array with argument
-                         cl_md[index_md][index_ct] */
+  return _SUCCESS_;
 
-  int index_md;
+}
+
+/**
+ * Same as output_total_cl_at_l(), with a workspace provided by the
+ * caller (or NULL for the default workspace of the calling thread),
+ * so that no memory is allocated.
+ *
+ * @param psp Input: pointer to spectra structure
+ * @param ple Input: pointer to lensing structure
+ * @param pop Input: pointer to output structure
+ * @param psw Input: pointer to spectra workspace (or NULL)
+ * @param l   Input: multipole number
+ * @param cl  Output: lensed \f$ C_l\f$'s for all types (TT, TE, EE, etc..)
+ * @return the error status
+ */
+
+int output_total_cl_at_l_with_workspace(
+                                        struct spectra * psp,
+                                        struct lensing * ple,
+                                        struct output * pop,
+                                        struct spectra_workspace * psw,
+                                        int l,
+                                        double * cl
+                                        ){
 
   if (ple->has_lensed_cls == _TRUE_) {
     class_call(lensing_cl_at_l(ple,
@@ -40,50 +63,25 @@ int output_total_cl_at_l(
   }
   else {
 
-    class_alloc(cl_md_ic,
-                psp->md_size*sizeof(double *),
-                pop->error_message);
-
-    class_alloc(cl_md,
-                psp->md_size*sizeof(double *),
-                pop->error_message);
-
-    for (index_md = 0; index_md < psp->md_size; index_md++) {
-
-      if (psp->md_size > 1)
-
-        class_alloc(cl_md[index_md],
-                    psp->ct_size*sizeof(double),
-                    ple->error_message);
-
-      if (psp->ic_size[index_md] > 1)
-
-        class_alloc(cl_md_ic[index_md],
-                    psp->ic_ic_size[index_md]*psp->ct_size*sizeof(double),
-                    ple->error_message);
+    if (psw == NULL) {
+      class_call(spectra_workspace_default(psp,&psw),
+                 psp->error_message,
+                 pop->error_message);
+    }
+    else {
+      class_call(spectra_workspace_reserve(psp,psw),
+                 psp->error_message,
+                 pop->error_message);
     }
 
     class_call(spectra_cl_at_l(psp,
                                (double)l,
                                cl,
-                               cl_md,
-                               cl_md_ic),
+                               psw->cl_md,
+                               psw->cl_md_ic),
                psp->error_message,
                pop->error_message);
 
-    for (index_md = 0; index_md < psp->md_size; index_md++) {
-
-      if (psp->md_size > 1)
-        free(cl_md[index_md]);
-
-      if (psp->ic_size[index_md] > 1)
-        free(cl_md_ic[index_md]);
-
-    }
-
-    free(cl_md_ic);
-    free(cl_md);
-
   }
 
   return _SUCCESS_;
@@ -251,6 +249,15 @@ int output_cl(
   double * cl_tot;    /* array with argument
                          cl_tot[index_ct] */
 
+  double * table;         /* lines to be written in out, with argument
+                             table[(l-2)*(psp->ct_size+1)+index_column] */
+
+  double * table_lensed;  /* idem for out_lensed */
+
+  double ** table_md;     /* idem for out_md[index_md] */
+
+  double *** table_md_ic; /* idem for out_md_ic[index_md][index_ic1_ic2] */
+
   int index_md;
   int index_ic1,index_ic2,index_ic1_ic2;
   int l;
@@ -276,12 +283,24 @@ int output_cl(
               psp->md_size*sizeof(double *),
               pop->error_message);
 
+  class_alloc(table_md_ic,
+              psp->md_size*sizeof(double **),
+              pop->error_message);
+
+  class_alloc(table_md,
+              psp->md_size*sizeof(double *),
+              pop->error_message);
+
   for (index_md = 0; index_md < ppt->md_size; index_md++) {
 
     class_alloc(out_md_ic[index_md],
                 psp->ic_ic_size[index_md]*sizeof(FILE *),
                 pop->error_message);
 
+    class_alloc(table_md_ic[index_md],
+                psp->ic_ic_size[index_md]*sizeof(double *),
+                pop->error_message);
+
   }
 
   /** - second, open only the relevant files, and write a heading in each of them */
@@ -302,6 +321,10 @@ int output_cl(
               psp->ct_size*sizeof(double),
               pop->error_message);
 
+  class_alloc(table,
+              (psp->l_max_tot-1)*(psp->ct_size+1)*sizeof(double),
+              pop->error_message);
+
 
   if (ple->has_lensed_cls == _TRUE_) {
 
@@ -316,6 +339,10 @@ int output_cl(
                                    ),
                pop->error_message,
                pop->error_message);
+
+    class_alloc(table_lensed,
+                (ple->l_lensed_max-1)*(psp->ct_size+1)*sizeof(double),
+                pop->error_message);
   }
 
   if (ppt->md_size > 1) {
@@ -350,6 +377,10 @@ int output_cl(
                   psp->ct_size*sizeof(double),
                   pop->error_message);
 
+      class_alloc(table_md[index_md],
+                  (psp->l_max[index_md]-1)*(psp->ct_size+1)*sizeof(double),
+                  pop->error_message);
+
     }
   }
 
@@ -492,6 +523,9 @@ int output_cl(
                        pop->error_message,
                        pop->error_message);
 
+            class_alloc(table_md_ic[index_md][index_ic1_ic2],
+                        (psp->l_max[index_md]-1)*(psp->ct_size+1)*sizeof(double),
+                        pop->error_message);
           }
         }
       }
@@ -504,7 +538,7 @@ int output_cl(
 
   /** - third, perform loop over l. For each multipole, get all \f$ C_l\f$'s
       by calling spectra_cl_at_l() and distribute the results to
-      relevant files */
+      the lines of the relevant files */
 
   for (l = 2; l <= psp->l_max_tot; l++) {
 
@@ -512,7 +546,7 @@ int output_cl(
                psp->error_message,
                pop->error_message);
 
-    class_call(output_one_line_of_cl(pba,psp,pop,out,(double)l,cl_tot,psp->ct_size),
+    class_call(output_one_line_of_cl(pba,psp,pop,table+(l-2)*(psp->ct_size+1),(double)l,cl_tot,psp->ct_size),
                pop->error_message,
                pop->error_message);
 
@@ -524,7 +558,7 @@ int output_cl(
                  ple->error_message,
                  pop->error_message);
 
-      class_call(output_one_line_of_cl(pba,psp,pop,out_lensed,l,cl_tot,psp->ct_size),
+      class_call(output_one_line_of_cl(pba,psp,pop,table_lensed+(l-2)*(psp->ct_size+1),l,cl_tot,psp->ct_size),
                  pop->error_message,
                  pop->error_message);
     }
@@ -533,7 +567,7 @@ int output_cl(
       for (index_md = 0; index_md < ppt->md_size; index_md++) {
         if (l <= psp->l_max[index_md]) {
 
-          class_call(output_one_line_of_cl(pba,psp,pop,out_md[index_md],l,cl_md[index_md],psp->ct_size),
+          class_call(output_one_line_of_cl(pba,psp,pop,table_md[index_md]+(l-2)*(psp->ct_size+1),l,cl_md[index_md],psp->ct_size),
                      pop->error_message,
                      pop->error_message);
         }
@@ -545,7 +579,7 @@ int output_cl(
         for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
           if (psp->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
 
-            class_call(output_one_line_of_cl(pba,psp,pop,out_md_ic[index_md][index_ic1_ic2],l,&(cl_md_ic[index_md][index_ic1_ic2*psp->ct_size]),psp->ct_size),
+            class_call(output_one_line_of_cl(pba,psp,pop,table_md_ic[index_md][index_ic1_ic2]+(l-2)*(psp->ct_size+1),l,&(cl_md_ic[index_md][index_ic1_ic2*psp->ct_size]),psp->ct_size),
                        pop->error_message,
                        pop->error_message);
           }
@@ -554,6 +588,38 @@ int output_cl(
     }
   }
 
+  /** - fourth, write the lines in the files */
+
+  class_call(output_print_table(pop,out,table,psp->l_max_tot-1,psp->ct_size+1,_TRUE_),
+             pop->error_message,
+             pop->error_message);
+
+  if (ple->has_lensed_cls == _TRUE_) {
+    class_call(output_print_table(pop,out_lensed,table_lensed,ple->l_lensed_max-1,psp->ct_size+1,_TRUE_),
+               pop->error_message,
+               pop->error_message);
+  }
+
+  if (ppt->md_size > 1) {
+    for (index_md = 0; index_md < ppt->md_size; index_md++) {
+      class_call(output_print_table(pop,out_md[index_md],table_md[index_md],psp->l_max[index_md]-1,psp->ct_size+1,_TRUE_),
+                 pop->error_message,
+                 pop->error_message);
+    }
+  }
+
+  for (index_md = 0; index_md < ppt->md_size; index_md++) {
+    if (ppt->ic_size[index_md] > 1) {
+      for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
+        if (psp->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
+          class_call(output_print_table(pop,out_md_ic[index_md][index_ic1_ic2],table_md_ic[index_md][index_ic1_ic2],psp->l_max[index_md]-1,psp->ct_size+1,_TRUE_),
+                     pop->error_message,
+                     pop->error_message);
+        }
+      }
+    }
+  }
+
   /** - finally, close files and free arrays of files and \f$ C_l\f$'s */
 
   for (index_md = 0; index_md < ppt->md_size; index_md++) {
@@ -561,6 +627,7 @@ int output_cl(
       for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
         if (psp->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
           fclose(out_md_ic[index_md][index_ic1_ic2]);
+          free(table_md_ic[index_md][index_ic1_ic2]);
         }
       }
       free(cl_md_ic[index_md]);
@@ -570,20 +637,26 @@ int output_cl(
     for (index_md = 0; index_md < ppt->md_size; index_md++) {
       fclose(out_md[index_md]);
       free(cl_md[index_md]);
+      free(table_md[index_md]);
     }
   }
   fclose(out);
+  free(table);
   if (ple->has_lensed_cls == _TRUE_) {
     fclose(out_lensed);
+    free(table_lensed);
   }
   free(cl_tot);
   for (index_md = 0; index_md < ppt->md_size; index_md++) {
     free(out_md_ic[index_md]);
+    free(table_md_ic[index_md]);
   }
   free(out_md_ic);
   free(cl_md_ic);
   free(out_md);
   free(cl_md);
+  free(table_md_ic);
+  free(table_md);
 
   return _SUCCESS_;
 
@@ -627,6 +700,9 @@ int output_pk(
   double * pk_cb_ic=NULL; /* same as pk_ic for CDM+baryon only */
   double * pk_cb_tot=NULL;     /* same as pk_tot for CDM+baryon only */
 
+  double * pk_table; /* array with argument
+                        pk_table[index_k * 2 + index_column] (k and P(k) values written in one file) */
+
   int index_md;
   int index_ic1,index_ic2;
   int index_ic1_ic2=0;
@@ -640,6 +716,10 @@ int output_pk(
 
   index_md=ppt->index_md_scalars;
 
+  class_alloc(pk_table,
+              2*psp->ln_k_size*sizeof(double),
+              pop->error_message);
+
   for (index_z = 0; index_z < pop->z_pk_num; index_z++) {
 
     /** - first, check that requested redshift z_pk is consistent */
@@ -946,42 +1026,30 @@ int output_pk(
 
     /** - fourth, write in files */
 
-    for (index_k=0; index_k<psp->ln_k_size; index_k++) {
+    class_call(output_all_lines_of_pk(pba,psp,pop,out,pk_tot,1,pk_table),
+               pop->error_message,
+               pop->error_message);
 
-      class_call(output_one_line_of_pk(out,
-                                       exp(psp->ln_k[index_k])/pba->h,
-                                       pk_tot[index_k]*pow(pba->h,3)),
+    if(pba->has_ncdm){
+      class_call(output_all_lines_of_pk(pba,psp,pop,out_cb,pk_cb_tot,1,pk_table),
                  pop->error_message,
                  pop->error_message);
+    }
 
-      if(pba->has_ncdm){
-        class_call(output_one_line_of_pk(out_cb,
-                                         exp(psp->ln_k[index_k])/pba->h,
-                                         pk_cb_tot[index_k]*pow(pba->h,3)),
-                   pop->error_message,
-                   pop->error_message);
-      }
+    if (psp->ic_size[index_md] > 1) {
 
-      if (psp->ic_size[index_md] > 1) {
+      for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
 
-        for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
+        if (psp->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
 
-          if (psp->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
+          class_call(output_all_lines_of_pk(pba,psp,pop,out_ic[index_ic1_ic2],pk_ic+index_ic1_ic2,psp->ic_ic_size[index_md],pk_table),
+                     pop->error_message,
+                     pop->error_message);
 
-            class_call(output_one_line_of_pk(out_ic[index_ic1_ic2],
-                                             exp(psp->ln_k[index_k])/pba->h,
-                                             pk_ic[index_k * psp->ic_ic_size[index_md] + index_ic1_ic2]*pow(pba->h,3)),
+          if(pba->has_ncdm){
+            class_call(output_all_lines_of_pk(pba,psp,pop,out_cb_ic[index_ic1_ic2],pk_cb_ic+index_ic1_ic2,psp->ic_ic_size[index_md],pk_table),
                        pop->error_message,
                        pop->error_message);
-
-            if(pba->has_ncdm){
-              class_call(output_one_line_of_pk(out_cb_ic[index_ic1_ic2],
-                                               exp(psp->ln_k[index_k])/pba->h,
-                                               pk_cb_ic[index_k * psp->ic_ic_size[index_md] + index_ic1_ic2]*pow(pba->h,3)),
-                         pop->error_message,
-                         pop->error_message);
-
-            }
           }
         }
       }
@@ -1008,6 +1076,8 @@ int output_pk(
     }
   }
 
+  free(pk_table);
+
   return _SUCCESS_;
 
 }
@@ -1039,6 +1109,9 @@ int output_pk_nl(
   FILE * out_cb;
   double * pk_cb_tot=NULL;
 
+  double * pk_table; /* array with argument
+                        pk_table[index_k * 2 + index_column] (k and P(k) values written in one file) */
+
   int index_k;
   int index_z;
 
@@ -1046,6 +1119,10 @@ int output_pk_nl(
   FileName file_cb_name;
   char redshift_suffix[7]; // 7 is enough to write "z%d_" as long as there are at most 10'000 bins
 
+  class_alloc(pk_table,
+              2*psp->ln_k_size*sizeof(double),
+              pop->error_message);
+
   for (index_z = 0; index_z < pop->z_pk_num; index_z++) {
 
     /** - first, check that requested redshift z_pk is consistent */
@@ -1128,22 +1205,14 @@ int output_pk_nl(
 
     /** - fourth, write in files */
 
-    for (index_k=0; index_k<psp->ln_k_size; index_k++) {
+    class_call(output_all_lines_of_pk(pba,psp,pop,out,pk_tot,1,pk_table),
+               pop->error_message,
+               pop->error_message);
 
-      class_call(output_one_line_of_pk(out,
-                                       exp(psp->ln_k[index_k])/pba->h,
-                                       pk_tot[index_k]*pow(pba->h,3)),
+    if (pba->has_ncdm){
+      class_call(output_all_lines_of_pk(pba,psp,pop,out_cb,pk_cb_tot,1,pk_table),
                  pop->error_message,
                  pop->error_message);
-
-      if (pba->has_ncdm){
-        class_call(output_one_line_of_pk(out_cb,
-                                         exp(psp->ln_k[index_k])/pba->h,
-                                         pk_cb_tot[index_k]*pow(pba->h,3)),
-                   pop->error_message,
-                   pop->error_message);
-      }
-
     }
 
     /** - fifth, free memory and close files */
@@ -1155,6 +1224,8 @@ int output_pk_nl(
 
   }
 
+  free(pk_table);
+
   return _SUCCESS_;
 
 }
@@ -1257,7 +1328,7 @@ int output_tk(
       else
         sprintf(file_name,"%s%s%s%s%s",pop->root,redshift_suffix,"tk_",ic_suffix,".dat");
 
-      class_open(tkfile, file_name, "w", pop->error_message);
+      class_open(tkfile,file_name,"w",pop->error_message);
 
       if (pop->write_header == _TRUE_) {
         if (pop->output_format == class_format) {
@@ -1290,10 +1361,13 @@ int output_tk(
         }
       }
 
-      output_print_data(tkfile,
-                        titles,
-                        data+index_ic*size_data,
-                        size_data);
+      class_call(output_print_data(pop,
+                                   tkfile,
+                                   titles,
+                                   data+index_ic*size_data,
+                                   size_data),
+                 pop->error_message,
+                 pop->error_message);
 
       /** - free memory and close files */
       fclose(tkfile);
@@ -1347,10 +1421,13 @@ int output_background(
     }
   }
 
-  output_print_data(backfile,
-                    titles,
-                    data,
-                    size_data);
+  class_call(output_print_data(pop,
+                               backfile,
+                               titles,
+                               data,
+                               size_data),
+             pop->error_message,
+             pop->error_message);
 
   free(data);
   fclose(backfile);
@@ -1402,10 +1479,13 @@ int output_thermodynamics(
     }
   }
 
-  output_print_data(thermofile,
-                    titles,
-                    data,
-                    size_data);
+  class_call(output_print_data(pop,
+                               thermofile,
+                               titles,
+                               data,
+                               size_data),
+             pop->error_message,
+             pop->error_message);
 
   free(data);
   fclose(thermofile);
@@ -1432,12 +1512,15 @@ int output_perturbations(
       index_md = ppt->index_md_scalars;
       k = ppt->k[index_md][ppt->index_k_output_values[index_md*ppt->k_output_values_num+index_ikout]];
       sprintf(file_name,"%s%s%d%s",pop->root,"perturbations_k",index_ikout,"_s.dat");
-      class_open(out, file_name, "w", ppt->error_message);
+      class_open(out,file_name,"w",pop->error_message);
       fprintf(out,"#scalar perturbations for mode k = %.*e Mpc^(-1)\n",_OUTPUTPRECISION_,k);
-      output_print_data(out,
-                        ppt->scalar_titles,
-                        ppt->scalar_perturbations_data[index_ikout],
-                        ppt->size_scalar_perturbation_data[index_ikout]);
+      class_call(output_print_data(pop,
+                                   out,
+                                   ppt->scalar_titles,
+                                   ppt->scalar_perturbations_data[index_ikout],
+                                   ppt->size_scalar_perturbation_data[index_ikout]),
+                 pop->error_message,
+                 pop->error_message);
 
       fclose(out);
     }
@@ -1445,12 +1528,15 @@ int output_perturbations(
       index_md = ppt->index_md_vectors;
       k = ppt->k[index_md][ppt->index_k_output_values[index_md*ppt->k_output_values_num+index_ikout]];
       sprintf(file_name,"%s%s%d%s",pop->root,"perturbations_k",index_ikout,"_v.dat");
-      class_open(out, file_name, "w", ppt->error_message);
+      class_open(out,file_name,"w",pop->error_message);
       fprintf(out,"#vector perturbations for mode k = %.*e Mpc^(-1)\n",_OUTPUTPRECISION_,k);
-      output_print_data(out,
-                        ppt->vector_titles,
-                        ppt->vector_perturbations_data[index_ikout],
-                        ppt->size_vector_perturbation_data[index_ikout]);
+      class_call(output_print_data(pop,
+                                   out,
+                                   ppt->vector_titles,
+                                   ppt->vector_perturbations_data[index_ikout],
+                                   ppt->size_vector_perturbation_data[index_ikout]),
+                 pop->error_message,
+                 pop->error_message);
 
       fclose(out);
     }
@@ -1458,12 +1544,15 @@ int output_perturbations(
       index_md = ppt->index_md_tensors;
       k = ppt->k[index_md][ppt->index_k_output_values[index_md*ppt->k_output_values_num+index_ikout]];
       sprintf(file_name,"%s%s%d%s",pop->root,"perturbations_k",index_ikout,"_t.dat");
-      class_open(out, file_name, "w", ppt->error_message);
+      class_open(out,file_name,"w",pop->error_message);
       fprintf(out,"#tensor perturbations for mode k = %.*e Mpc^(-1)\n",_OUTPUTPRECISION_,k);
-      output_print_data(out,
-                        ppt->tensor_titles,
-                        ppt->tensor_perturbations_data[index_ikout],
-                        ppt->size_tensor_perturbation_data[index_ikout]);
+      class_call(output_print_data(pop,
+                                   out,
+                                   ppt->tensor_titles,
+                                   ppt->tensor_perturbations_data[index_ikout],
+                                   ppt->size_tensor_perturbation_data[index_ikout]),
+                 pop->error_message,
+                 pop->error_message);
 
       fclose(out);
     }
@@ -1505,10 +1594,13 @@ int output_primordial(
     fprintf(out,"# Dimensionless primordial spectrum, equal to [k^3/2pi^2] P(k) \n");
   }
 
-  output_print_data(out,
-                    titles,
-                    data,
-                    size_data);
+  class_call(output_print_data(pop,
+                               out,
+                               titles,
+                               data,
+                               size_data),
+             pop->error_message,
+             pop->error_message);
 
   free(data);
   fclose(out);
@@ -1517,12 +1609,12 @@ int output_primordial(
 }
 
 
-int output_print_data(FILE *out,
+int output_print_data(struct output * pop,
+                      FILE *out,
                       char titles[_MAXTITLESTRINGLENGTH_],
                       double *dataptr,
                       int size_dataptr){
   int colnum=1, number_of_titles;
-  int index_title, index_tau;
   char thetitle[_MAXTITLESTRINGLENGTH_];
   char *pch;
 
@@ -1542,13 +1634,14 @@ int output_print_data(FILE *out,
   /** - Then we print the data */
   number_of_titles = colnum-1;
   if (number_of_titles>0){
-    for (index_tau=0; index_tau<size_dataptr/number_of_titles; index_tau++){
-      fprintf(out," ");
-      for (index_title=0; index_title<number_of_titles; index_title++){
-        class_fprintf_double(out, dataptr[index_tau*number_of_titles+index_title], _TRUE_);
-      }
-      fprintf(out,"\n");
-    }
+    class_call(output_print_table(pop,
+                                  out,
+                                  dataptr,
+                                  size_dataptr/number_of_titles,
+                                  number_of_titles,
+                                  _FALSE_),
+               pop->error_message,
+               pop->error_message);
   }
   return _SUCCESS_;
 }
@@ -1656,6 +1749,8 @@ int output_open_cl_file(
     if (psp->has_dd == _TRUE_){
       for (index_d1=0; index_d1<psp->d_size; index_d1++){
         for (index_d2=index_d1; index_d2<=MIN(index_d1+psp->non_diag,psp->d_size-1); index_d2++){
+          if (psp->has_dd_pair[index_d1*psp->d_size+index_d2] == _FALSE_)
+            continue;
           sprintf(tmp,"dens[%d]-dens[%d]",index_d1+1,index_d2+1);
           class_fprintf_columntitle(*clfile,tmp,_TRUE_,colnum);
         }
@@ -1703,12 +1798,13 @@ int output_open_cl_file(
 }
 
 /**
- * This routine write one line with l and all \f$ C_l\f$'s for all types (TT, TE...)
+ * This routine fills one line with l and all \f$ C_l\f$'s for all types (TT, TE...),
+ * in the units and order of the output format
  *
  * @param pba        Input: pointer to background structure (needed for \f$ T_{cmb}\f$)
  * @param psp        Input: pointer to spectra structure
  * @param pop        Input: pointer to output structure
- * @param clfile  Input: file pointer
+ * @param line    Output: l followed by the ct_size values to be written
  * @param l       Input: multipole
  * @param cl      Input: \f$ C_l\f$'s for all types
  * @param ct_size Input: number of types
@@ -1719,64 +1815,50 @@ int output_one_line_of_cl(
                           struct background * pba,
                           struct spectra * psp,
                           struct output * pop,
-                          FILE * clfile,
+                          double * line,
                           double l,
                           double * cl, /* array with argument cl[index_ct] */
                           int ct_size
                           ) {
   int index_ct, index_ct_rest;
+  int index_column;
   double factor;
 
   factor = l*(l+1)/2./_PI_;
 
-  fprintf(clfile," ");
+  index_column = 0;
 
-  if (0==1){
-    class_fprintf_int(clfile, (int)l, _TRUE_);
-  }
-  else{
-    fprintf(clfile,"%4d ",(int)l);
-  }
+  line[index_column++] = l;
 
   if (pop->output_format == class_format) {
 
     for (index_ct=0; index_ct < ct_size; index_ct++) {
-      class_fprintf_double(clfile, factor*cl[index_ct], _TRUE_);
+      line[index_column++] = factor*cl[index_ct];
     }
-    fprintf(clfile,"\n");
   }
 
   if (pop->output_format == camb_format) {
-    class_fprintf_double(clfile, factor*pow(pba->T_cmb*1.e6,2)*cl[psp->index_ct_tt], psp->has_tt);
-    class_fprintf_double(clfile, factor*pow(pba->T_cmb*1.e6,2)*cl[psp->index_ct_ee], psp->has_ee);
-    class_fprintf_double(clfile, factor*pow(pba->T_cmb*1.e6,2)*cl[psp->index_ct_bb], psp->has_bb);
-    class_fprintf_double(clfile, factor*pow(pba->T_cmb*1.e6,2)*cl[psp->index_ct_te], psp->has_te);
-    class_fprintf_double(clfile, l*(l+1)*factor*cl[psp->index_ct_pp], psp->has_pp);
-    class_fprintf_double(clfile, sqrt(l*(l+1))*factor*pba->T_cmb*1.e6*cl[psp->index_ct_tp], psp->has_tp);
-    class_fprintf_double(clfile, sqrt(l*(l+1))*factor*pba->T_cmb*1.e6*cl[psp->index_ct_ep], psp->has_ep);
-    index_ct_rest = 0;
     if (psp->has_tt == _TRUE_)
-      index_ct_rest++;
+      line[index_column++] = factor*pow(pba->T_cmb*1.e6,2)*cl[psp->index_ct_tt];
     if (psp->has_ee == _TRUE_)
-      index_ct_rest++;
+      line[index_column++] = factor*pow(pba->T_cmb*1.e6,2)*cl[psp->index_ct_ee];
     if (psp->has_bb == _TRUE_)
-      index_ct_rest++;
+      line[index_column++] = factor*pow(pba->T_cmb*1.e6,2)*cl[psp->index_ct_bb];
     if (psp->has_te == _TRUE_)
-      index_ct_rest++;
+      line[index_column++] = factor*pow(pba->T_cmb*1.e6,2)*cl[psp->index_ct_te];
     if (psp->has_pp == _TRUE_)
-      index_ct_rest++;
+      line[index_column++] = l*(l+1)*factor*cl[psp->index_ct_pp];
     if (psp->has_tp == _TRUE_)
-      index_ct_rest++;
+      line[index_column++] = sqrt(l*(l+1))*factor*pba->T_cmb*1.e6*cl[psp->index_ct_tp];
     if (psp->has_ep == _TRUE_)
-      index_ct_rest++;
-    /* Now print the remaining (if any) entries:*/
+      line[index_column++] = sqrt(l*(l+1))*factor*pba->T_cmb*1.e6*cl[psp->index_ct_ep];
+    /* Now fill the remaining (if any) entries:*/
+    index_ct_rest = index_column-1;
     for (index_ct=index_ct_rest; index_ct < ct_size; index_ct++) {
-      class_fprintf_double(clfile, factor*cl[index_ct], _TRUE_);
+      line[index_column++] = factor*cl[index_ct];
     }
-
-    fprintf(clfile,"\n");
-
   }
+
   return _SUCCESS_;
 
 }
@@ -1826,25 +1908,135 @@ int output_open_pk_file(
 }
 
 /**
- * This routine writes one line with k and P(k)
+ * This routine writes all lines with k and P(k) in one file
  *
- * @param pkfile  Input: file pointer
- * @param one_k   Input: wavenumber
- * @param one_pk  Input: matter power spectrum
+ * @param pba        Input: pointer to background structure (needed for h)
+ * @param psp        Input: pointer to spectra structure
+ * @param pop        Input: pointer to output structure
+ * @param pkfile     Input: file pointer
+ * @param pk         Input: matter power spectrum pk[index_k * pk_stride]
+ * @param pk_stride  Input: distance between two values of k in pk
+ * @param pk_table   Input: workspace of size 2*psp->ln_k_size
  * @return the error status
  */
 
-int output_one_line_of_pk(
-                          FILE * pkfile,
-                          double one_k,
-                          double one_pk
-                          ) {
+int output_all_lines_of_pk(
+                           struct background * pba,
+                           struct spectra * psp,
+                           struct output * pop,
+                           FILE * pkfile,
+                           double * pk,
+                           int pk_stride,
+                           double * pk_table
+                           ) {
+
+  int index_k;
+
+  for (index_k=0; index_k<psp->ln_k_size; index_k++) {
+    pk_table[2*index_k] = exp(psp->ln_k[index_k])/pba->h;
+    pk_table[2*index_k+1] = pk[index_k*pk_stride]*pow(pba->h,3);
+  }
 
-  fprintf(pkfile," ");
-  class_fprintf_double(pkfile,one_k,_TRUE_);
-  class_fprintf_double(pkfile,one_pk,_TRUE_);
-  fprintf(pkfile,"\n");
+  class_call(output_print_table(pop,pkfile,pk_table,psp->ln_k_size,2,_FALSE_),
+             pop->error_message,
+             pop->error_message);
 
   return _SUCCESS_;
 
 }
+
+/**
+ * This routine writes a table of numbers in a file, one line per row,
+ * with the same format as class_fprintf_double() (preceded by the
+ * multipole in the format of output_cl() if requested).
+ *
+ * Formatting numbers into text is the most expensive part of writing
+ * large tables. The rows are split into blocks of _OUTPUT_BLOCK_ROWS_
+ * which are formatted in parallel into one buffer, and the whole
+ * table is then written with a single call to fwrite().
+ *
+ * @param pop                 Input: pointer to output structure
+ * @param out                 Input: file pointer
+ * @param data                Input: table data[index_row*number_of_columns+index_column]
+ * @param number_of_rows      Input: number of rows
+ * @param number_of_columns   Input: number of columns
+ * @param first_column_is_l   Input: if _TRUE_, the first column contains multipoles and is written as an integer
+ * @return the error status
+ */
+
+int output_print_table(
+                       struct output * pop,
+                       FILE * out,
+                       double * data,
+                       int number_of_rows,
+                       int number_of_columns,
+                       short first_column_is_l
+                       ) {
+
+  int number_of_blocks;
+  int index_block,index_row,index_column;
+  size_t line_size,block_size,size;
+  size_t * length;
+  char * buffer;
+  char * pos;
+
+  if ((number_of_rows <= 0) || (number_of_columns <= 0))
+    return _SUCCESS_;
+
+  /* upper bound on the number of characters per line (each number
+     takes exactly _COLUMNWIDTH_+1 characters as long as
+     _COLUMNWIDTH_ >= _OUTPUTPRECISION_+8, see common.h) */
+
+  line_size = 2 + number_of_columns*(_COLUMNWIDTH_+_OUTPUTPRECISION_+10);
+  block_size = _OUTPUT_BLOCK_ROWS_*line_size;
+  number_of_blocks = (number_of_rows+_OUTPUT_BLOCK_ROWS_-1)/_OUTPUT_BLOCK_ROWS_;
+
+  class_alloc(buffer,number_of_blocks*block_size*sizeof(char),pop->error_message);
+  class_alloc(length,number_of_blocks*sizeof(size_t),pop->error_message);
+
+#pragma omp parallel for schedule (static) private(index_block,index_row,index_column,pos)
+
+  for (index_block=0; index_block<number_of_blocks; index_block++) {
+
+    pos = buffer + index_block*block_size;
+
+    for (index_row = index_block*_OUTPUT_BLOCK_ROWS_;
+         index_row < MIN((index_block+1)*_OUTPUT_BLOCK_ROWS_,number_of_rows);
+         index_row++) {
+
+      *(pos++) = ' ';
+
+      index_column = 0;
+
+      if (first_column_is_l == _TRUE_) {
+        pos += sprintf(pos,"%4d ",(int)data[index_row*number_of_columns]);
+        index_column++;
+      }
+
+      for (; index_column<number_of_columns; index_column++) {
+        pos += sprintf(pos,"%*.*e ",_COLUMNWIDTH_,_OUTPUTPRECISION_,data[index_row*number_of_columns+index_column]);
+      }
+
+      *(pos++) = '\n';
+    }
+
+    length[index_block] = pos - (buffer + index_block*block_size);
+  }
+
+  /* pack the blocks and write them at once */
+
+  size = length[0];
+  for (index_block=1; index_block<number_of_blocks; index_block++) {
+    memmove(buffer+size,buffer+index_block*block_size,length[index_block]);
+    size += length[index_block];
+  }
+
+  class_test(fwrite(buffer,sizeof(char),size,out) != size,
+             pop->error_message,
+             "could not write %zu characters in output file",size);
+
+  free(buffer);
+  free(length);
+
+  return _SUCCESS_;
+}
@@ -434,7 +434,7 @@ int perturb_init(
         tspent=0.;
 #endif
 
-#pragma omp for schedule (dynamic)
+#pragma omp for schedule (dynamic,ppr->perturb_omp_chunk)
 
         /* integrating backwards is slightly more optimal for parallel runs */
         //for (index_k = 0; index_k < ppt->k_size; index_k++) {
@@ -547,7 +547,7 @@ int perturb_free(
 
         for (index_type = 0; index_type < ppt->tp_size[index_md]; index_type++) {
 
-          free(ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_type]);
+          buffer_pool_free(ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_type]);
 
         }
 
@@ -1378,9 +1378,9 @@ int perturb_timesampling_for_sources(
     for (index_ic = 0; index_ic < ppt->ic_size[index_md]; index_ic++) {
       for (index_type = 0; index_type < ppt->tp_size[index_md]; index_type++) {
 
-        class_alloc(ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_type],
-                    ppt->k_size[index_md] * ppt->tau_size * sizeof(double),
-                    ppt->error_message);
+        class_alloc_pooled(ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_type],
+                           ppt->k_size[index_md] * ppt->tau_size * sizeof(double),
+                           ppt->error_message);
 
       }
     }
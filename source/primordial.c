@@ -193,13 +193,9 @@ int primordial_init(
 
   /** - define local variables */
 
-  double k,k_min,k_max;
-  int index_md,index_ic1,index_ic2,index_ic1_ic2,index_k;
-  double pk,pk1,pk2;
+  double k_min,k_max;
+  int index_md,index_k;
   double dlnk,lnpk_pivot,lnpk_minus,lnpk_plus,lnpk_minusminus,lnpk_plusplus;
-  /* uncomment if you use optional test below
-     (for correlated isocurvature modes) */
-  //double cos_delta_k;
 
   /** - check that we really need to compute the primordial spectra */
 
@@ -272,83 +268,20 @@ int primordial_init(
 
     for (index_k = 0; index_k < ppm->lnk_size; index_k++) {
 
-      k=exp(ppm->lnk[index_k]);
-
-      for (index_md = 0; index_md < ppt->md_size; index_md++) {
-        for (index_ic1 = 0; index_ic1 < ppm->ic_size[index_md]; index_ic1++) {
-          for (index_ic2 = index_ic1; index_ic2 < ppm->ic_size[index_md]; index_ic2++) {
-
-            index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,ppm->ic_size[index_md]);
-
-            if (ppm->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
-
-              class_call(primordial_analytic_spectrum(ppm,
-                                                      index_md,
-                                                      index_ic1_ic2,
-                                                      k,
-                                                      &pk),
-                         ppm->error_message,
-                         ppm->error_message);
-
-              if (index_ic1 == index_ic2) {
-
-                /* diagonal coefficients: ln[P(k)] */
-
-                ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = log(pk);
-              }
-              else {
-
-                /* non-diagonal coefficients: cosDelta(k) = P(k)_12/sqrt[P(k)_1 P(k)_2] */
-
-                class_call(primordial_analytic_spectrum(ppm,
-                                                        index_md,
-                                                        index_symmetric_matrix(index_ic1,index_ic1,ppm->ic_size[index_md]),
-                                                        k,
-                                                        &pk1),
-                           ppm->error_message,
-                           ppm->error_message);
-
-                class_call(primordial_analytic_spectrum(ppm,
-                                                        index_md,
-                                                        index_symmetric_matrix(index_ic2,index_ic2,ppm->ic_size[index_md]),
-                                                        k,
-                                                        &pk2),
-                           ppm->error_message,
-                           ppm->error_message);
-
-                /* either return an error if correlation is too large... */
-                /*
-                  cos_delta_k = pk/sqrt(pk1*pk2);
-                  class_test_except((cos_delta_k < -1.) || (cos_delta_k > 1.),
-                  ppm->error_message,
-                  primordial_free(ppm),
-                  "correlation angle between IC's takes unphysical values");
-
-                  ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = cos_delta_k;
-                */
-
-                /* ... or enforce definite positive correlation matrix */
-
-                if (pk > sqrt(pk1*pk2))
-                  ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = 1.;
-                else if (pk < -sqrt(pk1*pk2))
-                  ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = -1.;
-                else
-                  ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = pk/sqrt(pk1*pk2);
-
-
-              }
-            }
-            else {
-
-              /* non-diagonal coefficients when ic's are uncorrelated */
+      class_call(primordial_analytic_spectrum_at_index(ppt,
+                                                       ppm,
+                                                       index_k),
+                 ppm->error_message,
+                 ppm->error_message);
 
-              ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = 0.;
-            }
-          }
-        }
-      }
     }
+
+    class_call(primordial_refine_features(ppt,
+                                          ppm,
+                                          ppr,
+                                          NULL),
+               ppm->error_message,
+               ppm->error_message);
   }
 
   /** - deal with case of inflation with given \f$V(\phi)\f$ or \f$H(\phi)\f$ */
@@ -676,6 +609,465 @@ int primordial_get_lnk_list(
 
 }
 
+/**
+ * This routine fills the table of primordial spectra at one value of
+ * ln(k), in the case of a simple analytic spectrum.
+ *
+ * @param ppt     Input: pointer to perturbation structure
+ * @param ppm     Input/output: pointer to primordial structure
+ * @param index_k Input: index of wavenumber in ppm->lnk
+ * @return the error status
+ */
+
+int primordial_analytic_spectrum_at_index(
+                                          struct perturbs   * ppt,
+                                          struct primordial * ppm,
+                                          int index_k
+                                          ) {
+
+  double k;
+  int index_md,index_ic1,index_ic2,index_ic1_ic2;
+  double pk,pk1,pk2;
+  /* uncomment if you use optional test below
+     (for correlated isocurvature modes) */
+  //double cos_delta_k;
+
+  k=exp(ppm->lnk[index_k]);
+
+  for (index_md = 0; index_md < ppt->md_size; index_md++) {
+    for (index_ic1 = 0; index_ic1 < ppm->ic_size[index_md]; index_ic1++) {
+      for (index_ic2 = index_ic1; index_ic2 < ppm->ic_size[index_md]; index_ic2++) {
+
+        index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,ppm->ic_size[index_md]);
+
+        if (ppm->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
+
+          class_call(primordial_analytic_spectrum(ppm,
+                                                  index_md,
+                                                  index_ic1_ic2,
+                                                  k,
+                                                  &pk),
+                     ppm->error_message,
+                     ppm->error_message);
+
+          if (index_ic1 == index_ic2) {
+
+            /* diagonal coefficients: ln[P(k)] */
+
+            ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = log(pk);
+          }
+          else {
+
+            /* non-diagonal coefficients: cosDelta(k) = P(k)_12/sqrt[P(k)_1 P(k)_2] */
+
+            class_call(primordial_analytic_spectrum(ppm,
+                                                    index_md,
+                                                    index_symmetric_matrix(index_ic1,index_ic1,ppm->ic_size[index_md]),
+                                                    k,
+                                                    &pk1),
+                       ppm->error_message,
+                       ppm->error_message);
+
+            class_call(primordial_analytic_spectrum(ppm,
+                                                    index_md,
+                                                    index_symmetric_matrix(index_ic2,index_ic2,ppm->ic_size[index_md]),
+                                                    k,
+                                                    &pk2),
+                       ppm->error_message,
+                       ppm->error_message);
+
+            /* either return an error if correlation is too large... */
+            /*
+              cos_delta_k = pk/sqrt(pk1*pk2);
+              class_test_except((cos_delta_k < -1.) || (cos_delta_k > 1.),
+              ppm->error_message,
+              primordial_free(ppm),
+              "correlation angle between IC's takes unphysical values");
+
+              ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = cos_delta_k;
+            */
+
+            /* ... or enforce definite positive correlation matrix */
+
+            if (pk > sqrt(pk1*pk2))
+              ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = 1.;
+            else if (pk < -sqrt(pk1*pk2))
+              ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = -1.;
+            else
+              ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = pk/sqrt(pk1*pk2);
+
+
+          }
+        }
+        else {
+
+          /* non-diagonal coefficients when ic's are uncorrelated */
+
+          ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic1_ic2] = 0.;
+        }
+      }
+    }
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * This routine finds the points of the table of primordial spectra
+ * which resolve some structure (e.g. oscillations): those for which
+ * the cubic interpolation between the two previous and two next
+ * points misses the tabulated value of any diagonal ln[P(k)] by more
+ * than tol. For a spectrum with a constant tilt and running, ln[P(k)]
+ * is a polynomial of degree two in ln(k), and no point is found.
+ *
+ * @param ppm        Input: pointer to primordial structure
+ * @param tol        Input: tolerance on ln[P(k)]
+ * @param is_feature Output: array of size ppm->lnk_size, set to _TRUE_ for these points (must be already allocated)
+ * @param number     Output: number of such points
+ * @return the error status
+ */
+
+int primordial_feature_points(
+                              struct primordial * ppm,
+                              double tol,
+                              short * is_feature,
+                              int * number
+                              ) {
+
+  int index_k,index_md,index_ic,index_ic_ic,j,m;
+  double x,w[4],lnpk;
+
+  *number = 0;
+
+  for (index_k=0; index_k<ppm->lnk_size; index_k++) {
+
+    is_feature[index_k] = _FALSE_;
+
+    if ((index_k < 2) || (index_k > ppm->lnk_size-3))
+      continue;
+
+    /* Lagrange weights of the points index_k-2, index_k-1, index_k+1, index_k+2 */
+    x = ppm->lnk[index_k];
+    for (j=0; j<4; j++) {
+      w[j] = 1.;
+      for (m=0; m<4; m++) {
+        if (m != j)
+          w[j] *= (x-ppm->lnk[index_k+m-2+(m>1)])/(ppm->lnk[index_k+j-2+(j>1)]-ppm->lnk[index_k+m-2+(m>1)]);
+      }
+    }
+
+    for (index_md=0; index_md<ppm->md_size; index_md++) {
+      for (index_ic=0; index_ic<ppm->ic_size[index_md]; index_ic++) {
+
+        index_ic_ic = index_symmetric_matrix(index_ic,index_ic,ppm->ic_size[index_md]);
+
+        if (ppm->is_non_zero[index_md][index_ic_ic] == _FALSE_)
+          continue;
+
+        lnpk = 0.;
+        for (j=0; j<4; j++)
+          lnpk += w[j]*ppm->lnpk[index_md][(index_k+j-2+(j>1))*ppm->ic_ic_size[index_md]+index_ic_ic];
+
+        if (fabs(lnpk-ppm->lnpk[index_md][index_k*ppm->ic_ic_size[index_md]+index_ic_ic]) > tol)
+          is_feature[index_k] = _TRUE_;
+      }
+    }
+
+    if (is_feature[index_k] == _TRUE_)
+      (*number)++;
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * This routine refines adaptively the table of primordial spectra
+ * around its features, such that the cost scales with the number of
+ * features instead of requiring a larger k_per_decade_primordial
+ * everywhere. The steps adjacent to the points found by
+ * primordial_feature_points() are bisected, the spectrum is computed
+ * at the new points, and this is repeated until no such point is left
+ * or until the steps have been bisected
+ * primordial_feature_max_refinement times.
+ *
+ * This requires to compute the spectrum at any k, which is possible
+ * for analytic spectra and for the numerical simulation of
+ * inflation. Features must be sampled by the initial table with at
+ * least a few points per period in order to be detected.
+ *
+ * @param ppt   Input: pointer to perturbation structure
+ * @param ppm   Input/output: pointer to primordial structure
+ * @param ppr   Input: pointer to precision structure
+ * @param y_ini Input: initial conditions for the inflation simulator (NULL for analytic spectra)
+ * @return the error status
+ */
+
+int primordial_refine_features(
+                               struct perturbs * ppt,
+                               struct primordial * ppm,
+                               struct precision * ppr,
+                               double * y_ini
+                               ) {
+
+  int level,index_k,index_k_new,index_md,number,new_size,n_new,index_new;
+  short * is_feature;
+  int * new_points;
+  double * lnk_new;
+  double ** lnpk_new;
+  double dlnk_min;
+  int abort;
+
+  if ((ppr->primordial_feature_tol <= 0.) || (ppm->lnk_size < 5))
+    return _SUCCESS_;
+
+  dlnk_min = log(10.)/ppr->k_per_decade_primordial/pow(2.,ppr->primordial_feature_max_refinement);
+
+  for (level=0; level<ppr->primordial_feature_max_refinement; level++) {
+
+    class_alloc(is_feature,ppm->lnk_size*sizeof(short),ppm->error_message);
+
+    class_call(primordial_feature_points(ppm,
+                                         ppr->primordial_feature_tol,
+                                         is_feature,
+                                         &number),
+               ppm->error_message,
+               ppm->error_message);
+
+    /** - count the steps adjacent to points with features, and not already at the finest step */
+
+    n_new = 0;
+    for (index_k=0; index_k<ppm->lnk_size-1; index_k++) {
+      if (((is_feature[index_k] == _TRUE_) || (is_feature[index_k+1] == _TRUE_)) &&
+          (ppm->lnk[index_k+1]-ppm->lnk[index_k] > 1.5*dlnk_min))
+        n_new++;
+    }
+
+    if (n_new == 0) {
+      free(is_feature);
+      break;
+    }
+
+    /** - build the new table, with the previous values and a new point in the middle of these steps */
+
+    new_size = ppm->lnk_size+n_new;
+
+    class_alloc(lnk_new,new_size*sizeof(double),ppm->error_message);
+    class_alloc(new_points,n_new*sizeof(int),ppm->error_message);
+    class_alloc(lnpk_new,ppm->md_size*sizeof(double*),ppm->error_message);
+    for (index_md=0; index_md<ppm->md_size; index_md++) {
+      class_alloc(lnpk_new[index_md],new_size*ppm->ic_ic_size[index_md]*sizeof(double),ppm->error_message);
+    }
+
+    index_k_new = 0;
+    index_new = 0;
+    for (index_k=0; index_k<ppm->lnk_size; index_k++) {
+
+      lnk_new[index_k_new] = ppm->lnk[index_k];
+      for (index_md=0; index_md<ppm->md_size; index_md++) {
+        memcpy(lnpk_new[index_md]+index_k_new*ppm->ic_ic_size[index_md],
+               ppm->lnpk[index_md]+index_k*ppm->ic_ic_size[index_md],
+               ppm->ic_ic_size[index_md]*sizeof(double));
+      }
+      index_k_new++;
+
+      if ((index_k < ppm->lnk_size-1) &&
+          ((is_feature[index_k] == _TRUE_) || (is_feature[index_k+1] == _TRUE_)) &&
+          (ppm->lnk[index_k+1]-ppm->lnk[index_k] > 1.5*dlnk_min)) {
+        lnk_new[index_k_new] = 0.5*(ppm->lnk[index_k]+ppm->lnk[index_k+1]);
+        new_points[index_new++] = index_k_new;
+        index_k_new++;
+      }
+    }
+
+    free(is_feature);
+    free(ppm->lnk);
+    ppm->lnk = lnk_new;
+    for (index_md=0; index_md<ppm->md_size; index_md++) {
+      free(ppm->lnpk[index_md]);
+      ppm->lnpk[index_md] = lnpk_new[index_md];
+      class_realloc(ppm->ddlnpk[index_md],
+                    ppm->ddlnpk[index_md],
+                    new_size*ppm->ic_ic_size[index_md]*sizeof(double),
+                    ppm->error_message);
+    }
+    free(lnpk_new);
+    ppm->lnk_size = new_size;
+
+    /** - compute the spectrum at the new points */
+
+    abort = _FALSE_;
+
+#pragma omp parallel for schedule (dynamic) shared(ppt,ppm,ppr,y_ini,new_points,n_new,abort) private(index_new)
+    for (index_new=0; index_new<n_new; index_new++) {
+
+      if (ppm->primordial_spec_type == analytic_Pk) {
+        class_call_parallel(primordial_analytic_spectrum_at_index(ppt,ppm,new_points[index_new]),
+                            ppm->error_message,
+                            ppm->error_message);
+      }
+      else {
+        class_call_parallel(primordial_inflation_one_wavenumber(ppt,ppm,ppr,y_ini,new_points[index_new]),
+                            ppm->error_message,
+                            ppm->error_message);
+      }
+    }
+
+    free(new_points);
+
+    if (abort == _TRUE_) return _FAILURE_;
+
+    if (ppm->primordial_verbose > 1)
+      printf(" -> refinement %d around %d features: %d new values of k\n",level+1,number,n_new);
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * This routine checks whether a list of wavenumbers, used by another
+ * module for integrals over the primordial spectrum, resolves its
+ * features. For each step of the list containing points of the
+ * primordial table, it finds the number of equal sub-steps (a power of
+ * two, at most 2 to the power max_refinement) for which cubic
+ * interpolation in ln(k) between the nearest four values predicts the
+ * diagonal ln[P(k)] at these points within tol. This number is one
+ * for smooth spectra.
+ *
+ * @param ppm            Input: pointer to primordial structure
+ * @param k              Input: list of wavenumbers (increasing)
+ * @param k_size         Input: size of this list
+ * @param tol            Input: tolerance on ln[P(k)]
+ * @param max_refinement Input: maximum number of bisections of each step
+ * @param sub_steps      Output: number of sub-steps for each of the k_size-1 steps (must be already allocated)
+ * @return the error status
+ */
+
+int primordial_k_sampling(
+                          struct primordial * ppm,
+                          double * k,
+                          int k_size,
+                          double tol,
+                          int max_refinement,
+                          int * sub_steps
+                          ) {
+
+  int index_k,index_table,index_table_start,index_md,index_ic,index_ic_ic;
+  int n,n_max,x_size,index_x,index_x_start,j,m;
+  int ic_ic_size_max=0;
+  double * x;
+  double ** lnpk;
+  double h,w,lnpk_interp;
+  short converged;
+
+  for (index_k=0; index_k<k_size-1; index_k++)
+    sub_steps[index_k] = 1;
+
+  if ((tol <= 0.) || (k_size < 2))
+    return _SUCCESS_;
+
+  n_max = 1 << max_refinement;
+
+  for (index_md=0; index_md<ppm->md_size; index_md++)
+    ic_ic_size_max = MAX(ic_ic_size_max,ppm->ic_ic_size[index_md]);
+
+  /* the values of ln(k) at which P(k) is evaluated: one step before,
+     the sub-steps, one step after */
+  class_alloc(x,(n_max+3)*sizeof(double),ppm->error_message);
+  class_alloc(lnpk,(n_max+3)*sizeof(double*),ppm->error_message);
+  for (index_x=0; index_x<n_max+3; index_x++)
+    class_alloc(lnpk[index_x],ppm->md_size*ic_ic_size_max*sizeof(double),ppm->error_message);
+
+  index_table_start = 0;
+
+  for (index_k=0; index_k<k_size-1; index_k++) {
+
+    /** - find the points of the table inside this step */
+
+    while ((index_table_start < ppm->lnk_size) && (ppm->lnk[index_table_start] <= log(k[index_k])))
+      index_table_start++;
+
+    if ((index_table_start == ppm->lnk_size) || (ppm->lnk[index_table_start] >= log(k[index_k+1])))
+      continue;
+
+    /** - increase the number of sub-steps until they predict these points */
+
+    h = k[index_k+1]-k[index_k];
+
+    for (n=1; n<=n_max; n*=2) {
+
+      x_size = 0;
+      if (index_k > 0)
+        x[x_size++] = log(k[index_k-1]);
+      for (j=0; j<=n; j++)
+        x[x_size++] = log(k[index_k]+j*h/n);
+      if (index_k < k_size-2)
+        x[x_size++] = log(k[index_k+2]);
+
+      for (index_x=0; index_x<x_size; index_x++) {
+        for (index_md=0; index_md<ppm->md_size; index_md++) {
+          class_call(primordial_spectrum_at_k(ppm,
+                                              index_md,
+                                              logarithmic,
+                                              MAX(ppm->lnk[0],MIN(ppm->lnk[ppm->lnk_size-1],x[index_x])),
+                                              lnpk[index_x]+index_md*ic_ic_size_max),
+                     ppm->error_message,
+                     ppm->error_message);
+        }
+      }
+
+      converged = _TRUE_;
+
+      for (index_table=index_table_start;
+           (index_table < ppm->lnk_size) && (ppm->lnk[index_table] < log(k[index_k+1])) && (converged == _TRUE_);
+           index_table++) {
+
+        /* four nearest values: start one point before the sub-step containing this point */
+        for (index_x=1; (index_x < x_size-1) && (x[index_x] <= ppm->lnk[index_table]); index_x++);
+        index_x_start = MAX(0,MIN(x_size-4,index_x-2));
+
+        for (index_md=0; index_md<ppm->md_size; index_md++) {
+          for (index_ic=0; index_ic<ppm->ic_size[index_md]; index_ic++) {
+
+            index_ic_ic = index_symmetric_matrix(index_ic,index_ic,ppm->ic_size[index_md]);
+
+            if (ppm->is_non_zero[index_md][index_ic_ic] == _FALSE_)
+              continue;
+
+            lnpk_interp = 0.;
+            for (j=index_x_start; j<MIN(x_size,index_x_start+4); j++) {
+              w = 1.;
+              for (m=index_x_start; m<MIN(x_size,index_x_start+4); m++) {
+                if (m != j)
+                  w *= (ppm->lnk[index_table]-x[m])/(x[j]-x[m]);
+              }
+              lnpk_interp += w*lnpk[j][index_md*ic_ic_size_max+index_ic_ic];
+            }
+
+            if (fabs(lnpk_interp-ppm->lnpk[index_md][index_table*ppm->ic_ic_size[index_md]+index_ic_ic]) > tol)
+              converged = _FALSE_;
+          }
+        }
+      }
+
+      if (converged == _TRUE_)
+        break;
+    }
+
+    sub_steps[index_k] = MIN(n,n_max);
+  }
+
+  for (index_x=0; index_x<n_max+3; index_x++)
+    free(lnpk[index_x]);
+  free(lnpk);
+  free(x);
+
+  return _SUCCESS_;
+
+}
+
 /**
  * This routine interprets and stores in a condensed form the input parameters
  * in the case of a simple analytic spectra with amplitudes, tilts, runnings,
@@ -1429,6 +1821,14 @@ int primordial_inflation_solve_inflation(
                       ppm->error_message,
                       ppm->error_message,
                       free(y);free(y_ini);free(dy));
+
+    class_call_except(primordial_refine_features(ppt,
+                                                 ppm,
+                                                 ppr,
+                                                 y_ini),
+                      ppm->error_message,
+                      ppm->error_message,
+                      free(y);free(y_ini);free(dy));
   }
   else if (ppm->behavior == analytical) {
 
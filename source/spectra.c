@@ -18,6 +18,31 @@
 
 #include "spectra.h"
 
+/* default workspace of each thread, used by the interpolation
+   functions when they are not passed a workspace by the caller. They
+   are allocated on the heap and registered in a list, such that
+   spectra_workspace_default_free_all() can free those of all threads;
+   a thread whose generation differs from spectra_default_generation
+   holds a workspace which was freed in this way */
+struct spectra_default_workspace {
+  struct spectra_workspace workspace;
+  struct spectra_default_workspace * next;
+};
+
+static struct spectra_default_workspace * spectra_default_workspaces = NULL;
+static int spectra_default_generation = 0;
+
+#ifdef __GNUC__
+static __thread struct spectra_default_workspace * spectra_thread_workspace = NULL;
+static __thread int spectra_thread_generation = 0;
+#else
+static _Thread_local struct spectra_default_workspace * spectra_thread_workspace = NULL;
+static _Thread_local int spectra_thread_generation = 0;
+#endif
+
+/* last number given to a computation of the spectra tables (see workspace_stamp) */
+static int spectra_last_stamp = 0;
+
 
 
 int spectra_bandpower(struct spectra * psp,
@@ -305,6 +330,71 @@ int spectra_cl_at_l(
 
 }
 
+/**
+ * Conversion of a redshift into the logarithm of conformal time, within
+ * the range of the tables of P(k,tau) and T_i(k,tau).
+ *
+ * Small excursions outside of this range caused by rounding errors are
+ * brought back to the closest edge of the table.
+ *
+ * @param pba    Input: pointer to background structure (used for converting z into tau)
+ * @param psp    Input: pointer to spectra structure (containing the table ln_tau)
+ * @param z      Input: redshift
+ * @param ln_tau Output: logarithm of conformal time
+ * @return the error status
+ */
+
+int spectra_ln_tau_at_z(
+                        struct background * pba,
+                        struct spectra * psp,
+                        double z,
+                        double * ln_tau
+                        ) {
+
+  double tau;
+  double small_deviation = 1e-10;
+
+  /** - if only values at tau=tau_today are stored, only z=0 is valid */
+
+  if (psp->ln_tau_size == 1) {
+
+    class_test(z != 0.,
+               psp->error_message,
+               "asked z=%e but only P(k,z=0) has been tabulated",z);
+
+    *ln_tau = psp->ln_tau[0];
+    return _SUCCESS_;
+  }
+
+  class_call(background_tau_of_z(pba,z,&tau),
+             pba->error_message,
+             psp->error_message);
+
+  class_test(tau <= 0.,
+             psp->error_message,
+             "negative or null value of conformal time: cannot interpolate");
+
+  *ln_tau = log(tau);
+
+  class_test(*ln_tau<psp->ln_tau[0]-small_deviation,
+             psp->error_message,
+             "requested z was not inside of tau tabulation range (Requested %.10e, Min %.10e) ",*ln_tau,psp->ln_tau[0]-small_deviation);
+  if(*ln_tau<psp->ln_tau[0]){
+    //Case of small deviation caused by rounding
+    *ln_tau = psp->ln_tau[0];
+  }
+  class_test(*ln_tau>psp->ln_tau[psp->ln_tau_size-1]+small_deviation,
+             psp->error_message,
+             "requested z was not inside of tau tabulation range (Requested %.10e, Max %.10e) ",*ln_tau,psp->ln_tau[psp->ln_tau_size-1]+small_deviation);
+
+  if(*ln_tau>psp->ln_tau[psp->ln_tau_size-1]){
+    //Case of small deviation caused by rounding
+    *ln_tau = psp->ln_tau[psp->ln_tau_size-1];
+  }
+
+  return _SUCCESS_;
+}
+
 /**
  * Matter power spectrum for arbitrary redshift and for all initial conditions.
  *
@@ -363,39 +453,17 @@ int spectra_pk_at_z(
   int index_md;
   int last_index;
   int index_k;
-  double tau,ln_tau;
+  double ln_tau;
   int index_ic1,index_ic2,index_ic1_ic2;
 
   index_md = psp->index_md_scalars;
 
   /** - first step: convert z into \f$\ln{\tau}\f$ */
 
-  class_call(background_tau_of_z(pba,z,&tau),
-             pba->error_message,
-             psp->error_message);
-
-  class_test(tau <= 0.,
-             psp->error_message,
-             "negative or null value of conformal time: cannot interpolate");
-
-  ln_tau = log(tau);
-
-  double small_deviation = 1e-10;
-  class_test(ln_tau<psp->ln_tau[0]-small_deviation,
-             psp->error_message,
-             "requested z was not inside of tau tabulation range (Requested %.10e, Min %.10e) ",ln_tau,psp->ln_tau[0]-small_deviation);
-  if(ln_tau<psp->ln_tau[0]){
-    //Case of small deviation caused by rounding
-    ln_tau = psp->ln_tau[0];
-  }
-  class_test(ln_tau>psp->ln_tau[psp->ln_tau_size-1]+small_deviation,
+  class_call(spectra_ln_tau_at_z(pba,psp,z,&ln_tau),
              psp->error_message,
-             "requested z was not inside of tau tabulation range (Requested %.10e, Max %.10e) ",ln_tau,psp->ln_tau[psp->ln_tau_size-1]+small_deviation);
+             psp->error_message);
 
-  if(ln_tau>psp->ln_tau[psp->ln_tau_size-1]){
-    //Case of small deviation caused by rounding
-    ln_tau = psp->ln_tau[psp->ln_tau_size-1];
-  }
   /** - second step: for both modes (linear or logarithmic), store the spectrum in logarithmic format in the output array(s) */
 
   /** - --> (a) if only values at tau=tau_today are stored and we want \f$ P(k,z=0)\f$, no need to interpolate */
@@ -602,7 +670,7 @@ int spectra_pk_at_z(
  * Matter power spectrum for arbitrary wavenumber, redshift and initial condition.
  *
  * This routine evaluates the matter power spectrum at a given value of k and z by
- * interpolating in a table of all P(k)'s computed at this z by spectra_pk_at_z() (when kmin <= k <= kmax),
+ * interpolating in the bicubic spline of \f$\ln{P(k,\tau)}\f$ built by spectra_pk() (when kmin <= k <= kmax),
  * or eventually by using directly the primordial spectrum (when 0 <= k < kmin):
  * the latter case is an approximation, valid when kmin << comoving Hubble scale today.
  * Returns zero when k=0. Returns an error when k<0 or k > kmax.
@@ -636,330 +704,255 @@ int spectra_pk_at_k_and_z(
                           double * pk_cb_ic   /* same as pk_ic  for baryon+CDM part only */
                           ) {
 
+  class_call(spectra_pk_at_k_and_z_with_workspace(pba,ppm,psp,NULL,k,z,pk_tot,pk_ic,pk_cb_tot,pk_cb_ic),
+             psp->error_message,
+             psp->error_message);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Same as spectra_pk_at_k_and_z(), with a workspace provided by the
+ * caller (or NULL for the default workspace of the calling thread),
+ * so that no memory is allocated.
+ *
+ * @param pba        Input: pointer to background structure (used for converting z into tau)
+ * @param ppm        Input: pointer to primordial structure (used only in the case 0 < k < kmin)
+ * @param psp        Input: pointer to spectra structure (containing pre-computed table)
+ * @param psw        Input: pointer to workspace (or NULL)
+ * @param k          Input: wavenumber in 1/Mpc
+ * @param z          Input: redshift
+ * @param pk_tot     Output: total matter power spectrum P(k) in \f$ Mpc^3 \f$
+ * @param pk_ic      Output: for each pair of initial conditions, matter power spectra P(k) in \f$ Mpc^3\f$
+ * @param pk_cb_tot  Output: b+CDM power spectrum P(k) in \f$ Mpc^3 \f$
+ * @param pk_cb_ic   Output: for each pair of initial conditions, b+CDM power spectra P(k) in \f$ Mpc^3\f$
+ * @return the error status
+ */
+
+int spectra_pk_at_k_and_z_with_workspace(
+                                         struct background * pba,
+                                         struct primordial * ppm,
+                                         struct spectra * psp,
+                                         struct spectra_workspace * psw,
+                                         double k,
+                                         double z,
+                                         double * pk_tot,
+                                         double * pk_ic,
+                                         double * pk_cb_tot,
+                                         double * pk_cb_ic
+                                         ) {
+
   /** Summary: */
 
   /** - define local variables */
 
   int index_md;
-  int index_k;
-  int last_index;
   int index_ic1,index_ic2,index_ic1_ic2;
-
-  double * spectrum_at_z = NULL;
-  double * spectrum_at_z_ic = NULL;
-  double * spline;
-  double * pk_primordial_k = NULL;
+  double ln_tau;
+  double ln_k;
   double kmin;
-  double * pk_primordial_kmin = NULL;
-
-  double * spectrum_cb_at_z = NULL;
-  double * spectrum_cb_at_z_ic = NULL;
-  double * spline_cb = NULL;
+  double * pk_primordial_k;
+  double * pk_primordial_kmin;
 
   index_md = psp->index_md_scalars;
 
-  /** - first step: check that k is in valid range [0:kmax] (the test for z will be done when calling spectra_pk_at_z()) */
+  /** - first step: check that k is in valid range [0:kmax] */
 
   class_test((k < 0.) || (k > exp(psp->ln_k[psp->ln_k_size-1])),
              psp->error_message,
              "k=%e out of bounds [%e:%e]",k,0.,exp(psp->ln_k[psp->ln_k_size-1]));
 
-  /** - deal with case 0 <= k < kmin */
-
-  if (k < exp(psp->ln_k[0])) {
+  /** - deal with case k=0: then P(k)=0 */
 
-    /** - --> (a) subcase k=0: then P(k)=0 */
-
-    if (k == 0.) {
-      if (psp->ic_size[index_md] == 1) {
-        *pk_tot=0.;
-        if (pba->has_ncdm) *pk_cb_tot=0.;
-      }
-      else {
-        for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
-          pk_ic[index_ic1_ic2] = 0.;
-          if (pba->has_ncdm) pk_cb_ic[index_ic1_ic2] = 0.;
-        }
+  if (k == 0.) {
+    *pk_tot=0.;
+    if (pba->has_ncdm) *pk_cb_tot=0.;
+    if (psp->ic_size[index_md] > 1) {
+      for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
+        pk_ic[index_ic1_ic2] = 0.;
+        if (pba->has_ncdm) pk_cb_ic[index_ic1_ic2] = 0.;
       }
     }
+    return _SUCCESS_;
+  }
 
-    /** - --> (b) subcase 0<k<kmin: in this case we know that on super-Hubble scales:
-     *          P(k) = [some number] * k  * P_primordial(k)
-     *          so
-     *          P(k) = P(kmin) * (k P_primordial(k)) / (kmin P_primordial(kmin))
-     *          (note that the result is accurate only if kmin is such that [a0 kmin] << H0)
-     */
-
-    else {
+  /** - convert z into \f$\ln{\tau}\f$ */
 
-      /* compute P(k,z) which contains P(kmin,z)*/
-      class_alloc(spectrum_at_z,
-                  psp->ln_k_size*sizeof(double),
-                  psp->error_message);
-      class_alloc(spectrum_cb_at_z,
-                  psp->ln_k_size*sizeof(double),
-                  psp->error_message);
-      if (psp->ic_size[index_md] > 1) {
-        class_alloc(spectrum_at_z_ic,
-                    sizeof(double)*psp->ic_ic_size[index_md]*psp->ln_k_size,
-                    psp->error_message);
+  class_call(spectra_ln_tau_at_z(pba,psp,z,&ln_tau),
+             psp->error_message,
+             psp->error_message);
 
-        class_alloc(spectrum_cb_at_z_ic,
-                    sizeof(double)*psp->ic_ic_size[index_md]*psp->ln_k_size,
-                    psp->error_message);
+  /** - interpolate \f$\ln{P(k,\tau)}\f$ in the bicubic spline table
+      (at kmin when 0 < k < kmin, see below) */
 
-      }
-      class_call(spectra_pk_at_z(pba,
-                                 psp,
-                                 linear,
-                                 z,
-                                 spectrum_at_z,
-                                 spectrum_at_z_ic,
-                                 spectrum_cb_at_z,
-                                 spectrum_cb_at_z_ic),
-                 psp->error_message,
-                 psp->error_message);
+  kmin = exp(psp->ln_k[0]);
 
-      /* compute P_primordial(k) */
-      class_alloc(pk_primordial_k,
-                  sizeof(double)*psp->ic_ic_size[index_md],
-                  psp->error_message);
-      class_call(primordial_spectrum_at_k(ppm,
-                                          index_md,
-                                          linear,
-                                          k,
-                                          pk_primordial_k),
-                 ppm->error_message,psp->error_message);
-
-      /* compute P_primordial(kmin) */
-      kmin = exp(psp->ln_k[0]);
-      class_alloc(pk_primordial_kmin,
-                  sizeof(double)*psp->ic_ic_size[index_md],
-                  psp->error_message);
-      class_call(primordial_spectrum_at_k(ppm,
-                                          index_md,
-                                          linear,
-                                          kmin,
-                                          pk_primordial_kmin),
-                 ppm->error_message,
-                 psp->error_message);
+  if (k < kmin) {
+    ln_k = psp->ln_k[0];
+  }
+  else {
+    ln_k = MIN(log(k),psp->ln_k[psp->ln_k_size-1]); // prevent rounding error leading to ln(k) being bigger than maximum value
+  }
 
-      /* apply above analytic approximation for P(k) */
-      index_k=0;
-      if (psp->ic_size[index_md] == 1) {
-        index_ic1_ic2 = 0;
-        *pk_tot = spectrum_at_z[index_k]
-          *k*pk_primordial_k[index_ic1_ic2]
-          /kmin/pk_primordial_kmin[index_ic1_ic2];
-        if (pba->has_ncdm){
-          *pk_cb_tot = spectrum_cb_at_z[index_k]
-            *k*pk_primordial_k[index_ic1_ic2]
-            /kmin/pk_primordial_kmin[index_ic1_ic2];
-        }
-      }
-      else {
-      	for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
-          pk_ic[index_ic1_ic2] = spectrum_at_z_ic[index_ic1_ic2]
-            *k*pk_primordial_k[index_ic1_ic2]
-            /kmin/pk_primordial_kmin[index_ic1_ic2];
-          if (pba->has_ncdm){
-            pk_cb_ic[index_ic1_ic2] = spectrum_cb_at_z_ic[index_ic1_ic2]
-              *k*pk_primordial_k[index_ic1_ic2]
-              /kmin/pk_primordial_kmin[index_ic1_ic2];
-          }
-        }
-      }
+  if (psp->ic_size[index_md] == 1) {
+
+    class_call(spectra_pk_bicubic_at_k_and_tau(psp,
+                                               psp->ln_tau,
+                                               psp->ln_tau_size,
+                                               psp->ln_pk,
+                                               psp->ddln_pk,
+                                               psp->ddkln_pk,
+                                               psp->ddkddln_pk,
+                                               1,
+                                               ln_k,
+                                               ln_tau,
+                                               pk_tot),
+               psp->error_message,
+               psp->error_message);
 
-      free(spectrum_at_z);
-      free(spectrum_cb_at_z);
-      if (psp->ic_size[index_md] > 1){
-        free(spectrum_at_z_ic);
-        free(spectrum_cb_at_z_ic);
-      }
-      free(pk_primordial_k);
-      free(pk_primordial_kmin);
+    *pk_tot = exp(*pk_tot);
+
+    if (pba->has_ncdm) {
+
+      class_call(spectra_pk_bicubic_at_k_and_tau(psp,
+                                                 psp->ln_tau,
+                                                 psp->ln_tau_size,
+                                                 psp->ln_pk_cb,
+                                                 psp->ddln_pk_cb,
+                                                 psp->ddkln_pk_cb,
+                                                 psp->ddkddln_pk_cb,
+                                                 1,
+                                                 ln_k,
+                                                 ln_tau,
+                                                 pk_cb_tot),
+                 psp->error_message,
+                 psp->error_message);
 
+      *pk_cb_tot = exp(*pk_cb_tot);
     }
   }
-
-  /** - deal with case kmin <= k <= kmax */
-
   else {
 
-    /* compute P(k,z) (in logarithmic format for more accurate interpolation) */
-    class_alloc(spectrum_at_z,
-                psp->ln_k_size*sizeof(double),
-                psp->error_message);
-    class_alloc(spectrum_cb_at_z,
-                psp->ln_k_size*sizeof(double),
-                psp->error_message);
-    if (psp->ic_size[index_md] > 1) {
-      class_alloc(spectrum_at_z_ic,
-                  sizeof(double)*psp->ic_ic_size[index_md]*psp->ln_k_size,
-                  psp->error_message);
-      class_alloc(spectrum_cb_at_z_ic,
-                  sizeof(double)*psp->ic_ic_size[index_md]*psp->ln_k_size,
-                  psp->error_message);
-    }
-    class_call(spectra_pk_at_z(pba,
-                               psp,
-                               logarithmic,
-                               z,
-                               spectrum_at_z,
-                               spectrum_at_z_ic,
-                               spectrum_cb_at_z,
-                               spectrum_cb_at_z_ic),
+    class_call(spectra_pk_bicubic_at_k_and_tau(psp,
+                                               psp->ln_tau,
+                                               psp->ln_tau_size,
+                                               psp->ln_pk,
+                                               psp->ddln_pk,
+                                               psp->ddkln_pk,
+                                               psp->ddkddln_pk,
+                                               psp->ic_ic_size[index_md],
+                                               ln_k,
+                                               ln_tau,
+                                               pk_ic),
                psp->error_message,
                psp->error_message);
 
-    /* get its second derivatives with spline, then interpolate, then convert to linear format */
-
-    class_alloc(spline,
-                sizeof(double)*psp->ic_ic_size[index_md]*psp->ln_k_size,
-                psp->error_message);
-
-    if(pba->has_ncdm)
-      class_alloc(spline_cb,
-                  sizeof(double)*psp->ic_ic_size[index_md]*psp->ln_k_size,
-                  psp->error_message);
-
-    if (psp->ic_size[index_md] == 1) {
-
-      class_call(array_spline_table_lines(psp->ln_k,
-                                          psp->ln_k_size,
-                                          spectrum_at_z,
-                                          1,
-                                          spline,
-                                          _SPLINE_NATURAL_,
-                                          psp->error_message),
-                 psp->error_message,
-                 psp->error_message);
-
-      class_call(array_interpolate_spline(psp->ln_k,
-                                          psp->ln_k_size,
-                                          spectrum_at_z,
-                                          spline,
-                                          1,
-                                          log(k),
-                                          &last_index,
-                                          pk_tot,
-                                          1,
-                                          psp->error_message),
+    if (pba->has_ncdm) {
+
+      class_call(spectra_pk_bicubic_at_k_and_tau(psp,
+                                                 psp->ln_tau,
+                                                 psp->ln_tau_size,
+                                                 psp->ln_pk_cb,
+                                                 psp->ddln_pk_cb,
+                                                 psp->ddkln_pk_cb,
+                                                 psp->ddkddln_pk_cb,
+                                                 psp->ic_ic_size[index_md],
+                                                 ln_k,
+                                                 ln_tau,
+                                                 pk_cb_ic),
                  psp->error_message,
                  psp->error_message);
+    }
 
-      *pk_tot = exp(*pk_tot);
-
-      if(pba->has_ncdm){
-        class_call(array_spline_table_lines(psp->ln_k,
-                                            psp->ln_k_size,
-                                            spectrum_cb_at_z,
-                                            1,
-                                            spline_cb,
-                                            _SPLINE_NATURAL_,
-                                            psp->error_message),
-                   psp->error_message,
-                   psp->error_message);
-
-        class_call(array_interpolate_spline(psp->ln_k,
-                                            psp->ln_k_size,
-                                            spectrum_cb_at_z,
-                                            spline_cb,
-                                            1,
-                                            log(k),
-                                            &last_index,
-                                            pk_cb_tot,
-                                            1,
-                                            psp->error_message),
-                   psp->error_message,
-                   psp->error_message);
+    /* convert diagonal elements to linear format, and off-diagonal
+       elements from cross-correlation angles to cross-spectra */
 
-        *pk_cb_tot = exp(*pk_cb_tot);
+    for (index_ic1 = 0; index_ic1 < psp->ic_size[index_md]; index_ic1++) {
+      index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic1,psp->ic_size[index_md]);
+      pk_ic[index_ic1_ic2] = exp(pk_ic[index_ic1_ic2]);
+      if(pba->has_ncdm) pk_cb_ic[index_ic1_ic2] = exp(pk_cb_ic[index_ic1_ic2]);
+    }
+    for (index_ic1 = 0; index_ic1 < psp->ic_size[index_md]; index_ic1++) {
+      for (index_ic2 = index_ic1+1; index_ic2 < psp->ic_size[index_md]; index_ic2++) {
+        index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,psp->ic_size[index_md]);
+        if (psp->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
+          pk_ic[index_ic1_ic2] = pk_ic[index_ic1_ic2]*
+            sqrt(pk_ic[index_symmetric_matrix(index_ic1,index_ic1,psp->ic_size[index_md])]*
+                 pk_ic[index_symmetric_matrix(index_ic2,index_ic2,psp->ic_size[index_md])]);
+          if(pba->has_ncdm){
+            pk_cb_ic[index_ic1_ic2] = pk_cb_ic[index_ic1_ic2]*
+              sqrt(pk_cb_ic[index_symmetric_matrix(index_ic1,index_ic1,psp->ic_size[index_md])]*
+                   pk_cb_ic[index_symmetric_matrix(index_ic2,index_ic2,psp->ic_size[index_md])]);
+          }
+        }
+        else {
+          pk_ic[index_ic1_ic2] = 0.;
+          if (pba->has_ncdm) pk_cb_ic[index_ic1_ic2] = 0.;
+        }
       }
-
     }
-    else {
+  }
 
-      class_call(array_spline_table_lines(psp->ln_k,
-                                          psp->ln_k_size,
-                                          spectrum_at_z_ic,
-                                          psp->ic_ic_size[index_md],
-                                          spline,
-                                          _SPLINE_NATURAL_,
-                                          psp->error_message),
+  /** - deal with case 0 < k < kmin: in this case we know that on super-Hubble scales:
+   *          P(k) = [some number] * k  * P_primordial(k)
+   *          so
+   *          P(k) = P(kmin) * (k P_primordial(k)) / (kmin P_primordial(kmin))
+   *          (note that the result is accurate only if kmin is such that [a0 kmin] << H0)
+   */
+
+  if (k < kmin) {
+
+    /* get scratch space for primordial spectra */
+    if (psw == NULL) {
+      class_call(spectra_workspace_default(psp,&psw),
                  psp->error_message,
                  psp->error_message);
-
-      class_call(array_interpolate_spline(psp->ln_k,
-                                          psp->ln_k_size,
-                                          spectrum_at_z_ic,
-                                          spline,
-                                          psp->ic_ic_size[index_md],
-                                          log(k),
-                                          &last_index,
-                                          pk_ic,
-                                          psp->ic_ic_size[index_md],
-                                          psp->error_message),
+    }
+    else {
+      class_call(spectra_workspace_reserve(psp,psw),
                  psp->error_message,
                  psp->error_message);
+    }
+    pk_primordial_k = psw->pk_primordial_k;
+    pk_primordial_kmin = psw->pk_primordial_kmin;
+
+    /* compute P_primordial(k) */
+    class_call(primordial_spectrum_at_k(ppm,
+                                        index_md,
+                                        linear,
+                                        k,
+                                        pk_primordial_k),
+               ppm->error_message,psp->error_message);
+
+    /* compute P_primordial(kmin) */
+    class_call(primordial_spectrum_at_k(ppm,
+                                        index_md,
+                                        linear,
+                                        kmin,
+                                        pk_primordial_kmin),
+               ppm->error_message,
+               psp->error_message);
 
-      if(pba->has_ncdm){
-        class_call(array_spline_table_lines(psp->ln_k,
-                                            psp->ln_k_size,
-                                            spectrum_cb_at_z_ic,
-                                            psp->ic_ic_size[index_md],
-                                            spline_cb,
-                                            _SPLINE_NATURAL_,
-                                            psp->error_message),
-                   psp->error_message,
-                   psp->error_message);
-
-        class_call(array_interpolate_spline(psp->ln_k,
-                                            psp->ln_k_size,
-                                            spectrum_cb_at_z_ic,
-                                            spline_cb,
-                                            psp->ic_ic_size[index_md],
-                                            log(k),
-                                            &last_index,
-                                            pk_cb_ic,
-                                            psp->ic_ic_size[index_md],
-                                            psp->error_message),
-                   psp->error_message,
-                   psp->error_message);
-      }
-
-      for (index_ic1 = 0; index_ic1 < psp->ic_size[index_md]; index_ic1++) {
-        index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic1,psp->ic_size[index_md]);
-        pk_ic[index_ic1_ic2] = exp(pk_ic[index_ic1_ic2]);
-        if(pba->has_ncdm) pk_cb_ic[index_ic1_ic2] = exp(pk_cb_ic[index_ic1_ic2]);
+    /* apply above analytic approximation for P(k) */
+    if (psp->ic_size[index_md] == 1) {
+      index_ic1_ic2 = 0;
+      *pk_tot *= k*pk_primordial_k[index_ic1_ic2]
+        /kmin/pk_primordial_kmin[index_ic1_ic2];
+      if (pba->has_ncdm){
+        *pk_cb_tot *= k*pk_primordial_k[index_ic1_ic2]
+          /kmin/pk_primordial_kmin[index_ic1_ic2];
       }
-      for (index_ic1 = 0; index_ic1 < psp->ic_size[index_md]; index_ic1++) {
-        for (index_ic2 = index_ic1+1; index_ic2 < psp->ic_size[index_md]; index_ic2++) {
-          index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,psp->ic_size[index_md]);
-          if (psp->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
-            pk_ic[index_ic1_ic2] = pk_ic[index_ic1_ic2]*
-              sqrt(pk_ic[index_symmetric_matrix(index_ic1,index_ic1,psp->ic_size[index_md])]*
-                   pk_ic[index_symmetric_matrix(index_ic2,index_ic2,psp->ic_size[index_md])]);
-            if(pba->has_ncdm){
-              pk_cb_ic[index_ic1_ic2] = pk_cb_ic[index_ic1_ic2]*
-                sqrt(pk_cb_ic[index_symmetric_matrix(index_ic1,index_ic1,psp->ic_size[index_md])]*
-                     pk_cb_ic[index_symmetric_matrix(index_ic2,index_ic2,psp->ic_size[index_md])]);
-            }
-          }
-          else {
-            pk_ic[index_ic1_ic2] = 0.;
-            if (pba->has_ncdm) pk_cb_ic[index_ic1_ic2] = 0.;
-          }
+    }
+    else {
+      for (index_ic1_ic2 = 0; index_ic1_ic2 < psp->ic_ic_size[index_md]; index_ic1_ic2++) {
+        pk_ic[index_ic1_ic2] *= k*pk_primordial_k[index_ic1_ic2]
+          /kmin/pk_primordial_kmin[index_ic1_ic2];
+        if (pba->has_ncdm){
+          pk_cb_ic[index_ic1_ic2] *= k*pk_primordial_k[index_ic1_ic2]
+            /kmin/pk_primordial_kmin[index_ic1_ic2];
         }
       }
-      free(spectrum_at_z_ic);
-      free(spectrum_cb_at_z_ic);
     }
-
-    free(spectrum_at_z);
-    free(spectrum_cb_at_z);
-    free(spline);
-    if(pba->has_ncdm) free(spline_cb);
   }
 
   /** - last step: if more than one condition, sum over pk_ic to get pk_tot, and set back coefficients of non-correlated pairs to exactly zero. */
@@ -1170,10 +1163,8 @@ int spectra_pk_nl_at_z(
  * Non-linear total matter power spectrum for arbitrary wavenumber and redshift.
  *
  * This routine evaluates the matter power spectrum at a given value of k and z by
- * interpolating in a table of all P(k)'s computed at this z by spectra_pk_nl_at_z() (when kmin <= k <= kmax),
- * or eventually by using directly the primordial spectrum (when 0 <= k < kmin):
- * the latter case is an approximation, valid when kmin << comoving Hubble scale today.
- * Returns zero when k=0. Returns an error when k<0 or k > kmax.
+ * interpolating in the bicubic spline of \f$\ln{P_{NL}(k,\tau)}\f$ built by spectra_pk().
+ * Returns an error when k<kmin or k > kmax.
  *
  * This function can be
  * called from whatever module at whatever time, provided that
@@ -1204,111 +1195,94 @@ int spectra_pk_nl_at_k_and_z(
 
   /** - define local variables */
 
-  int index_md;
-  int last_index;
-
-  double * spectrum_at_z = NULL;
-  double * spline;
-
-  double * spectrum_cb_at_z = NULL;
-  double * spline_cb = NULL;
+  double ln_tau;
+  double ln_k;
 
-  index_md = psp->index_md_scalars;
-
-  /** - check that k is in valid range [0:kmax] (the test for z will be done when calling spectra_pk_at_z()) */
+  /** - check that k is in valid range [kmin:kmax] */
 
   class_test((k < exp(psp->ln_k[0])) || (k > exp(psp->ln_k[psp->ln_k_size-1])),
              psp->error_message,
              "k=%e out of bounds [%e:%e]",k,0.,exp(psp->ln_k[psp->ln_k_size-1]));
 
-  /** - compute P(k,z) (in logarithmic format for more accurate interpolation) */
-  class_alloc(spectrum_at_z,
-              psp->ln_k_size*sizeof(double),
-              psp->error_message);
+  ln_k = MAX(MIN(log(k),psp->ln_k[psp->ln_k_size-1]),psp->ln_k[0]); // prevent rounding error leading to ln(k) being outside the table
 
-  class_alloc(spectrum_cb_at_z,
-              psp->ln_k_size*sizeof(double),
-              psp->error_message);
+  /** - convert z into ln(tau) */
 
-  class_call(spectra_pk_nl_at_z(pba,
-                                psp,
-                                logarithmic,
-                                z,
-                                spectrum_at_z,
-                                spectrum_cb_at_z),
+  class_call(spectra_ln_tau_at_z(pba,psp,z,&ln_tau),
              psp->error_message,
              psp->error_message);
 
-  /** - get its second derivatives with spline, then interpolate, then convert to linear format */
-
-  class_alloc(spline,
-              sizeof(double)*psp->ic_ic_size[index_md]*psp->ln_k_size,
-              psp->error_message);
+  /** - interpolate in the bicubic spline of the non-linear spectrum,
+      or of the linear one before the time at which non-linear
+      corrections start being computed */
+
+  if ((psp->ln_tau_size > 1) && (ln_tau < psp->ln_tau_nl[0])) {
+
+    class_call(spectra_pk_bicubic_at_k_and_tau(psp,
+                                               psp->ln_tau,
+                                               psp->ln_tau_size,
+                                               psp->ln_pk_l,
+                                               psp->ddln_pk_l,
+                                               psp->ddkln_pk_l,
+                                               psp->ddkddln_pk_l,
+                                               1,
+                                               ln_k,
+                                               ln_tau,
+                                               pk_tot),
+               psp->error_message,
+               psp->error_message);
 
-  if(pba->has_ncdm){
-    class_alloc(spline_cb,
-                sizeof(double)*psp->ic_ic_size[index_md]*psp->ln_k_size,
-                psp->error_message);
+    if (pba->has_ncdm) {
+      class_call(spectra_pk_bicubic_at_k_and_tau(psp,
+                                                 psp->ln_tau,
+                                                 psp->ln_tau_size,
+                                                 psp->ln_pk_cb_l,
+                                                 psp->ddln_pk_cb_l,
+                                                 psp->ddkln_pk_cb_l,
+                                                 psp->ddkddln_pk_cb_l,
+                                                 1,
+                                                 ln_k,
+                                                 ln_tau,
+                                                 pk_cb_tot),
+                 psp->error_message,
+                 psp->error_message);
+    }
   }
+  else {
 
-  class_call(array_spline_table_lines(psp->ln_k,
-                                      psp->ln_k_size,
-                                      spectrum_at_z,
-                                      1,
-                                      spline,
-                                      _SPLINE_NATURAL_,
-                                      psp->error_message),
-             psp->error_message,
-             psp->error_message);
-
-  class_call(array_interpolate_spline(psp->ln_k,
-                                      psp->ln_k_size,
-                                      spectrum_at_z,
-                                      spline,
-                                      1,
-                                      log(k),
-                                      &last_index,
-                                      pk_tot,
-                                      1,
-                                      psp->error_message),
-             psp->error_message,
-             psp->error_message);
-
-  *pk_tot = exp(*pk_tot);
-
-  if(pba->has_ncdm){
-
-    class_call(array_spline_table_lines(psp->ln_k,
-                                        psp->ln_k_size,
-                                        spectrum_cb_at_z,
-                                        1,
-                                        spline_cb,
-                                        _SPLINE_NATURAL_,
-                                        psp->error_message),
-               psp->error_message,
-               psp->error_message);
-
-    class_call(array_interpolate_spline(psp->ln_k,
-                                        psp->ln_k_size,
-                                        spectrum_cb_at_z,
-                                        spline_cb,
-                                        1,
-                                        log(k),
-                                        &last_index,
-                                        pk_cb_tot,
-                                        1,
-                                        psp->error_message),
-               psp->error_message,
-               psp->error_message);
-
-    *pk_cb_tot = exp(*pk_cb_tot);
+    class_call(spectra_pk_bicubic_at_k_and_tau(psp,
+                                               psp->ln_tau_nl,
+                                               psp->ln_tau_nl_size,
+                                               psp->ln_pk_nl,
+                                               psp->ddln_pk_nl,
+                                               psp->ddkln_pk_nl,
+                                               psp->ddkddln_pk_nl,
+                                               1,
+                                               ln_k,
+                                               ln_tau,
+                                               pk_tot),
+               psp->error_message,
+               psp->error_message);
 
+    if (pba->has_ncdm) {
+      class_call(spectra_pk_bicubic_at_k_and_tau(psp,
+                                                 psp->ln_tau_nl,
+                                                 psp->ln_tau_nl_size,
+                                                 psp->ln_pk_cb_nl,
+                                                 psp->ddln_pk_cb_nl,
+                                                 psp->ddkln_pk_cb_nl,
+                                                 psp->ddkddln_pk_cb_nl,
+                                                 1,
+                                                 ln_k,
+                                                 ln_tau,
+                                                 pk_cb_tot),
+                 psp->error_message,
+                 psp->error_message);
+    }
   }
 
-  free(spectrum_at_z);
-  free(spectrum_cb_at_z);
-  free(spline);
-  if(pba->has_ncdm) free(spline_cb);
+  *pk_tot = exp(*pk_tot);
+  if (pba->has_ncdm) *pk_cb_tot = exp(*pk_cb_tot);
 
   return _SUCCESS_;
 
@@ -1438,6 +1412,36 @@ int spectra_tk_at_k_and_z(
                           double * output  /* array with argument output[index_ic*psp->tr_size+index_tr] (must be already allocated) */
                           ) {
 
+  class_call(spectra_tk_at_k_and_z_with_workspace(pba,psp,NULL,k,z,output),
+             psp->error_message,
+             psp->error_message);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Same as spectra_tk_at_k_and_z(), with a workspace provided by the
+ * caller (or NULL for the default workspace of the calling thread),
+ * so that no memory is allocated.
+ *
+ * @param pba        Input: pointer to background structure (used for converting z into tau)
+ * @param psp        Input: pointer to spectra structure (containing pre-computed table)
+ * @param psw        Input: pointer to workspace (or NULL)
+ * @param k          Input: wavenumber in 1/Mpc
+ * @param z          Input: redshift
+ * @param output     Output: matter transfer functions
+ * @return the error status
+ */
+
+int spectra_tk_at_k_and_z_with_workspace(
+                                         struct background * pba,
+                                         struct spectra * psp,
+                                         struct spectra_workspace * psw,
+                                         double k,
+                                         double z,
+                                         double * output
+                                         ) {
+
   /** Summary: */
 
   /** - define local variables */
@@ -1455,34 +1459,50 @@ int spectra_tk_at_k_and_z(
              psp->error_message,
              "k=%e out of bounds [%e:%e]",k,0.,exp(psp->ln_k[psp->ln_k_size-1]));
 
-  /** - compute T_i(k,z) */
+  /** - get scratch space */
 
-  class_alloc(tks_at_z,
-              psp->ln_k_size*psp->tr_size*psp->ic_size[index_md]*sizeof(double),
-              psp->error_message);
+  if (psw == NULL) {
+    class_call(spectra_workspace_default(psp,&psw),
+               psp->error_message,
+               psp->error_message);
+  }
+  else {
+    class_call(spectra_workspace_reserve(psp,psw),
+               psp->error_message,
+               psp->error_message);
+  }
+  tks_at_z = psw->tks_at_z;
+  ddtks_at_z = psw->ddtks_at_z;
 
-  class_call(spectra_tk_at_z(pba,
-                             psp,
-                             z,
-                             tks_at_z),
-             psp->error_message,
-             psp->error_message);
+  /** - compute T_i(k,z) and get its second derivatives w.r.t. k with
+      spline, unless the workspace already holds them for this z */
 
-  /** - get its second derivatives w.r.t. k with spline, then interpolate */
+  if ((psw->tk_stamp != psp->workspace_stamp) || (psw->tk_z != z)) {
 
-  class_alloc(ddtks_at_z,
-              psp->ln_k_size*psp->tr_size*psp->ic_size[index_md]*sizeof(double),
-              psp->error_message);
+    psw->tk_stamp = 0;
 
-  class_call(array_spline_table_lines(psp->ln_k,
-                                      psp->ln_k_size,
-                                      tks_at_z,
-                                      psp->tr_size*psp->ic_size[index_md],
-                                      ddtks_at_z,
-                                      _SPLINE_NATURAL_,
-                                      psp->error_message),
-             psp->error_message,
-             psp->error_message);
+    class_call(spectra_tk_at_z(pba,
+                               psp,
+                               z,
+                               tks_at_z),
+               psp->error_message,
+               psp->error_message);
+
+    class_call(array_spline_table_lines(psp->ln_k,
+                                        psp->ln_k_size,
+                                        tks_at_z,
+                                        psp->tr_size*psp->ic_size[index_md],
+                                        ddtks_at_z,
+                                        _SPLINE_NATURAL_,
+                                        psp->error_message),
+               psp->error_message,
+               psp->error_message);
+
+    psw->tk_stamp = psp->workspace_stamp;
+    psw->tk_z = z;
+  }
+
+  /** - interpolate */
 
   class_call(array_interpolate_spline(psp->ln_k,
                                       psp->ln_k_size,
@@ -1497,11 +1517,255 @@ int spectra_tk_at_k_and_z(
              psp->error_message,
              psp->error_message);
 
-  free(tks_at_z);
-  free(ddtks_at_z);
+  return _SUCCESS_;
+
+}
+
+/**
+ * Initialize a workspace for the interpolation functions of the
+ * spectra module, with buffers large enough for this spectra
+ * structure.
+ *
+ * @param psp Input: pointer to spectra structure
+ * @param psw Output: pointer to workspace
+ * @return the error status
+ */
+
+int spectra_workspace_init(
+                           struct spectra * psp,
+                           struct spectra_workspace * psw
+                           ) {
+
+  psw->tk_size = 0;
+  psw->tks_at_z = NULL;
+  psw->ddtks_at_z = NULL;
+  psw->tk_stamp = 0;
+  psw->tk_z = 0.;
+  psw->ic_ic_size = 0;
+  psw->pk_primordial_k = NULL;
+  psw->pk_primordial_kmin = NULL;
+  psw->md_size = 0;
+  psw->cl_md_size = 0;
+  psw->cl_md_ic_size = 0;
+  psw->cl_md = NULL;
+  psw->cl_md_ic = NULL;
+  psw->cl_md_data = NULL;
+  psw->cl_md_ic_data = NULL;
+
+  class_call(spectra_workspace_reserve(psp,psw),
+             psp->error_message,
+             psp->error_message);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Make sure that the buffers of a workspace are large enough for this
+ * spectra structure (they are reallocated only if they are too small),
+ * and point cl_md and cl_md_ic to the right places.
+ *
+ * @param psp Input: pointer to spectra structure
+ * @param psw Input/Output: pointer to workspace
+ * @return the error status
+ */
+
+int spectra_workspace_reserve(
+                              struct spectra * psp,
+                              struct spectra_workspace * psw
+                              ) {
+
+  int index_md;
+  int size;
+
+  if (psp->md_size == 0)
+    return _SUCCESS_;
+
+  /** - buffers for matter transfer functions and primordial spectra */
+
+  if (psp->ln_k_size > 0) {
+
+    if (psp->matter_transfer != NULL) {
+      size = psp->ln_k_size*psp->tr_size*psp->ic_size[psp->index_md_scalars];
+      if (size > psw->tk_size) {
+        class_realloc(psw->tks_at_z,psw->tks_at_z,size*sizeof(double),psp->error_message);
+        class_realloc(psw->ddtks_at_z,psw->ddtks_at_z,size*sizeof(double),psp->error_message);
+        psw->tk_size = size;
+        psw->tk_stamp = 0;
+      }
+    }
+
+    size = psp->ic_ic_size[psp->index_md_scalars];
+    if (size > psw->ic_ic_size) {
+      class_realloc(psw->pk_primordial_k,psw->pk_primordial_k,size*sizeof(double),psp->error_message);
+      class_realloc(psw->pk_primordial_kmin,psw->pk_primordial_kmin,size*sizeof(double),psp->error_message);
+      psw->ic_ic_size = size;
+    }
+  }
+
+  /** - buffers for C_l's of each mode and pair of initial conditions */
+
+  if (psp->ct_size > 0) {
+
+    if (psp->md_size > psw->md_size) {
+      class_realloc(psw->cl_md,psw->cl_md,psp->md_size*sizeof(double*),psp->error_message);
+      class_realloc(psw->cl_md_ic,psw->cl_md_ic,psp->md_size*sizeof(double*),psp->error_message);
+      psw->md_size = psp->md_size;
+    }
+
+    size = psp->md_size*psp->ct_size;
+    if (size > psw->cl_md_size) {
+      class_realloc(psw->cl_md_data,psw->cl_md_data,size*sizeof(double),psp->error_message);
+      psw->cl_md_size = size;
+    }
+
+    size = 0;
+    for (index_md=0; index_md<psp->md_size; index_md++)
+      size += psp->ic_ic_size[index_md]*psp->ct_size;
+    if (size > psw->cl_md_ic_size) {
+      class_realloc(psw->cl_md_ic_data,psw->cl_md_ic_data,size*sizeof(double),psp->error_message);
+      psw->cl_md_ic_size = size;
+    }
+
+    size = 0;
+    for (index_md=0; index_md<psp->md_size; index_md++) {
+      psw->cl_md[index_md] = psw->cl_md_data+index_md*psp->ct_size;
+      psw->cl_md_ic[index_md] = psw->cl_md_ic_data+size;
+      size += psp->ic_ic_size[index_md]*psp->ct_size;
+    }
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Free the buffers of a workspace.
+ *
+ * @param psw Input: pointer to workspace
+ * @return the error status
+ */
+
+int spectra_workspace_free(
+                           struct spectra_workspace * psw
+                           ) {
+
+  free(psw->tks_at_z);
+  free(psw->ddtks_at_z);
+  free(psw->pk_primordial_k);
+  free(psw->pk_primordial_kmin);
+  free(psw->cl_md);
+  free(psw->cl_md_ic);
+  free(psw->cl_md_data);
+  free(psw->cl_md_ic_data);
+
+  psw->tk_size = 0;
+  psw->tks_at_z = NULL;
+  psw->ddtks_at_z = NULL;
+  psw->tk_stamp = 0;
+  psw->tk_z = 0.;
+  psw->ic_ic_size = 0;
+  psw->pk_primordial_k = NULL;
+  psw->pk_primordial_kmin = NULL;
+  psw->md_size = 0;
+  psw->cl_md_size = 0;
+  psw->cl_md_ic_size = 0;
+  psw->cl_md = NULL;
+  psw->cl_md_ic = NULL;
+  psw->cl_md_data = NULL;
+  psw->cl_md_ic_data = NULL;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Default workspace of the calling thread, with buffers large enough
+ * for this spectra structure. It is allocated and registered at the
+ * first call from each thread, and kept afterwards. Its buffers are
+ * freed by spectra_free() or spectra_workspace_default_free() called
+ * from the same thread, and the workspace itself by
+ * spectra_workspace_default_free_all().
+ *
+ * @param psp Input: pointer to spectra structure
+ * @param psw Output: pointer to the workspace of the calling thread
+ * @return the error status
+ */
+
+int spectra_workspace_default(
+                              struct spectra * psp,
+                              struct spectra_workspace ** psw
+                              ) {
+
+  struct spectra_default_workspace * pdw;
+
+  if ((spectra_thread_workspace == NULL) ||
+      (spectra_thread_generation != spectra_default_generation)) {
+
+    class_alloc(pdw,sizeof(struct spectra_default_workspace),psp->error_message);
+
+    class_call_except(spectra_workspace_init(psp,&(pdw->workspace)),
+                      psp->error_message,
+                      psp->error_message,
+                      spectra_workspace_free(&(pdw->workspace));free(pdw));
+
+#pragma omp critical (spectra_workspace)
+    {
+      pdw->next = spectra_default_workspaces;
+      spectra_default_workspaces = pdw;
+    }
+
+    spectra_thread_workspace = pdw;
+    spectra_thread_generation = spectra_default_generation;
+  }
+
+  *psw = &(spectra_thread_workspace->workspace);
+
+  class_call(spectra_workspace_reserve(psp,*psw),
+             psp->error_message,
+             psp->error_message);
 
   return _SUCCESS_;
+}
+
+/**
+ * Free the buffers of the default workspace of the calling thread.
+ * Called by spectra_free(). The workspaces of the other threads are
+ * not touched: they are freed by spectra_workspace_default_free_all().
+ *
+ * @return the error status
+ */
+
+int spectra_workspace_default_free() {
+
+  if ((spectra_thread_workspace == NULL) ||
+      (spectra_thread_generation != spectra_default_generation))
+    return _SUCCESS_;
+
+  return spectra_workspace_free(&(spectra_thread_workspace->workspace));
+}
+
+/**
+ * Free the default workspaces of all threads. Must not be called
+ * while other threads use the functions of this module; a thread
+ * calling them later gets a new workspace.
+ *
+ * @return the error status
+ */
+
+int spectra_workspace_default_free_all() {
+
+  struct spectra_default_workspace * pdw;
+
+#pragma omp critical (spectra_workspace)
+  {
+    while (spectra_default_workspaces != NULL) {
+      pdw = spectra_default_workspaces;
+      spectra_default_workspaces = pdw->next;
+      spectra_workspace_free(&(pdw->workspace));
+      free(pdw);
+    }
+    spectra_default_generation++;
+  }
 
+  return _SUCCESS_;
 }
 
 /**
@@ -1533,6 +1797,15 @@ int spectra_init(
   double TT_II,TT_RI,TT_RR;
   int l1,l2;
 
+  /** - give a new number to the tables computed here, such that no
+      workspace uses values cached for a previous computation */
+
+#pragma omp critical (spectra_stamp)
+  {
+    spectra_last_stamp++;
+    psp->workspace_stamp = spectra_last_stamp;
+  }
+
   /** - check that we really want to compute at least one spectrum */
 
   if ((ppt->has_cls == _FALSE_) &&
@@ -1552,7 +1825,7 @@ int spectra_init(
   /** - initialize indices and allocate some of the arrays in the
       spectra structure */
 
-  class_call(spectra_indices(pba,ppt,ptr,ppm,psp),
+  class_call(spectra_indices(ppr,pba,ppt,ptr,ppm,psp),
              psp->error_message,
              psp->error_message);
 
@@ -1560,7 +1833,7 @@ int spectra_init(
 
   if (ppt->has_cls == _TRUE_) {
 
-    class_call(spectra_cls(pba,ppt,ptr,ppm,psp),
+    class_call(spectra_cls(ppr,pba,ppt,pnl,ptr,ppm,psp),
                psp->error_message,
                psp->error_message);
 
@@ -1740,6 +2013,8 @@ int spectra_free(
       free(psp->l);
       free(psp->l_size);
       free(psp->l_max_ct);
+      if (psp->has_dd_pair != NULL)
+        free(psp->has_dd_pair);
       free(psp->l_max);
       free(psp->cl);
       free(psp->ddcl);
@@ -1764,6 +2039,11 @@ int spectra_free(
           free(psp->ddln_pk_l);
         }
 
+        free(psp->ddkln_pk);
+        free(psp->ddkddln_pk);
+        free(psp->ddkln_pk_l);
+        free(psp->ddkddln_pk_l);
+
         if (psp->ln_pk_nl != NULL) {
 
           free(psp->ln_tau_nl);
@@ -1772,6 +2052,9 @@ int spectra_free(
           if (psp->ln_tau_nl_size > 1) {
             free(psp->ddln_pk_nl);
           }
+
+          free(psp->ddkln_pk_nl);
+          free(psp->ddkddln_pk_nl);
         }
 
       }
@@ -1790,6 +2073,11 @@ int spectra_free(
           free(psp->ddln_pk_cb_l);
         }
 
+        free(psp->ddkln_pk_cb);
+        free(psp->ddkddln_pk_cb);
+        free(psp->ddkln_pk_cb_l);
+        free(psp->ddkddln_pk_cb_l);
+
         if (psp->ln_pk_cb_nl != NULL) {
 
           free(psp->ln_pk_cb_nl);
@@ -1797,6 +2085,9 @@ int spectra_free(
           if (psp->ln_tau_nl_size > 1) {
             free(psp->ddln_pk_cb_nl);
           }
+
+          free(psp->ddkln_pk_cb_nl);
+          free(psp->ddkddln_pk_cb_nl);
         }
 
       }
@@ -1817,6 +2108,12 @@ int spectra_free(
   free(psp->ic_size);
   free(psp->ic_ic_size);
 
+  /** - release the default workspace of the calling thread */
+
+  class_call(spectra_workspace_default_free(),
+             psp->error_message,
+             psp->error_message);
+
   return _SUCCESS_;
 
 }
@@ -1824,6 +2121,7 @@ int spectra_free(
 /**
  * This routine defines indices and allocates tables in the spectra structure
  *
+ * @param ppr  Input: pointer to precision structure
  * @param pba  Input: pointer to background structure
  * @param ppt  Input: pointer to perturbation structure
  * @param ptr  Input: pointer to transfers structure
@@ -1833,6 +2131,7 @@ int spectra_free(
  */
 
 int spectra_indices(
+                    struct precision * ppr,
                     struct background * pba,
                     struct perturbs * ppt,
                     struct transfers * ptr,
@@ -1844,6 +2143,8 @@ int spectra_indices(
   int index_md;
   int index_ic1_ic2;
   int index_tr;
+  int index_d1,index_d2;
+  double overlap;
 
   psp->md_size = ppt->md_size;
   if (ppt->has_scalars == _TRUE_)
@@ -1951,10 +2252,54 @@ int spectra_indices(
     else
       psp->d_size=0;
 
+    /* pairs of bins for which C_l^dd is computed: those allowed by
+       non_diag, excepted when their selection functions barely
+       overlap. Only density and redshift-space distortion terms are
+       local enough for this criterion. */
+
+    psp->dd_size = 0;
+    psp->has_dd_pair = NULL;
+
+    if (psp->d_size > 0) {
+
+      class_alloc(psp->has_dd_pair,
+                  sizeof(short)*psp->d_size*psp->d_size,
+                  psp->error_message);
+
+      for (index_d1=0; index_d1<psp->d_size; index_d1++) {
+        for (index_d2=index_d1; index_d2<psp->d_size; index_d2++) {
+
+          psp->has_dd_pair[index_d1*psp->d_size+index_d2] = (index_d2-index_d1 <= psp->non_diag) ? _TRUE_ : _FALSE_;
+
+          if ((psp->has_dd_pair[index_d1*psp->d_size+index_d2] == _TRUE_) &&
+              (index_d2 > index_d1) &&
+              (psp->non_diag_min_overlap > 0.) &&
+              (ppt->has_nc_lens == _FALSE_) &&
+              (ppt->has_nc_gr == _FALSE_)) {
+
+            class_call(transfer_selection_overlap(ppr,ppt,ptr,index_d1,index_d2,&overlap),
+                       ptr->error_message,
+                       psp->error_message);
+
+            if (overlap < psp->non_diag_min_overlap)
+              psp->has_dd_pair[index_d1*psp->d_size+index_d2] = _FALSE_;
+          }
+
+          psp->has_dd_pair[index_d2*psp->d_size+index_d1] = psp->has_dd_pair[index_d1*psp->d_size+index_d2];
+
+          if (psp->has_dd_pair[index_d1*psp->d_size+index_d2] == _TRUE_)
+            psp->dd_size++;
+        }
+      }
+    }
+
+    if ((psp->spectra_verbose > 1) && (psp->non_diag_min_overlap > 0.) && (ppt->has_cl_number_count == _TRUE_))
+      printf(" -> computing C_l^dd for %d pairs of bins with overlapping selection functions\n",psp->dd_size);
+
     if ((ppt->has_cl_number_count == _TRUE_) && (ppt->has_scalars == _TRUE_)) {
       psp->has_dd = _TRUE_;
       psp->index_ct_dd=index_ct;
-      index_ct+=(psp->d_size*(psp->d_size+1)-(psp->d_size-psp->non_diag)*(psp->d_size-1-psp->non_diag))/2;
+      index_ct+=psp->dd_size;
     }
     else {
       psp->has_dd = _FALSE_;
@@ -2050,7 +2395,7 @@ int spectra_indices(
 
       if (psp->has_dd == _TRUE_)
         for (index_ct=psp->index_ct_dd;
-             index_ct<psp->index_ct_dd+(psp->d_size*(psp->d_size+1)-(psp->d_size-psp->non_diag)*(psp->d_size-1-psp->non_diag))/2;
+             index_ct<psp->index_ct_dd+psp->dd_size;
              index_ct++)
           psp->l_max_ct[ppt->index_md_scalars][index_ct] = ppt->l_lss_max;
 
@@ -2149,8 +2494,10 @@ int spectra_indices(
  * This routine computes a table of values for all harmonic spectra \f$ C_l \f$'s,
  * given the transfer functions and primordial spectra.
  *
+ * @param ppr Input: pointer to precision structure
  * @param pba Input: pointer to background structure
  * @param ppt Input: pointer to perturbation structure
+ * @param pnl Input: pointer to nonlinear structure
  * @param ptr Input: pointer to transfers structure
  * @param ppm Input: pointer to primordial structure
  * @param psp Input/Output: pointer to spectra structure
@@ -2158,8 +2505,10 @@ int spectra_indices(
  */
 
 int spectra_cls(
+                struct precision * ppr,
                 struct background * pba,
                 struct perturbs * ppt,
+                struct nonlinear * pnl,
                 struct transfers * ptr,
                 struct primordial * ppm,
                 struct spectra * psp
@@ -2324,7 +2673,19 @@ int spectra_cls(
       }
     }
 
-    /** - --> (d) now that for a given mode, all possible \f$ C_l\f$'s have been computed,
+    /** - --> (d) for scalars, eventually replace the \f$ C_l\f$'s of
+        density number counts and galaxy lensing at low l by their
+        FFTLog computation */
+
+    if ((ptr->has_cl_fftlog == _TRUE_) && _scalars_) {
+
+      class_call(spectra_cls_fftlog(ppr,pba,ppt,pnl,ptr,ppm,psp),
+                 psp->error_message,
+                 psp->error_message);
+
+    }
+
+    /** - --> (e) now that for a given mode, all possible \f$ C_l\f$'s have been computed,
         compute second derivative of the array in which they are stored,
         in view of spline interpolation. */
 
@@ -2607,6 +2968,8 @@ int spectra_compute_cl(
       index_ct=0;
       for (index_d1=0; index_d1<psp->d_size; index_d1++) {
         for (index_d2=index_d1; index_d2<=MIN(index_d1+psp->non_diag,psp->d_size-1); index_d2++) {
+          if (psp->has_dd_pair[index_d1*psp->d_size+index_d2] == _FALSE_)
+            continue;
           cl_integrand[index_q*cl_integrand_num_columns+1+psp->index_ct_dd+index_ct]=
             primordial_pk[index_ic1_ic2]
             * transfer_ic1_nc[index_d1]
@@ -2775,86 +3138,825 @@ int spectra_compute_cl(
 }
 
 /**
- * This routine computes the values of k and tau at which the matter
- * power spectra \f$ P(k,\tau)\f$ and the matter transfer functions \f$ T_i(k,\tau)\f$
- * will be stored.
+ * This routine computes the \f$ C_l\f$'s of density number counts
+ * and galaxy lensing (types dd, ll and dl) for multipoles up to
+ * ptr->l_fftlog_max, without the Limber approximation and without
+ * the line-of-sight integrals of the transfer module, and overwrites
+ * the values computed by spectra_compute_cl() for these types.
  *
- * @param pba Input: pointer to background structure (for z to tau conversion)
- * @param ppt Input: pointer to perturbation structure (contain source functions)
- * @param pnl Input: pointer to nonlinear structure (contain nonlinear corrections)
+ * For two windows X and Y, with sources \f$ S_X(k,\chi) \f$ and
+ * \f$ S_Y(k,\chi) \f$ (already multiplied by the window functions),
+ *
+ * \f[ C_l^{XY} = \int d\chi_1 \int d\chi_2 \, 4 \pi \int \frac{dk}{k} P(k) S_X(k,\chi_1) S_Y(k,\chi_2) j_l(k\chi_1) j_l(k\chi_2) . \f]
+ *
+ * The domain is split into the regions \f$ \chi_2 < \chi_1 \f$ and
+ * \f$ \chi_1 < \chi_2 \f$. In the first one, \f$ \chi_2 = t \chi_1 \f$
+ * is sampled on a uniform grid in t. For each pair of sampled
+ * distances, the integrand in k is decomposed into complex power laws
+ * with FFTLog; the integral over k and t is then a sum of these
+ * coefficients times tabulated integrals of the Bessel kernel (see
+ * fftlog_kernel_get()), and the outer integral over \f$ \chi_1 \f$ is
+ * done with the trapezoidal rule (see spectra_fftlog_region()).
+ *
+ * @param ppr Input: pointer to precision structure
+ * @param pba Input: pointer to background structure
+ * @param ppt Input: pointer to perturbation structure
+ * @param pnl Input: pointer to nonlinear structure
+ * @param ptr Input: pointer to transfers structure
+ * @param ppm Input: pointer to primordial structure
  * @param psp Input/Output: pointer to spectra structure
  * @return the error status
  */
 
-int spectra_k_and_tau(
-                      struct background * pba,
-                      struct perturbs * ppt,
-                      struct nonlinear * pnl,
-                      struct spectra * psp
-                      ) {
+int spectra_cls_fftlog(
+                       struct precision * ppr,
+                       struct background * pba,
+                       struct perturbs * ppt,
+                       struct nonlinear * pnl,
+                       struct transfers * ptr,
+                       struct primordial * ppm,
+                       struct spectra * psp
+                       ) {
 
-  /** Summary: */
+  struct spectra_fftlog sf;
+  struct spectra_fftlog * psf = &sf;
+  int index_md,index_tt,index_l,l_size;
+  int index_k,index_ic,index_ic1,index_ic2,index_ic1_ic2,index_ct;
+  int index_d1,index_d2,index_w_density=0,index_w_lensing=0,index_source;
+  int index_task,task_size,ic_size,ic_ic_size;
+  int * task;  /* task[index_task*6+i] = index_ct, index_ic1_ic2, outer window, outer ic, inner window, inner ic */
+  double * task_factor;
+  double * result;
+  double * primordial_pk;
+  double ln_k_min,ln_k_max,ln_k,x,taper;
+  int abort;
 
-  /** - define local variables */
+  index_md = ppt->index_md_scalars;
+  ic_size = psp->ic_size[index_md];
+  ic_ic_size = psp->ic_ic_size[index_md];
 
-  int index_k;
-  int index_tau;
-  int index_tau_min_nl;
-  double tau_min;
+  /** - multipoles computed with FFTLog: those of the types dd, ll and dl up to l_fftlog_max */
 
-  /** - check the presence of scalar modes */
+  index_tt = (ppt->has_nc_density == _TRUE_) ? ptr->index_tt_density : ptr->index_tt_lensing;
 
-  class_test((ppt->has_scalars == _FALSE_),
+  l_size = 0;
+  while ((l_size < ptr->l_size_tt[index_md][index_tt]) && (ptr->l[l_size] <= ptr->l_fftlog_max))
+    l_size++;
+
+  if (l_size == 0)
+    return _SUCCESS_;
+
+  if (psp->spectra_verbose > 0)
+    printf(" -> computing density and lensing C_l's up to l=%d with FFTLog\n",ptr->l[l_size-1]);
+
+  /** - get the weights of the Bessel kernel (computed only once in the
+      process), with a different bias for density and lensing since
+      their integrands have very different slopes at small k */
+
+  psf->pfk[0] = NULL;
+  psf->pfk[1] = NULL;
+
+  if (ppt->has_nc_density == _TRUE_) {
+    class_call(fftlog_kernel_get(ppr->fftlog_k_size,
+                                 ppr->fftlog_dlnk,
+                                 ppr->fftlog_bias_density,
+                                 ppr->fftlog_t_sampling,
+                                 ppr->fftlog_kernel_tolerance,
+                                 l_size,
+                                 ptr->l,
+                                 &(psf->pfk[0]),
+                                 psp->error_message),
+               psp->error_message,
+               psp->error_message);
+  }
+
+  if (ppt->has_cl_lensing_potential == _TRUE_) {
+    class_call(fftlog_kernel_get(ppr->fftlog_k_size,
+                                 ppr->fftlog_dlnk,
+                                 ppr->fftlog_bias_lensing,
+                                 ppr->fftlog_t_sampling,
+                                 ppr->fftlog_kernel_tolerance,
+                                 l_size,
+                                 ptr->l,
+                                 &(psf->pfk[1]),
+                                 psp->error_message),
+               psp->error_message,
+               psp->error_message);
+  }
+
+  /** - FFTLog wavenumbers, centered on the range of the sources */
+
+  psf->k_size = ppr->fftlog_k_size;
+  psf->dlnk = ppr->fftlog_dlnk;
+
+  /* the smooth window (taper) goes from one to zero over fftlog_taper
+     in ln(k), centered on each end of the range of the C_l's: its
+     integral is then that of the sharp cut of the line-of-sight
+     integrals, up to the variation of the integrand */
+  ln_k_min = log(ppt->k[index_md][0])-0.5*ppr->fftlog_taper;
+  ln_k_max = log(ppt->k[index_md][ppt->k_size_cl[index_md]-1])+0.5*ppr->fftlog_taper;
+
+  class_test(ln_k_max-ln_k_min > (psf->k_size-1)*psf->dlnk,
              psp->error_message,
-             "you cannot ask for matter power spectrum since you turned off scalar modes");
+             "the range of wavenumbers of the sources plus the taper, ln(k_max/k_min)+fftlog_taper=%e, does not fit in fftlog_k_size=%d steps of fftlog_dlnk=%e",
+             ln_k_max-ln_k_min,psf->k_size,psf->dlnk);
 
-  /** - check the maximum redshift z_max_pk at which \f$P(k,z)\f$ and \f$ T_i(k,z)\f$ should be
-      computable by interpolation. If it is equal to zero, only \f$ P(k,z=0)\f$
-      needs to be computed. If it is higher, we will store in a table
-      various P(k,tau) at several values of tau generously encompassing
-      the range 0<z<z_max_pk */
+  psf->ln_k0 = 0.5*(ln_k_min+ln_k_max)-0.5*(psf->k_size-1)*psf->dlnk;
+  psf->index_k_min = (int)ceil((ln_k_min-psf->ln_k0)/psf->dlnk);
+  psf->k_in_size = (int)floor((ln_k_max-psf->ln_k0)/psf->dlnk)+1-psf->index_k_min;
+
+  /** - primordial spectrum, times a smooth window going to zero at both ends of the range */
+
+  class_alloc(psf->pk,ic_ic_size*psf->k_in_size*sizeof(double),psp->error_message);
+  class_alloc(primordial_pk,ic_ic_size*sizeof(double),psp->error_message);
+
+  for (index_k=0; index_k<psf->k_in_size; index_k++) {
+
+    ln_k = psf->ln_k0+(psf->index_k_min+index_k)*psf->dlnk;
+
+    class_call(primordial_spectrum_at_k(ppm,index_md,linear,exp(ln_k),primordial_pk),
+               ppm->error_message,
+               psp->error_message);
+
+    taper = 1.;
+    x = MIN(ln_k-ln_k_min,ln_k_max-ln_k)/ppr->fftlog_taper;
+    if (x < 1.)
+      taper = MAX(x,0.)-sin(2.*_PI_*MAX(x,0.))/(2.*_PI_);
+
+    for (index_ic1_ic2=0; index_ic1_ic2<ic_ic_size; index_ic1_ic2++)
+      psf->pk[index_ic1_ic2*psf->k_in_size+index_k] = primordial_pk[index_ic1_ic2]*taper;
+  }
+
+  free(primordial_pk);
+
+  /** - sources at the FFTLog wavenumbers: delta_m for density, phi+psi for lensing */
+
+  psf->source_size = 2;
+  class_calloc(psf->source,psf->source_size*ic_size,sizeof(double*),psp->error_message);
+
+  for (index_ic=0; index_ic<ic_size; index_ic++) {
+    if (ppt->has_nc_density == _TRUE_) {
+      class_alloc(psf->source[0*ic_size+index_ic],ppt->tau_size*psf->k_in_size*sizeof(double),psp->error_message);
+      class_call(spectra_fftlog_sources(ppt,pnl,psp,psf,index_md,index_ic,ppt->index_tp_delta_m,psf->source[0*ic_size+index_ic]),
+                 psp->error_message,
+                 psp->error_message);
+    }
+    if (ppt->has_cl_lensing_potential == _TRUE_) {
+      class_alloc(psf->source[1*ic_size+index_ic],ppt->tau_size*psf->k_in_size*sizeof(double),psp->error_message);
+      class_call(spectra_fftlog_sources(ppt,pnl,psp,psf,index_md,index_ic,ppt->index_tp_phi_plus_psi,psf->source[1*ic_size+index_ic]),
+                 psp->error_message,
+                 psp->error_message);
+    }
+  }
+
+  /** - window functions: one per bin for density, then one per bin for lensing */
+
+  psf->chi_size = ppr->fftlog_chi_sampling;
+  psf->window_size = 0;
+  if (ppt->has_nc_density == _TRUE_) {
+    index_w_density = psf->window_size;
+    psf->window_size += psp->d_size;
+  }
+  if (ppt->has_cl_lensing_potential == _TRUE_) {
+    index_w_lensing = psf->window_size;
+    psf->window_size += psp->d_size;
+  }
+
+  class_alloc(psf->window_source,psf->window_size*sizeof(int),psp->error_message);
+  class_alloc(psf->chi_min,psf->window_size*sizeof(double),psp->error_message);
+  class_alloc(psf->dchi,psf->window_size*sizeof(double),psp->error_message);
+  class_alloc(psf->window,psf->window_size*psf->chi_size*sizeof(double),psp->error_message);
+  class_alloc(psf->ddwindow,psf->window_size*psf->chi_size*sizeof(double),psp->error_message);
+
+  for (index_d1=0; index_d1<psp->d_size; index_d1++) {
+    if (ppt->has_nc_density == _TRUE_) {
+      psf->window_source[index_w_density+index_d1] = 0;
+      class_call(spectra_fftlog_window(ppr,pba,ppt,ptr,psp,psf,index_d1,_FALSE_,index_w_density+index_d1),
+                 psp->error_message,
+                 psp->error_message);
+    }
+    if (ppt->has_cl_lensing_potential == _TRUE_) {
+      psf->window_source[index_w_lensing+index_d1] = 1;
+      class_call(spectra_fftlog_window(ppr,pba,ppt,ptr,psp,psf,index_d1,_TRUE_,index_w_lensing+index_d1),
+                 psp->error_message,
+                 psp->error_message);
+    }
+  }
+
+  /** - list of elementary tasks: each C_l is the sum of two regions,
+      or twice the same region for auto-correlations */
+
+  class_alloc(task,6*2*ic_ic_size*psp->ct_size*sizeof(int),psp->error_message);
+  class_alloc(task_factor,2*ic_ic_size*psp->ct_size*sizeof(double),psp->error_message);
+
+  task_size = 0;
+
+#define _SPECTRA_FFTLOG_TASKS_(index_ct,index_w1,index_w2)              \
+  {                                                                     \
+    task[6*task_size+0] = index_ct;                                     \
+    task[6*task_size+1] = index_ic1_ic2;                                \
+    task[6*task_size+2] = index_w1;                                     \
+    task[6*task_size+3] = index_ic1;                                    \
+    task[6*task_size+4] = index_w2;                                     \
+    task[6*task_size+5] = index_ic2;                                    \
+    if ((index_w1 == index_w2) && (index_ic1 == index_ic2)) {           \
+      task_factor[task_size++] = 2.;                                    \
+    }                                                                   \
+    else {                                                              \
+      task_factor[task_size++] = 1.;                                    \
+      task[6*task_size+0] = index_ct;                                   \
+      task[6*task_size+1] = index_ic1_ic2;                              \
+      task[6*task_size+2] = index_w2;                                   \
+      task[6*task_size+3] = index_ic2;                                  \
+      task[6*task_size+4] = index_w1;                                   \
+      task[6*task_size+5] = index_ic1;                                  \
+      task_factor[task_size++] = 1.;                                    \
+    }                                                                   \
+  }
+
+  for (index_ic1=0; index_ic1<ic_size; index_ic1++) {
+    for (index_ic2=index_ic1; index_ic2<ic_size; index_ic2++) {
+      index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,ic_size);
+      if (psp->is_non_zero[index_md][index_ic1_ic2] == _FALSE_)
+        continue;
+
+      if (psp->has_dd == _TRUE_) {
+        index_ct=0;
+        for (index_d1=0; index_d1<psp->d_size; index_d1++) {
+          for (index_d2=index_d1; index_d2<=MIN(index_d1+psp->non_diag,psp->d_size-1); index_d2++) {
+            if (psp->has_dd_pair[index_d1*psp->d_size+index_d2] == _FALSE_)
+              continue;
+            _SPECTRA_FFTLOG_TASKS_(psp->index_ct_dd+index_ct,index_w_density+index_d1,index_w_density+index_d2);
+            index_ct++;
+          }
+        }
+      }
+
+      if (psp->has_ll == _TRUE_) {
+        index_ct=0;
+        for (index_d1=0; index_d1<psp->d_size; index_d1++) {
+          for (index_d2=index_d1; index_d2<=MIN(index_d1+psp->non_diag,psp->d_size-1); index_d2++) {
+            _SPECTRA_FFTLOG_TASKS_(psp->index_ct_ll+index_ct,index_w_lensing+index_d1,index_w_lensing+index_d2);
+            index_ct++;
+          }
+        }
+      }
+
+      if (psp->has_dl == _TRUE_) {
+        index_ct=0;
+        for (index_d1=0; index_d1<psp->d_size; index_d1++) {
+          for (index_d2=MAX(index_d1-psp->non_diag,0); index_d2<=MIN(index_d1+psp->non_diag,psp->d_size-1); index_d2++) {
+            _SPECTRA_FFTLOG_TASKS_(psp->index_ct_dl+index_ct,index_w_density+index_d1,index_w_lensing+index_d2);
+            index_ct++;
+          }
+        }
+      }
+    }
+  }
+
+#undef _SPECTRA_FFTLOG_TASKS_
+
+  /** - compute all regions in parallel */
+
+  class_calloc(result,task_size*l_size,sizeof(double),psp->error_message);
+
+  abort = _FALSE_;
 
-  /* if z_max_pk<0, return error */
-  class_test((psp->z_max_pk < 0),
+#pragma omp parallel for schedule (dynamic) shared(pba,ppt,psp,psf,task,result,index_md,task_size,abort) private(index_task)
+
+  for (index_task=0; index_task<task_size; index_task++) {
+
+#pragma omp flush(abort)
+
+    class_call_parallel(spectra_fftlog_region(pba,
+                                              ppt,
+                                              psp,
+                                              psf,
+                                              index_md,
+                                              task[6*index_task+2],
+                                              task[6*index_task+3],
+                                              task[6*index_task+4],
+                                              task[6*index_task+5],
+                                              task[6*index_task+1],
+                                              result+index_task*l_size),
+                        psp->error_message,
+                        psp->error_message);
+  }
+
+  if (abort == _TRUE_) return _FAILURE_;
+
+  /** - sum the regions and overwrite the C_l's of the line-of-sight integrals */
+
+  for (index_task=0; index_task<task_size; index_task++) {
+    for (index_l=0; index_l<l_size; index_l++) {
+      psp->cl[index_md][(index_l*ic_ic_size+task[6*index_task+1])*psp->ct_size+task[6*index_task+0]] = 0.;
+    }
+  }
+
+  for (index_task=0; index_task<task_size; index_task++) {
+    for (index_l=0; index_l<l_size; index_l++) {
+      psp->cl[index_md][(index_l*ic_ic_size+task[6*index_task+1])*psp->ct_size+task[6*index_task+0]]
+        += task_factor[index_task]*result[index_task*l_size+index_l];
+    }
+  }
+
+  /** - free the shared tables (the kernel weights stay in the cache of the fftlog tool) */
+
+  free(result);
+  free(task);
+  free(task_factor);
+  free(psf->pk);
+  for (index_source=0; index_source<psf->source_size*ic_size; index_source++)
+    free(psf->source[index_source]);
+  free(psf->source);
+  free(psf->window_source);
+  free(psf->chi_min);
+  free(psf->dchi);
+  free(psf->window);
+  free(psf->ddwindow);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Sample one source of the perturbation module at the FFTLog
+ * wavenumbers (frozen at its edge values outside the range of the C_l's), for all its values of conformal time,
+ * with the same non-linear corrections and the same spline
+ * interpolation in k as in the transfer module.
+ *
+ * @param ppt       Input: pointer to perturbation structure
+ * @param pnl       Input: pointer to nonlinear structure
+ * @param psp       Input: pointer to spectra structure (for error messages)
+ * @param psf       Input: pointer to FFTLog tables, with the wavenumbers already defined
+ * @param index_md  Input: index of mode
+ * @param index_ic  Input: index of initial condition
+ * @param index_tp  Input: index of source type (delta_m or phi+psi)
+ * @param source    Output: sampled source, source[index_tau*psf->k_in_size+index_k]
+ * @return the error status
+ */
+
+int spectra_fftlog_sources(
+                           struct perturbs * ppt,
+                           struct nonlinear * pnl,
+                           struct spectra * psp,
+                           struct spectra_fftlog * psf,
+                           int index_md,
+                           int index_ic,
+                           int index_tp,
+                           double * source
+                           ) {
+
+  int index_k,index_q,index_tau,k_size;
+  double k,h,a,b;
+  double * pert_source;
+  double * pert_source_spline;
+
+  k_size = ppt->k_size[index_md];
+
+  class_alloc(pert_source,ppt->tau_size*k_size*sizeof(double),psp->error_message);
+  class_alloc(pert_source_spline,ppt->tau_size*k_size*sizeof(double),psp->error_message);
+
+  for (index_tau=0; index_tau<ppt->tau_size; index_tau++) {
+    for (index_k=0; index_k<k_size; index_k++) {
+      pert_source[index_tau*k_size+index_k] = ppt->sources[index_md][index_ic*ppt->tp_size[index_md]+index_tp][index_tau*k_size+index_k];
+      if (pnl->method != nl_none)
+        pert_source[index_tau*k_size+index_k] *= pnl->nl_corr_density[pnl->index_pk_m][index_tau*k_size+index_k];
+    }
+  }
+
+  class_call(array_spline_table_columns2(ppt->k[index_md],
+                                         k_size,
+                                         pert_source,
+                                         ppt->tau_size,
+                                         pert_source_spline,
+                                         _SPLINE_EST_DERIV_,
+                                         psp->error_message),
              psp->error_message,
-             "asked for negative redshift z=%e",psp->z_max_pk);
+             psp->error_message);
+
+  index_k = 0;
+
+  for (index_q=0; index_q<psf->k_in_size; index_q++) {
+
+    /* beyond the range of the C_l's, the source is frozen at its edge value (and damped by the taper) */
+    k = exp(psf->ln_k0+(psf->index_k_min+index_q)*psf->dlnk);
+    k = MAX(ppt->k[index_md][0],MIN(k,ppt->k[index_md][ppt->k_size_cl[index_md]-1]));
+
+    while ((index_k+2 < k_size) && (ppt->k[index_md][index_k+1] < k))
+      index_k++;
+
+    h = ppt->k[index_md][index_k+1]-ppt->k[index_md][index_k];
+    b = (k-ppt->k[index_md][index_k])/h;
+    a = 1.-b;
 
-  /* if z_max_pk=0, there is just one value to store */
-  if (psp->z_max_pk == 0.) {
-    psp->ln_tau_size=1;
+    for (index_tau=0; index_tau<ppt->tau_size; index_tau++) {
+      source[index_tau*psf->k_in_size+index_q] =
+        a * pert_source[index_tau*k_size+index_k]
+        + b * pert_source[index_tau*k_size+index_k+1]
+        + ((a*a*a-a) * pert_source_spline[index_tau*k_size+index_k]
+           +(b*b*b-b) * pert_source_spline[index_tau*k_size+index_k+1])*h*h/6.0;
+    }
   }
 
-  /* if z_max_pk>0, store several values (with a comfortable margin above z_max_pk) in view of interpolation */
-  else{
+  free(pert_source);
+  free(pert_source_spline);
 
-    /* find the first relevant value of tau (last value in the table tau_ampling before tau(z_max)) and infer the number of values of tau at which P(k) must be stored */
+  return _SUCCESS_;
 
-    class_call(background_tau_of_z(pba,psp->z_max_pk,&tau_min),
-               pba->error_message,
+}
+
+/**
+ * Tabulate one window function, multiplied by the comoving distance
+ * chi, on a uniform grid in chi, and spline it. For density number
+ * counts, the window is the bias times the normalized selection
+ * function, over the range of transfer_selection_times(). For galaxy
+ * lensing, it is the lensing kernel computed as in transfer_sources()
+ * (with the same sign convention),
+ *
+ * \f[ \chi W(\chi) = \int_{\chi_s > \chi} d\chi_s \frac{\chi-\chi_s}{\chi_s} W_s(\chi_s) , \f]
+ *
+ * with the same sampling of the sources \f$ W_s \f$, over
+ * \f$ [0,\chi_s^{max}] \f$.
+ *
+ * @param ppr        Input: pointer to precision structure
+ * @param pba        Input: pointer to background structure
+ * @param ppt        Input: pointer to perturbation structure
+ * @param ptr        Input: pointer to transfers structure
+ * @param psp        Input: pointer to spectra structure (for error messages)
+ * @param psf        Input/Output: pointer to FFTLog tables
+ * @param bin        Input: index of redshift bin
+ * @param is_lensing Input: _TRUE_ for galaxy lensing, _FALSE_ for density
+ * @param index_w    Input: index of the window in the FFTLog tables
+ * @return the error status
+ */
+
+int spectra_fftlog_window(
+                          struct precision * ppr,
+                          struct background * pba,
+                          struct perturbs * ppt,
+                          struct transfers * ptr,
+                          struct spectra * psp,
+                          struct spectra_fftlog * psf,
+                          int bin,
+                          short is_lensing,
+                          int index_w
+                          ) {
+
+  int index_chi,index_s,chi_size,source_size;
+  double tau0,tau_min,tau_mean,tau_max,chi,chi_max;
+  double * tau0_minus_tau;
+  double * w_trapz;
+  double * selection;
+  double * pvecback;
+  double * window;
+  double * chi_grid;
+
+  tau0 = pba->conformal_age;
+  chi_size = psf->chi_size;
+  window = psf->window+index_w*chi_size;
+
+  class_call(transfer_selection_times(ppr,pba,ppt,ptr,bin,&tau_min,&tau_mean,&tau_max),
+             ptr->error_message,
+             psp->error_message);
+
+  class_alloc(pvecback,pba->bg_size*sizeof(double),psp->error_message);
+
+  if (is_lensing == _FALSE_) {
+
+    /* the grid of transfer_selection_compute() goes backward in chi */
+
+    psf->chi_min[index_w] = tau0-tau_max;
+    psf->dchi[index_w] = (tau_max-tau_min)/(chi_size-1);
+
+    class_alloc(tau0_minus_tau,chi_size*sizeof(double),psp->error_message);
+    class_alloc(w_trapz,chi_size*sizeof(double),psp->error_message);
+    class_alloc(selection,chi_size*sizeof(double),psp->error_message);
+
+    for (index_chi=0; index_chi<chi_size; index_chi++)
+      tau0_minus_tau[index_chi] = psf->chi_min[index_w]+(chi_size-1-index_chi)*psf->dchi[index_w];
+
+    class_call(array_trapezoidal_mweights(tau0_minus_tau,chi_size,w_trapz,psp->error_message),
+               psp->error_message,
+               psp->error_message);
+
+    class_call(transfer_selection_compute(ppr,pba,ppt,ptr,selection,tau0_minus_tau,w_trapz,chi_size,pvecback,tau0,bin),
+               ptr->error_message,
                psp->error_message);
 
-    index_tau=0;
-    class_test((tau_min <= ppt->tau_sampling[index_tau]),
+    for (index_chi=0; index_chi<chi_size; index_chi++)
+      window[chi_size-1-index_chi] = tau0_minus_tau[index_chi]*ptr->selection_bias[bin]*selection[index_chi];
+
+  }
+  else {
+
+    source_size = ppr->selection_sampling;
+
+    class_alloc(tau0_minus_tau,source_size*sizeof(double),psp->error_message);
+    class_alloc(w_trapz,source_size*sizeof(double),psp->error_message);
+    class_alloc(selection,source_size*sizeof(double),psp->error_message);
+
+    class_call(transfer_selection_sampling(ppr,pba,ppt,ptr,bin,tau0_minus_tau,source_size),
+               ptr->error_message,
+               psp->error_message);
+
+    class_call(array_trapezoidal_mweights(tau0_minus_tau,source_size,w_trapz,psp->error_message),
                psp->error_message,
-               "you asked for zmax=%e, i.e. taumin=%e, smaller than or equal to the first possible value =%e; it should be strictly bigger for a successfull interpolation",psp->z_max_pk,tau_min,ppt->tau_sampling[0]);
+               psp->error_message);
 
-    while (ppt->tau_sampling[index_tau] < tau_min){
-      index_tau++;
+    class_call(transfer_selection_compute(ppr,pba,ppt,ptr,selection,tau0_minus_tau,w_trapz,source_size,pvecback,tau0,bin),
+               ptr->error_message,
+               psp->error_message);
+
+    chi_max = tau0-tau_min;
+    psf->chi_min[index_w] = 0.;
+    psf->dchi[index_w] = chi_max/(chi_size-1);
+
+    for (index_chi=0; index_chi<chi_size; index_chi++) {
+      chi = index_chi*psf->dchi[index_w];
+      window[index_chi] = 0.;
+      for (index_s=0; index_s<source_size; index_s++) {
+        if ((tau0_minus_tau[index_s] > 0.) && (tau0_minus_tau[index_s] > chi))
+          window[index_chi] += (chi-tau0_minus_tau[index_s])/tau0_minus_tau[index_s]*selection[index_s]*w_trapz[index_s];
+      }
     }
-    index_tau --;
-    class_test(index_tau<0,
-               psp->error_message,
-               "by construction, this should never happen, a bug must have been introduced somewhere");
+  }
 
-    /* whenever possible, take a few more values in to avoid boundary effects in the interpolation */
-    if (index_tau>0) index_tau--;
-    if (index_tau>0) index_tau--;
-    if (index_tau>0) index_tau--;
-    if (index_tau>0) index_tau--;
-    psp->ln_tau_size=ppt->tau_size-index_tau;
+  class_alloc(chi_grid,chi_size*sizeof(double),psp->error_message);
 
+  for (index_chi=0; index_chi<chi_size; index_chi++)
+    chi_grid[index_chi] = psf->chi_min[index_w]+index_chi*psf->dchi[index_w];
+
+  class_call(array_spline_table_lines(chi_grid,
+                                      chi_size,
+                                      window,
+                                      1,
+                                      psf->ddwindow+index_w*chi_size,
+                                      _SPLINE_EST_DERIV_,
+                                      psp->error_message),
+             psp->error_message,
+             psp->error_message);
+
+  free(chi_grid);
+  free(tau0_minus_tau);
+  free(w_trapz);
+  free(selection);
+  free(pvecback);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Integral of one pair of windows over the region where the distance
+ * of the inner window is smaller than that of the outer window, for
+ * all multipoles of the FFTLog kernel table. For each sampled distance
+ * \f$ \chi_1 \f$ of the outer window, and each node \f$ t_j \f$ of the
+ * grid in \f$ t = \chi_2/\chi_1 \f$ where the inner window does not
+ * vanish, the integrand in k is decomposed into complex power laws
+ * with coefficients \f$ c_m \f$ (see fftlog_coefficients()), and
+ *
+ * \f[ R_l = \sum_{\chi_1} w(\chi_1)\, {\rm Re} \sum_m \chi_1^{1-s_m} \sum_j W_{l,j,m} \, c_m(\chi_1, t_j) \f]
+ *
+ * with trapezoidal weights \f$ w(\chi_1) \f$ and the kernel weights
+ * \f$ W_{l,j,m} \f$ of fftlog_kernel_get().
+ *
+ * @param pba           Input: pointer to background structure
+ * @param ppt           Input: pointer to perturbation structure
+ * @param psp           Input: pointer to spectra structure (for error messages)
+ * @param psf           Input: pointer to FFTLog tables
+ * @param index_md      Input: index of mode
+ * @param index_w_out   Input: index of outer window
+ * @param index_ic_out  Input: index of initial condition of outer window
+ * @param index_w_in    Input: index of inner window
+ * @param index_ic_in   Input: index of initial condition of inner window
+ * @param index_ic1_ic2 Input: index of the pair of initial conditions
+ * @param result        Output: integral for each multipole of the kernel table (added to input values)
+ * @return the error status
+ */
+
+int spectra_fftlog_region(
+                          struct background * pba,
+                          struct perturbs * ppt,
+                          struct spectra * psp,
+                          struct spectra_fftlog * psf,
+                          int index_md,
+                          int index_w_out,
+                          int index_ic_out,
+                          int index_w_in,
+                          int index_ic_in,
+                          int index_ic1_ic2,
+                          double * result
+                          ) {
+
+  struct fftlog_kernel * pfk;
+  int k_in_size,m_size,t_size,chi_size,l_size;
+  int index_chi,index_t,index_t_first,index_t_last,index_l,index_m,index_k,index_tau;
+  int inf,sup,mid;
+  double tau0,tau,chi_out,chi_in,chi_max_in,quad,window_out,window_in,a,b,weight_tau;
+  double eta,amplitude,phase,q_re,q_im;
+  double * source_out;
+  double * source_in;
+  double * pk;
+  double * window;
+  double * ddwindow;
+  double * s_out;
+  double * f;
+  double * work;
+  double * coef;
+  double * sum;
+  double * weight;
+
+  if ((psf->window_source[index_w_out] == 1) && (psf->window_source[index_w_in] == 1))
+    pfk = psf->pfk[1];
+  else
+    pfk = psf->pfk[0];
+  k_in_size = psf->k_in_size;
+  m_size = pfk->m_size;
+  t_size = pfk->t_size;
+  l_size = pfk->l_size;
+  chi_size = psf->chi_size;
+  tau0 = pba->conformal_age;
+
+  source_out = psf->source[psf->window_source[index_w_out]*psp->ic_size[index_md]+index_ic_out];
+  source_in = psf->source[psf->window_source[index_w_in]*psp->ic_size[index_md]+index_ic_in];
+  pk = psf->pk+index_ic1_ic2*k_in_size;
+  window = psf->window+index_w_in*chi_size;
+  ddwindow = psf->ddwindow+index_w_in*chi_size;
+  chi_max_in = psf->chi_min[index_w_in]+(chi_size-1)*psf->dchi[index_w_in];
+
+  class_alloc(s_out,k_in_size*sizeof(double),psp->error_message);
+  class_calloc(f,psf->k_size,sizeof(double),psp->error_message);
+  class_alloc(work,2*psf->k_size*sizeof(double),psp->error_message);
+  class_alloc(coef,2*m_size*sizeof(double),psp->error_message);
+  class_alloc(sum,2*l_size*m_size*sizeof(double),psp->error_message);
+
+  /* find the interval of conformal time of the sources containing tau, and the weight of its upper end */
+#define _SPECTRA_FFTLOG_TAU_(tau)                                       \
+  {                                                                     \
+    inf = 0;                                                            \
+    sup = ppt->tau_size-1;                                              \
+    while (sup-inf > 1) {                                               \
+      mid = (inf+sup)/2;                                                \
+      if (ppt->tau_sampling[mid] > tau) sup = mid; else inf = mid;      \
+    }                                                                   \
+    index_tau = inf;                                                    \
+    weight_tau = (tau-ppt->tau_sampling[inf])/(ppt->tau_sampling[sup]-ppt->tau_sampling[inf]); \
+    weight_tau = MAX(0.,MIN(1.,weight_tau));                            \
+  }
+
+  for (index_chi=0; index_chi<chi_size; index_chi++) {
+
+    chi_out = psf->chi_min[index_w_out]+index_chi*psf->dchi[index_w_out];
+
+    if (chi_out <= 0.)
+      continue;
+
+    window_out = psf->window[index_w_out*chi_size+index_chi]/chi_out;
+
+    if (window_out == 0.)
+      continue;
+
+    /** - nodes in t where the inner window does not vanish (t=0 excluded) */
+
+    index_t_first = MAX(1,(int)ceil(t_size*psf->chi_min[index_w_in]/chi_out));
+    index_t_last = MIN(t_size,(int)floor(t_size*chi_max_in/chi_out));
+
+    if (index_t_first > index_t_last)
+      continue;
+
+    quad = psf->dchi[index_w_out];
+    if ((index_chi == 0) || (index_chi == chi_size-1))
+      quad *= 0.5;
+
+    /** - primordial spectrum times outer source */
+
+    tau = tau0-chi_out;
+    _SPECTRA_FFTLOG_TAU_(tau);
+
+    for (index_k=0; index_k<k_in_size; index_k++) {
+      s_out[index_k] = pk[index_k]*window_out*
+        ((1.-weight_tau)*source_out[index_tau*k_in_size+index_k]+weight_tau*source_out[(index_tau+1)*k_in_size+index_k]);
+    }
+
+    for (index_m=0; index_m<2*l_size*m_size; index_m++)
+      sum[index_m] = 0.;
+
+    for (index_t=index_t_first; index_t<=index_t_last; index_t++) {
+
+      /** - inner window (spline on the uniform grid) and source */
+
+      chi_in = chi_out*index_t/t_size;
+
+      index_k = (int)((chi_in-psf->chi_min[index_w_in])/psf->dchi[index_w_in]);
+      index_k = MAX(0,MIN(chi_size-2,index_k));
+      b = (chi_in-psf->chi_min[index_w_in])/psf->dchi[index_w_in]-index_k;
+      a = 1.-b;
+      window_in = (a*window[index_k]+b*window[index_k+1]
+                   +((a*a*a-a)*ddwindow[index_k]+(b*b*b-b)*ddwindow[index_k+1])
+                   *psf->dchi[index_w_in]*psf->dchi[index_w_in]/6.)/chi_in;
+
+      tau = tau0-chi_in;
+      _SPECTRA_FFTLOG_TAU_(tau);
+
+      for (index_k=0; index_k<k_in_size; index_k++) {
+        f[psf->index_k_min+index_k] = s_out[index_k]*window_in*
+          ((1.-weight_tau)*source_in[index_tau*k_in_size+index_k]+weight_tau*source_in[(index_tau+1)*k_in_size+index_k]);
+      }
+
+      /** - power-law decomposition in k, and sum of the kernel weights of this node */
+
+      class_call(fftlog_coefficients(f,psf->k_size,psf->dlnk,psf->ln_k0,pfk->bias,work,coef,psp->error_message),
+                 psp->error_message,
+                 psp->error_message);
+
+      for (index_l=0; index_l<l_size; index_l++) {
+
+        if (pfk->index_t_min[index_l] > index_t)
+          continue;
+
+        weight = pfk->weight+2*((index_l*(t_size+1)+index_t)*m_size);
+
+        for (index_m=0; index_m<m_size; index_m++) {
+          sum[2*(index_l*m_size+index_m)] += weight[2*index_m]*coef[2*index_m]-weight[2*index_m+1]*coef[2*index_m+1];
+          sum[2*(index_l*m_size+index_m)+1] += weight[2*index_m]*coef[2*index_m+1]+weight[2*index_m+1]*coef[2*index_m];
+        }
+      }
+    }
+
+    /** - factor \f$ \chi_1^{1-s_m} \f$ and outer trapezoidal weight */
+
+    for (index_m=0; index_m<m_size; index_m++) {
+
+      eta = 2.*_PI_*index_m/(psf->k_size*psf->dlnk);
+      amplitude = quad*pow(chi_out,1.-pfk->bias);
+      phase = -eta*log(chi_out);
+      q_re = amplitude*cos(phase);
+      q_im = amplitude*sin(phase);
+
+      for (index_l=0; index_l<l_size; index_l++) {
+        result[index_l] += q_re*sum[2*(index_l*m_size+index_m)]-q_im*sum[2*(index_l*m_size+index_m)+1];
+      }
+    }
   }
 
+#undef _SPECTRA_FFTLOG_TAU_
+
+  free(s_out);
+  free(f);
+  free(work);
+  free(coef);
+  free(sum);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * This routine computes the values of k and tau at which the matter
+ * power spectra \f$ P(k,\tau)\f$ and the matter transfer functions \f$ T_i(k,\tau)\f$
+ * will be stored.
+ *
+ * @param pba Input: pointer to background structure (for z to tau conversion)
+ * @param ppt Input: pointer to perturbation structure (contain source functions)
+ * @param pnl Input: pointer to nonlinear structure (contain nonlinear corrections)
+ * @param psp Input/Output: pointer to spectra structure
+ * @return the error status
+ */
+
+int spectra_k_and_tau(
+                      struct background * pba,
+                      struct perturbs * ppt,
+                      struct nonlinear * pnl,
+                      struct spectra * psp
+                      ) {
+
+  /** Summary: */
+
+  /** - define local variables */
+
+  int index_k;
+  int index_tau;
+  int index_tau_min_nl;
+
+  /** - check the presence of scalar modes */
+
+  class_test((ppt->has_scalars == _FALSE_),
+             psp->error_message,
+             "you cannot ask for matter power spectrum since you turned off scalar modes");
+
+  /** - check the maximum redshift z_max_pk at which \f$P(k,z)\f$ and \f$ T_i(k,z)\f$ should be
+      computable by interpolation. If it is equal to zero, only \f$ P(k,z=0)\f$
+      needs to be computed. If it is higher, we will store in a table
+      various P(k,tau) at several values of tau generously encompassing
+      the range 0<z<z_max_pk */
+
+  class_call(nonlinear_pk_l_index_tau_min(pba,ppt,psp->z_max_pk,&index_tau,psp->error_message),
+             psp->error_message,
+             psp->error_message);
+
+  psp->ln_tau_size=ppt->tau_size-index_tau;
+
   /** - allocate and fill table of tau values at which \f$P(k,\tau)\f$ and \f$T_i(k,\tau)\f$ are stored */
 
   class_alloc(psp->ln_tau,sizeof(double)*psp->ln_tau_size,psp->error_message);
@@ -2902,8 +4004,9 @@ int spectra_k_and_tau(
 }
 
 /**
- * This routine computes a table of values for all matter power spectra P(k),
- * given the source functions and primordial spectra.
+ * This routine fills the table of values of all matter power spectra P(k),
+ * copying the linear spectra computed once by the nonlinear module
+ * (see nonlinear_pk_linear()) and applying the non-linear corrections.
  *
  * @param pba Input: pointer to background structure (will provide H, Omega_m at redshift of interest)
  * @param ppt Input: pointer to perturbation structure (contain source functions)
@@ -2926,18 +4029,12 @@ int spectra_pk(
   /** - define local variables */
 
   int index_md;
-  int index_ic1,index_ic2,index_ic1_ic1,index_ic2_ic2,index_ic1_ic2;
   int index_k;
   int index_tau;
+  int index_tau_l;
   int delta_index_nl=0;
   int delta_index_nl_cb=0;
-  double * primordial_pk; /* array with argument primordial_pk[index_ic_ic] */
-  double source_ic1;
-  double source_ic2;
-  double pk_tot=0.,ln_pk_tot=0.;
-  double source_ic1_cb;
-  double source_ic2_cb;
-  double pk_cb_tot=0.,ln_pk_cb_tot=0.;
+  double * nl_corr;
 
   /** - check the presence of scalar modes */
 
@@ -2947,11 +4044,7 @@ int spectra_pk(
 
   index_md = psp->index_md_scalars;
 
-  /** - allocate temporary vectors where the primordial spectrum and the background quantities will be stored */
-
-  class_alloc(primordial_pk,psp->ic_ic_size[index_md]*sizeof(double),psp->error_message);
-
-  /** - allocate and fill array of \f$P(k,\tau)\f$ values */
+  /** - allocate array of \f$P(k,\tau)\f$ values */
 
   class_alloc(psp->ln_pk,
               sizeof(double)*psp->ln_tau_size*psp->ln_k_size*psp->ic_ic_size[index_md],
@@ -3015,135 +4108,59 @@ int spectra_pk(
     psp->ln_pk_cb_nl = NULL;
   }
 
-  for (index_tau=0 ; index_tau < psp->ln_tau_size; index_tau++) {
-    for (index_k=0; index_k<psp->ln_k_size; index_k++) {
-
-      class_call(primordial_spectrum_at_k(ppm,index_md,logarithmic,psp->ln_k[index_k],primordial_pk),
-                 ppm->error_message,
-                 psp->error_message);
+  /** - copy the linear spectra at the relevant values of tau from
+      the table computed once in the nonlinear module */
 
-      pk_tot =0;
-      pk_cb_tot = 0.;
-      /* curvature primordial spectrum:
-         P_R(k) = 1/(2pi^2) k^3 <R R>
-         so, primordial curvature correlator:
-         <R R> = (2pi^2) k^-3 P_R(k)
-         so, delta_m correlator:
-         P(k) = <delta_m delta_m> = (2pi^2) k^-3 (source_m)^2 P_R(k)
+  index_tau_l = ppt->tau_size-psp->ln_tau_size-pnl->index_tau_min_l;
 
-         For isocurvature or cross adiabatic-isocurvature parts,
-         replace one or two 'R' by 'S_i's */
-
-      /* part diagonal in initial conditions */
-      for (index_ic1 = 0; index_ic1 < psp->ic_size[index_md]; index_ic1++) {
-
-        index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic1,psp->ic_size[index_md]);
-
-        source_ic1 = ppt->sources[index_md]
-          [index_ic1 * ppt->tp_size[index_md] + ppt->index_tp_delta_m]
-          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
-
-        psp->ln_pk[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2] =
-          log(2.*_PI_*_PI_/exp(3.*psp->ln_k[index_k])
-              *source_ic1*source_ic1
-              *exp(primordial_pk[index_ic1_ic2]));
-
-        pk_tot += exp(psp->ln_pk[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2]);
-
-        if(pba->has_ncdm){
-
-          source_ic1_cb = ppt->sources[index_md]
-            [index_ic1 * ppt->tp_size[index_md] + ppt->index_tp_delta_cb]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
-
-          psp->ln_pk_cb[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2] =
-            log(2.*_PI_*_PI_/exp(3.*psp->ln_k[index_k])
-                *source_ic1_cb*source_ic1_cb
-                *exp(primordial_pk[index_ic1_ic2]));
-
-          pk_cb_tot += exp(psp->ln_pk_cb[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2]);
-
-        }
-
-      }
-
-      /* part non-diagonal in initial conditions */
-      for (index_ic1 = 0; index_ic1 < psp->ic_size[index_md]; index_ic1++) {
-        for (index_ic2 = index_ic1+1; index_ic2 < psp->ic_size[index_md]; index_ic2++) {
-
-          index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,psp->ic_size[index_md]);
-          index_ic1_ic1 = index_symmetric_matrix(index_ic1,index_ic1,psp->ic_size[index_md]);
-          index_ic2_ic2 = index_symmetric_matrix(index_ic2,index_ic2,psp->ic_size[index_md]);
-
-          if (psp->is_non_zero[index_md][index_ic1_ic2] == _TRUE_) {
-
-            source_ic1 = ppt->sources[index_md]
-              [index_ic1 * ppt->tp_size[index_md] + ppt->index_tp_delta_m]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
-
-            source_ic2 = ppt->sources[index_md]
-              [index_ic2 * ppt->tp_size[index_md] + ppt->index_tp_delta_m]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
-
-            psp->ln_pk[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2] =
-              primordial_pk[index_ic1_ic2]*SIGN(source_ic1)*SIGN(source_ic2);
-
-            pk_tot += psp->ln_pk[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2]
-              * sqrt(psp->ln_pk[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic1]
-                     * psp->ln_pk[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic2_ic2]);
-
-            if(pba->has_ncdm){
-
-              source_ic1_cb = ppt->sources[index_md]
-                [index_ic1 * ppt->tp_size[index_md] + ppt->index_tp_delta_cb]
-                [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
-
-              source_ic2_cb = ppt->sources[index_md]
-                [index_ic2 * ppt->tp_size[index_md] + ppt->index_tp_delta_cb]
-                [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
-
-              psp->ln_pk_cb[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2] =
-                primordial_pk[index_ic1_ic2]*SIGN(source_ic1_cb)*SIGN(source_ic2_cb);
+  class_test((pnl->has_pk_l == _FALSE_) || (index_tau_l < 0),
+             psp->error_message,
+             "the nonlinear module did not compute the linear spectrum up to z_max_pk=%e",psp->z_max_pk);
 
-              pk_cb_tot += psp->ln_pk_cb[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2]
-                * sqrt(psp->ln_pk_cb[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic1]
-                       * psp->ln_pk_cb[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic2_ic2]);
+  memcpy(psp->ln_pk,
+         pnl->ln_pk_ic_l[pnl->index_pk_m] + index_tau_l*psp->ln_k_size*psp->ic_ic_size[index_md],
+         sizeof(double)*psp->ln_tau_size*psp->ln_k_size*psp->ic_ic_size[index_md]);
 
-            }
-
-          }
-          else {
-            psp->ln_pk[(index_tau * psp->ln_k_size + index_k)* psp->ic_ic_size[index_md] + index_ic1_ic2] = 0.;
-          }
-        }
-      }
+  memcpy(psp->ln_pk_l,
+         pnl->ln_pk_l[pnl->index_pk_m] + index_tau_l*psp->ln_k_size,
+         sizeof(double)*psp->ln_tau_size*psp->ln_k_size);
 
-      ln_pk_tot = log(pk_tot);
+  if (pba->has_ncdm) {
 
-      if(pba->has_ncdm) ln_pk_cb_tot = log(pk_cb_tot);
+    memcpy(psp->ln_pk_cb,
+           pnl->ln_pk_ic_l[pnl->index_pk_cb] + index_tau_l*psp->ln_k_size*psp->ic_ic_size[index_md],
+           sizeof(double)*psp->ln_tau_size*psp->ln_k_size*psp->ic_ic_size[index_md]);
 
-      psp->ln_pk_l[index_tau * psp->ln_k_size + index_k] = ln_pk_tot;
+    memcpy(psp->ln_pk_cb_l,
+           pnl->ln_pk_l[pnl->index_pk_cb] + index_tau_l*psp->ln_k_size,
+           sizeof(double)*psp->ln_tau_size*psp->ln_k_size);
+  }
 
-      if(pba->has_ncdm) psp->ln_pk_cb_l[index_tau * psp->ln_k_size + index_k] = ln_pk_cb_tot;
+  /** - if non-linear corrections are required, compute the total
+      non-linear spectra (m and cb share the same ln_tau_nl) */
 
-      /* if non-linear corrections required, compute the total non-linear matter power spectrum */
+  if (pnl->method != nl_none) {
 
-      if ((pnl->method != nl_none) && (index_tau >= delta_index_nl)) {
+    for (index_tau=delta_index_nl; index_tau < psp->ln_tau_size; index_tau++) {
 
-        psp->ln_pk_nl[(index_tau-delta_index_nl) * psp->ln_k_size + index_k] =
-          ln_pk_tot
-          + 2.*log(pnl->nl_corr_density[pnl->index_pk_m][(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k]);
+      nl_corr = pnl->nl_corr_density[pnl->index_pk_m] + (index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md];
 
+      for (index_k=0; index_k<psp->ln_k_size; index_k++) {
+        psp->ln_pk_nl[(index_tau-delta_index_nl) * psp->ln_k_size + index_k] =
+          psp->ln_pk_l[index_tau * psp->ln_k_size + index_k]
+          + 2.*log(nl_corr[index_k]);
       }
 
-      if((pba->has_ncdm) && (pnl->method != nl_none) && (index_tau >= delta_index_nl_cb)){
+      if (pba->has_ncdm) {
 
-        psp->ln_pk_cb_nl[(index_tau-delta_index_nl_cb) * psp->ln_k_size + index_k] =
-          ln_pk_cb_tot
-          + 2.*log(pnl->nl_corr_density[pnl->index_pk_cb][(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k]);
+        nl_corr = pnl->nl_corr_density[pnl->index_pk_cb] + (index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md];
 
+        for (index_k=0; index_k<psp->ln_k_size; index_k++) {
+          psp->ln_pk_cb_nl[(index_tau-delta_index_nl) * psp->ln_k_size + index_k] =
+            psp->ln_pk_cb_l[index_tau * psp->ln_k_size + index_k]
+            + 2.*log(nl_corr[index_k]);
+        }
       }
-
     }
   }
 
@@ -3205,6 +4222,59 @@ int spectra_pk(
 
   }
 
+  /**- compute the remaining coefficients of the bicubic splines of
+     \f$P(k,\tau)\f$ over (ln(k),ln(tau)), so that point queries by
+     spectra_pk_at_k_and_z() do not need to rebuild a spline in k */
+
+  class_call(spectra_pk_bicubic_table(psp,
+                                      psp->ln_tau,
+                                      psp->ln_tau_size,
+                                      psp->ln_pk,
+                                      psp->ic_ic_size[index_md],
+                                      &(psp->ddkln_pk),
+                                      &(psp->ddkddln_pk)),
+             psp->error_message,
+             psp->error_message);
+
+  class_call(spectra_pk_bicubic_table(psp,
+                                      psp->ln_tau,
+                                      psp->ln_tau_size,
+                                      psp->ln_pk_l,
+                                      1,
+                                      &(psp->ddkln_pk_l),
+                                      &(psp->ddkddln_pk_l)),
+             psp->error_message,
+             psp->error_message);
+
+  if (pba->has_ncdm) {
+
+    class_call(spectra_pk_bicubic_table(psp,
+                                        psp->ln_tau,
+                                        psp->ln_tau_size,
+                                        psp->ln_pk_cb,
+                                        psp->ic_ic_size[index_md],
+                                        &(psp->ddkln_pk_cb),
+                                        &(psp->ddkddln_pk_cb)),
+               psp->error_message,
+               psp->error_message);
+
+    class_call(spectra_pk_bicubic_table(psp,
+                                        psp->ln_tau,
+                                        psp->ln_tau_size,
+                                        psp->ln_pk_cb_l,
+                                        1,
+                                        &(psp->ddkln_pk_cb_l),
+                                        &(psp->ddkddln_pk_cb_l)),
+               psp->error_message,
+               psp->error_message);
+  }
+  else {
+    psp->ddkln_pk_cb = NULL;
+    psp->ddkddln_pk_cb = NULL;
+    psp->ddkln_pk_cb_l = NULL;
+    psp->ddkddln_pk_cb_l = NULL;
+  }
+
   /* compute sigma8 (mean variance today in sphere of radius 8/h Mpc */
 
   class_call(spectra_sigma(pba,ppm,psp,8./pba->h,0.,&(psp->sigma8)),
@@ -3261,9 +4331,246 @@ int spectra_pk(
 
       }
     }
+
+    class_call(spectra_pk_bicubic_table(psp,
+                                        psp->ln_tau_nl,
+                                        psp->ln_tau_nl_size,
+                                        psp->ln_pk_nl,
+                                        1,
+                                        &(psp->ddkln_pk_nl),
+                                        &(psp->ddkddln_pk_nl)),
+               psp->error_message,
+               psp->error_message);
+
+    if (pba->has_ncdm) {
+      class_call(spectra_pk_bicubic_table(psp,
+                                          psp->ln_tau_nl,
+                                          psp->ln_tau_nl_size,
+                                          psp->ln_pk_cb_nl,
+                                          1,
+                                          &(psp->ddkln_pk_cb_nl),
+                                          &(psp->ddkddln_pk_cb_nl)),
+                 psp->error_message,
+                 psp->error_message);
+    }
+    else {
+      psp->ddkln_pk_cb_nl = NULL;
+      psp->ddkddln_pk_cb_nl = NULL;
+    }
+  }
+  else {
+    psp->ddkln_pk_nl = NULL;
+    psp->ddkddln_pk_nl = NULL;
+    psp->ddkln_pk_cb_nl = NULL;
+    psp->ddkddln_pk_cb_nl = NULL;
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * This routine completes the coefficients of a bicubic (tensor-product)
+ * spline of a table ln_pk[(index_tau * psp->ln_k_size + index_k) * y_size + index_y]
+ * over (ln(k), ln(tau)), given that the second derivatives with respect
+ * to ln(tau) have already been computed (e.g. ddln_pk).
+ *
+ * It allocates and fills the second derivatives with respect to ln(k)
+ * at each tau (natural spline, as in spectra_pk_at_k_and_z()), and
+ * the second derivatives of the latter with respect to ln(tau)
+ * (estimated first derivative at the edges, as for ddln_pk). Since both
+ * spline operations are linear and act on different indices,
+ * interpolating with these coefficients gives the same result as
+ * first interpolating in tau and then building a spline in k.
+ *
+ * @param psp         Input: pointer to spectra structure (for ln_k and error message)
+ * @param ln_tau      Input: table of ln(tau) values
+ * @param ln_tau_size Input: size of ln_tau
+ * @param ln_pk       Input: table to be interpolated
+ * @param y_size      Input: number of columns per (tau,k) point (e.g. number of pairs of initial conditions)
+ * @param ddkln_pk    Output: pointer to allocated table of second derivatives with respect to ln(k)
+ * @param ddkddln_pk  Output: pointer to allocated table of mixed derivatives (NULL if ln_tau_size=1)
+ * @return the error status
+ */
+
+int spectra_pk_bicubic_table(
+                             struct spectra * psp,
+                             double * ln_tau,
+                             int ln_tau_size,
+                             double * ln_pk,
+                             int y_size,
+                             double ** ddkln_pk,
+                             double ** ddkddln_pk
+                             ) {
+
+  int index_tau;
+  double * ddk;
+  int abort;
+
+  class_alloc(*ddkln_pk,
+              sizeof(double)*ln_tau_size*psp->ln_k_size*y_size,
+              psp->error_message);
+
+  /* the splines in ln(k) at different values of tau are independent */
+
+  ddk = *ddkln_pk;
+  abort = _FALSE_;
+
+#pragma omp parallel for schedule (static) shared(psp,ln_pk,y_size,ddk,abort) private(index_tau)
+
+  for (index_tau=0; index_tau<ln_tau_size; index_tau++) {
+
+#pragma omp flush(abort)
+
+    class_call_parallel(array_spline_table_lines(psp->ln_k,
+                                                 psp->ln_k_size,
+                                                 ln_pk+index_tau*psp->ln_k_size*y_size,
+                                                 y_size,
+                                                 ddk+index_tau*psp->ln_k_size*y_size,
+                                                 _SPLINE_NATURAL_,
+                                                 psp->error_message),
+                        psp->error_message,
+                        psp->error_message);
+  }
+
+  if (abort == _TRUE_) return _FAILURE_;
+
+  if (ln_tau_size > 1) {
+
+    class_alloc(*ddkddln_pk,
+                sizeof(double)*ln_tau_size*psp->ln_k_size*y_size,
+                psp->error_message);
+
+    class_call(array_spline_table_lines(ln_tau,
+                                        ln_tau_size,
+                                        *ddkln_pk,
+                                        psp->ln_k_size*y_size,
+                                        *ddkddln_pk,
+                                        _SPLINE_EST_DERIV_,
+                                        psp->error_message),
+               psp->error_message,
+               psp->error_message);
+  }
+  else {
+    *ddkddln_pk = NULL;
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Evaluate a bicubic spline built by spectra_pk_bicubic_table() at
+ * one point (ln(k), ln(tau)), for all the y_size columns.
+ *
+ * Only the four tabulated k-columns bracketing ln(k) are read, so the
+ * cost does not depend on the number of k values (apart from the
+ * bisection locating the intervals), and nothing is allocated.
+ *
+ * @param psp          Input: pointer to spectra structure (for ln_k and error message)
+ * @param ln_tau       Input: table of ln(tau) values
+ * @param ln_tau_size  Input: size of ln_tau
+ * @param ln_pk        Input: tabulated values
+ * @param ddln_pk      Input: their second derivatives with respect to ln(tau) (unused if ln_tau_size=1)
+ * @param ddkln_pk     Input: their second derivatives with respect to ln(k)
+ * @param ddkddln_pk   Input: mixed derivatives (unused if ln_tau_size=1)
+ * @param y_size       Input: number of columns per (tau,k) point
+ * @param ln_k         Input: logarithm of wavenumber
+ * @param ln_tau_value Input: logarithm of conformal time
+ * @param result       Output: interpolated values, array of size y_size (must be already allocated)
+ * @return the error status
+ */
+
+int spectra_pk_bicubic_at_k_and_tau(
+                                    struct spectra * psp,
+                                    double * ln_tau,
+                                    int ln_tau_size,
+                                    double * ln_pk,
+                                    double * ddln_pk,
+                                    double * ddkln_pk,
+                                    double * ddkddln_pk,
+                                    int y_size,
+                                    double ln_k,
+                                    double ln_tau_value,
+                                    double * result
+                                    ) {
+
+  int inf,sup,mid;
+  int inf_tau=0,sup_tau=0;
+  int index_y,index_knode;
+  int row_inf,row_sup;
+  double h,a,b;
+  double h_tau=0.,a_tau=1.,b_tau=0.;
+  double y[2],ddy[2];
+
+  /** - locate ln(k) in the ln_k table */
+
+  class_test((ln_k < psp->ln_k[0]) || (ln_k > psp->ln_k[psp->ln_k_size-1]),
+             psp->error_message,
+             "ln(k)=%e out of bounds [%e:%e]",ln_k,psp->ln_k[0],psp->ln_k[psp->ln_k_size-1]);
+
+  inf=0;
+  sup=psp->ln_k_size-1;
+  while (sup-inf > 1) {
+    mid=(inf+sup)/2;
+    if (ln_k < psp->ln_k[mid]) {sup=mid;}
+    else {inf=mid;}
+  }
+
+  h = psp->ln_k[sup]-psp->ln_k[inf];
+  b = (ln_k-psp->ln_k[inf])/h;
+  a = 1.-b;
+
+  /** - locate ln(tau) in the ln_tau table (if there are several values) */
+
+  if (ln_tau_size > 1) {
+
+    class_test((ln_tau_value < ln_tau[0]) || (ln_tau_value > ln_tau[ln_tau_size-1]),
+               psp->error_message,
+               "ln(tau)=%e out of bounds [%e:%e]",ln_tau_value,ln_tau[0],ln_tau[ln_tau_size-1]);
+
+    inf_tau=0;
+    sup_tau=ln_tau_size-1;
+    while (sup_tau-inf_tau > 1) {
+      mid=(inf_tau+sup_tau)/2;
+      if (ln_tau_value < ln_tau[mid]) {sup_tau=mid;}
+      else {inf_tau=mid;}
+    }
+
+    h_tau = ln_tau[sup_tau]-ln_tau[inf_tau];
+    b_tau = (ln_tau_value-ln_tau[inf_tau])/h_tau;
+    a_tau = 1.-b_tau;
   }
 
-  free (primordial_pk);
+  /** - for each column, interpolate in tau the values and their
+      second derivatives in k at the two bracketing k nodes, then
+      interpolate in k */
+
+  for (index_y=0; index_y<y_size; index_y++) {
+
+    for (index_knode=0; index_knode<2; index_knode++) {
+
+      row_inf = (inf_tau*psp->ln_k_size+inf+index_knode)*y_size+index_y;
+
+      if (ln_tau_size > 1) {
+
+        row_sup = (sup_tau*psp->ln_k_size+inf+index_knode)*y_size+index_y;
+
+        y[index_knode] = a_tau*ln_pk[row_inf] + b_tau*ln_pk[row_sup]
+          + ((a_tau*a_tau*a_tau-a_tau)*ddln_pk[row_inf]
+             +(b_tau*b_tau*b_tau-b_tau)*ddln_pk[row_sup])*h_tau*h_tau/6.0;
+
+        ddy[index_knode] = a_tau*ddkln_pk[row_inf] + b_tau*ddkln_pk[row_sup]
+          + ((a_tau*a_tau*a_tau-a_tau)*ddkddln_pk[row_inf]
+             +(b_tau*b_tau*b_tau-b_tau)*ddkddln_pk[row_sup])*h_tau*h_tau/6.0;
+      }
+      else {
+        y[index_knode] = ln_pk[row_inf];
+        ddy[index_knode] = ddkln_pk[row_inf];
+      }
+    }
+
+    result[index_y] = a*y[0] + b*y[1]
+      + ((a*a*a-a)*ddy[0] + (b*b*b-b)*ddy[1])*h*h/6.0;
+  }
 
   return _SUCCESS_;
 }
@@ -3471,6 +4778,138 @@ int spectra_sigma_cb(
 
 }
 
+/**
+ * This routine computes sigma(R) at a list of redshifts.
+ *
+ * Same result as calling spectra_sigma() for each redshift, but the
+ * window function is computed only once, and P(k) is obtained at all
+ * tabulated wavenumbers with a single interpolation in time per
+ * redshift (with spectra_pk_at_z()) instead of one interpolation per
+ * wavenumber.
+ *
+ * @param pba     Input: pointer to background structure
+ * @param ppm     Input: pointer to primordial structure
+ * @param psp     Input: pointer to spectra structure
+ * @param R       Input: radius in Mpc
+ * @param z_array Input: values of redshift
+ * @param z_size  Input: number of values
+ * @param sigma   Output: array of size z_size with the variance in a sphere of radius R (dimensionless)
+ * @return the error status
+ */
+
+int spectra_sigma_at_z_vector(
+                              struct background * pba,
+                              struct primordial * ppm,
+                              struct spectra * psp,
+                              double R,
+                              double * z_array,
+                              int z_size,
+                              double * sigma
+                              ) {
+
+  double * pk;
+  double * pk_ic = NULL;
+  double * pk_cb = NULL;
+  double * pk_cb_ic = NULL;
+  double * k2W2;
+
+  double * array_for_sigma;
+  int index_num;
+  int index_k;
+  int index_y;
+  int index_ddy;
+  int index_z;
+  int i;
+
+  double k,W,x;
+
+  class_alloc(pk,psp->ln_k_size*sizeof(double),psp->error_message);
+  class_alloc(k2W2,psp->ln_k_size*sizeof(double),psp->error_message);
+  if (pba->has_ncdm)
+    class_alloc(pk_cb,psp->ln_k_size*sizeof(double),psp->error_message);
+  if (psp->ic_ic_size[psp->index_md_scalars]>1){
+    class_alloc(pk_ic,
+                psp->ln_k_size*psp->ic_ic_size[psp->index_md_scalars]*sizeof(double),
+                psp->error_message);
+    if (pba->has_ncdm)
+      class_alloc(pk_cb_ic,
+                  psp->ln_k_size*psp->ic_ic_size[psp->index_md_scalars]*sizeof(double),
+                  psp->error_message);
+  }
+
+  i=0;
+  index_k=i;
+  i++;
+  index_y=i;
+  i++;
+  index_ddy=i;
+  i++;
+  index_num=i;
+
+  class_alloc(array_for_sigma,
+              psp->ln_k_size*index_num*sizeof(double),
+              psp->error_message);
+
+  /** - the wavenumbers and window function do not depend on z */
+
+  for (i=0;i<psp->ln_k_size;i++) {
+    k=exp(psp->ln_k[i]);
+    if (i == (psp->ln_k_size-1)) k *= 0.9999999; // same as in spectra_sigma()
+    x=k*R;
+    W=3./x/x/x*(sin(x)-x*cos(x));
+    array_for_sigma[i*index_num+index_k]=k;
+    k2W2[i]=k*k*W*W;
+  }
+
+  for (index_z=0; index_z<z_size; index_z++) {
+
+    class_call(spectra_pk_at_z(pba,psp,linear,z_array[index_z],pk,pk_ic,pk_cb,pk_cb_ic),
+               psp->error_message,
+               psp->error_message);
+
+    for (i=0;i<psp->ln_k_size;i++)
+      array_for_sigma[i*index_num+index_y]=k2W2[i]*pk[i];
+
+    class_call(array_spline(array_for_sigma,
+                            index_num,
+                            psp->ln_k_size,
+                            index_k,
+                            index_y,
+                            index_ddy,
+                            _SPLINE_EST_DERIV_,
+                            psp->error_message),
+               psp->error_message,
+               psp->error_message);
+
+    class_call(array_integrate_all_spline(array_for_sigma,
+                                          index_num,
+                                          psp->ln_k_size,
+                                          index_k,
+                                          index_y,
+                                          index_ddy,
+                                          sigma+index_z,
+                                          psp->error_message),
+               psp->error_message,
+               psp->error_message);
+
+    sigma[index_z] = sqrt(sigma[index_z]/(2.*_PI_*_PI_));
+  }
+
+  free(array_for_sigma);
+  free(k2W2);
+  free(pk);
+  if (pba->has_ncdm)
+    free(pk_cb);
+  if (psp->ic_ic_size[psp->index_md_scalars]>1){
+    free(pk_ic);
+    if (pba->has_ncdm)
+      free(pk_cb_ic);
+  }
+
+  return _SUCCESS_;
+
+}
+
 /**
  * This routine computes a table of values for all matter power spectra P(k),
  * given the source functions and primordial spectra.
@@ -3489,102 +4928,230 @@ int spectra_matter_transfers(
 
   /** Summary: */
 
-  /** - define local variables */
+  /** - define local variables */
+
+  int index_md;
+  int index_tau;
+  double * pvecback_sp_long; /* array with argument pvecback_sp_long[pba->index_bg] */
+  double w_fld,dw_over_da_fld,integral_fld;
+
+  /* This code can be optionally compiled with the openmp option for parallel computation.
+     Inside parallel regions, the use of the command "return" is forbidden.
+     For error management, instead of "return _FAILURE_", we will set the variable below
+     to "abort = _TRUE_". This will lead to a "return _FAILURE_" jus after leaving the
+     parallel region. */
+  int abort;
+
+  /** - check the presence of scalar modes */
+
+  class_test((ppt->has_scalars == _FALSE_),
+             psp->error_message,
+             "you cannot ask for matter power spectrum since you turned off scalar modes");
+
+  index_md = psp->index_md_scalars;
+
+  /** - allocate and fill array of \f$ T_i(k,\tau)\f$ values */
+
+  class_alloc(psp->matter_transfer,sizeof(double)*psp->ln_tau_size*psp->ln_k_size*psp->ic_size[index_md]*psp->tr_size,psp->error_message);
+
+  /** - the equation of state of the fluid enters the weights of its velocity in theta_tot */
+
+  if (pba->has_fld == _TRUE_) {
+    class_call(background_w_fld(pba,0.,&w_fld,&dw_over_da_fld,&integral_fld), pba->error_message, psp->error_message);
+  }
+  else {
+    w_fld = 0.;
+  }
+
+  /** - fill the table for each value of tau. Different values of tau
+      are independent and can be computed in parallel. */
+
+  abort = _FALSE_;
+
+#pragma omp parallel                                                    \
+  shared(pba,ppt,psp,w_fld,abort)                                       \
+  private(index_tau,pvecback_sp_long)
+
+  {
+
+    class_alloc_parallel(pvecback_sp_long,pba->bg_size*sizeof(double),psp->error_message);
+
+#pragma omp for schedule (dynamic)
+
+    for (index_tau=0 ; index_tau < psp->ln_tau_size; index_tau++) {
+
+#pragma omp flush(abort)
+
+      class_call_parallel(spectra_matter_transfers_at_tau_index(pba,
+                                                                ppt,
+                                                                psp,
+                                                                index_tau,
+                                                                w_fld,
+                                                                pvecback_sp_long),
+                          psp->error_message,
+                          psp->error_message);
+
+    }
+
+    free(pvecback_sp_long);
+
+  } /* end of parallel region */
+
+  if (abort == _TRUE_) return _FAILURE_;
+
+  /**- if interpolation of \f$ P(k,\tau)\f$ will be needed (as a function of tau),
+     compute array of second derivatives in view of spline interpolation */
+
+  if (psp->ln_tau_size > 1) {
+
+    class_alloc(psp->ddmatter_transfer,sizeof(double)*psp->ln_tau_size*psp->ln_k_size*psp->ic_size[index_md]*psp->tr_size,psp->error_message);
+
+    class_call(array_spline_table_lines(psp->ln_tau,
+                                        psp->ln_tau_size,
+                                        psp->matter_transfer,
+                                        psp->ic_size[index_md]*psp->ln_k_size*psp->tr_size,
+                                        psp->ddmatter_transfer,
+                                        _SPLINE_EST_DERIV_,
+                                        psp->error_message),
+               psp->error_message,
+               psp->error_message);
+
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * This routine fills the table of transfer functions computed by
+ * spectra_matter_transfers() for one value of tau and all wavenumbers.
+ *
+ * @param pba              Input: pointer to background structure (will provide density of each species)
+ * @param ppt              Input: pointer to perturbation structure (contain source functions)
+ * @param psp              Input/Output: pointer to spectra structure
+ * @param index_tau        Input: index of tau in the table ln_tau
+ * @param w_fld            Input: equation of state of the fluid (if any)
+ * @param pvecback_sp_long Input: workspace of size pba->bg_size
+ * @return the error status
+ */
+
+int spectra_matter_transfers_at_tau_index(
+                                          struct background * pba,
+                                          struct perturbs * ppt,
+                                          struct spectra * psp,
+                                          int index_tau,
+                                          double w_fld,
+                                          double * pvecback_sp_long
+                                          ) {
 
   int index_md;
   int index_ic;
   int index_k;
-  int index_tau;
   int last_index_back;
-  double * pvecback_sp_long; /* array with argument pvecback_sp_long[pba->index_bg] */
   double delta_i,theta_i,rho_i;
   double delta_rho_tot,rho_tot;
   double rho_plus_p_theta_tot,rho_plus_p_tot;
   int n_ncdm;
-  double w_fld,dw_over_da_fld,integral_fld;
 
-  /** - check the presence of scalar modes */
+  index_md = psp->index_md_scalars;
 
-  class_test((ppt->has_scalars == _FALSE_),
-             psp->error_message,
-             "you cannot ask for matter power spectrum since you turned off scalar modes");
+  class_call(background_at_tau(pba,
+                               ppt->tau_sampling[index_tau-psp->ln_tau_size+ppt->tau_size],
+                               /* for this last argument we could have passed
+                                  exp(psp->ln_tau[index_tau]) but we would then loose
+                                  precision in the exp(log(x)) operation) */
+                               pba->long_info,
+                               pba->inter_normal,
+                               &last_index_back,
+                               pvecback_sp_long),
+             pba->error_message,
+             psp->error_message);
 
-  index_md = psp->index_md_scalars;
+  for (index_k=0; index_k<psp->ln_k_size; index_k++) {
 
-  /** - allocate and fill array of \f$ T_i(k,\tau)\f$ values */
+    for (index_ic = 0; index_ic < psp->ic_size[index_md]; index_ic++) {
 
-  class_alloc(psp->matter_transfer,sizeof(double)*psp->ln_tau_size*psp->ln_k_size*psp->ic_size[index_md]*psp->tr_size,psp->error_message);
+      delta_rho_tot=0.;
+      rho_tot=0.;
+      rho_plus_p_theta_tot=0.;
+      rho_plus_p_tot=0.;
 
-  /** - allocate temporary vectors where the background quantities will be stored */
+      /* T_g(k,tau) */
 
-  class_alloc(pvecback_sp_long,pba->bg_size*sizeof(double),psp->error_message);
+      rho_i = pvecback_sp_long[pba->index_bg_rho_g];
 
-  for (index_tau=0 ; index_tau < psp->ln_tau_size; index_tau++) {
+      if (ppt->has_source_delta_g == _TRUE_) {
 
-    class_call(background_at_tau(pba,
-                                 ppt->tau_sampling[index_tau-psp->ln_tau_size+ppt->tau_size],
-                                 /* for this last argument we could have passed
-                                    exp(psp->ln_tau[index_tau]) but we would then loose
-                                    precision in the exp(log(x)) operation) */
-                                 pba->long_info,
-                                 pba->inter_normal,
-                                 &last_index_back,
-                                 pvecback_sp_long),
-               pba->error_message,
-               psp->error_message);
+        delta_i = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_g]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-    for (index_k=0; index_k<psp->ln_k_size; index_k++) {
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_g] = delta_i;
 
-      for (index_ic = 0; index_ic < psp->ic_size[index_md]; index_ic++) {
+        delta_rho_tot += rho_i * delta_i;
 
-        delta_rho_tot=0.;
-        rho_tot=0.;
-        rho_plus_p_theta_tot=0.;
-        rho_plus_p_tot=0.;
+        rho_tot += rho_i;
 
-        /* T_g(k,tau) */
+      }
 
-        rho_i = pvecback_sp_long[pba->index_bg_rho_g];
+      if (ppt->has_source_theta_g == _TRUE_) {
 
-        if (ppt->has_source_delta_g == _TRUE_) {
+        theta_i = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_g]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          delta_i = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_g]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_g] = theta_i;
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_g] = delta_i;
+        rho_plus_p_theta_tot += 4./3. * rho_i * theta_i;
 
-          delta_rho_tot += rho_i * delta_i;
+        rho_plus_p_tot += 4./3. * rho_i;
 
-          rho_tot += rho_i;
+      }
 
-        }
+      /* T_b(k,tau) */
 
-        if (ppt->has_source_theta_g == _TRUE_) {
+      rho_i = pvecback_sp_long[pba->index_bg_rho_b];
 
-          theta_i = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_g]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+      if (ppt->has_source_delta_b == _TRUE_) {
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_g] = theta_i;
+        delta_i = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_b]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          rho_plus_p_theta_tot += 4./3. * rho_i * theta_i;
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_b] = delta_i;
 
-          rho_plus_p_tot += 4./3. * rho_i;
+        delta_rho_tot += rho_i * delta_i;
 
-        }
+      }
+
+      rho_tot += rho_i;
+
+      if (ppt->has_source_theta_b == _TRUE_) {
+
+        theta_i = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_b]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_b] = theta_i;
+
+        rho_plus_p_theta_tot += rho_i * theta_i;
+
+      }
+
+      rho_plus_p_tot += rho_i;
 
-        /* T_b(k,tau) */
+      /* T_cdm(k,tau) */
 
-        rho_i = pvecback_sp_long[pba->index_bg_rho_b];
+      if (pba->has_cdm == _TRUE_) {
 
-        if (ppt->has_source_delta_b == _TRUE_) {
+        rho_i = pvecback_sp_long[pba->index_bg_rho_cdm];
+
+        if (ppt->has_source_delta_cdm == _TRUE_) {
 
           delta_i = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_b]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_cdm]
             [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_b] = delta_i;
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_cdm] = delta_i;
 
           delta_rho_tot += rho_i * delta_i;
 
@@ -3592,13 +5159,13 @@ int spectra_matter_transfers(
 
         rho_tot += rho_i;
 
-        if (ppt->has_source_theta_b == _TRUE_) {
+        if (ppt->has_source_theta_cdm == _TRUE_) {
 
           theta_i = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_b]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_cdm]
             [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_b] = theta_i;
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_cdm] = theta_i;
 
           rho_plus_p_theta_tot += rho_i * theta_i;
 
@@ -3606,202 +5173,204 @@ int spectra_matter_transfers(
 
         rho_plus_p_tot += rho_i;
 
-        /* T_cdm(k,tau) */
-
-        if (pba->has_cdm == _TRUE_) {
+      }
 
-          rho_i = pvecback_sp_long[pba->index_bg_rho_cdm];
+      /* T_dcdm(k,tau) */
 
-          if (ppt->has_source_delta_cdm == _TRUE_) {
+      if (pba->has_dcdm == _TRUE_) {
 
-            delta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_cdm]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        rho_i = pvecback_sp_long[pba->index_bg_rho_dcdm];
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_cdm] = delta_i;
+        if (ppt->has_source_delta_dcdm == _TRUE_) {
 
-            delta_rho_tot += rho_i * delta_i;
+          delta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_dcdm]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_dcdm] = delta_i;
 
-          rho_tot += rho_i;
+          delta_rho_tot += rho_i * delta_i;
 
-          if (ppt->has_source_theta_cdm == _TRUE_) {
+        }
 
-            theta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_cdm]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        rho_tot += rho_i;
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_cdm] = theta_i;
+        if (ppt->has_source_theta_dcdm == _TRUE_) {
 
-            rho_plus_p_theta_tot += rho_i * theta_i;
+          theta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_dcdm]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_dcdm] = theta_i;
 
-          rho_plus_p_tot += rho_i;
+          rho_plus_p_theta_tot += rho_i * theta_i;
 
         }
 
-        /* T_dcdm(k,tau) */
+        rho_plus_p_tot += rho_i;
 
-        if (pba->has_dcdm == _TRUE_) {
+      }
 
-          rho_i = pvecback_sp_long[pba->index_bg_rho_dcdm];
+      /* T_scf(k,tau) */
 
-          if (ppt->has_source_delta_dcdm == _TRUE_) {
+      if (pba->has_scf == _TRUE_) {
 
-            delta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_dcdm]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        rho_i = pvecback_sp_long[pba->index_bg_rho_scf];
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_dcdm] = delta_i;
+        if (ppt->has_source_delta_scf == _TRUE_) {
 
-            delta_rho_tot += rho_i * delta_i;
+          delta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_scf]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_scf] = delta_i;
 
-          rho_tot += rho_i;
+          delta_rho_tot += rho_i * delta_i;
 
-          if (ppt->has_source_theta_dcdm == _TRUE_) {
+        }
 
-            theta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_dcdm]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        rho_tot += rho_i;
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_dcdm] = theta_i;
+        if (ppt->has_source_theta_scf == _TRUE_) {
 
-            rho_plus_p_theta_tot += rho_i * theta_i;
+          theta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_scf]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_scf] = theta_i;
 
-          rho_plus_p_tot += rho_i;
+          rho_plus_p_theta_tot += (rho_i + pvecback_sp_long[pba->index_bg_p_scf]) * theta_i;
 
         }
 
-        /* T_scf(k,tau) */
+        rho_plus_p_tot += (rho_i + pvecback_sp_long[pba->index_bg_p_scf]);
 
-        if (pba->has_scf == _TRUE_) {
-
-          rho_i = pvecback_sp_long[pba->index_bg_rho_scf];
+      }
 
-          if (ppt->has_source_delta_scf == _TRUE_) {
 
-            delta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_scf]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+      /* T_fld(k,tau) */
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_scf] = delta_i;
+      if (pba->has_fld == _TRUE_) {
 
-            delta_rho_tot += rho_i * delta_i;
+        rho_i = pvecback_sp_long[pba->index_bg_rho_fld];
 
-          }
+        if (ppt->has_source_delta_fld == _TRUE_) {
 
-          rho_tot += rho_i;
+          delta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_fld]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          if (ppt->has_source_theta_scf == _TRUE_) {
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_fld] = delta_i;
 
-            theta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_scf]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+          delta_rho_tot += rho_i * delta_i;
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_scf] = theta_i;
+        }
 
-            rho_plus_p_theta_tot += (rho_i + pvecback_sp_long[pba->index_bg_p_scf]) * theta_i;
+        rho_tot += rho_i;
 
-          }
+        if (ppt->has_source_theta_fld == _TRUE_) {
 
-          rho_plus_p_tot += (rho_i + pvecback_sp_long[pba->index_bg_p_scf]);
+          theta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_fld]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-        }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_fld] = theta_i;
 
+          rho_plus_p_theta_tot += (1. + w_fld) * rho_i * theta_i;
 
-        /* T_fld(k,tau) */
+        }
 
-        if (pba->has_fld == _TRUE_) {
+        rho_plus_p_tot += (1. + w_fld) * rho_i;
 
-          rho_i = pvecback_sp_long[pba->index_bg_rho_fld];
+      }
 
-          class_call(background_w_fld(pba,0.,&w_fld,&dw_over_da_fld,&integral_fld), pba->error_message, psp->error_message);
+      /* T_ur(k,tau) */
 
-          if (ppt->has_source_delta_fld == _TRUE_) {
+      if (pba->has_ur == _TRUE_) {
 
-            delta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_fld]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        rho_i = pvecback_sp_long[pba->index_bg_rho_ur];
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_fld] = delta_i;
+        if (ppt->has_source_delta_ur == _TRUE_) {
 
-            delta_rho_tot += rho_i * delta_i;
+          delta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_ur]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_ur] = delta_i;
 
-          rho_tot += rho_i;
+          delta_rho_tot += rho_i * delta_i;
 
-          if (ppt->has_source_theta_fld == _TRUE_) {
+        }
 
-            theta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_fld]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        rho_tot += rho_i;
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_fld] = theta_i;
+        if (ppt->has_source_theta_ur == _TRUE_) {
 
-            rho_plus_p_theta_tot += (1. + w_fld) * rho_i * theta_i;
+          theta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_ur]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_ur] = theta_i;
 
-          rho_plus_p_tot += (1. + w_fld) * rho_i;
+          rho_plus_p_theta_tot += 4./3. * rho_i * theta_i;
 
         }
 
-        /* T_ur(k,tau) */
+        rho_plus_p_tot += 4./3. * rho_i;
 
-        if (pba->has_ur == _TRUE_) {
+      }
 
-          rho_i = pvecback_sp_long[pba->index_bg_rho_ur];
+      /* T_dr(k,tau) */
 
-          if (ppt->has_source_delta_ur == _TRUE_) {
+      if (pba->has_dr == _TRUE_) {
 
-            delta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_ur]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        rho_i = pvecback_sp_long[pba->index_bg_rho_dr];
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_ur] = delta_i;
+        if (ppt->has_source_delta_dr == _TRUE_) {
 
-            delta_rho_tot += rho_i * delta_i;
+          delta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_dr]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_dr] = delta_i;
 
-          rho_tot += rho_i;
+          delta_rho_tot += rho_i * delta_i;
 
-          if (ppt->has_source_theta_ur == _TRUE_) {
+        }
 
-            theta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_ur]
-              [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+        rho_tot += rho_i;
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_ur] = theta_i;
+        if (ppt->has_source_theta_dr == _TRUE_) {
 
-            rho_plus_p_theta_tot += 4./3. * rho_i * theta_i;
+          theta_i = ppt->sources[index_md]
+            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_dr]
+            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-          }
+          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_dr] = theta_i;
 
-          rho_plus_p_tot += 4./3. * rho_i;
+          rho_plus_p_theta_tot += 4./3. * rho_i * theta_i;
 
         }
 
-        /* T_dr(k,tau) */
+        rho_plus_p_tot += 4./3. * rho_i;
+
+      }
+
+      /* T_ncdm_i(k,tau) */
+
+      if (pba->has_ncdm == _TRUE_) {
 
-        if (pba->has_dr == _TRUE_) {
+        for (n_ncdm=0; n_ncdm < pba->N_ncdm; n_ncdm++) {
 
-          rho_i = pvecback_sp_long[pba->index_bg_rho_dr];
+          rho_i = pvecback_sp_long[pba->index_bg_rho_ncdm1+n_ncdm];
 
-          if (ppt->has_source_delta_dr == _TRUE_) {
+          if (ppt->has_source_delta_ncdm == _TRUE_) {
 
             delta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_dr]
+              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_ncdm1+n_ncdm]
               [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_dr] = delta_i;
+            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_ncdm1+n_ncdm] = delta_i;
 
             delta_rho_tot += rho_i * delta_i;
 
@@ -3809,166 +5378,106 @@ int spectra_matter_transfers(
 
           rho_tot += rho_i;
 
-          if (ppt->has_source_theta_dr == _TRUE_) {
+          if (ppt->has_source_theta_ncdm == _TRUE_) {
 
             theta_i = ppt->sources[index_md]
-              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_dr]
+              [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_ncdm1+n_ncdm]
               [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_dr] = theta_i;
-
-            rho_plus_p_theta_tot += 4./3. * rho_i * theta_i;
-
-          }
-
-          rho_plus_p_tot += 4./3. * rho_i;
-
-        }
-
-        /* T_ncdm_i(k,tau) */
-
-        if (pba->has_ncdm == _TRUE_) {
-
-          for (n_ncdm=0; n_ncdm < pba->N_ncdm; n_ncdm++) {
-
-            rho_i = pvecback_sp_long[pba->index_bg_rho_ncdm1+n_ncdm];
-
-            if (ppt->has_source_delta_ncdm == _TRUE_) {
-
-              delta_i = ppt->sources[index_md]
-                [index_ic * ppt->tp_size[index_md] + ppt->index_tp_delta_ncdm1+n_ncdm]
-                [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
-
-              psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_ncdm1+n_ncdm] = delta_i;
-
-              delta_rho_tot += rho_i * delta_i;
-
-            }
-
-            rho_tot += rho_i;
-
-            if (ppt->has_source_theta_ncdm == _TRUE_) {
-
-              theta_i = ppt->sources[index_md]
-                [index_ic * ppt->tp_size[index_md] + ppt->index_tp_theta_ncdm1+n_ncdm]
-                [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+            psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_ncdm1+n_ncdm] = theta_i;
 
-              psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_ncdm1+n_ncdm] = theta_i;
-
-              rho_plus_p_theta_tot += (rho_i + pvecback_sp_long[pba->index_bg_p_ncdm1+n_ncdm]) * theta_i;
-
-            }
-
-            rho_plus_p_tot += (rho_i + pvecback_sp_long[pba->index_bg_p_ncdm1+n_ncdm]);
+            rho_plus_p_theta_tot += (rho_i + pvecback_sp_long[pba->index_bg_p_ncdm1+n_ncdm]) * theta_i;
 
           }
 
-        }
-
-        if (ppt->has_source_phi == _TRUE_) {
-
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_phi] = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_phi]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+          rho_plus_p_tot += (rho_i + pvecback_sp_long[pba->index_bg_p_ncdm1+n_ncdm]);
 
         }
 
-        if (ppt->has_source_psi == _TRUE_) {
+      }
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_psi] = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_psi]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+      if (ppt->has_source_phi == _TRUE_) {
 
-        }
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_phi] = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_phi]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-        if (ppt->has_source_phi_prime == _TRUE_) {
+      }
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_phi_prime] = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_phi_prime]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+      if (ppt->has_source_psi == _TRUE_) {
 
-        }
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_psi] = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_psi]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-        if (ppt->has_source_h == _TRUE_) {
+      }
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_h] = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_h]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+      if (ppt->has_source_phi_prime == _TRUE_) {
 
-        }
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_phi_prime] = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_phi_prime]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-        if (ppt->has_source_h_prime == _TRUE_) {
+      }
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_h_prime] = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_h_prime]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+      if (ppt->has_source_h == _TRUE_) {
 
-        }
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_h] = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_h]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-        if (ppt->has_source_eta == _TRUE_) {
+      }
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_eta] = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_eta]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+      if (ppt->has_source_h_prime == _TRUE_) {
 
-        }
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_h_prime] = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_h_prime]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-        if (ppt->has_source_eta_prime == _TRUE_) {
+      }
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_eta_prime] = ppt->sources[index_md]
-            [index_ic * ppt->tp_size[index_md] + ppt->index_tp_eta_prime]
-            [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
+      if (ppt->has_source_eta == _TRUE_) {
 
-        }
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_eta] = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_eta]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-        /* could include homogeneous component in rho_tot if uncommented (leave commented to match CMBFAST/CAMB definition) */
+      }
 
-        /* 	if (pba->has_lambda == _TRUE_) { */
+      if (ppt->has_source_eta_prime == _TRUE_) {
 
-        /* 	  rho_i = pvecback_sp_long[pba->index_bg_rho_lambda]; */
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_eta_prime] = ppt->sources[index_md]
+          [index_ic * ppt->tp_size[index_md] + ppt->index_tp_eta_prime]
+          [(index_tau-psp->ln_tau_size+ppt->tau_size) * ppt->k_size[index_md] + index_k];
 
-        /* 	  rho_tot += rho_i; */
-        /* 	} */
+      }
 
-        /* T_tot(k,tau) */
+      /* could include homogeneous component in rho_tot if uncommented (leave commented to match CMBFAST/CAMB definition) */
 
-        if (ppt->has_density_transfers == _TRUE_) {
+      /* 	if (pba->has_lambda == _TRUE_) { */
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_tot] = delta_rho_tot/rho_tot;
+      /* 	  rho_i = pvecback_sp_long[pba->index_bg_rho_lambda]; */
 
-        }
+      /* 	  rho_tot += rho_i; */
+      /* 	} */
 
-        if (ppt->has_velocity_transfers == _TRUE_) {
+      /* T_tot(k,tau) */
 
-          psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_tot] = rho_plus_p_theta_tot/rho_plus_p_tot;
+      if (ppt->has_density_transfers == _TRUE_) {
 
-        }
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_delta_tot] = delta_rho_tot/rho_tot;
 
       }
-    }
-  }
-
-  /**- if interpolation of \f$ P(k,\tau)\f$ will be needed (as a function of tau),
-     compute array of second derivatives in view of spline interpolation */
 
-  if (psp->ln_tau_size > 1) {
+      if (ppt->has_velocity_transfers == _TRUE_) {
 
-    class_alloc(psp->ddmatter_transfer,sizeof(double)*psp->ln_tau_size*psp->ln_k_size*psp->ic_size[index_md]*psp->tr_size,psp->error_message);
+        psp->matter_transfer[((index_tau*psp->ln_k_size + index_k) * psp->ic_size[index_md] + index_ic) * psp->tr_size + psp->index_tr_theta_tot] = rho_plus_p_theta_tot/rho_plus_p_tot;
 
-    class_call(array_spline_table_lines(psp->ln_tau,
-                                        psp->ln_tau_size,
-                                        psp->matter_transfer,
-                                        psp->ic_size[index_md]*psp->ln_k_size*psp->tr_size,
-                                        psp->ddmatter_transfer,
-                                        _SPLINE_EST_DERIV_,
-                                        psp->error_message),
-               psp->error_message,
-               psp->error_message);
+      }
 
+    }
   }
 
-  free (pvecback_sp_long);
-
   return _SUCCESS_;
 }
 
@@ -4232,126 +5741,71 @@ int spectra_fast_pk_at_kvec_and_zvec(
   /** - define local variables */
 
   int index_md;
-  int index_k, index_knode, index_z;
-  double *spline, *pk_at_k, *ln_kvec, *ln_pk_table;
-  double h, a, b;
-  double *spline_cb, *pk_cb_at_k, *ln_pk_cb_table;
+  int index_k, index_z;
+  double ln_k, ln_tau;
+  int use_nl;
 
   index_md = psp->index_md_scalars;
   class_test(psp->ic_size[index_md] != 1,
              psp->error_message,
              "This function has only been coded for pure adiabatic ICs, sorry.");
 
-  /** Compute spline over ln(k) */
-  class_alloc(ln_kvec, sizeof(double)*kvec_size,psp->error_message);
-  class_alloc(ln_pk_table, sizeof(double)*psp->ln_k_size*zvec_size,psp->error_message);
-  class_alloc(spline, sizeof(double)*psp->ln_k_size*zvec_size,psp->error_message);
-  class_alloc(pk_at_k, sizeof(double)*psp->ln_tau_size,psp->error_message);
+  /** - loop over redshifts, and for each of them interpolate directly
+      in the bicubic spline tables for each k (no temporary table
+      needs to be built, and the k vector does not need to be sorted) */
 
-  class_alloc(ln_pk_cb_table, sizeof(double)*psp->ln_k_size*zvec_size,psp->error_message);
-  class_alloc(spline_cb, sizeof(double)*psp->ln_k_size*zvec_size,psp->error_message);
-  class_alloc(pk_cb_at_k, sizeof(double)*psp->ln_tau_size,psp->error_message);
-
-  /** Construct table of log(pk) on the computed k nodes but requested redshifts: */
   for (index_z=0; index_z<zvec_size; index_z++){
-    if (nonlinear==_TRUE_) {
-      class_call(spectra_pk_nl_at_z(pba,psp, logarithmic,zvec[index_z],ln_pk_table+index_z*psp->ln_k_size,ln_pk_cb_table+index_z*psp->ln_k_size),
-                 psp->error_message,
-                 psp->error_message);
-    }
-    else{
-      class_call(spectra_pk_at_z(pba,psp, logarithmic,zvec[index_z],ln_pk_table+index_z*psp->ln_k_size, NULL,ln_pk_cb_table+index_z*psp->ln_k_size,NULL),
-                 psp->error_message,
-                 psp->error_message);
-    }
-  }
-
-  class_call(array_spline_table_columns2(psp->ln_k,
-                                         psp->ln_k_size,
-                                         ln_pk_table,
-                                         zvec_size,
-                                         spline,
-                                         _SPLINE_NATURAL_,
-                                         psp->error_message),
-             psp->error_message,
-             psp->error_message);
 
-  if(pba->has_ncdm){
-    class_call(array_spline_table_columns2(psp->ln_k,
-                                           psp->ln_k_size,
-                                           ln_pk_cb_table,
-                                           zvec_size,
-                                           spline_cb,
-                                           _SPLINE_NATURAL_,
-                                           psp->error_message),
+    class_call(spectra_ln_tau_at_z(pba,psp,zvec[index_z],&ln_tau),
                psp->error_message,
                psp->error_message);
-  }
-  /** Construct ln(kvec): */
-  for (index_k=0; index_k<kvec_size; index_k++){
-    ln_kvec[index_k] = log(kvec[index_k]);
-  }
 
-  /** I will assume that the k vector is sorted in ascending order.
-      Case k<kmin: */
-  for(index_k = 0; index_k<kvec_size; index_k++){
-    if (ln_kvec[index_k] >= psp->ln_k[0])
-      break;
-    for (index_z = 0; index_z < zvec_size; index_z++) {
-      /** If needed, add some extrapolation here */
-      pk_tot_out[index_z*kvec_size+index_k] = 0.;
-      if(pba->has_ncdm) pk_cb_tot_out[index_z*kvec_size+index_k] = 0.;
-    }
-    /** Implement some extrapolation perhaps */
-  }
+    use_nl = ((nonlinear == _TRUE_) && ((psp->ln_tau_size == 1) || (ln_tau >= psp->ln_tau_nl[0])));
 
-  /** Case kmin<=k<=kmax. Do not loop through kvec, but loop through the
-      interpolation nodes. */
-  for (index_knode=0; index_knode < (psp->ln_k_size-1); index_knode++){
-    /** Loop through k's that fall in this interval */
-    //printf("index _k is %d, do we have %g < %g <%g?\n",index_k, psp->ln_k[index_knode],ln_kvec[index_k],psp->ln_k[index_knode+1]);
-    while ((index_k < kvec_size) && (ln_kvec[index_k] <= psp->ln_k[index_knode+1])){
-      /** Perform interpolation */
-      h = psp->ln_k[index_knode+1]-psp->ln_k[index_knode];
-      b = (ln_kvec[index_k] - psp->ln_k[index_knode])/h;
-      a = 1.-b;
-      for (index_z = 0; index_z < zvec_size; index_z++) {
-        pk_tot_out[index_z*kvec_size+index_k] =
-          exp(
-              a * ln_pk_table[index_z*psp->ln_k_size + index_knode]
-              + b * ln_pk_table[index_z*psp->ln_k_size + index_knode+1]
-              + ((a*a*a-a) * spline[index_z*psp->ln_k_size + index_knode]
-                 +(b*b*b-b) * spline[index_z*psp->ln_k_size + index_knode+1])*h*h/6.0
-              );
+    for (index_k=0; index_k<kvec_size; index_k++){
+
+      ln_k = (kvec[index_k] > 0.) ? log(kvec[index_k]) : -_HUGE_;
+
+      /** - case k<kmin or k>kmax: if needed, add some extrapolation here */
+      if ((ln_k < psp->ln_k[0]) || (ln_k > psp->ln_k[psp->ln_k_size-1])) {
+        pk_tot_out[index_z*kvec_size+index_k] = 0.;
+        if(pba->has_ncdm) pk_cb_tot_out[index_z*kvec_size+index_k] = 0.;
+        continue;
+      }
+
+      if (use_nl == _TRUE_) {
+        class_call(spectra_pk_bicubic_at_k_and_tau(psp,psp->ln_tau_nl,psp->ln_tau_nl_size,
+                                                   psp->ln_pk_nl,psp->ddln_pk_nl,psp->ddkln_pk_nl,psp->ddkddln_pk_nl,
+                                                   1,ln_k,ln_tau,pk_tot_out+index_z*kvec_size+index_k),
+                   psp->error_message,
+                   psp->error_message);
         if(pba->has_ncdm){
-          pk_cb_tot_out[index_z*kvec_size+index_k] =
-            exp(
-                a * ln_pk_cb_table[index_z*psp->ln_k_size + index_knode]
-                + b * ln_pk_cb_table[index_z*psp->ln_k_size + index_knode+1]
-                + ((a*a*a-a) * spline_cb[index_z*psp->ln_k_size + index_knode]
-                   +(b*b*b-b) * spline_cb[index_z*psp->ln_k_size + index_knode+1])*h*h/6.0
-                );
+          class_call(spectra_pk_bicubic_at_k_and_tau(psp,psp->ln_tau_nl,psp->ln_tau_nl_size,
+                                                     psp->ln_pk_cb_nl,psp->ddln_pk_cb_nl,psp->ddkln_pk_cb_nl,psp->ddkddln_pk_cb_nl,
+                                                     1,ln_k,ln_tau,pk_cb_tot_out+index_z*kvec_size+index_k),
+                     psp->error_message,
+                     psp->error_message);
+        }
+      }
+      else {
+        class_call(spectra_pk_bicubic_at_k_and_tau(psp,psp->ln_tau,psp->ln_tau_size,
+                                                   psp->ln_pk_l,psp->ddln_pk_l,psp->ddkln_pk_l,psp->ddkddln_pk_l,
+                                                   1,ln_k,ln_tau,pk_tot_out+index_z*kvec_size+index_k),
+                   psp->error_message,
+                   psp->error_message);
+        if(pba->has_ncdm){
+          class_call(spectra_pk_bicubic_at_k_and_tau(psp,psp->ln_tau,psp->ln_tau_size,
+                                                     psp->ln_pk_cb_l,psp->ddln_pk_cb_l,psp->ddkln_pk_cb_l,psp->ddkddln_pk_cb_l,
+                                                     1,ln_k,ln_tau,pk_cb_tot_out+index_z*kvec_size+index_k),
+                     psp->error_message,
+                     psp->error_message);
         }
       }
-      index_k++;
-    }
-  }
 
-  /** case k>kmax */
-  while (index_k<kvec_size){
-    for (index_z = 0; index_z < zvec_size; index_z++) {
-      /** If needed, add some extrapolation here */
-      pk_tot_out[index_z*kvec_size+index_k] = 0.;
-      if(pba->has_ncdm) pk_cb_tot_out[index_z*kvec_size+index_k] = 0.;
+      pk_tot_out[index_z*kvec_size+index_k] = exp(pk_tot_out[index_z*kvec_size+index_k]);
+      if(pba->has_ncdm) pk_cb_tot_out[index_z*kvec_size+index_k] = exp(pk_cb_tot_out[index_z*kvec_size+index_k]);
     }
-    index_k++;
   }
 
-  free(ln_kvec);
-  free(ln_pk_table);
-  free(ln_pk_cb_table);
-  free(spline);
-  if(pba->has_ncdm) free(spline_cb);
-  free(pk_at_k);
   return _SUCCESS_;
 }
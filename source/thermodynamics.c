@@ -240,6 +240,118 @@ int thermodynamics_at_z(
   return _SUCCESS_;
 }
 
+/**
+ * One thermodynamics quantity at a list of redshifts.
+ *
+ * Same as calling thermodynamics_at_z() for each redshift, but only
+ * the column index_th is interpolated, and the table is walked from
+ * one point to the next with the closeby interpolation mode instead
+ * of being bisected each time. The redshifts can be given in any
+ * order, but the walk is fastest when they are sorted. Redshifts
+ * above the range of the table go through thermodynamics_at_z(), with
+ * background quantities computed at the corresponding time.
+ *
+ * @param pba      Input: pointer to background structure
+ * @param pth      Input: pointer to the thermodynamics structure (containing pre-computed table)
+ * @param z_array  Input: values of redshift
+ * @param z_size   Input: number of values
+ * @param index_th Input: index of the requested thermodynamics quantity (e.g. pth->index_th_xe)
+ * @param result   Output: array of size z_size (must be already allocated)
+ * @return the error status
+ */
+
+int thermodynamics_at_z_vector(
+                               struct background * pba,
+                               struct thermo * pth,
+                               double * z_array,
+                               int z_size,
+                               int index_th,
+                               double * result
+                               ) {
+
+  int index_z;
+  int last_index=0;
+  int last_index_back;
+  double z,tau;
+  double * pvecback = NULL;
+  double * pvecthermo = NULL;
+
+  class_test((index_th < 0) || (index_th >= pth->th_size),
+             pth->error_message,
+             "index_th=%d out of range [0:%d]",index_th,pth->th_size-1);
+
+  for (index_z=0; index_z<z_size; index_z++) {
+
+    z = z_array[index_z];
+
+    /** - above the table, rely on the analytic approximations of thermodynamics_at_z() */
+    if (z >= pth->z_table[pth->tt_size-1]) {
+
+      if (pvecback == NULL) {
+        class_alloc(pvecback,pba->bg_size*sizeof(double),pth->error_message);
+        class_alloc(pvecthermo,pth->th_size*sizeof(double),pth->error_message);
+      }
+
+      class_call(background_tau_of_z(pba,z,&tau),
+                 pba->error_message,
+                 pth->error_message);
+
+      class_call(background_at_tau(pba,tau,pba->long_info,pba->inter_normal,&last_index_back,pvecback),
+                 pba->error_message,
+                 pth->error_message);
+
+      class_call(thermodynamics_at_z(pba,pth,z,pth->inter_normal,&last_index,pvecback,pvecthermo),
+                 pth->error_message,
+                 pth->error_message);
+
+      result[index_z] = pvecthermo[index_th];
+    }
+
+    /** - same special cases with linear interpolation as in thermodynamics_at_z() */
+    else if (((pth->reio_parametrization == reio_half_tanh) && (z < 2*pth->z_reio))
+             || ((pth->reio_parametrization == reio_inter) && (z < 50.))) {
+
+      class_call(array_interpolate_linear(
+                                          pth->z_table,
+                                          pth->tt_size,
+                                          pth->thermodynamics_table+index_th,
+                                          pth->th_size,
+                                          z,
+                                          &last_index,
+                                          result+index_z,
+                                          1,
+                                          pth->error_message),
+                 pth->error_message,
+                 pth->error_message);
+    }
+
+    /** - otherwise, spline interpolation of the requested column only */
+    else {
+
+      class_call(array_interpolate_spline_growing_closeby(
+                                                          pth->z_table,
+                                                          pth->tt_size,
+                                                          pth->thermodynamics_table+index_th,
+                                                          pth->d2thermodynamics_dz2_table+index_th,
+                                                          pth->th_size,
+                                                          z,
+                                                          &last_index,
+                                                          result+index_z,
+                                                          1,
+                                                          pth->error_message),
+                 pth->error_message,
+                 pth->error_message);
+    }
+  }
+
+  if (pvecback != NULL) {
+    free(pvecback);
+    free(pvecthermo);
+  }
+
+  return _SUCCESS_;
+}
+
 /**
  * Initialize the thermo structure, and in particular the
  * thermodynamics interpolation table.
@@ -1055,24 +1167,26 @@ int thermodynamics_indices(
 }
 
 /**
- * Infer the primordial helium fraction from standard BBN, as a
- * function of the baryon density and expansion rate during BBN.
+ * Read the table of primordial helium fraction from standard BBN,
+ * and spline it along the Delta N_eff direction. This is the reading
+ * function passed to table_cache_get(), such that the file is read
+ * only once per process.
  *
- * This module is simpler then the one used in arXiv:0712.2826 because
- * it neglects the impact of a possible significant chemical
- * potentials for electron neutrinos. The full code with xi_nu_e could
- * be introduced here later.
+ * The table is stored as:
+ * - shape[0] = num_omegab, shape[1] = num_deltaN
+ * - data = [omegab (num_omegab values), deltaN (num_deltaN values), YHe (num_omegab*num_deltaN values), ddYHe (num_omegab*num_deltaN values)]
  *
- * @param ppr Input: pointer to precision structure
- * @param pba Input: pointer to background structure
- * @param pth Input/Output: pointer to initialized thermo structure
+ * @param filename      Input: name of the BBN file
+ * @param table         Output: table to be filled
+ * @param error_message Output: error message
  * @return the error status
  */
-int thermodynamics_helium_from_bbn(
-                                   struct precision * ppr,
-                                   struct background * pba,
-                                   struct thermo * pth
-                                   ) {
+
+int thermodynamics_read_bbn_table(
+                                  char * filename,
+                                  struct file_table * table,
+                                  ErrorMsg error_message
+                                  ) {
 
   FILE * fA;
   char line[_LINE_LENGTH_MAX_];
@@ -1085,48 +1199,8 @@ int thermodynamics_helium_from_bbn(
   double * deltaN=NULL;
   double * YHe=NULL;
   double * ddYHe=NULL;
-  double * YHe_at_deltaN=NULL;
-  double * ddYHe_at_deltaN=NULL;
 
   int array_line=0;
-  double DeltaNeff;
-  double omega_b;
-  int last_index;
-  double Neff_bbn, z_bbn, tau_bbn, *pvecback;
-
-  /**Summary: */
-  /** - Infer effective number of neutrinos at the time of BBN */
-  class_alloc(pvecback,pba->bg_size*sizeof(double),pba->error_message);
-
-  /** - 8.6173e-11 converts from Kelvin to MeV. We randomly choose 0.1 MeV to be the temperature of BBN */
-  z_bbn = 0.1/(8.6173e-11*pba->T_cmb)-1.0;
-
-  class_call(background_tau_of_z(pba,
-                                 z_bbn,
-                                 &tau_bbn),
-             pba->error_message,
-             pth->error_message);
-
-  class_call(background_at_tau(pba,
-                               tau_bbn,
-                               pba->long_info,
-                               pba->inter_normal,
-                               &last_index,
-                               pvecback),
-             pba->error_message,
-             pth->error_message);
-
-  Neff_bbn = (pvecback[pba->index_bg_Omega_r]
-	      *pvecback[pba->index_bg_rho_crit]
-	      -pvecback[pba->index_bg_rho_g])
-    /(7./8.*pow(4./11.,4./3.)*pvecback[pba->index_bg_rho_g]);
-
-  free(pvecback);
-
-  //  printf("Neff early = %g, Neff at bbn: %g\n",pba->Neff,Neff_bbn);
-
-  /** - compute Delta N_eff as defined in bbn file, i.e. \f$ \Delta N_{eff}=0\f$ means \f$ N_{eff}=3.046\f$ */
-  DeltaNeff = Neff_bbn - 3.046;
 
   /* the following file is assumed to contain (apart from comments and blank lines):
      - the two numbers (num_omegab, num_deltaN) = number of values of BBN free parameters
@@ -1140,7 +1214,9 @@ int thermodynamics_helium_from_bbn(
      .....
   */
 
-  class_open(fA,ppr->sBBN_file, "r",pth->error_message);
+  table->data = NULL;
+
+  class_open(fA,filename, "r",error_message);
 
   /* go through each line */
   while (fgets(line,_LINE_LENGTH_MAX_-1,fA) != NULL) {
@@ -1165,28 +1241,36 @@ int thermodynamics_helium_from_bbn(
 
         /* read (num_omegab, num_deltaN), infer size of arrays and allocate them */
         class_test(sscanf(line,"%d %d",&num_omegab,&num_deltaN) != 2,
-                   pth->error_message,
-                   "could not read value of parameters (num_omegab,num_deltaN) in file %s\n",ppr->sBBN_file);
-
-        class_alloc(omegab,num_omegab*sizeof(double),pth->error_message);
-        class_alloc(deltaN,num_deltaN*sizeof(double),pth->error_message);
-        class_alloc(YHe,num_omegab*num_deltaN*sizeof(double),pth->error_message);
-        class_alloc(ddYHe,num_omegab*num_deltaN*sizeof(double),pth->error_message);
-        class_alloc(YHe_at_deltaN,num_omegab*sizeof(double),pth->error_message);
-        class_alloc(ddYHe_at_deltaN,num_omegab*sizeof(double),pth->error_message);
+                   error_message,
+                   "could not read value of parameters (num_omegab,num_deltaN) in file %s\n",filename);
+
+        table->shape[0] = num_omegab;
+        table->shape[1] = num_deltaN;
+        table->data_size = num_omegab+num_deltaN+2*num_omegab*num_deltaN;
+        class_alloc(table->data,table->data_size*sizeof(double),error_message);
+        omegab = table->data;
+        deltaN = omegab+num_omegab;
+        YHe = deltaN+num_deltaN;
+        ddYHe = YHe+num_omegab*num_deltaN;
         array_line=0;
 
       }
       else {
 
+        class_test_except(array_line >= num_omegab*num_deltaN,
+                          error_message,
+                          fclose(fA);free(table->data),
+                          "file %s contains more than num_omegab*num_deltaN=%d lines of data\n",filename,num_omegab*num_deltaN);
+
         /* read (omegab, deltaN, YHe) */
-        class_test(sscanf(line,"%lg %lg %lg",
-                          &(omegab[array_line%num_omegab]),
-                          &(deltaN[array_line/num_omegab]),
-                          &(YHe[array_line])
-                          ) != 3,
-                   pth->error_message,
-                   "could not read value of parameters (omegab,deltaN,YHe) in file %s\n",ppr->sBBN_file);
+        class_test_except(sscanf(line,"%lg %lg %lg",
+                                 &(omegab[array_line%num_omegab]),
+                                 &(deltaN[array_line/num_omegab]),
+                                 &(YHe[array_line])
+                                 ) != 3,
+                          error_message,
+                          fclose(fA);free(table->data),
+                          "could not read value of parameters (omegab,deltaN,YHe) in file %s\n",filename);
         array_line ++;
       }
     }
@@ -1194,86 +1278,198 @@ int thermodynamics_helium_from_bbn(
 
   fclose(fA);
 
+  class_test_except((num_omegab < 2) || (num_deltaN < 2),
+                    error_message,
+                    free(table->data),
+                    "could not find a table of at least 2x2 values of (omegab,deltaN) in file %s\n",filename);
+
+  class_test_except(array_line != num_omegab*num_deltaN,
+                    error_message,
+                    free(table->data),
+                    "file %s contains %d lines of data instead of num_omegab*num_deltaN=%d\n",filename,array_line,num_omegab*num_deltaN);
+
   /** - spline in one dimension (along deltaN) */
-  class_call(array_spline_table_lines(deltaN,
-                                      num_deltaN,
-                                      YHe,
-                                      num_omegab,
-                                      ddYHe,
-                                      _SPLINE_NATURAL_,
-                                      pth->error_message),
-             pth->error_message,
+  class_call_except(array_spline_table_lines(deltaN,
+                                             num_deltaN,
+                                             YHe,
+                                             num_omegab,
+                                             ddYHe,
+                                             _SPLINE_NATURAL_,
+                                             error_message),
+                    error_message,
+                    error_message,
+                    free(table->data));
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Infer the primordial helium fraction from standard BBN, as a
+ * function of the baryon density and expansion rate during BBN.
+ *
+ * This module is simpler then the one used in arXiv:0712.2826 because
+ * it neglects the impact of a possible significant chemical
+ * potentials for electron neutrinos. The full code with xi_nu_e could
+ * be introduced here later.
+ *
+ * @param ppr Input: pointer to precision structure
+ * @param pba Input: pointer to background structure
+ * @param pth Input/Output: pointer to initialized thermo structure
+ * @return the error status
+ */
+int thermodynamics_helium_from_bbn(
+                                   struct precision * ppr,
+                                   struct background * pba,
+                                   struct thermo * pth
+                                   ) {
+
+  struct file_table * bbn_table;
+
+  int num_omegab;
+  int num_deltaN;
+
+  double * omegab;
+  double * deltaN;
+  double * YHe;
+  double * ddYHe;
+  double * YHe_at_deltaN=NULL;
+  double * ddYHe_at_deltaN=NULL;
+
+  double DeltaNeff;
+  double omega_b;
+  int last_index;
+  double Neff_bbn, z_bbn, tau_bbn, *pvecback;
+
+  /**Summary: */
+  /** - Infer effective number of neutrinos at the time of BBN */
+  class_alloc(pvecback,pba->bg_size*sizeof(double),pba->error_message);
+
+  /** - 8.6173e-11 converts from Kelvin to MeV. We randomly choose 0.1 MeV to be the temperature of BBN */
+  z_bbn = 0.1/(8.6173e-11*pba->T_cmb)-1.0;
+
+  class_call(background_tau_of_z(pba,
+                                 z_bbn,
+                                 &tau_bbn),
+             pba->error_message,
              pth->error_message);
 
-  omega_b=pba->Omega0_b*pba->h*pba->h;
+  class_call(background_at_tau(pba,
+                               tau_bbn,
+                               pba->long_info,
+                               pba->inter_normal,
+                               &last_index,
+                               pvecback),
+             pba->error_message,
+             pth->error_message);
 
-  class_test(omega_b < omegab[0],
-             pth->error_message,
-             "You have asked for an unrealistic small value omega_b = %e. The corresponding value of the primordial helium fraction cannot be found in the interpolation table. If you really want this value, you should fix YHe to a given value rather than to BBN",
-             omega_b);
+  Neff_bbn = (pvecback[pba->index_bg_Omega_r]
+	      *pvecback[pba->index_bg_rho_crit]
+	      -pvecback[pba->index_bg_rho_g])
+    /(7./8.*pow(4./11.,4./3.)*pvecback[pba->index_bg_rho_g]);
 
-  class_test(omega_b > omegab[num_omegab-1],
-             pth->error_message,
-             "You have asked for an unrealistic high value omega_b = %e. The corresponding value of the primordial helium fraction cannot be found in the interpolation table. If you really want this value, you should fix YHe to a given value rather than to BBN",
-             omega_b);
+  free(pvecback);
 
-  class_test(DeltaNeff < deltaN[0],
-             pth->error_message,
-             "You have asked for an unrealistic small value of Delta N_eff = %e. The corresponding value of the primordial helium fraction cannot be found in the interpolation table. If you really want this value, you should fix YHe to a given value rather than to BBN",
-             DeltaNeff);
+  //  printf("Neff early = %g, Neff at bbn: %g\n",pba->Neff,Neff_bbn);
 
-  class_test(DeltaNeff > deltaN[num_deltaN-1],
-             pth->error_message,
-             "You have asked for an unrealistic high value of Delta N_eff = %e. The corresponding value of the primordial helium fraction cannot be found in the interpolation table. If you really want this value, you should fix YHe to a given value rather than to BBN",
-             DeltaNeff);
+  /** - compute Delta N_eff as defined in bbn file, i.e. \f$ \Delta N_{eff}=0\f$ means \f$ N_{eff}=3.046\f$ */
+  DeltaNeff = Neff_bbn - 3.046;
 
-  /** - interpolate in one dimension (along deltaN) */
-  class_call(array_interpolate_spline(deltaN,
-                                      num_deltaN,
-                                      YHe,
-                                      ddYHe,
-                                      num_omegab,
-                                      DeltaNeff,
-                                      &last_index,
-                                      YHe_at_deltaN,
-                                      num_omegab,
-                                      pth->error_message),
+  /** - get the table of YHe(omegab,deltaN), splined along deltaN
+      (read from the file only at the first call in the process) */
+  class_call(table_cache_get(ppr->sBBN_file,
+                             thermodynamics_read_bbn_table,
+                             &bbn_table,
+                             pth->error_message),
              pth->error_message,
              pth->error_message);
 
+  num_omegab = bbn_table->shape[0];
+  num_deltaN = bbn_table->shape[1];
+  omegab = bbn_table->data;
+  deltaN = omegab+num_omegab;
+  YHe = deltaN+num_deltaN;
+  ddYHe = YHe+num_omegab*num_deltaN;
+
+  omega_b=pba->Omega0_b*pba->h*pba->h;
+
+  class_test_except(omega_b < omegab[0],
+                    pth->error_message,
+                    table_cache_release(bbn_table,pth->error_message),
+                    "You have asked for an unrealistic small value omega_b = %e. The corresponding value of the primordial helium fraction cannot be found in the interpolation table. If you really want this value, you should fix YHe to a given value rather than to BBN",
+                    omega_b);
+
+  class_test_except(omega_b > omegab[num_omegab-1],
+                    pth->error_message,
+                    table_cache_release(bbn_table,pth->error_message),
+                    "You have asked for an unrealistic high value omega_b = %e. The corresponding value of the primordial helium fraction cannot be found in the interpolation table. If you really want this value, you should fix YHe to a given value rather than to BBN",
+                    omega_b);
+
+  class_test_except(DeltaNeff < deltaN[0],
+                    pth->error_message,
+                    table_cache_release(bbn_table,pth->error_message),
+                    "You have asked for an unrealistic small value of Delta N_eff = %e. The corresponding value of the primordial helium fraction cannot be found in the interpolation table. If you really want this value, you should fix YHe to a given value rather than to BBN",
+                    DeltaNeff);
+
+  class_test_except(DeltaNeff > deltaN[num_deltaN-1],
+                    pth->error_message,
+                    table_cache_release(bbn_table,pth->error_message),
+                    "You have asked for an unrealistic high value of Delta N_eff = %e. The corresponding value of the primordial helium fraction cannot be found in the interpolation table. If you really want this value, you should fix YHe to a given value rather than to BBN",
+                    DeltaNeff);
+
+  class_alloc(YHe_at_deltaN,num_omegab*sizeof(double),pth->error_message);
+  class_alloc(ddYHe_at_deltaN,num_omegab*sizeof(double),pth->error_message);
+
+  /** - interpolate in one dimension (along deltaN) */
+  class_call_except(array_interpolate_spline(deltaN,
+                                             num_deltaN,
+                                             YHe,
+                                             ddYHe,
+                                             num_omegab,
+                                             DeltaNeff,
+                                             &last_index,
+                                             YHe_at_deltaN,
+                                             num_omegab,
+                                             pth->error_message),
+                    pth->error_message,
+                    pth->error_message,
+                    free(YHe_at_deltaN);free(ddYHe_at_deltaN);table_cache_release(bbn_table,pth->error_message));
+
   /** - spline in remaining dimension (along omegab) */
-  class_call(array_spline_table_lines(omegab,
-                                      num_omegab,
-                                      YHe_at_deltaN,
-                                      1,
-                                      ddYHe_at_deltaN,
-                                      _SPLINE_NATURAL_,
-                                      pth->error_message),
-             pth->error_message,
-             pth->error_message);
+  class_call_except(array_spline_table_lines(omegab,
+                                             num_omegab,
+                                             YHe_at_deltaN,
+                                             1,
+                                             ddYHe_at_deltaN,
+                                             _SPLINE_NATURAL_,
+                                             pth->error_message),
+                    pth->error_message,
+                    pth->error_message,
+                    free(YHe_at_deltaN);free(ddYHe_at_deltaN);table_cache_release(bbn_table,pth->error_message));
 
   /** - interpolate in remaining dimension (along omegab) */
-  class_call(array_interpolate_spline(omegab,
-                                      num_omegab,
-                                      YHe_at_deltaN,
-                                      ddYHe_at_deltaN,
-                                      1,
-                                      omega_b,
-                                      &last_index,
-                                      &(pth->YHe),
-                                      1,
-                                      pth->error_message),
-             pth->error_message,
-             pth->error_message);
+  class_call_except(array_interpolate_spline(omegab,
+                                             num_omegab,
+                                             YHe_at_deltaN,
+                                             ddYHe_at_deltaN,
+                                             1,
+                                             omega_b,
+                                             &last_index,
+                                             &(pth->YHe),
+                                             1,
+                                             pth->error_message),
+                    pth->error_message,
+                    pth->error_message,
+                    free(YHe_at_deltaN);free(ddYHe_at_deltaN);table_cache_release(bbn_table,pth->error_message));
 
-  /** - deallocate arrays */
-  free(omegab);
-  free(deltaN);
-  free(YHe);
-  free(ddYHe);
+  /** - deallocate arrays, and release the table */
   free(YHe_at_deltaN);
   free(ddYHe_at_deltaN);
 
+  class_call(table_cache_release(bbn_table,pth->error_message),
+             pth->error_message,
+             pth->error_message);
+
   return _SUCCESS_;
 
 }
@@ -2650,7 +2846,7 @@ int thermodynamics_recombination_with_hyrec(
   REC_COSMOPARAMS param;
   HRATEEFF rate_table;
   TWO_PHOTON_PARAMS twog_params;
-  double *xe_output, *Tm_output;
+  double *z_output, *xe_output, *Tm_output;
   int i,j,l,Nz,b;
   double z, xe, Tm, Hz;
   FILE *fA;
@@ -2680,6 +2876,8 @@ int thermodynamics_recombination_with_hyrec(
   param.zend = 0.;
   param.dlna = 8.49e-5;
   param.nz = (long) floor(2+log((1.+param.zstart)/(1.+param.zend))/param.dlna);
+  param.dlna_max = ppr->hyrec_dlna_max;
+  param.tol = ppr->hyrec_tolerance;
   param.annihilation = pth->annihilation;
   param.has_on_the_spot = pth->has_on_the_spot;
   param.decay = pth->decay;
@@ -2690,11 +2888,31 @@ int thermodynamics_recombination_with_hyrec(
   param.annihilation_f_halo = pth->annihilation_f_halo;
   param.annihilation_z_halo = pth->annihilation_z_halo;
 
+  switch (pth->hyrec_model) {
+  case hyrec_peebles:
+    param.model = PEEBLES;
+    break;
+  case hyrec_recfast:
+    param.model = RECFAST;
+    break;
+  case hyrec_emla2s2p:
+    param.model = EMLA2s2p;
+    break;
+  case hyrec_full:
+    param.model = FULL;
+    break;
+  default:
+    class_stop(pth->error_message,"unknown HyRec model %d",pth->hyrec_model);
+  }
+
   /** - Build effective rate tables */
 
-  /* allocate contiguous memory zone */
+  /* allocate contiguous memory zone (including the output redshifts, ionization
+     fractions and temperatures) */
+
+  Nz=ppr->recfast_Nz0;
 
-  buf_size = (2*NTR+NTM+2*NTR*NTM+2*param.nz)*sizeof(double) + 2*NTM*sizeof(double*);
+  buf_size = (2*NTR+NTM+2*NTR*NTM+3*Nz)*sizeof(double) + 2*NTM*sizeof(double*);
 
   class_alloc(buffer,
               buf_size,
@@ -2716,8 +2934,9 @@ int thermodynamics_recombination_with_hyrec(
   }
   rate_table.logR2p2s_tab = (double*)(rate_table.logAlpha_tab[1][NTM-1]+NTR);
 
-  xe_output = (double*)(rate_table.logR2p2s_tab+NTR);
-  Tm_output = (double*)(xe_output+param.nz);
+  z_output = (double*)(rate_table.logR2p2s_tab+NTR);
+  xe_output = (double*)(z_output+Nz);
+  Tm_output = (double*)(xe_output+Nz);
 
   /* store sampled values of temperatures */
 
@@ -2729,47 +2948,53 @@ int thermodynamics_recombination_with_hyrec(
   rate_table.DlogTR = rate_table.logTR_tab[1] - rate_table.logTR_tab[0];
   rate_table.DTM_TR = rate_table.TM_TR_tab[1] - rate_table.TM_TR_tab[0];
 
-  /* read in file */
+  /* read in file (only for the models using effective rates) */
+
+  if (MODEL_NEEDS_RATES(param.model)) {
 
-  class_open(fA,ppr->hyrec_Alpha_inf_file, "r",pth->error_message);
-  class_open(fR,ppr->hyrec_R_inf_file, "r",pth->error_message);
+    class_open(fA,ppr->hyrec_Alpha_inf_file, "r",pth->error_message);
+    class_open(fR,ppr->hyrec_R_inf_file, "r",pth->error_message);
 
-  for (i = 0; i < NTR; i++) {
-    for (j = 0; j < NTM; j++) {
-      for (l = 0; l <= 1; l++) {
-        if (fscanf(fA, "%le", &(rate_table.logAlpha_tab[l][j][i])) != 1)
-          class_stop(pth->error_message,"Error reading hyrec data file %s",ppr->hyrec_Alpha_inf_file);
-        rate_table.logAlpha_tab[l][j][i] = log(rate_table.logAlpha_tab[l][j][i]);
+    for (i = 0; i < NTR; i++) {
+      for (j = 0; j < NTM; j++) {
+        for (l = 0; l <= 1; l++) {
+          if (fscanf(fA, "%le", &(rate_table.logAlpha_tab[l][j][i])) != 1)
+            class_stop(pth->error_message,"Error reading hyrec data file %s",ppr->hyrec_Alpha_inf_file);
+          rate_table.logAlpha_tab[l][j][i] = log(rate_table.logAlpha_tab[l][j][i]);
+        }
       }
-    }
 
-    if (fscanf(fR, "%le", &(rate_table.logR2p2s_tab[i])) !=1)
-      class_stop(pth->error_message,"Error reading hyrec data file %s",ppr->hyrec_R_inf_file);
-    rate_table.logR2p2s_tab[i] = log(rate_table.logR2p2s_tab[i]);
+      if (fscanf(fR, "%le", &(rate_table.logR2p2s_tab[i])) !=1)
+        class_stop(pth->error_message,"Error reading hyrec data file %s",ppr->hyrec_R_inf_file);
+      rate_table.logR2p2s_tab[i] = log(rate_table.logR2p2s_tab[i]);
 
+    }
+    fclose(fA);
+    fclose(fR);
   }
-  fclose(fA);
-  fclose(fR);
 
-  /* Read two-photon rate tables */
+  /* Read two-photon rate tables (only for the full model) */
 
-  class_open(fA,ppr->hyrec_two_photon_tables_file, "r",pth->error_message);
+  if (MODEL_NEEDS_TWO_PHOTON(param.model)) {
 
-  for (b = 0; b < NVIRT; b++) {
-    if ((fscanf(fA, "%le", &(twog_params.Eb_tab[b])) != 1) ||
-        (fscanf(fA, "%le", &(twog_params.A1s_tab[b])) != 1) ||
-        (fscanf(fA, "%le", &(twog_params.A2s_tab[b])) != 1) ||
-        (fscanf(fA, "%le", &(twog_params.A3s3d_tab[b])) != 1) ||
-        (fscanf(fA, "%le", &(twog_params.A4s4d_tab[b])) != 1))
-      class_stop(pth->error_message,"Error reading hyrec data file %s",ppr->hyrec_two_photon_tables_file);
-  }
+    class_open(fA,ppr->hyrec_two_photon_tables_file, "r",pth->error_message);
 
-  fclose(fA);
+    for (b = 0; b < NVIRT; b++) {
+      if ((fscanf(fA, "%le", &(twog_params.Eb_tab[b])) != 1) ||
+          (fscanf(fA, "%le", &(twog_params.A1s_tab[b])) != 1) ||
+          (fscanf(fA, "%le", &(twog_params.A2s_tab[b])) != 1) ||
+          (fscanf(fA, "%le", &(twog_params.A3s3d_tab[b])) != 1) ||
+          (fscanf(fA, "%le", &(twog_params.A4s4d_tab[b])) != 1))
+        class_stop(pth->error_message,"Error reading hyrec data file %s",ppr->hyrec_two_photon_tables_file);
+    }
 
-  /** - Normalize 2s--1s differential decay rate to L2s1s (can be set by user in hydrogen.h) */
-  L2s1s_current = 0.;
-  for (b = 0; b < NSUBLYA; b++) L2s1s_current += twog_params.A2s_tab[b];
-  for (b = 0; b < NSUBLYA; b++) twog_params.A2s_tab[b] *= L2s1s/L2s1s_current;
+    fclose(fA);
+
+    /** - Normalize 2s--1s differential decay rate to L2s1s (can be set by user in hydrogen.h) */
+    L2s1s_current = 0.;
+    for (b = 0; b < NSUBLYA; b++) L2s1s_current += twog_params.A2s_tab[b];
+    for (b = 0; b < NSUBLYA; b++) twog_params.A2s_tab[b] *= L2s1s/L2s1s_current;
+  }
 
   /*  In CLASS, we have neutralized the switches for the various
       effects considered in Hirata (2008), keeping the full
@@ -2777,20 +3002,21 @@ int thermodynamics_recombination_with_hyrec(
       functionality by copying a few lines from hyrec/hyrec.c to
       here */
 
-  /** - Compute the recombination history by calling a function in hyrec (no CLASS-like error management here) */
+  /** - Compute the recombination history by calling a function in hyrec (no CLASS-like error management here), directly at the redshifts of the recombination table */
+
+  for(i=0; i <Nz; i++)
+    z_output[i] = param.zstart * (1. - (double)(i+1) / (double)Nz);
 
   if (pth->thermodynamics_verbose > 0)
     printf(" -> calling HyRec version %s,\n",HYREC_VERSION);
 
-  rec_build_history(&param, &rate_table, &twog_params, xe_output, Tm_output);
+  rec_build_history(&param, &rate_table, &twog_params, Nz, z_output, xe_output, Tm_output);
 
   if (pth->thermodynamics_verbose > 0)
     printf("    by Y. Ali-Haïmoud & C. Hirata\n");
 
   /** - fill a few parameters in preco and pth */
 
-  Nz=ppr->recfast_Nz0;
-
   preco->rt_size = Nz;
   preco->H0 = pba->H0 * _c_ / _Mpc_over_m_;
   /* preco->H0 in inverse seconds (while pba->H0 is [H0/c] in inverse Mpcs) */
@@ -2816,29 +3042,9 @@ int thermodynamics_recombination_with_hyrec(
 
     /** - --> get redshift, corresponding results from hyrec, and background quantities */
 
-    z = param.zstart * (1. - (double)(i+1) / (double)Nz);
-
-    /* get (xe,Tm) by interpolating in pre-computed tables */
-
-    class_call(array_interpolate_cubic_equal(-log(1.+param.zstart),
-                                             param.dlna,
-                                             xe_output,
-                                             param.nz,
-                                             -log(1.+z),
-                                             &xe,
-                                             pth->error_message),
-               pth->error_message,
-               pth->error_message);
-
-    class_call(array_interpolate_cubic_equal(-log(1.+param.zstart),
-                                             param.dlna,
-                                             Tm_output,
-                                             param.nz,
-                                             -log(1.+z),
-                                             &Tm,
-                                             pth->error_message),
-               pth->error_message,
-               pth->error_message);
+    z = z_output[i];
+    xe = xe_output[i];
+    Tm = Tm_output[i];
 
     class_call(background_tau_of_z(pba,
                                    z,
@@ -100,6 +100,7 @@ int transfer_functions_at_q(
  *
  * - for each thread (in case of parallel run), initialize the fields of a memory zone called the transfer_workspace with transfer_workspace_init()
  *
+ * - if transfer_pruning_tolerance is positive (flat case), compute transfer functions for a subset of q values first, and flag negligible (q,l) pairs at other q values with transfer_pruning_select()
  * - loop over q values. For each q, compute the Bessel functions if needed with transfer_update_HIS(), and defer the calculation of all transfer functions to transfer_compute_for_each_q()
  * - for each thread, free the the workspace with transfer_workspace_free()
  *
@@ -107,6 +108,7 @@ int transfer_functions_at_q(
  * @param pba Input: pointer to background structure
  * @param pth Input: pointer to thermodynamics structure
  * @param ppt Input: pointer to perturbation structure
+ * @param ppm Input: pointer to primordial structure
  * @param pnl Input: pointer to nonlinear structure
  * @param ptr Output: pointer to initialized transfers structure
  * @return the error status
@@ -117,6 +119,7 @@ int transfer_init(
                   struct background * pba,
                   struct thermo * pth,
                   struct perturbs * ppt,
+                  struct primordial * ppm,
                   struct nonlinear * pnl,
                   struct transfers * ptr
                   ) {
@@ -128,6 +131,12 @@ int transfer_init(
   /* running index for wavenumbers */
   int index_q;
 
+  /* running index for modes */
+  int index_md;
+
+  /* whether negligible (q,l) pairs are pruned */
+  short prune;
+
   /* conformal time today */
   double tau0;
   /* conformal time at recombination */
@@ -216,10 +225,38 @@ int transfer_init(
   /** - initialize all indices in the transfers structure and
       allocate all its arrays using transfer_indices_of_transfers() */
 
-  class_call(transfer_indices_of_transfers(ppr,ppt,ptr,q_period,pba->K,pba->sgnK),
+  class_call(transfer_indices_of_transfers(ppr,ppt,ppm,ptr,q_period,pba->K,pba->sgnK),
              ptr->error_message,
              ptr->error_message);
 
+  /** - decide whether the C_l's of density number counts and galaxy
+      lensing are computed at low l by the spectra module with FFTLog
+      (flat case, number counts with the density term only), and
+      whether their line-of-sight integrals can then be skipped (when
+      no cross-correlation with CMB types needs them) */
+
+  ptr->has_cl_fftlog = _FALSE_;
+  ptr->l_fftlog_max = -1;
+  ptr->fftlog_skip = _FALSE_;
+
+  if ((ppr->fftlog_lss == 1) && (ppt->has_scalars == _TRUE_) &&
+      ((ppt->has_nc_density == _TRUE_) || (ppt->has_cl_lensing_potential == _TRUE_))) {
+
+    if ((pba->sgnK == 0) &&
+        (ppt->has_nc_rsd == _FALSE_) && (ppt->has_nc_lens == _FALSE_) && (ppt->has_nc_gr == _FALSE_) &&
+        (ppt->selection != dirac)) {
+
+      ptr->has_cl_fftlog = _TRUE_;
+      ptr->l_fftlog_max = ppr->fftlog_l_max;
+
+      if ((ppt->has_cl_cmb_temperature == _FALSE_) && (ppt->has_cl_cmb_lensing_potential == _FALSE_))
+        ptr->fftlog_skip = _TRUE_;
+    }
+    else if (ptr->transfer_verbose > 0) {
+      printf(" -> FFTLog C_l's only available in the flat case, for number counts with the density term only and non-Dirac selection functions: using line-of-sight integrals\n");
+    }
+  }
+
   /** - copy sources to a local array sources (in fact, only the pointers are copied, not the data), and eventually apply non-linear corrections to the sources */
 
   class_alloc(sources,
@@ -295,13 +332,21 @@ int transfer_init(
   /* (a.3.) workspace, allocated in a parallel zone since in openmp
       version there is one workspace per thread */
 
+  /** - decide whether negligible (q,l) pairs should be pruned
+      (only in the flat case) */
+
+  prune = ((ppr->transfer_pruning_tolerance > 0.) && (pba->sgnK == 0)) ? _TRUE_ : _FALSE_;
+  ptr->pruned = NULL;
+  ptr->pruned_fraction = 0.;
+  ptr->pruned_cl_error = 0.;
+
   /* initialize error management flag */
   abort = _FALSE_;
 
   /* beginning of parallel region */
 
 #pragma omp parallel                                                    \
-  shared(tau_size_max,ptr,ppr,pba,ppt,tp_of_tt,tau_rec,sources_spline,abort,BIS,tau0) \
+  shared(tau_size_max,ptr,ppr,pba,ppt,ppm,tp_of_tt,tau_rec,sources_spline,abort,BIS,tau0,prune) \
   private(ptw,index_q,tstart,tstop,tspent)
   {
 
@@ -325,10 +370,55 @@ int transfer_init(
                         ptr->error_message,
                         ptr->error_message);
 
+    /** - if pruning is enabled, first compute transfer functions
+        at every transfer_pruning_stride wavenumber (in parallel
+        over wavenumbers). Then select the pairs with negligible
+        contributions to the C_l's among the other wavenumbers. */
+
+    if (prune == _TRUE_) {
+
+#pragma omp for schedule (dynamic)
+
+      for (index_q = 0; index_q < ptr->q_size; index_q += ppr->transfer_pruning_stride) {
+
+        class_call_parallel(transfer_update_HIS(ppr,
+                                                ptr,
+                                                ptw,
+                                                index_q,
+                                                tau0),
+                            ptr->error_message,
+                            ptr->error_message);
+
+        class_call_parallel(transfer_compute_for_each_q(ppr,
+                                                        pba,
+                                                        ppt,
+                                                        ptr,
+                                                        tp_of_tt,
+                                                        index_q,
+                                                        tau_size_max,
+                                                        tau_rec,
+                                                        sources,
+                                                        sources_spline,
+                                                        ptw),
+                            ptr->error_message,
+                            ptr->error_message);
+
+#pragma omp flush(abort)
+
+      }
+
+#pragma omp single
+      {
+        class_call_parallel(transfer_pruning_select(ppr,pba,ppt,ppm,ptr,tau_rec,&BIS),
+                            ptr->error_message,
+                            ptr->error_message);
+      }
+    }
+
     /** - loop over all wavenumbers (parallelized).*/
     /* For each wavenumber: */
 
-#pragma omp for schedule (dynamic)
+#pragma omp for schedule (dynamic,ppr->transfer_omp_chunk)
 
     for (index_q = 0; index_q < ptr->q_size; index_q++) {
 
@@ -336,6 +426,10 @@ int transfer_init(
       tstart = omp_get_wtime();
 #endif
 
+      /* with pruning, some wavenumbers were already computed */
+      if ((prune == _TRUE_) && (index_q % ppr->transfer_pruning_stride == 0))
+        continue;
+
       if (ptr->transfer_verbose > 2)
         printf("Compute transfer for wavenumber [%d/%zu]\n",index_q,ptr->q_size-1);
 
@@ -385,6 +479,13 @@ int transfer_init(
 
   } /* end of parallel region */
 
+  if (ptr->pruned != NULL) {
+    for (index_md = 0; index_md < ptr->md_size; index_md++)
+      free(ptr->pruned[index_md]);
+    free(ptr->pruned);
+    ptr->pruned = NULL;
+  }
+
   if (abort == _TRUE_) return _FAILURE_;
 
   /** - finally, free arrays allocated outside parallel zone */
@@ -427,7 +528,7 @@ int transfer_free(
 
     for (index_md = 0; index_md < ptr->md_size; index_md++) {
       free(ptr->l_size_tt[index_md]);
-      free(ptr->transfer[index_md]);
+      buffer_pool_free(ptr->transfer[index_md]);
       free(ptr->k[index_md]);
     }
 
@@ -439,17 +540,16 @@ int transfer_free(
     free(ptr->k);
     free(ptr->transfer);
 
-    if (ptr->nz_size > 0) {
-      free(ptr->nz_z);
-      free(ptr->nz_nz);
-      free(ptr->nz_ddnz);
+    /* the nz and nz_evo tables belong to the table cache: only release them */
+    if (ptr->has_nz_file == _TRUE_) {
+      class_call(table_cache_release(ptr->nz_table,ptr->error_message),
+                 ptr->error_message,
+                 ptr->error_message);
     }
-
-    if (ptr->nz_evo_size > 0) {
-      free(ptr->nz_evo_z);
-      free(ptr->nz_evo_nz);
-      free(ptr->nz_evo_dlog_nz);
-      free(ptr->nz_evo_dd_dlog_nz);
+    if (ptr->has_nz_evo_file == _TRUE_) {
+      class_call(table_cache_release(ptr->nz_evo_table,ptr->error_message),
+                 ptr->error_message,
+                 ptr->error_message);
     }
   }
 
@@ -467,6 +567,7 @@ int transfer_free(
  *
  * @param ppr      Input: pointer to precision structure
  * @param ppt      Input: pointer to perturbation structure
+ * @param ppm      Input: pointer to primordial structure
  * @param ptr      Input/Output: pointer to transfer structure
  * @param q_period Input: order of magnitude of the oscillation period of transfer functions
  * @param K        Input: spatial curvature (in absolute value)
@@ -477,6 +578,7 @@ int transfer_free(
 int transfer_indices_of_transfers(
                                   struct precision * ppr,
                                   struct perturbs * ppt,
+                                  struct primordial * ppm,
                                   struct transfers * ptr,
                                   double q_period,
                                   double K,
@@ -572,7 +674,7 @@ int transfer_indices_of_transfers(
 
   /** - get q values using transfer_get_q_list() */
 
-  class_call(transfer_get_q_list(ppr,ppt,ptr,q_period,K,sgnK),
+  class_call(transfer_get_q_list(ppr,ppt,ppm,ptr,q_period,K,sgnK),
              ptr->error_message,
              ptr->error_message);
 
@@ -611,9 +713,9 @@ int transfer_indices_of_transfers(
   for (index_md = 0; index_md < ptr->md_size; index_md++) {
 
     /** - allocate arrays of transfer functions, (ptr->transfer[index_md])[index_ic][index_tt][index_l][index_k] */
-    class_alloc(ptr->transfer[index_md],
-                ppt->ic_size[index_md] * ptr->tt_size[index_md] * ptr->l_size[index_md] * ptr->q_size * sizeof(double),
-                ptr->error_message);
+    class_alloc_pooled(ptr->transfer[index_md],
+                       ppt->ic_size[index_md] * ptr->tt_size[index_md] * ptr->l_size[index_md] * ptr->q_size * sizeof(double),
+                       ptr->error_message);
 
   }
 
@@ -653,9 +755,9 @@ int transfer_perturbation_copy_sources_and_nl_corrections(
              ((ppt->has_source_phi_plus_psi == _TRUE_) && (index_tp == ppt->index_tp_phi_plus_psi)) ||
              ((ppt->has_source_psi == _TRUE_) && (index_tp == ppt->index_tp_psi)))) {
 
-          class_alloc(sources[index_md][index_ic * ppt->tp_size[index_md] + index_tp],
-                      ppt->k_size[index_md]*ppt->tau_size*sizeof(double),
-                      ptr->error_message);
+          class_alloc_pooled(sources[index_md][index_ic * ppt->tp_size[index_md] + index_tp],
+                             ppt->k_size[index_md]*ppt->tau_size*sizeof(double),
+                             ptr->error_message);
 
           for (index_tau=0; index_tau<ppt->tau_size; index_tau++) {
             for (index_k=0; index_k<ppt->k_size[index_md]; index_k++) {
@@ -714,9 +816,9 @@ int transfer_perturbation_source_spline(
 
       for (index_tp = 0; index_tp < ppt->tp_size[index_md]; index_tp++) {
 
-        class_alloc(sources_spline[index_md][index_ic * ppt->tp_size[index_md] + index_tp],
-                    ppt->k_size[index_md]*ppt->tau_size*sizeof(double),
-                    ptr->error_message);
+        class_alloc_pooled(sources_spline[index_md][index_ic * ppt->tp_size[index_md] + index_tp],
+                           ppt->k_size[index_md]*ppt->tau_size*sizeof(double),
+                           ptr->error_message);
 
         class_call(array_spline_table_columns2(ppt->k[index_md],
                                                ppt->k_size[index_md],
@@ -759,7 +861,7 @@ int transfer_perturbation_sources_free(
              ((ppt->has_source_phi_plus_psi == _TRUE_) && (index_tp == ppt->index_tp_phi_plus_psi)) ||
              ((ppt->has_source_psi == _TRUE_) && (index_tp == ppt->index_tp_psi)))) {
 
-          free(sources[index_md][index_ic * ppt->tp_size[index_md] + index_tp]);
+          buffer_pool_free(sources[index_md][index_ic * ppt->tp_size[index_md] + index_tp]);
         }
       }
     }
@@ -782,7 +884,7 @@ int transfer_perturbation_sources_spline_free(
   for (index_md = 0; index_md < ptr->md_size; index_md++) {
     for (index_ic = 0; index_ic < ppt->ic_size[index_md]; index_ic++) {
       for (index_tp = 0; index_tp < ppt->tp_size[index_md]; index_tp++) {
-        free(sources_spline[index_md][index_ic * ppt->tp_size[index_md] + index_tp]);
+        buffer_pool_free(sources_spline[index_md][index_ic * ppt->tp_size[index_md] + index_tp]);
       }
     }
     free(sources_spline[index_md]);
@@ -989,10 +1091,13 @@ int transfer_get_l_list(
 /**
  * This routine defines the number and values of wavenumbers q for
  * each mode (goes smoothly from logarithmic step for small q's to
- * linear step for large q's).
+ * linear step for large q's). In the flat case, steps are further
+ * subdivided where they do not resolve features of the primordial
+ * spectrum, as found by primordial_k_sampling().
  *
  * @param ppr     Input: pointer to precision structure
  * @param ppt     Input: pointer to perturbation structure
+ * @param ppm     Input: pointer to primordial structure
  * @param ptr     Input/Output: pointer to transfers structure containing q's
  * @param q_period Input: order of magnitude of the oscillation period of transfer functions
  * @param K        Input: spatial curvature (in absolute value)
@@ -1003,6 +1108,7 @@ int transfer_get_l_list(
 int transfer_get_q_list(
                         struct precision * ppr,
                         struct perturbs * ppt,
+                        struct primordial * ppm,
                         struct transfers * ptr,
                         double q_period,
                         double K,
@@ -1019,6 +1125,13 @@ int transfer_get_q_list(
   double q_logstep_spline;
   double q_logstep_trapzd;
   int index_md;
+  int * sub_steps;
+  int sub_steps_max;
+  int n_transition;
+  int index_step;
+  double * density;
+  double * q_list;
+  int q_size;
 
   /* first and last value in flat case*/
 
@@ -1201,6 +1314,103 @@ int transfer_get_q_list(
                 ptr->q_size*sizeof(double),
                 ptr->error_message);
 
+  /* in flat universe, refine the steps which do not resolve features
+     of the primordial spectra (oscillations, steps...), such that
+     the C_l integrals over q sample them correctly. The transfer
+     functions oscillate with a period close to two steps, and their
+     integrals are accurate only as long as the step varies slowly:
+     hence the density of points is increased gradually, over
+     q_numstep_transition steps, on each side of the features. */
+
+  if ((sgnK == 0) && (ppr->primordial_feature_tol > 0.)) {
+
+    class_alloc(sub_steps,(ptr->q_size-1)*sizeof(int),ptr->error_message);
+
+    class_call(primordial_k_sampling(ppm,
+                                     ptr->q,
+                                     ptr->q_size,
+                                     ppr->primordial_feature_tol,
+                                     ppr->q_feature_max_refinement,
+                                     sub_steps),
+               ppm->error_message,
+               ptr->error_message);
+
+    sub_steps_max = 1;
+    for (index_q=0; index_q<ptr->q_size-1; index_q++)
+      sub_steps_max = MAX(sub_steps_max,sub_steps[index_q]);
+
+    if (sub_steps_max > 1) {
+
+      /* density of points with respect to the initial list, in each of its steps */
+
+      n_transition = MAX(1,(int)ppr->q_numstep_transition);
+
+      class_calloc(density,ptr->q_size-1,sizeof(double),ptr->error_message);
+
+      for (index_q=0; index_q<ptr->q_size-1; index_q++)
+        density[index_q] = 1.;
+
+      for (index_q=0; index_q<ptr->q_size-1; index_q++) {
+        if (sub_steps[index_q] > 1) {
+          for (index_step=MAX(0,index_q-n_transition); index_step<MIN(ptr->q_size-1,index_q+n_transition+1); index_step++) {
+            density[index_step] = MAX(density[index_step],
+                                      1.+(sub_steps[index_q]-1.)*(1.-(double)abs(index_step-index_q)/n_transition));
+          }
+        }
+      }
+
+      q_size_max = 2;
+      for (index_q=0; index_q<ptr->q_size-1; index_q++)
+        q_size_max += (int)ceil(density[index_q])+1;
+
+      class_alloc(q_list,q_size_max*sizeof(double),ptr->error_message);
+
+      /* new list, with a step equal to the initial one divided by the density */
+
+      q_size = 0;
+      q_list[q_size++] = ptr->q[0];
+      index_step = 0;
+
+      while (_TRUE_) {
+
+        q = q_list[q_size-1];
+
+        while ((index_step < ptr->q_size-1) && (q >= ptr->q[index_step+1]))
+          index_step++;
+
+        if (index_step == ptr->q_size-1)
+          break;
+
+        q_step = (ptr->q[index_step+1]-ptr->q[index_step])/density[index_step];
+
+        if ((density[index_step] == 1.) && (q == ptr->q[index_step]))
+          q = ptr->q[index_step+1];
+        else
+          q += q_step;
+
+        if (q > ptr->q[ptr->q_size-1]-0.5*q_step)
+          break;
+
+        class_test(q_size >= q_size_max-1,ptr->error_message,"buggy q-list definition");
+
+        q_list[q_size++] = q;
+      }
+
+      if (q_list[q_size-1] < ptr->q[ptr->q_size-1])
+        q_list[q_size++] = ptr->q[ptr->q_size-1];
+
+      if (ptr->transfer_verbose > 1)
+        printf("Resolving features of the primordial spectrum with %d additional wavenumbers\n",q_size-(int)ptr->q_size);
+
+      free(density);
+      free(ptr->q);
+      ptr->q = q_list;
+      ptr->q_size = q_size;
+    }
+
+    free(sub_steps);
+  }
+
   /* in curved universe, check at which index the flat rescaling
      approximation will start being used */
 
@@ -1764,6 +1974,40 @@ int transfer_compute_for_each_q(
 
         for (index_tt = 0; index_tt < ptr->tt_size[index_md]; index_tt++) {
 
+          /** - if the C_l's of this type are computed with FFTLog
+              for all its multipoles, skip even the computation of
+              the source (see spectra_cls_fftlog()) */
+
+          if ((ptr->fftlog_skip == _TRUE_) && _index_tt_fftlog_ &&
+              (ptr->l[ptr->l_size_tt[index_md][index_tt]-1] <= ptr->l_fftlog_max)) {
+            for (index_l = 0; index_l < ptr->l_size[index_md]; index_l++) {
+              ptr->transfer[index_md][((index_ic * ptr->tt_size[index_md] + index_tt)
+                                       * ptr->l_size[index_md] + index_l)
+                                      * ptr->q_size + index_q] = 0.;
+            }
+            continue;
+          }
+
+          /** - if all multipoles of this type are pruned or
+              neglected, skip even the computation of the source */
+
+          if (ptr->pruned != NULL) {
+            for (index_l = 0; index_l < ptr->l_size[index_md]; index_l++) {
+              if (ptr->pruned[index_md][((index_ic * ptr->tt_size[index_md] + index_tt)
+                                         * ptr->l_size[index_md] + index_l)
+                                        * ptr->q_size + index_q] == _FALSE_)
+                break;
+            }
+            if (index_l == ptr->l_size[index_md]) {
+              for (index_l = 0; index_l < ptr->l_size[index_md]; index_l++) {
+                ptr->transfer[index_md][((index_ic * ptr->tt_size[index_md] + index_tt)
+                                         * ptr->l_size[index_md] + index_l)
+                                        * ptr->q_size + index_q] = 0.;
+              }
+              continue;
+            }
+          }
+
           /** - check if we must now deal with a new source with a
               new index ppt->index_type. If yes, interpolate it at the
               right values of k. */
@@ -1855,6 +2099,17 @@ int transfer_compute_for_each_q(
             if ((ptw->sgnK != 0) && (index_l>=ptw->HIS.l_size) && (index_q < ptr->index_q_flat_approximation)) {
               neglect = _TRUE_;
             }
+            /* pairs with negligible contribution to the C_l's, see transfer_pruning_select() */
+            if ((ptr->pruned != NULL) &&
+                (ptr->pruned[index_md][((index_ic * ptr->tt_size[index_md] + index_tt)
+                                        * ptr->l_size[index_md] + index_l)
+                                       * ptr->q_size + index_q] == _TRUE_)) {
+              neglect = _TRUE_;
+            }
+            /* multipoles whose C_l's are computed with FFTLog */
+            if ((ptr->fftlog_skip == _TRUE_) && _index_tt_fftlog_ && (ptr->l[index_l] <= ptr->l_fftlog_max)) {
+              neglect = _TRUE_;
+            }
             if (neglect == _TRUE_) {
 
               ptr->transfer[index_md][((index_ic * ptr->tt_size[index_md] + index_tt)
@@ -3007,6 +3262,102 @@ int transfer_selection_function(
   return _SUCCESS_;
 }
 
+/**
+ * Overlap between the selection functions of two redshift bins,
+ * defined as \f$ \int dz W_1 W_2 / \sqrt{\int dz W_1^2 \int dz W_2^2}
+ * \f$. It is equal to one for identical bins and vanishes for
+ * disjoint ones. For Dirac selection functions, it is one if the two
+ * bins coincide and zero otherwise.
+ *
+ * @param ppr                   Input: pointer to precision structure
+ * @param ppt                   Input: pointer to perturbation structure
+ * @param ptr                   Input: pointer to transfers structure
+ * @param bin1                  Input: first redshift bin number
+ * @param bin2                  Input: second redshift bin number
+ * @param overlap               Output: overlap of the two selection functions
+ * @return the error status
+ */
+
+int transfer_selection_overlap(
+                               struct precision * ppr,
+                               struct perturbs * ppt,
+                               struct transfers * ptr,
+                               int bin1,
+                               int bin2,
+                               double * overlap
+                               ) {
+
+  int bin[2];
+  double z_min[2];
+  double z_max[2];
+  double norm[2];
+  double z,dz,w1,w2,cross,weight;
+  int index_bin,index_z,z_size;
+
+  if (ppt->selection==dirac) {
+    *overlap = (ppt->selection_mean[bin1] == ppt->selection_mean[bin2]) ? 1. : 0.;
+    return _SUCCESS_;
+  }
+
+  /* redshift range of each bin, consistent with transfer_selection_times() */
+  bin[0] = bin1;
+  bin[1] = bin2;
+  for (index_bin=0; index_bin<2; index_bin++) {
+    if (ppt->selection==gaussian) {
+      z_min[index_bin] = MAX(ppt->selection_mean[bin[index_bin]]-ppt->selection_width[bin[index_bin]]*ppr->selection_cut_at_sigma,0.);
+      z_max[index_bin] = ppt->selection_mean[bin[index_bin]]+ppt->selection_width[bin[index_bin]]*ppr->selection_cut_at_sigma;
+    }
+    else {
+      z_min[index_bin] = MAX(ppt->selection_mean[bin[index_bin]]-(1.+ppr->selection_cut_at_sigma*ppr->selection_tophat_edge)*ppt->selection_width[bin[index_bin]],0.);
+      z_max[index_bin] = ppt->selection_mean[bin[index_bin]]+(1.+ppr->selection_cut_at_sigma*ppr->selection_tophat_edge)*ppt->selection_width[bin[index_bin]];
+    }
+  }
+
+  if ((z_max[0] <= z_min[1]) || (z_max[1] <= z_min[0])) {
+    *overlap = 0.;
+    return _SUCCESS_;
+  }
+
+  z_size = MAX((int)ppr->selection_sampling,2);
+
+  /* norm of each selection function, with trapezoidal integration */
+  for (index_bin=0; index_bin<2; index_bin++) {
+    norm[index_bin] = 0.;
+    dz = (z_max[index_bin]-z_min[index_bin])/(z_size-1);
+    for (index_z=0; index_z<z_size; index_z++) {
+      z = z_min[index_bin]+index_z*dz;
+      class_call(transfer_selection_function(ppr,ppt,ptr,bin[index_bin],z,&w1),
+                 ptr->error_message,
+                 ptr->error_message);
+      weight = ((index_z == 0) || (index_z == z_size-1)) ? 0.5 : 1.;
+      norm[index_bin] += weight*w1*w1*dz;
+    }
+  }
+
+  /* cross term, over the intersection of the two ranges */
+  cross = 0.;
+  dz = (MIN(z_max[0],z_max[1])-MAX(z_min[0],z_min[1]))/(z_size-1);
+  for (index_z=0; index_z<z_size; index_z++) {
+    z = MAX(z_min[0],z_min[1])+index_z*dz;
+    class_call(transfer_selection_function(ppr,ppt,ptr,bin1,z,&w1),
+               ptr->error_message,
+               ptr->error_message);
+    class_call(transfer_selection_function(ppr,ppt,ptr,bin2,z,&w2),
+               ptr->error_message,
+               ptr->error_message);
+    weight = ((index_z == 0) || (index_z == z_size-1)) ? 0.5 : 1.;
+    cross += weight*w1*w2*dz;
+  }
+
+  class_test((norm[0] <= 0.) || (norm[1] <= 0.),
+             ptr->error_message,
+             "selection function of bin %d or %d vanishes everywhere",bin1,bin2);
+
+  *overlap = cross/sqrt(norm[0]*norm[1]);
+
+  return _SUCCESS_;
+}
+
 /**
  * Analytic form for dNdz distribution, from arXiv:1004.4640
  *
@@ -3453,6 +3804,303 @@ int transfer_selection_compute(
  * @return the error status
  */
 
+/**
+ * Select the (q,l) pairs whose line-of-sight integral can be skipped
+ * (pruned) because their contribution to the C_l's is negligible.
+ *
+ * Transfer functions must have already been computed exactly at every
+ * transfer_pruning_stride wavenumber. At the other wavenumbers, the
+ * amplitude of the transfer function is predicted as the largest
+ * exact value among the _TRANSFER_PRUNING_WINDOW_ closest exact
+ * wavenumbers on each side: since transfer functions oscillate with a
+ * period of about two steps in q, with a phase drifting slowly from
+ * one step to the next, this window samples their envelope. Pairs for
+ * which no exact value is available in the window are never pruned.
+ *
+ * The contribution of each pair to the diagonal \f$ C_l^{XX} \f$ of
+ * its type X is then \f$ w_q P(q) \Delta_l^X(q)^2 / q \f$ (with w_q the
+ * quadrature weight over q and P(q) the primordial spectrum). Let
+ * \f$ a^X(q) \f$ be the square root of this contribution divided by
+ * \f$ C_l^{XX} \f$. Setting \f$ \Delta_l^X(q) \f$ to zero changes any
+ * \f$ C_l^{XY} \f$ by at most \f$ a^X(q) \max_Y a^Y(q) \f$ in units of
+ * \f$ \sqrt{C_l^{XX} C_l^{YY}} \f$: this is the cost of pruning the
+ * pair. For each type and multipole, the pairs are sorted by
+ * increasing ratio of this cost to the work saved by skipping the
+ * integral (estimated as the length of the integration range in
+ * units of the Bessel oscillation period, or one for the Limber
+ * approximation), and pruned in this order as long as the sum of
+ * their costs remains below transfer_pruning_tolerance.
+ *
+ * Allocates and fills ptr->pruned, and fills ptr->pruned_fraction and
+ * ptr->pruned_cl_error.
+ *
+ * @param ppr     Input: pointer to precision structure
+ * @param pba     Input: pointer to background structure
+ * @param ppt     Input: pointer to perturbation structure
+ * @param ppm     Input: pointer to primordial structure
+ * @param ptr     Input/Output: pointer to transfers structure
+ * @param tau_rec Input: recombination time
+ * @param pBIS    Input: pointer to flat spherical Bessel functions
+ * @return the error status
+ */
+
+int transfer_pruning_select(
+                            struct precision * ppr,
+                            struct background * pba,
+                            struct perturbs * ppt,
+                            struct primordial * ppm,
+                            struct transfers * ptr,
+                            double tau_rec,
+                            HyperInterpStruct * pBIS
+                            ) {
+
+  int index_md,index_ic,index_tt,index_l,index_q,index_q_exact,index;
+  int stride,index_q_min,index_q_max;
+  int cost_size,index_c;
+  long int pairs=0,pruned_pairs=0;
+  double total_work=0.,pruned_work=0.;
+  double * weight;
+  double * pk;
+  double * pk_weight;
+  double * amplitude;
+  double * amplitude_max;
+  double * work;
+  double * sorted;
+  double cl,cost,sum,transfer_max,l,k,q_max_bessel,tau0,range;
+  double threshold;
+  short * exact;
+  short * candidate;
+  short neglect,use_limber;
+
+  stride = ppr->transfer_pruning_stride;
+  tau0 = pba->conformal_age;
+  q_max_bessel = pBIS->x[pBIS->x_size-1]/tau0;
+
+  class_alloc(ptr->pruned,ptr->md_size*sizeof(short *),ptr->error_message);
+  class_alloc(exact,ptr->q_size*sizeof(short),ptr->error_message);
+  class_alloc(weight,ptr->q_size*sizeof(double),ptr->error_message);
+  class_alloc(pk_weight,ptr->q_size*sizeof(double),ptr->error_message);
+  class_alloc(amplitude_max,ptr->q_size*sizeof(double),ptr->error_message);
+  class_alloc(sorted,2*ptr->q_size*sizeof(double),ptr->error_message);
+
+  /* wavenumbers where transfer functions have been computed exactly,
+     and quadrature weights over q */
+  for (index_q = 0; index_q < ptr->q_size; index_q++) {
+    exact[index_q] = (index_q % stride == 0) ? _TRUE_ : _FALSE_;
+    weight[index_q] = 0.5*(ptr->q[MIN(index_q+1,ptr->q_size-1)]-ptr->q[MAX(index_q-1,0)]);
+  }
+
+  for (index_md = 0; index_md < ptr->md_size; index_md++) {
+
+    class_alloc(ptr->pruned[index_md],
+                ppt->ic_size[index_md]*ptr->tt_size[index_md]*ptr->l_size[index_md]*ptr->q_size*sizeof(short),
+                ptr->error_message);
+
+    class_alloc(pk,ppm->ic_ic_size[index_md]*sizeof(double),ptr->error_message);
+    class_alloc(amplitude,ptr->tt_size[index_md]*ptr->q_size*sizeof(double),ptr->error_message);
+    class_alloc(work,ptr->tt_size[index_md]*ptr->q_size*sizeof(double),ptr->error_message);
+    class_alloc(candidate,ptr->tt_size[index_md]*ptr->q_size*sizeof(short),ptr->error_message);
+
+    for (index_ic = 0; index_ic < ppt->ic_size[index_md]; index_ic++) {
+
+      /* weight times primordial spectrum over q */
+      for (index_q = 0; index_q < ptr->q_size; index_q++) {
+        pk_weight[index_q] = 0.;
+        if (ptr->k[index_md][index_q] <= ppt->k[index_md][ppt->k_size_cl[index_md]-1]) {
+          class_call(primordial_spectrum_at_k(ppm,index_md,linear,ptr->k[index_md][index_q],pk),
+                     ppm->error_message,
+                     ptr->error_message);
+          pk_weight[index_q] = weight[index_q]*pk[index_symmetric_matrix(index_ic,index_ic,ppm->ic_size[index_md])]/ptr->q[index_q];
+        }
+      }
+
+      for (index_l = 0; index_l < ptr->l_size[index_md]; index_l++) {
+
+        l = (double)ptr->l[index_l];
+
+        for (index_q = 0; index_q < ptr->q_size; index_q++)
+          amplitude_max[index_q] = 0.;
+
+        /* for all types: which pairs would be computed (the others
+           are neglected anyway, like in
+           transfer_compute_for_each_q()), their work, and the
+           normalised amplitudes a^X(q) */
+        for (index_tt = 0; index_tt < ptr->tt_size[index_md]; index_tt++) {
+
+          index = ((index_ic * ptr->tt_size[index_md] + index_tt) * ptr->l_size[index_md] + index_l) * ptr->q_size;
+
+          for (index_q = 0; index_q < ptr->q_size; index_q++) {
+
+            k = ptr->k[index_md][index_q];
+            candidate[index_tt*ptr->q_size+index_q] = _FALSE_;
+            work[index_tt*ptr->q_size+index_q] = 0.;
+
+            if ((k > ppt->k[index_md][ppt->k_size_cl[index_md]-1]) ||
+                (index_l >= ptr->l_size_tt[index_md][index_tt]))
+              continue;
+
+            class_call(transfer_can_be_neglected(ppr,
+                                                 ppt,
+                                                 ptr,
+                                                 index_md,
+                                                 index_ic,
+                                                 index_tt,
+                                                 (tau0-tau_rec)*ptr->angular_rescaling,
+                                                 ptr->q[index_q],
+                                                 l,
+                                                 &neglect),
+                       ptr->error_message,
+                       ptr->error_message);
+
+            if (neglect == _TRUE_)
+              continue;
+
+            candidate[index_tt*ptr->q_size+index_q] = _TRUE_;
+
+            class_call(transfer_use_limber(ppr,ppt,ptr,q_max_bessel,index_md,index_tt,ptr->q[index_q],l,&use_limber),
+                       ptr->error_message,
+                       ptr->error_message);
+
+            if (use_limber == _TRUE_) {
+              work[index_tt*ptr->q_size+index_q] = 1.;
+            }
+            else {
+              range = k*tau0-pBIS->chi_at_phimin[index_l];
+              work[index_tt*ptr->q_size+index_q] = MAX(range/_PI_,1.);
+            }
+          }
+
+          cl = 0.;
+          for (index_q = 0; index_q < ptr->q_size; index_q++) {
+
+            amplitude[index_tt*ptr->q_size+index_q] = -1.;
+
+            if (candidate[index_tt*ptr->q_size+index_q] == _FALSE_)
+              continue;
+
+            if (exact[index_q] == _TRUE_) {
+              transfer_max = fabs(ptr->transfer[index_md][index+index_q]);
+            }
+            else {
+              index_q_min = MAX((index_q/stride-_TRANSFER_PRUNING_WINDOW_+1)*stride,0);
+              index_q_max = MIN((index_q/stride+_TRANSFER_PRUNING_WINDOW_)*stride,ptr->q_size-1);
+              transfer_max = -1.;
+              for (index_q_exact = index_q_min; index_q_exact <= index_q_max; index_q_exact++) {
+                if ((exact[index_q_exact] == _TRUE_) && (candidate[index_tt*ptr->q_size+index_q_exact] == _TRUE_))
+                  transfer_max = MAX(transfer_max,fabs(ptr->transfer[index_md][index+index_q_exact]));
+              }
+              /* no prediction available: this pair will not be pruned */
+              if (transfer_max < 0.)
+                continue;
+            }
+
+            amplitude[index_tt*ptr->q_size+index_q] = pk_weight[index_q]*transfer_max*transfer_max;
+            cl += amplitude[index_tt*ptr->q_size+index_q];
+          }
+
+          for (index_q = 0; index_q < ptr->q_size; index_q++) {
+            if ((amplitude[index_tt*ptr->q_size+index_q] >= 0.) && (cl > 0.)) {
+              amplitude[index_tt*ptr->q_size+index_q] = sqrt(amplitude[index_tt*ptr->q_size+index_q]/cl);
+              amplitude_max[index_q] = MAX(amplitude_max[index_q],amplitude[index_tt*ptr->q_size+index_q]);
+            }
+          }
+        }
+
+        /* for each type, prune the pairs with smallest cost/work */
+        for (index_tt = 0; index_tt < ptr->tt_size[index_md]; index_tt++) {
+
+          index = ((index_ic * ptr->tt_size[index_md] + index_tt) * ptr->l_size[index_md] + index_l) * ptr->q_size;
+
+          /* (cost/work, cost) of all pairs which can be pruned */
+          cost_size = 0;
+          for (index_q = 0; index_q < ptr->q_size; index_q++) {
+            if (candidate[index_tt*ptr->q_size+index_q] == _TRUE_) {
+              pairs++;
+              total_work += work[index_tt*ptr->q_size+index_q];
+              if ((exact[index_q] == _FALSE_) && (amplitude[index_tt*ptr->q_size+index_q] >= 0.)) {
+                cost = amplitude[index_tt*ptr->q_size+index_q]*amplitude_max[index_q];
+                sorted[2*cost_size] = cost/work[index_tt*ptr->q_size+index_q];
+                sorted[2*cost_size+1] = cost;
+                cost_size++;
+              }
+            }
+          }
+
+          /* largest cost/work such that the costs of all pairs with
+             smaller cost/work sum to less than the tolerance */
+          threshold = -1.;
+          qsort(sorted,cost_size,2*sizeof(double),transfer_pruning_compare);
+          sum = 0.;
+          for (index_c = 0; (index_c < cost_size) && (sum+sorted[2*index_c+1] <= ppr->transfer_pruning_tolerance); index_c++) {
+            sum += sorted[2*index_c+1];
+            threshold = sorted[2*index_c];
+          }
+
+          /* pairs which need not be computed: those neglected anyway, and those pruned */
+          sum = 0.;
+          for (index_q = 0; index_q < ptr->q_size; index_q++) {
+            cost = amplitude[index_tt*ptr->q_size+index_q]*amplitude_max[index_q];
+            if (candidate[index_tt*ptr->q_size+index_q] == _FALSE_) {
+              ptr->pruned[index_md][index+index_q] = _TRUE_;
+            }
+            else if ((exact[index_q] == _FALSE_) &&
+                     (amplitude[index_tt*ptr->q_size+index_q] >= 0.) &&
+                     (cost/work[index_tt*ptr->q_size+index_q] <= threshold)) {
+              ptr->pruned[index_md][index+index_q] = _TRUE_;
+              sum += cost;
+              pruned_pairs++;
+              pruned_work += work[index_tt*ptr->q_size+index_q];
+            }
+            else {
+              ptr->pruned[index_md][index+index_q] = _FALSE_;
+            }
+          }
+
+          ptr->pruned_cl_error = MAX(ptr->pruned_cl_error,sum);
+        }
+      }
+    }
+
+    free(pk);
+    free(amplitude);
+    free(work);
+    free(candidate);
+  }
+
+  if (pairs > 0)
+    ptr->pruned_fraction = (double)pruned_pairs/(double)pairs;
+
+  if (ptr->transfer_verbose > 0)
+    printf(" -> pruned %ld out of %ld line-of-sight integrals (%.1f%%, %.1f%% of estimated work), estimated max relative error on C_l's %.2e\n",
+           pruned_pairs,pairs,100.*ptr->pruned_fraction,(total_work > 0. ? 100.*pruned_work/total_work : 0.),ptr->pruned_cl_error);
+
+  free(exact);
+  free(weight);
+  free(pk_weight);
+  free(amplitude_max);
+  free(sorted);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Comparison function for sorting with qsort() in increasing order of
+ * the first double of each element
+ */
+
+int transfer_pruning_compare(
+                             const void * a,
+                             const void * b
+                             ) {
+
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+
+  return (da > db) - (da < db);
+
+}
+
 int transfer_compute_for_each_l(
                                 struct transfer_workspace * ptw,
                                 struct precision * ppr,
@@ -4605,114 +5253,216 @@ int transfer_select_radial_function(
 
 }
 
-/* for reading global selection function (ie the one multiplying the selection function of each bin) */
+/**
+ * Read a global selection function dN/dz from a file with two columns
+ * (z, dN/dz), and spline it. This is the reading function passed to
+ * table_cache_get(), such that the file is read only once per process.
+ *
+ * The table is stored as shape[0] = nz_size and data = [z, dN/dz,
+ * second derivative of dN/dz] (nz_size values each).
+ *
+ * @param filename      Input: name of the file
+ * @param table         Output: table to be filled
+ * @param error_message Output: error message
+ * @return the error status
+ */
 
-int transfer_global_selection_read(
-                                   struct transfers * ptr
-                                   ) {
+int transfer_read_nz_table(
+                           char * filename,
+                           struct file_table * table,
+                           ErrorMsg error_message
+                           ) {
 
-  /* for reading selection function */
   FILE * input_file;
   int row,status;
   double tmp1,tmp2;
+  int nz_size;
+  double * nz_z;
+  double * nz_nz;
 
-  ptr->nz_size = 0;
+  class_open(input_file,filename,"r",error_message);
 
-  if (ptr->has_nz_file == _TRUE_) {
+  /* Find size of table */
+  for (row=0,status=2; status==2; row++){
+    status = fscanf(input_file,"%lf %lf",&tmp1,&tmp2);
+  }
+  rewind(input_file);
+  nz_size = row-1;
 
-    input_file = fopen(ptr->nz_file_name,"r");
-    class_test(input_file == NULL,
-               ptr->error_message,
-               "Could not open file %s!",ptr->nz_file_name);
+  class_test(nz_size < 2,
+             error_message,
+             "could not read at least two lines (z, dN/dz) in file %s",filename);
+
+  /* Allocate room for interpolation table */
+  table->shape[0] = nz_size;
+  table->shape[1] = 3;
+  table->data_size = 3*nz_size;
+  class_alloc(table->data,sizeof(double)*table->data_size,error_message);
+  nz_z = table->data;
+  nz_nz = nz_z+nz_size;
+
+  for (row=0; row<nz_size; row++){
+    status = fscanf(input_file,"%lf %lf",
+                    &nz_z[row],&nz_nz[row]);
+    //printf("%d: (z,dNdz) = (%g,%g)\n",row,nz_z[row],nz_nz[row]);
+  }
+  fclose(input_file);
+
+  /* Call spline interpolation: */
+  class_call_except(array_spline_table_lines(nz_z,
+                                             nz_size,
+                                             nz_nz,
+                                             1,
+                                             nz_nz+nz_size,
+                                             _SPLINE_EST_DERIV_,
+                                             error_message),
+                    error_message,
+                    error_message,
+                    free(table->data));
 
-    /* Find size of table */
-    for (row=0,status=2; status==2; row++){
-      status = fscanf(input_file,"%lf %lf",&tmp1,&tmp2);
-    }
-    rewind(input_file);
-    ptr->nz_size = row-1;
-
-    /* Allocate room for interpolation table */
-    class_alloc(ptr->nz_z,sizeof(double)*ptr->nz_size,ptr->error_message);
-    class_alloc(ptr->nz_nz,sizeof(double)*ptr->nz_size,ptr->error_message);
-    class_alloc(ptr->nz_ddnz,sizeof(double)*ptr->nz_size,ptr->error_message);
-
-    for (row=0; row<ptr->nz_size; row++){
-      status = fscanf(input_file,"%lf %lf",
-                      &ptr->nz_z[row],&ptr->nz_nz[row]);
-      //printf("%d: (z,dNdz) = (%g,%g)\n",row,ptr->nz_z[row],ptr->nz_nz[row]);
-    }
-    fclose(input_file);
+  return _SUCCESS_;
 
-    /* Call spline interpolation: */
-    class_call(array_spline_table_lines(ptr->nz_z,
-                                        ptr->nz_size,
-                                        ptr->nz_nz,
-                                        1,
-                                        ptr->nz_ddnz,
-                                        _SPLINE_EST_DERIV_,
-                                        ptr->error_message),
+}
+
+/**
+ * Read an evolution function dN/dz from a file with two columns (z,
+ * dN/dz), infer dlog(dN/dz)/dz and spline it. This is the reading
+ * function passed to table_cache_get(), such that the file is read
+ * only once per process.
+ *
+ * The table is stored as shape[0] = nz_evo_size and data = [z, dN/dz,
+ * dlog(dN/dz)/dz, second derivative of dlog(dN/dz)/dz] (nz_evo_size
+ * values each).
+ *
+ * @param filename      Input: name of the file
+ * @param table         Output: table to be filled
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int transfer_read_nz_evo_table(
+                               char * filename,
+                               struct file_table * table,
+                               ErrorMsg error_message
+                               ) {
+
+  FILE * input_file;
+  int row,status;
+  double tmp1,tmp2;
+  int nz_evo_size;
+  double * nz_evo_z;
+  double * nz_evo_nz;
+  double * nz_evo_dlog_nz;
+
+  class_open(input_file,filename,"r",error_message);
+
+  /* Find size of table */
+  for (row=0,status=2; status==2; row++){
+    status = fscanf(input_file,"%lf %lf",&tmp1,&tmp2);
+  }
+  rewind(input_file);
+  nz_evo_size = row-1;
+
+  class_test(nz_evo_size < 2,
+             error_message,
+             "could not read at least two lines (z, dN/dz) in file %s",filename);
+
+  /* Allocate room for interpolation table */
+  table->shape[0] = nz_evo_size;
+  table->shape[1] = 4;
+  table->data_size = 4*nz_evo_size;
+  class_alloc(table->data,sizeof(double)*table->data_size,error_message);
+  nz_evo_z = table->data;
+  nz_evo_nz = nz_evo_z+nz_evo_size;
+  nz_evo_dlog_nz = nz_evo_nz+nz_evo_size;
+
+  for (row=0; row<nz_evo_size; row++){
+    status = fscanf(input_file,"%lf %lf",
+                    &nz_evo_z[row],&nz_evo_nz[row]);
+  }
+  fclose(input_file);
+
+  /* infer dlog(dN/dz)/dz from dN/dz */
+  nz_evo_dlog_nz[0] =
+    (log(nz_evo_nz[1])-log(nz_evo_nz[0]))
+    /(nz_evo_z[1]-nz_evo_z[0]);
+  for (row=1; row<nz_evo_size-1; row++){
+    nz_evo_dlog_nz[row] =
+      (log(nz_evo_nz[row+1])-log(nz_evo_nz[row-1]))
+      /(nz_evo_z[row+1]-nz_evo_z[row-1]);
+  }
+  nz_evo_dlog_nz[nz_evo_size-1] =
+    (log(nz_evo_nz[nz_evo_size-1])-log(nz_evo_nz[nz_evo_size-2]))
+    /(nz_evo_z[nz_evo_size-1]-nz_evo_z[nz_evo_size-2]);
+
+  /* to test that the file is read:
+     for (row=0; row<nz_evo_size; row++){
+     fprintf(stdout,"%d: (z,dNdz,dlndNdzdz) = (%g,%g,%g)\n",row,nz_evo_z[row],nz_evo_nz[row],nz_evo_dlog_nz[row]);
+     }
+  */
+
+  /* Call spline interpolation: */
+  class_call_except(array_spline_table_lines(nz_evo_z,
+                                             nz_evo_size,
+                                             nz_evo_dlog_nz,
+                                             1,
+                                             nz_evo_dlog_nz+nz_evo_size,
+                                             _SPLINE_EST_DERIV_,
+                                             error_message),
+                    error_message,
+                    error_message,
+                    free(table->data));
+
+  return _SUCCESS_;
+
+}
+
+/* for reading global selection function (ie the one multiplying the
+   selection function of each bin). The tables are read and splined
+   only once per process by table_cache_get(), and ptr only points to
+   them until transfer_free() releases them. */
+
+int transfer_global_selection_read(
+                                   struct transfers * ptr
+                                   ) {
+
+  struct file_table * table;
+
+  ptr->nz_size = 0;
+
+  if (ptr->has_nz_file == _TRUE_) {
+
+    class_call(table_cache_get(ptr->nz_file_name,
+                               transfer_read_nz_table,
+                               &table,
+                               ptr->error_message),
                ptr->error_message,
                ptr->error_message);
+
+    ptr->nz_table = table;
+    ptr->nz_size = table->shape[0];
+    ptr->nz_z = table->data;
+    ptr->nz_nz = ptr->nz_z+ptr->nz_size;
+    ptr->nz_ddnz = ptr->nz_nz+ptr->nz_size;
   }
 
   ptr->nz_evo_size = 0;
 
   if (ptr->has_nz_evo_file == _TRUE_) {
 
-    input_file = fopen(ptr->nz_evo_file_name,"r");
-    class_test(input_file == NULL,
-               ptr->error_message,
-               "Could not open file %s!",ptr->nz_evo_file_name);
-
-    /* Find size of table */
-    for (row=0,status=2; status==2; row++){
-      status = fscanf(input_file,"%lf %lf",&tmp1,&tmp2);
-    }
-    rewind(input_file);
-    ptr->nz_evo_size = row-1;
-
-    /* Allocate room for interpolation table */
-    class_alloc(ptr->nz_evo_z,sizeof(double)*ptr->nz_evo_size,ptr->error_message);
-    class_alloc(ptr->nz_evo_nz,sizeof(double)*ptr->nz_evo_size,ptr->error_message);
-    class_alloc(ptr->nz_evo_dlog_nz,sizeof(double)*ptr->nz_evo_size,ptr->error_message);
-    class_alloc(ptr->nz_evo_dd_dlog_nz,sizeof(double)*ptr->nz_evo_size,ptr->error_message);
-
-    for (row=0; row<ptr->nz_evo_size; row++){
-      status = fscanf(input_file,"%lf %lf",
-                      &ptr->nz_evo_z[row],&ptr->nz_evo_nz[row]);
-    }
-    fclose(input_file);
-
-    /* infer dlog(dN/dz)/dz from dN/dz */
-    ptr->nz_evo_dlog_nz[0] =
-      (log(ptr->nz_evo_nz[1])-log(ptr->nz_evo_nz[0]))
-      /(ptr->nz_evo_z[1]-ptr->nz_evo_z[0]);
-    for (row=1; row<ptr->nz_evo_size-1; row++){
-      ptr->nz_evo_dlog_nz[row] =
-        (log(ptr->nz_evo_nz[row+1])-log(ptr->nz_evo_nz[row-1]))
-        /(ptr->nz_evo_z[row+1]-ptr->nz_evo_z[row-1]);
-    }
-    ptr->nz_evo_dlog_nz[ptr->nz_evo_size-1] =
-      (log(ptr->nz_evo_nz[ptr->nz_evo_size-1])-log(ptr->nz_evo_nz[ptr->nz_evo_size-2]))
-      /(ptr->nz_evo_z[ptr->nz_evo_size-1]-ptr->nz_evo_z[ptr->nz_evo_size-2]);
-
-    /* to test that the file is read:
-       for (row=0; row<ptr->nz_evo_size; row++){
-       fprintf(stdout,"%d: (z,dNdz,dlndNdzdz) = (%g,%g,%g)\n",row,ptr->nz_evo_z[row],ptr->nz_evo_nz[row],ptr->nz_evo_dlog_nz[row]);
-       }
-    */
-
-    /* Call spline interpolation: */
-    class_call(array_spline_table_lines(ptr->nz_evo_z,
-                                        ptr->nz_evo_size,
-                                        ptr->nz_evo_dlog_nz,
-                                        1,
-                                        ptr->nz_evo_dd_dlog_nz,
-                                        _SPLINE_EST_DERIV_,
-                                        ptr->error_message),
+    class_call(table_cache_get(ptr->nz_evo_file_name,
+                               transfer_read_nz_evo_table,
+                               &table,
+                               ptr->error_message),
                ptr->error_message,
                ptr->error_message);
+
+    ptr->nz_evo_table = table;
+    ptr->nz_evo_size = table->shape[0];
+    ptr->nz_evo_z = table->data;
+    ptr->nz_evo_nz = ptr->nz_evo_z+ptr->nz_evo_size;
+    ptr->nz_evo_dlog_nz = ptr->nz_evo_nz+ptr->nz_evo_size;
+    ptr->nz_evo_dd_dlog_nz = ptr->nz_evo_dlog_nz+ptr->nz_evo_size;
   }
 
   return _SUCCESS_;
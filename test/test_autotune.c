@@ -0,0 +1,324 @@
+/** @file test_autotune.c
+ *
+ * Find the parallel configuration giving the largest number of
+ * models computed per hour on this node, for a given input file.
+ *
+ * When many models are computed (e.g. in a Markov chain or a grid),
+ * the available threads can be split between several CLASS instances
+ * running in parallel (as in test_loops_omp.c), each of them using
+ * the remaining threads in its own parallel loops. The best split
+ * depends on the model (number of wavenumbers, stiffness of the
+ * perturbation equations, l_max...) and on the hardware, and so does
+ * the best chunk size of the dynamic schedules in the loops over
+ * wavenumbers of the perturbation and transfer modules (precision
+ * parameters perturb_omp_chunk and transfer_omp_chunk).
+ *
+ * This program runs short calibration jobs of the input file: first
+ * for each number of instances dividing the number of threads, then
+ * for several chunk sizes with the best split. It writes the best
+ * configuration in a file which can be passed to test_loops_omp, and
+ * whose chunk sizes can be passed to any CLASS run as precision
+ * parameters (e.g. as the precision file of ClassEngine).
+ *
+ * Usage: test_autotune input.ini [output file] [models per instance]
+ */
+
+#include "class.h"
+
+/** number of tested values of each chunk size */
+#define _AUTOTUNE_CHUNKS_ 4
+
+/**
+ * Compute one model from the given input parameters, without writing
+ * output files.
+ */
+
+int autotune_one_model(
+                       struct file_content *pfc,
+                       ErrorMsg errmsg
+                       ) {
+
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermo th;           /* for thermodynamics */
+  struct perturbs pt;         /* for source functions */
+  struct transfers tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct spectra sp;          /* for output spectra */
+  struct nonlinear nl;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct output op;           /* for output files */
+
+  class_call(input_init(pfc,&pr,&ba,&th,&pt,&tr,&pm,&sp,&nl,&le,&op,errmsg),
+             errmsg,
+             errmsg);
+
+  class_call(background_init(&pr,&ba),ba.error_message,errmsg);
+  class_call(thermodynamics_init(&pr,&ba,&th),th.error_message,errmsg);
+  class_call(perturb_init(&pr,&ba,&th,&pt),pt.error_message,errmsg);
+  class_call(primordial_init(&pr,&pt,&pm),pm.error_message,errmsg);
+  class_call(nonlinear_init(&pr,&ba,&th,&pt,&pm,&nl),nl.error_message,errmsg);
+  class_call(transfer_init(&pr,&ba,&th,&pt,&pm,&nl,&tr),tr.error_message,errmsg);
+  class_call(spectra_init(&pr,&ba,&pt,&pm,&nl,&tr,&sp),sp.error_message,errmsg);
+  class_call(lensing_init(&pr,&pt,&sp,&nl,&le),le.error_message,errmsg);
+
+  class_call(lensing_free(&le),le.error_message,errmsg);
+  class_call(spectra_free(&sp),sp.error_message,errmsg);
+  class_call(transfer_free(&tr),tr.error_message,errmsg);
+  class_call(nonlinear_free(&nl),nl.error_message,errmsg);
+  class_call(primordial_free(&pm),pm.error_message,errmsg);
+  class_call(perturb_free(&pt),pt.error_message,errmsg);
+  class_call(thermodynamics_free(&th),th.error_message,errmsg);
+  class_call(background_free(&ba),ba.error_message,errmsg);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Run a calibration job: number_of_instances instances of CLASS in
+ * parallel, with number_of_threads threads each, computing
+ * models_per_instance models each. Returns the number of models per
+ * hour.
+ */
+
+int autotune_job(
+                 struct file_content *pfc,
+                 int index_perturb_chunk,
+                 int index_transfer_chunk,
+                 int perturb_chunk,
+                 int transfer_chunk,
+                 int number_of_instances,
+                 int number_of_threads,
+                 int models_per_instance,
+                 double * models_per_hour,
+                 ErrorMsg errmsg
+                 ) {
+
+  double tstart,tstop;
+  int abort;
+
+  sprintf(pfc->value[index_perturb_chunk],"%d",perturb_chunk);
+  sprintf(pfc->value[index_transfer_chunk],"%d",transfer_chunk);
+
+  abort = _FALSE_;
+
+#ifdef _OPENMP
+  tstart = omp_get_wtime();
+#else
+  tstart = (double)time(NULL);
+#endif
+
+#pragma omp parallel num_threads(number_of_instances) shared(pfc,abort,errmsg)
+  {
+    struct file_content fc_local;
+    ErrorMsg errmsg_local;
+    int j;
+
+#ifdef _OPENMP
+    omp_set_num_threads(number_of_threads);
+#endif
+
+    /* each instance needs its own copy, since input_init() sets the read flags */
+    if (parser_init(&fc_local,pfc->size,"",errmsg_local) == _FAILURE_) {
+      abort = _TRUE_;
+    }
+    else {
+      for (j=0; j < pfc->size; j++) {
+        strcpy(fc_local.value[j],pfc->value[j]);
+        strcpy(fc_local.name[j],pfc->name[j]);
+        fc_local.read[j] = _FALSE_;
+      }
+
+      for (j=0; (j < models_per_instance) && (abort == _FALSE_); j++) {
+        if (autotune_one_model(&fc_local,errmsg_local) == _FAILURE_) {
+#pragma omp critical (autotune)
+          {
+            abort = _TRUE_;
+            strcpy(errmsg,errmsg_local);
+          }
+        }
+#pragma omp flush(abort)
+      }
+
+      parser_free(&fc_local);
+    }
+  }
+
+  if (abort == _TRUE_) return _FAILURE_;
+
+#ifdef _OPENMP
+  tstop = omp_get_wtime();
+#else
+  tstop = (double)time(NULL);
+#endif
+
+  *models_per_hour = 3600.*number_of_instances*models_per_instance/MAX(tstop-tstart,1.e-6);
+
+  printf(" -> %d instance(s) x %d thread(s), perturb_omp_chunk=%d, transfer_omp_chunk=%d : %.1f models per hour\n",
+         number_of_instances,number_of_threads,perturb_chunk,transfer_chunk,*models_per_hour);
+
+  return _SUCCESS_;
+
+}
+
+int main(int argc, char **argv) {
+
+  struct file_content fc_input;
+  struct file_content fc;
+  ErrorMsg errmsg;
+  FileName output_name;
+  FILE * output;
+
+  int total_number_of_threads = 1;
+  int models_per_instance = 2;
+  int chunks[_AUTOTUNE_CHUNKS_] = {1,2,4,8};
+  int index_perturb_chunk=-1,index_transfer_chunk=-1;
+  int number_of_instances,best_instances;
+  int index_chunk,best_perturb_chunk,best_transfer_chunk;
+  int i,size;
+  double models_per_hour,best_models_per_hour;
+
+  if (argc < 2) {
+    printf("usage: %s input.ini [output file] [models per instance]\n",argv[0]);
+    return _FAILURE_;
+  }
+
+  if (argc > 2)
+    strcpy(output_name,argv[2]);
+  else
+    strcpy(output_name,"autotune.ini");
+
+  if (argc > 3)
+    models_per_instance = MAX(atoi(argv[3]),1);
+
+  /** - read the input file, and make sure that it contains exactly one entry for each chunk size */
+
+  if (parser_read_file(argv[1],&fc_input,errmsg) == _FAILURE_) {
+    printf("\n\nError reading %s\n=>%s\n",argv[1],errmsg);
+    return _FAILURE_;
+  }
+
+  for (i=0; i < fc_input.size; i++) {
+    if (strcmp(fc_input.name[i],"perturb_omp_chunk") == 0)
+      index_perturb_chunk = i;
+    if (strcmp(fc_input.name[i],"transfer_omp_chunk") == 0)
+      index_transfer_chunk = i;
+  }
+
+  size = fc_input.size;
+  if (index_perturb_chunk < 0)
+    index_perturb_chunk = size++;
+  if (index_transfer_chunk < 0)
+    index_transfer_chunk = size++;
+
+  parser_init(&fc,size,argv[1],errmsg);
+  for (i=0; i < fc_input.size; i++) {
+    strcpy(fc.name[i],fc_input.name[i]);
+    strcpy(fc.value[i],fc_input.value[i]);
+  }
+  strcpy(fc.name[index_perturb_chunk],"perturb_omp_chunk");
+  strcpy(fc.name[index_transfer_chunk],"transfer_omp_chunk");
+
+#ifdef _OPENMP
+  total_number_of_threads = omp_get_max_threads();
+  omp_set_nested(1);
+#endif
+
+  printf("# Calibrating %s on %d thread(s), with %d model(s) per instance and per job\n",
+         argv[1],total_number_of_threads,models_per_instance);
+
+  /** - untimed run, such that tables read from files are cached and pages are mapped */
+
+  printf("# Warm-up run\n");
+
+  if (autotune_job(&fc,index_perturb_chunk,index_transfer_chunk,1,1,1,total_number_of_threads,1,&models_per_hour,errmsg) == _FAILURE_) {
+    printf("\n\nError in calibration run\n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  /** - number of instances (dividing the number of threads) with default chunk sizes */
+
+  printf("# Calibration runs\n");
+
+  best_instances = 1;
+  best_perturb_chunk = 1;
+  best_transfer_chunk = 1;
+  best_models_per_hour = 0.;
+
+  for (number_of_instances=1; number_of_instances<=total_number_of_threads; number_of_instances++) {
+
+    if (total_number_of_threads % number_of_instances != 0) continue;
+
+    if (autotune_job(&fc,index_perturb_chunk,index_transfer_chunk,1,1,
+                     number_of_instances,total_number_of_threads/number_of_instances,
+                     models_per_instance,&models_per_hour,errmsg) == _FAILURE_) {
+      printf("\n\nError in calibration run\n=>%s\n",errmsg);
+      return _FAILURE_;
+    }
+
+    if (models_per_hour > best_models_per_hour) {
+      best_models_per_hour = models_per_hour;
+      best_instances = number_of_instances;
+    }
+  }
+
+  /** - chunk sizes of the perturbation and transfer loops with the best split, one after the other */
+
+  for (index_chunk=1; index_chunk<_AUTOTUNE_CHUNKS_; index_chunk++) {
+
+    if (autotune_job(&fc,index_perturb_chunk,index_transfer_chunk,chunks[index_chunk],best_transfer_chunk,
+                     best_instances,total_number_of_threads/best_instances,
+                     models_per_instance,&models_per_hour,errmsg) == _FAILURE_) {
+      printf("\n\nError in calibration run\n=>%s\n",errmsg);
+      return _FAILURE_;
+    }
+
+    if (models_per_hour > best_models_per_hour) {
+      best_models_per_hour = models_per_hour;
+      best_perturb_chunk = chunks[index_chunk];
+    }
+  }
+
+  for (index_chunk=1; index_chunk<_AUTOTUNE_CHUNKS_; index_chunk++) {
+
+    if (autotune_job(&fc,index_perturb_chunk,index_transfer_chunk,best_perturb_chunk,chunks[index_chunk],
+                     best_instances,total_number_of_threads/best_instances,
+                     models_per_instance,&models_per_hour,errmsg) == _FAILURE_) {
+      printf("\n\nError in calibration run\n=>%s\n",errmsg);
+      return _FAILURE_;
+    }
+
+    if (models_per_hour > best_models_per_hour) {
+      best_models_per_hour = models_per_hour;
+      best_transfer_chunk = chunks[index_chunk];
+    }
+  }
+
+  /** - write the recommended configuration */
+
+  output = fopen(output_name,"w");
+  if (output == NULL) {
+    printf("\n\nError: could not open %s\n",output_name);
+    return _FAILURE_;
+  }
+
+  fprintf(output,"# Parallel configuration found by test_autotune for %s\n",argv[1]);
+  fprintf(output,"# on %d thread(s): %.1f models per hour\n",total_number_of_threads,best_models_per_hour);
+  fprintf(output,"number_of_class_instances = %d\n",best_instances);
+  fprintf(output,"number_of_threads_inside_class = %d\n",total_number_of_threads/best_instances);
+  fprintf(output,"perturb_omp_chunk = %d\n",best_perturb_chunk);
+  fprintf(output,"transfer_omp_chunk = %d\n",best_transfer_chunk);
+
+  fclose(output);
+
+  printf("# Best configuration written in %s: %d instance(s) x %d thread(s), perturb_omp_chunk=%d, transfer_omp_chunk=%d (%.1f models per hour)\n",
+         output_name,best_instances,total_number_of_threads/best_instances,
+         best_perturb_chunk,best_transfer_chunk,best_models_per_hour);
+
+  parser_free(&fc);
+  parser_free(&fc_input);
+
+  return _SUCCESS_;
+
+}
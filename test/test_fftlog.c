@@ -0,0 +1,257 @@
+/** @file test_fftlog.c
+ *
+ * Accuracy test of the C_l's of density number counts and galaxy
+ * lensing computed with FFTLog by the spectra module (precision
+ * parameter fftlog_lss, see spectra_cls_fftlog()).
+ *
+ * The input file is run twice: once with the line-of-sight integrals
+ * of the transfer module, the Limber approximation being switched off
+ * up to l_max_lss, and once with FFTLog. The C_l's of types dd, ll
+ * and dl are compared up to fftlog_l_max, relatively to the square
+ * root of the product of the two corresponding auto-correlations
+ * (such that cross-correlations crossing zero do not spoil the test).
+ * The time spent in each run is also printed.
+ *
+ * The input file should request nCl (with the density term only)
+ * and/or sCl, with a non-Dirac selection function.
+ *
+ * Usage: test_fftlog input.ini [precision.pre]
+ */
+
+#include "class.h"
+
+/** largest relative difference allowed between the two computations */
+#define _TEST_FFTLOG_TOL_ 1.e-2
+
+/**
+ * Compute the C_l's of one model, with or without FFTLog, and return
+ * a copy of the table of scalar C_l's.
+ */
+
+int fftlog_one_model(
+                     int argc,
+                     char **argv,
+                     int fftlog_lss,
+                     double ** cl,
+                     int * l_size,
+                     int * l_fftlog_max,
+                     int * ic_ic_size,
+                     struct spectra * psp_out,
+                     double * time,
+                     ErrorMsg errmsg
+                     ) {
+
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermo th;           /* for thermodynamics */
+  struct perturbs pt;         /* for source functions */
+  struct transfers tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct spectra sp;          /* for output spectra */
+  struct nonlinear nl;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct output op;           /* for output files */
+  int index_md,size,bin;
+  double tstart,z_min;
+
+  class_call(input_init_from_arguments(argc,argv,&pr,&ba,&th,&pt,&tr,&pm,&sp,&nl,&le,&op,errmsg),
+             errmsg,
+             errmsg);
+
+  pr.fftlog_lss = fftlog_lss;
+
+  /* switch to the Limber approximation just above l_max_lss (larger
+     values would only refine the sampling of the line-of-sight
+     integrals, see transfer_source_tau_size()) */
+  if (fftlog_lss == 0) {
+    z_min = pt.selection_mean[0];
+    for (bin=1; bin<pt.selection_num; bin++)
+      z_min = MIN(z_min,pt.selection_mean[bin]);
+    pr.l_switch_limber_for_nc_local_over_z = 1.01*(pt.l_lss_max+1)/z_min;
+    pr.l_switch_limber_for_nc_los_over_z = 1.01*(pt.l_lss_max+1)/z_min;
+  }
+
+#ifdef _OPENMP
+  tstart = omp_get_wtime();
+#else
+  tstart = 0.;
+#endif
+
+  class_call(background_init(&pr,&ba),ba.error_message,errmsg);
+  class_call(thermodynamics_init(&pr,&ba,&th),th.error_message,errmsg);
+  class_call(perturb_init(&pr,&ba,&th,&pt),pt.error_message,errmsg);
+  class_call(primordial_init(&pr,&pt,&pm),pm.error_message,errmsg);
+  class_call(nonlinear_init(&pr,&ba,&th,&pt,&pm,&nl),nl.error_message,errmsg);
+  class_call(transfer_init(&pr,&ba,&th,&pt,&pm,&nl,&tr),tr.error_message,errmsg);
+  class_call(spectra_init(&pr,&ba,&pt,&pm,&nl,&tr,&sp),sp.error_message,errmsg);
+
+#ifdef _OPENMP
+  *time = omp_get_wtime()-tstart;
+#else
+  *time = 0.;
+#endif
+
+  class_test((fftlog_lss == 1) && (tr.has_cl_fftlog == _FALSE_),
+             errmsg,
+             "this input file cannot be computed with FFTLog: request nCl (density only) or sCl, flat, with a non-Dirac selection function");
+
+  index_md = pt.index_md_scalars;
+  size = sp.l_size[index_md]*sp.ic_ic_size[index_md]*sp.ct_size;
+  class_alloc(*cl,size*sizeof(double),errmsg);
+  memcpy(*cl,sp.cl[index_md],size*sizeof(double));
+  *l_size = sp.l_size[index_md];
+  *l_fftlog_max = tr.l_fftlog_max;
+  *ic_ic_size = sp.ic_ic_size[index_md];
+
+  /* keep the indices needed for the comparison (arrays freed below are copied) */
+  *psp_out = sp;
+  class_alloc(psp_out->l,sp.l_size_max*sizeof(double),errmsg);
+  memcpy(psp_out->l,sp.l,sp.l_size_max*sizeof(double));
+  if (sp.has_dd_pair != NULL) {
+    class_alloc(psp_out->has_dd_pair,sp.d_size*sp.d_size*sizeof(short),errmsg);
+    memcpy(psp_out->has_dd_pair,sp.has_dd_pair,sp.d_size*sp.d_size*sizeof(short));
+  }
+
+  class_call(spectra_free(&sp),sp.error_message,errmsg);
+  class_call(transfer_free(&tr),tr.error_message,errmsg);
+  class_call(nonlinear_free(&nl),nl.error_message,errmsg);
+  class_call(primordial_free(&pm),pm.error_message,errmsg);
+  class_call(perturb_free(&pt),pt.error_message,errmsg);
+  class_call(thermodynamics_free(&th),th.error_message,errmsg);
+  class_call(background_free(&ba),ba.error_message,errmsg);
+
+  return _SUCCESS_;
+
+}
+
+int main(int argc, char **argv) {
+
+  struct spectra sp;          /* indices of the C_l's of the reference run */
+  struct spectra sp_fftlog;   /* idem for the FFTLog run */
+  ErrorMsg errmsg;            /* for error messages */
+
+  double * cl_ref;
+  double * cl_fftlog;
+  int l_size,l_size_fftlog,l_fftlog_max,index_l,index_ct,index_d1,index_d2,ic_ic_size,ct_size;
+  int * ct_d1;       /* first window of each compared type */
+  int * ct_d2;       /* second window */
+  int * ct_auto;     /* index of the auto-correlation of each window, ct_auto[2*index_d+0,1] for density and lensing */
+  short * ct_lensing; /* are the first and second windows lensing windows? */
+  double time_ref,time_fftlog,cl1,cl2,diff,max_diff_dd=0.,max_diff_ll=0.,max_diff_dl=0.;
+  int count=0,index_first,index_last,ct;
+
+  if (fftlog_one_model(argc,argv,0,&cl_ref,&l_size,&l_fftlog_max,&ic_ic_size,&sp,&time_ref,errmsg) == _FAILURE_) {
+    printf("\n\nError in reference run \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  printf(" -> line-of-sight integrals without Limber approximation: %e s\n",time_ref);
+
+  if (fftlog_one_model(argc,argv,1,&cl_fftlog,&l_size_fftlog,&l_fftlog_max,&ic_ic_size,&sp_fftlog,&time_fftlog,errmsg) == _FAILURE_) {
+    printf("\n\nError in FFTLog run \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  printf(" -> FFTLog (including the kernel weights computed once in the process): %e s\n",time_fftlog);
+
+  ct_size = sp.ct_size;
+
+  ct_d1 = malloc(ct_size*sizeof(int));
+  ct_d2 = malloc(ct_size*sizeof(int));
+  ct_lensing = malloc(2*ct_size*sizeof(short));
+  ct_auto = malloc(2*sp.d_size*sizeof(int));
+
+  for (index_ct=0; index_ct<ct_size; index_ct++)
+    ct_d1[index_ct] = -1;
+
+  /** - windows of each type dd, ll, dl, with the same indexing as in spectra_compute_cl() */
+
+  if (sp.has_dd == _TRUE_) {
+    ct = sp.index_ct_dd;
+    for (index_d1=0; index_d1<sp.d_size; index_d1++) {
+      for (index_d2=index_d1; index_d2<=MIN(index_d1+sp.non_diag,sp.d_size-1); index_d2++) {
+        if (sp.has_dd_pair[index_d1*sp.d_size+index_d2] == _FALSE_)
+          continue;
+        ct_d1[ct] = index_d1; ct_d2[ct] = index_d2;
+        ct_lensing[2*ct] = _FALSE_; ct_lensing[2*ct+1] = _FALSE_;
+        if (index_d1 == index_d2) ct_auto[2*index_d1] = ct;
+        ct++;
+      }
+    }
+  }
+
+  if (sp.has_ll == _TRUE_) {
+    ct = sp.index_ct_ll;
+    for (index_d1=0; index_d1<sp.d_size; index_d1++) {
+      for (index_d2=index_d1; index_d2<=MIN(index_d1+sp.non_diag,sp.d_size-1); index_d2++) {
+        ct_d1[ct] = index_d1; ct_d2[ct] = index_d2;
+        ct_lensing[2*ct] = _TRUE_; ct_lensing[2*ct+1] = _TRUE_;
+        if (index_d1 == index_d2) ct_auto[2*index_d1+1] = ct;
+        ct++;
+      }
+    }
+  }
+
+  if ((sp.has_dl == _TRUE_) && (sp.has_dd == _TRUE_) && (sp.has_ll == _TRUE_)) {
+    ct = sp.index_ct_dl;
+    for (index_d1=0; index_d1<sp.d_size; index_d1++) {
+      for (index_d2=MAX(index_d1-sp.non_diag,0); index_d2<=MIN(index_d1+sp.non_diag,sp.d_size-1); index_d2++) {
+        ct_d1[ct] = index_d1; ct_d2[ct] = index_d2;
+        ct_lensing[2*ct] = _FALSE_; ct_lensing[2*ct+1] = _TRUE_;
+        ct++;
+      }
+    }
+  }
+
+  /** - compare, for the first pair of initial conditions */
+
+  for (index_l=0; (index_l<l_size) && (sp.l[index_l] <= l_fftlog_max); index_l++) {
+    for (index_ct=0; index_ct<ct_size; index_ct++) {
+
+      if (ct_d1[index_ct] < 0)
+        continue;
+
+      index_first = ct_auto[2*ct_d1[index_ct]+ct_lensing[2*index_ct]];
+      index_last = ct_auto[2*ct_d2[index_ct]+ct_lensing[2*index_ct+1]];
+
+      cl1 = cl_ref[(index_l*ic_ic_size)*ct_size+index_first];
+      cl2 = cl_ref[(index_l*ic_ic_size)*ct_size+index_last];
+
+      diff = fabs(cl_fftlog[(index_l*ic_ic_size)*ct_size+index_ct]-cl_ref[(index_l*ic_ic_size)*ct_size+index_ct])/sqrt(fabs(cl1*cl2));
+
+      if ((ct_lensing[2*index_ct] == _FALSE_) && (ct_lensing[2*index_ct+1] == _FALSE_))
+        max_diff_dd = MAX(max_diff_dd,diff);
+      else if ((ct_lensing[2*index_ct] == _TRUE_) && (ct_lensing[2*index_ct+1] == _TRUE_))
+        max_diff_ll = MAX(max_diff_ll,diff);
+      else
+        max_diff_dl = MAX(max_diff_dl,diff);
+
+      count++;
+    }
+  }
+
+  printf(" -> compared %d values up to l=%d: largest relative differences %e (dd), %e (ll), %e (dl)\n",
+         count,l_fftlog_max,max_diff_dd,max_diff_ll,max_diff_dl);
+
+  free(cl_ref);
+  free(cl_fftlog);
+  free(ct_d1);
+  free(ct_d2);
+  free(ct_lensing);
+  free(ct_auto);
+  free(sp.l);
+  free(sp.has_dd_pair);
+  free(sp_fftlog.l);
+  free(sp_fftlog.has_dd_pair);
+
+  fftlog_kernel_free();
+
+  if ((count == 0) || (max_diff_dd > _TEST_FFTLOG_TOL_) || (max_diff_ll > _TEST_FFTLOG_TOL_) || (max_diff_dl > _TEST_FFTLOG_TOL_)) {
+    printf("FAILED\n");
+    return _FAILURE_;
+  }
+
+  printf("PASSED\n");
+  return _SUCCESS_;
+
+}
@@ -0,0 +1,148 @@
+/** @file test_hyrec.c
+ *
+ * Benchmark of the models for hydrogen recombination in HyRec
+ * (input parameter hyrec_model), from the cheapest to the most
+ * accurate: PEEBLES, RECFAST, EMLA2s2p and FULL.
+ *
+ * The thermodynamics of the input file is computed with HyRec and each
+ * model in turn, several times. For each model, the mean time spent in
+ * thermodynamics_init() (which includes reading the tables the model
+ * needs) is printed, together with the largest relative difference of
+ * the free electron fraction x_e(z) and the difference of the
+ * recombination redshift with respect to the FULL model.
+ *
+ * Usage: test_hyrec input.ini [precision.pre]
+ */
+
+#include "class.h"
+
+/** number of computations of the thermodynamics for each model */
+#define _TEST_HYREC_RUNS_ 5
+
+int main(int argc, char **argv) {
+
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermo th;           /* for thermodynamics */
+  struct perturbs pt;         /* for source functions */
+  struct transfers tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct spectra sp;          /* for output spectra */
+  struct nonlinear nl;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct output op;           /* for output files */
+  ErrorMsg errmsg;            /* for error messages */
+
+  enum hyrec_model model[4] = {hyrec_full, hyrec_emla2s2p, hyrec_recfast, hyrec_peebles};
+  char * model_name[4] = {"FULL", "EMLA2s2p", "RECFAST", "PEEBLES"};
+  int index_model,index_run,index_z,tt_size=0;
+  double * z_full=NULL;
+  double * xe_full=NULL;
+  double * xe_model=NULL;
+  double tstart,time,diff,max_diff,z_max_diff,z_rec_full=0.;
+
+  if (input_init_from_arguments(argc, argv,&pr,&ba,&th,&pt,&tr,&pm,&sp,&nl,&le,&op,errmsg) == _FAILURE_) {
+    printf("\n\nError running input_init_from_arguments \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  th.recombination = hyrec;
+  th.thermodynamics_verbose = 0;
+
+  if (background_init(&pr,&ba) == _FAILURE_) {
+    printf("\n\nError running background_init \n=>%s\n",ba.error_message);
+    return _FAILURE_;
+  }
+
+  printf("%10s %16s %22s %8s %12s\n","model","time (s)","max |dx_e/x_e|","at z","dz_rec");
+
+  /* the FULL model comes first, it is the reference of the others */
+
+  for (index_model=0; index_model<4; index_model++) {
+
+    th.hyrec_model = model[index_model];
+
+    time = 0.;
+
+    for (index_run=0; index_run<_TEST_HYREC_RUNS_; index_run++) {
+
+#ifdef _OPENMP
+      tstart = omp_get_wtime();
+#else
+      tstart = (double)clock()/CLOCKS_PER_SEC;
+#endif
+
+      if (thermodynamics_init(&pr,&ba,&th) == _FAILURE_) {
+        printf("\n\nError in thermodynamics_init \n=>%s\n",th.error_message);
+        return _FAILURE_;
+      }
+
+#ifdef _OPENMP
+      time += omp_get_wtime()-tstart;
+#else
+      time += (double)clock()/CLOCKS_PER_SEC-tstart;
+#endif
+
+      if (index_run < _TEST_HYREC_RUNS_-1) {
+        if (thermodynamics_free(&th) == _FAILURE_) {
+          printf("\n\nError in thermodynamics_free \n=>%s\n",th.error_message);
+          return _FAILURE_;
+        }
+      }
+    }
+
+    /* x_e of each model at the redshifts of the table of the FULL model
+       (the sampling of reionization may differ between models) */
+
+    if (index_model == 0) {
+      tt_size = th.tt_size;
+      z_full = malloc(tt_size*sizeof(double));
+      xe_full = malloc(tt_size*sizeof(double));
+      xe_model = malloc(tt_size*sizeof(double));
+      for (index_z=0; index_z<tt_size; index_z++) {
+        z_full[index_z] = th.z_table[index_z];
+        xe_full[index_z] = th.thermodynamics_table[index_z*th.th_size+th.index_th_xe];
+      }
+      z_rec_full = th.z_rec;
+    }
+
+    if (thermodynamics_at_z_vector(&ba,&th,z_full,tt_size,th.index_th_xe,xe_model) == _FAILURE_) {
+      printf("\n\nError in thermodynamics_at_z_vector \n=>%s\n",th.error_message);
+      return _FAILURE_;
+    }
+
+    max_diff = 0.;
+    z_max_diff = 0.;
+    for (index_z=0; index_z<tt_size; index_z++) {
+      diff = fabs(xe_model[index_z]/xe_full[index_z]-1.);
+      if (diff > max_diff) {
+        max_diff = diff;
+        z_max_diff = z_full[index_z];
+      }
+    }
+
+    printf("%10s %16e %22e %8.1f %12e\n",
+           model_name[index_model],
+           time/_TEST_HYREC_RUNS_,
+           max_diff,
+           z_max_diff,
+           th.z_rec-z_rec_full);
+
+    if (thermodynamics_free(&th) == _FAILURE_) {
+      printf("\n\nError in thermodynamics_free \n=>%s\n",th.error_message);
+      return _FAILURE_;
+    }
+  }
+
+  free(z_full);
+  free(xe_full);
+  free(xe_model);
+
+  if (background_free(&ba) == _FAILURE_) {
+    printf("\n\nError in background_free \n=>%s\n",ba.error_message);
+    return _FAILURE_;
+  }
+
+  return _SUCCESS_;
+
+}
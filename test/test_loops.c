@@ -50,7 +50,7 @@ int class(
              pnl->error_message,
              errmsg);
 
-  class_call(transfer_init(ppr,pba,pth,ppt,pnl,ptr),
+  class_call(transfer_init(ppr,pba,pth,ppt,ppm,pnl,ptr),
              ptr->error_message,
              errmsg);
 
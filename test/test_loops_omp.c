@@ -11,6 +11,10 @@
    the variable number_of_class_instances below). Each of them uses a
    number of thread such that all cores are used. */
 
+/* Alternatively, the file written by test_autotune can be passed as
+   argument: its number of instances is then used, and its chunk
+   sizes are passed to each instance as precision parameters. */
+
 #include "class.h"
 
 int class(
@@ -55,7 +59,7 @@ int class(
              pnl->error_message,
              errmsg);
 
-  class_call(transfer_init(ppr,pba,pth,ppt,pnl,ptr),
+  class_call(transfer_init(ppr,pba,pth,ppt,ppm,pnl,ptr),
              ptr->error_message,
              errmsg);
 
@@ -114,7 +118,7 @@ int class(
 
 }
 
-int main() {
+int main(int argc, char **argv) {
 
   /* shared variable that will be common to all CLASS instances */
   int i;
@@ -123,7 +127,10 @@ int main() {
   int num_loops=10;
 
   struct file_content fc;
+  struct file_content fc_base;
+  struct file_content fc_tuning;
   ErrorMsg errmsg_parser;
+  int flag;
 
   int total_number_of_threads;
   int number_of_class_instances;
@@ -133,6 +140,14 @@ int main() {
   int index_ct_ee;
   int index_ct_te;
 
+  /* optional configuration written by test_autotune */
+  if (argc > 1) {
+    if (parser_read_file(argv[1],&fc_tuning,errmsg_parser) == _FAILURE_) {
+      printf("\n\nError reading %s\n=>%s\n",argv[1],errmsg_parser);
+      return _FAILURE_;
+    }
+  }
+
   /* dealing with the openMP part (number of instances, number of
      threads per instance...) */
 
@@ -146,6 +161,14 @@ int main() {
      number of threads should be dividable by this number) */
   number_of_class_instances=2;
 
+  /* or number of instances found by test_autotune */
+  if (argc > 1) {
+    if (parser_read_int(&fc_tuning,"number_of_class_instances",&number_of_class_instances,&flag,errmsg_parser) == _FAILURE_) {
+      printf("\n\nError reading %s\n=>%s\n",argv[1],errmsg_parser);
+      return _FAILURE_;
+    }
+  }
+
   if ((total_number_of_threads % number_of_class_instances) != 0)
     printf("The total number of threads, %d, is not a mutiple of the requested number of CLASS instances, %d\n",total_number_of_threads,number_of_class_instances);
   number_of_threads_inside_class = total_number_of_threads/number_of_class_instances;
@@ -203,6 +226,17 @@ int main() {
   strcpy(fc.name[9],"perturbations_verbose");
   sprintf(fc.value[9],"%d",0); // Trick: set to 2 to cross-check actual number of threads per CLASS instance
 
+  /* append the chunk sizes found by test_autotune (the other entries of that file are ignored by CLASS) */
+  if (argc > 1) {
+    fc_base = fc;
+    if (parser_cat(&fc_base,&fc_tuning,&fc,errmsg_parser) == _FAILURE_) {
+      printf("\n\nError in parser_cat\n=>%s\n",errmsg_parser);
+      return _FAILURE_;
+    }
+    parser_free(&fc_base);
+    parser_free(&fc_tuning);
+  }
+
   /* Create an array of Cl's where all results will be stored for each parameter value in the loop */
   double *** cl;
   cl = malloc(num_loops*sizeof(double**));
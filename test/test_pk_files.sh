@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# Regression test for the linear and non-linear P(k) output files.
+#
+# Runs ./class on each input file of test/pk_files/ and compares the
+# files *_pk*.dat with test/pk_files/reference/ byte by byte. The
+# reference files were written by the code before the table of linear
+# spectra was shared between the nonlinear and spectra modules, with
+# the default compiler flags of the Makefile (gcc, -O4 -ffast-math).
+# With another compiler, other flags or another libm, the last digits
+# may legitimately differ.
+#
+# Usage (from the main directory): make test_pk_files
+
+dir=test/pk_files
+out=$(mktemp -d)
+status=0
+
+for ini in $dir/*.ini; do
+  name=$(basename $ini .ini)
+  (grep -v '^#' $ini; echo "root = $out/${name}_") > $out/$name.ini
+  if ! ./class $out/$name.ini > /dev/null; then
+    echo "$name: error running class"
+    status=1
+    continue
+  fi
+  for ref in $dir/reference/${name}_*pk*.dat; do
+    if cmp -s $ref $out/$(basename $ref); then
+      echo "$name: $(basename $ref) identical"
+    else
+      echo "$name: $(basename $ref) DIFFERS"
+      status=1
+    fi
+  done
+done
+
+rm -rf $out
+
+if [ $status -eq 0 ]; then
+  echo "PASSED"
+else
+  echo "FAILED"
+fi
+exit $status
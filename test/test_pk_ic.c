@@ -0,0 +1,185 @@
+/** @file test_pk_ic.c
+ *
+ * Regression test for the total linear matter power spectrum of runs
+ * with several initial conditions.
+ *
+ * The spectra module stores ln P(k,tau) for each diagonal pair of
+ * initial conditions, and the correlation coefficient (with the sign of
+ * the product of the sources) for each off-diagonal pair. The total
+ * linear spectrum must then be
+ *
+ *   P = sum_i P_ii + 2 sum_{i<j} corr_ij sqrt(P_ii P_jj),
+ *
+ * which is also what Halofit receives from the nonlinear module. This
+ * test checks the total stored in ln_pk_l (and ln_pk_cb_l with massive
+ * neutrinos) against this sum, computed directly from the source
+ * functions and the primordial spectrum.
+ *
+ * Usage: test_pk_ic input.ini [precision.pre]
+ * with an input requesting mPk and at least two correlated initial
+ * conditions, e.g. ic = ad,cdi and c_ad_cdi = 0.5.
+ */
+
+#include "class.h"
+
+/** largest relative difference allowed between total linear spectra */
+#define _TEST_PK_IC_TOL_ 1.e-10
+
+int main(int argc, char **argv) {
+
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermo th;           /* for thermodynamics */
+  struct perturbs pt;         /* for source functions */
+  struct transfers tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct spectra sp;          /* for output spectra */
+  struct nonlinear nl;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct output op;           /* for output files */
+  ErrorMsg errmsg;            /* for error messages */
+
+  int index_md,index_tau,index_tau_pt,index_k,index_delta,cb;
+  int index_ic1,index_ic2,index_ic1_ic2;
+  int ic_size,k_size;
+  double * primordial_pk;
+  double * table;
+  double source_ic1,source_ic2,pk_tot,diff,max_diff=0.;
+
+  if (input_init_from_arguments(argc, argv,&pr,&ba,&th,&pt,&tr,&pm,&sp,&nl,&le,&op,errmsg) == _FAILURE_) {
+    printf("\n\nError running input_init_from_arguments \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  if (pt.has_pk_matter == _FALSE_) {
+    printf("\n\nError: the input file should request mPk\n");
+    return _FAILURE_;
+  }
+
+  if (background_init(&pr,&ba) == _FAILURE_) {
+    printf("\n\nError running background_init \n=>%s\n",ba.error_message);
+    return _FAILURE_;
+  }
+
+  if (thermodynamics_init(&pr,&ba,&th) == _FAILURE_) {
+    printf("\n\nError in thermodynamics_init \n=>%s\n",th.error_message);
+    return _FAILURE_;
+  }
+
+  if (perturb_init(&pr,&ba,&th,&pt) == _FAILURE_) {
+    printf("\n\nError in perturb_init \n=>%s\n",pt.error_message);
+    return _FAILURE_;
+  }
+
+  if (primordial_init(&pr,&pt,&pm) == _FAILURE_) {
+    printf("\n\nError in primordial_init \n=>%s\n",pm.error_message);
+    return _FAILURE_;
+  }
+
+  if (nonlinear_init(&pr,&ba,&th,&pt,&pm,&nl) == _FAILURE_) {
+    printf("\n\nError in nonlinear_init \n=>%s\n",nl.error_message);
+    return _FAILURE_;
+  }
+
+  if (transfer_init(&pr,&ba,&th,&pt,&pm,&nl,&tr) == _FAILURE_) {
+    printf("\n\nError in transfer_init \n=>%s\n",tr.error_message);
+    return _FAILURE_;
+  }
+
+  if (spectra_init(&pr,&ba,&pt,&pm,&nl,&tr,&sp) == _FAILURE_) {
+    printf("\n\nError in spectra_init \n=>%s\n",sp.error_message);
+    return _FAILURE_;
+  }
+
+  index_md = pt.index_md_scalars;
+  ic_size = sp.ic_size[index_md];
+  k_size = sp.ln_k_size;
+
+  if (ic_size < 2)
+    printf(" -> warning: only one initial condition, the cross terms are not tested\n");
+
+  primordial_pk = malloc(sp.ic_ic_size[index_md]*sizeof(double));
+
+  for (cb=0; cb<=(ba.has_ncdm == _TRUE_ ? 1 : 0); cb++) {
+
+    index_delta = (cb == 0) ? pt.index_tp_delta_m : pt.index_tp_delta_cb;
+    table = (cb == 0) ? sp.ln_pk_l : sp.ln_pk_cb_l;
+
+    for (index_k=0; index_k<k_size; index_k++) {
+
+      if (primordial_spectrum_at_k(&pm,index_md,linear,exp(sp.ln_k[index_k]),primordial_pk) == _FAILURE_) {
+        printf("\n\nError in primordial_spectrum_at_k \n=>%s\n",pm.error_message);
+        return _FAILURE_;
+      }
+
+      for (index_tau=0; index_tau<sp.ln_tau_size; index_tau++) {
+
+        index_tau_pt = index_tau-sp.ln_tau_size+pt.tau_size;
+
+        pk_tot = 0.;
+        for (index_ic1=0; index_ic1<ic_size; index_ic1++) {
+          for (index_ic2=index_ic1; index_ic2<ic_size; index_ic2++) {
+            index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,ic_size);
+            if ((index_ic1 != index_ic2) && (sp.is_non_zero[index_md][index_ic1_ic2] == _FALSE_))
+              continue;
+            source_ic1 = pt.sources[index_md][index_ic1*pt.tp_size[index_md]+index_delta][index_tau_pt*pt.k_size[index_md]+index_k];
+            source_ic2 = pt.sources[index_md][index_ic2*pt.tp_size[index_md]+index_delta][index_tau_pt*pt.k_size[index_md]+index_k];
+            pk_tot += (index_ic1 == index_ic2 ? 1. : 2.)*2.*_PI_*_PI_/exp(3.*sp.ln_k[index_k])
+              *source_ic1*source_ic2*primordial_pk[index_ic1_ic2];
+          }
+        }
+
+        diff = fabs(exp(table[index_tau*k_size+index_k])/pk_tot-1.);
+        max_diff = MAX(max_diff,diff);
+      }
+    }
+  }
+
+  printf(" -> largest relative difference of the total linear spectrum %e\n",max_diff);
+
+  free(primordial_pk);
+
+  if (spectra_free(&sp) == _FAILURE_) {
+    printf("\n\nError in spectra_free \n=>%s\n",sp.error_message);
+    return _FAILURE_;
+  }
+
+  if (transfer_free(&tr) == _FAILURE_) {
+    printf("\n\nError in transfer_free \n=>%s\n",tr.error_message);
+    return _FAILURE_;
+  }
+
+  if (nonlinear_free(&nl) == _FAILURE_) {
+    printf("\n\nError in nonlinear_free \n=>%s\n",nl.error_message);
+    return _FAILURE_;
+  }
+
+  if (primordial_free(&pm) == _FAILURE_) {
+    printf("\n\nError in primordial_free \n=>%s\n",pm.error_message);
+    return _FAILURE_;
+  }
+
+  if (perturb_free(&pt) == _FAILURE_) {
+    printf("\n\nError in perturb_free \n=>%s\n",pt.error_message);
+    return _FAILURE_;
+  }
+
+  if (thermodynamics_free(&th) == _FAILURE_) {
+    printf("\n\nError in thermodynamics_free \n=>%s\n",th.error_message);
+    return _FAILURE_;
+  }
+
+  if (background_free(&ba) == _FAILURE_) {
+    printf("\n\nError in background_free \n=>%s\n",ba.error_message);
+    return _FAILURE_;
+  }
+
+  if (max_diff > _TEST_PK_IC_TOL_) {
+    printf("FAILED\n");
+    return _FAILURE_;
+  }
+
+  printf("PASSED\n");
+  return _SUCCESS_;
+
+}
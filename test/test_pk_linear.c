@@ -0,0 +1,259 @@
+/** @file test_pk_linear.c
+ *
+ * Regression test for the table of linear spectra P_L(k,tau) computed
+ * once in the nonlinear module (nonlinear_pk_linear()) and read by
+ * spectra_pk().
+ *
+ * The spectra of each pair of initial conditions stored by the spectra
+ * module, from which the output files P(k,z) are written, are compared
+ * with a direct computation from the source functions and the
+ * primordial spectrum, following the arithmetic used by spectra_pk()
+ * before the table was shared. The linear spectrum used by Halofit
+ * (nonlinear_pk_l()) is compared with the same direct computation in
+ * linear mode. The differences must stay below _TEST_PK_LINEAR_TOL_:
+ * the direct computation uses scalar calls of log() and exp(), while
+ * the code may use their vectorised versions, so this test does not
+ * compare bit by bit. The written files are compared byte by byte with
+ * those of the former code by test/test_pk_files.sh.
+ *
+ * Usage: test_pk_linear input.ini [precision.pre]
+ */
+
+#include "class.h"
+
+/** largest relative difference allowed between linear spectra */
+#define _TEST_PK_LINEAR_TOL_ 1.e-13
+
+int main(int argc, char **argv) {
+
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermo th;           /* for thermodynamics */
+  struct perturbs pt;         /* for source functions */
+  struct transfers tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct spectra sp;          /* for output spectra */
+  struct nonlinear nl;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct output op;           /* for output files */
+  ErrorMsg errmsg;            /* for error messages */
+
+  int index_md,index_tau,index_tau_pt,index_k,index_pk,index_delta;
+  int index_ic1,index_ic2,index_ic1_ic2;
+  int ic_size,ic_ic_size,k_size;
+  int mismatch=0,total=0;
+  double * primordial_pk;
+  double * primordial_pk_lin;
+  double * ln_pk_ic;
+  double * pk_l;
+  double * lnk;
+  double * lnpk;
+  double * ddlnpk;
+  double * table;
+  double source_ic1,source_ic2,pk_factor,pk_halofit,diff,max_diff=0.;
+
+  if (input_init_from_arguments(argc, argv,&pr,&ba,&th,&pt,&tr,&pm,&sp,&nl,&le,&op,errmsg) == _FAILURE_) {
+    printf("\n\nError running input_init_from_arguments \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  if (pt.has_pk_matter == _FALSE_) {
+    printf("\n\nError: the input file should request mPk\n");
+    return _FAILURE_;
+  }
+
+  if (background_init(&pr,&ba) == _FAILURE_) {
+    printf("\n\nError running background_init \n=>%s\n",ba.error_message);
+    return _FAILURE_;
+  }
+
+  if (thermodynamics_init(&pr,&ba,&th) == _FAILURE_) {
+    printf("\n\nError in thermodynamics_init \n=>%s\n",th.error_message);
+    return _FAILURE_;
+  }
+
+  if (perturb_init(&pr,&ba,&th,&pt) == _FAILURE_) {
+    printf("\n\nError in perturb_init \n=>%s\n",pt.error_message);
+    return _FAILURE_;
+  }
+
+  if (primordial_init(&pr,&pt,&pm) == _FAILURE_) {
+    printf("\n\nError in primordial_init \n=>%s\n",pm.error_message);
+    return _FAILURE_;
+  }
+
+  if (nonlinear_init(&pr,&ba,&th,&pt,&pm,&nl) == _FAILURE_) {
+    printf("\n\nError in nonlinear_init \n=>%s\n",nl.error_message);
+    return _FAILURE_;
+  }
+
+  if (transfer_init(&pr,&ba,&th,&pt,&pm,&nl,&tr) == _FAILURE_) {
+    printf("\n\nError in transfer_init \n=>%s\n",tr.error_message);
+    return _FAILURE_;
+  }
+
+  if (spectra_init(&pr,&ba,&pt,&pm,&nl,&tr,&sp) == _FAILURE_) {
+    printf("\n\nError in spectra_init \n=>%s\n",sp.error_message);
+    return _FAILURE_;
+  }
+
+  index_md = pt.index_md_scalars;
+  ic_size = sp.ic_size[index_md];
+  ic_ic_size = sp.ic_ic_size[index_md];
+  k_size = sp.ln_k_size;
+
+  primordial_pk = malloc(ic_ic_size*sizeof(double));
+  primordial_pk_lin = malloc(ic_ic_size*sizeof(double));
+  ln_pk_ic = malloc(ic_ic_size*sizeof(double));
+  pk_l = malloc(nl.k_size*sizeof(double));
+  lnk = malloc(nl.k_size*sizeof(double));
+  lnpk = malloc(nl.k_size*sizeof(double));
+  ddlnpk = malloc(nl.k_size*sizeof(double));
+
+  /** - spectra of each pair of initial conditions in the spectra module, up to round-off */
+
+  for (index_pk=0; index_pk<nl.pk_size; index_pk++) {
+
+    if (index_pk == nl.index_pk_m) {
+      index_delta = pt.index_tp_delta_m;
+      table = sp.ln_pk;
+    }
+    else {
+      index_delta = pt.index_tp_delta_cb;
+      table = sp.ln_pk_cb;
+    }
+
+    for (index_k=0; index_k<k_size; index_k++) {
+
+      if (primordial_spectrum_at_k(&pm,index_md,logarithmic,sp.ln_k[index_k],primordial_pk) == _FAILURE_) {
+        printf("\n\nError in primordial_spectrum_at_k \n=>%s\n",pm.error_message);
+        return _FAILURE_;
+      }
+
+      pk_factor = 2.*_PI_*_PI_/exp(3.*sp.ln_k[index_k]);
+
+      for (index_tau=0; index_tau<sp.ln_tau_size; index_tau++) {
+
+        index_tau_pt = index_tau-sp.ln_tau_size+pt.tau_size;
+
+        for (index_ic1=0; index_ic1<ic_size; index_ic1++) {
+          for (index_ic2=index_ic1; index_ic2<ic_size; index_ic2++) {
+
+            index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,ic_size);
+
+            source_ic1 = pt.sources[index_md][index_ic1*pt.tp_size[index_md]+index_delta][index_tau_pt*pt.k_size[index_md]+index_k];
+            source_ic2 = pt.sources[index_md][index_ic2*pt.tp_size[index_md]+index_delta][index_tau_pt*pt.k_size[index_md]+index_k];
+
+            if (index_ic1 == index_ic2)
+              ln_pk_ic[index_ic1_ic2] = log(pk_factor*source_ic1*source_ic1*exp(primordial_pk[index_ic1_ic2]));
+            else if (sp.is_non_zero[index_md][index_ic1_ic2] == _TRUE_)
+              ln_pk_ic[index_ic1_ic2] = primordial_pk[index_ic1_ic2]*SIGN(source_ic1)*SIGN(source_ic2);
+            else
+              ln_pk_ic[index_ic1_ic2] = 0.;
+
+            total++;
+            if (fabs(ln_pk_ic[index_ic1_ic2]-table[(index_tau*k_size+index_k)*ic_ic_size+index_ic1_ic2]) > _TEST_PK_LINEAR_TOL_)
+              mismatch++;
+          }
+        }
+      }
+    }
+  }
+
+  printf(" -> spectra module: %d of %d values of ln P(k,tau) differ from the direct computation by more than %e\n",
+         mismatch,total,_TEST_PK_LINEAR_TOL_);
+
+  /** - linear spectrum used by Halofit, compared with the direct computation */
+
+  if (nl.method == nl_halofit) {
+
+    for (index_pk=0; index_pk<nl.pk_size; index_pk++) {
+
+      index_delta = (index_pk == nl.index_pk_m) ? pt.index_tp_delta_m : pt.index_tp_delta_cb;
+
+      for (index_tau=0; index_tau<nl.tau_size; index_tau++) {
+
+        if (nonlinear_pk_l(&ba,&pt,&pm,&nl,index_pk,index_tau,pk_l,lnk,lnpk,ddlnpk) == _FAILURE_) {
+          printf("\n\nError in nonlinear_pk_l \n=>%s\n",nl.error_message);
+          return _FAILURE_;
+        }
+
+        for (index_k=0; index_k<nl.k_size; index_k++) {
+
+          if (primordial_spectrum_at_k(&pm,index_md,linear,nl.k[index_k],primordial_pk_lin) == _FAILURE_) {
+            printf("\n\nError in primordial_spectrum_at_k \n=>%s\n",pm.error_message);
+            return _FAILURE_;
+          }
+
+          pk_halofit = 0.;
+          for (index_ic1=0; index_ic1<ic_size; index_ic1++) {
+            for (index_ic2=index_ic1; index_ic2<ic_size; index_ic2++) {
+              index_ic1_ic2 = index_symmetric_matrix(index_ic1,index_ic2,ic_size);
+              source_ic1 = pt.sources[index_md][index_ic1*pt.tp_size[index_md]+index_delta][index_tau*pt.k_size[index_md]+index_k];
+              source_ic2 = pt.sources[index_md][index_ic2*pt.tp_size[index_md]+index_delta][index_tau*pt.k_size[index_md]+index_k];
+              pk_halofit += (index_ic1 == index_ic2 ? 1. : 2.)*2.*_PI_*_PI_/pow(nl.k[index_k],3)
+                *source_ic1*source_ic2*primordial_pk_lin[index_ic1_ic2];
+            }
+          }
+
+          diff = fabs(pk_l[index_k]/pk_halofit-1.);
+          max_diff = MAX(max_diff,diff);
+        }
+      }
+    }
+
+    printf(" -> Halofit: largest relative difference of the linear spectrum %e\n",max_diff);
+  }
+
+  free(primordial_pk);
+  free(primordial_pk_lin);
+  free(ln_pk_ic);
+  free(pk_l);
+  free(lnk);
+  free(lnpk);
+  free(ddlnpk);
+
+  if (spectra_free(&sp) == _FAILURE_) {
+    printf("\n\nError in spectra_free \n=>%s\n",sp.error_message);
+    return _FAILURE_;
+  }
+
+  if (transfer_free(&tr) == _FAILURE_) {
+    printf("\n\nError in transfer_free \n=>%s\n",tr.error_message);
+    return _FAILURE_;
+  }
+
+  if (nonlinear_free(&nl) == _FAILURE_) {
+    printf("\n\nError in nonlinear_free \n=>%s\n",nl.error_message);
+    return _FAILURE_;
+  }
+
+  if (primordial_free(&pm) == _FAILURE_) {
+    printf("\n\nError in primordial_free \n=>%s\n",pm.error_message);
+    return _FAILURE_;
+  }
+
+  if (perturb_free(&pt) == _FAILURE_) {
+    printf("\n\nError in perturb_free \n=>%s\n",pt.error_message);
+    return _FAILURE_;
+  }
+
+  if (thermodynamics_free(&th) == _FAILURE_) {
+    printf("\n\nError in thermodynamics_free \n=>%s\n",th.error_message);
+    return _FAILURE_;
+  }
+
+  if (background_free(&ba) == _FAILURE_) {
+    printf("\n\nError in background_free \n=>%s\n",ba.error_message);
+    return _FAILURE_;
+  }
+
+  if ((mismatch > 0) || (max_diff > _TEST_PK_LINEAR_TOL_)) {
+    printf("FAILED\n");
+    return _FAILURE_;
+  }
+
+  printf("PASSED\n");
+  return _SUCCESS_;
+
+}
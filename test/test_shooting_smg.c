@@ -0,0 +1,165 @@
+/** @file test_shooting_smg.c
+ *
+ * Test of the shooting for the parameter of a modified gravity model
+ * fixed by Omega_smg, with and without the
+ * sensitivities of the background to this parameter (input parameter
+ * shooting_sensitivity_smg, see input_find_root_newton()).
+ *
+ * The input file is read twice: once with bracketing of the root and
+ * Ridders' method, once with Newton's method using the derivative of
+ * the target obtained from a single integration of the background
+ * together with its sensitivities. For each run, the parameter found,
+ * the number of background computations, the time spent in the
+ * shooting and the remaining difference between the target and its
+ * value in the final background are printed.
+ *
+ * The input file should have the single shooting target Omega_smg
+ * (with other targets, as M_pl_today_smg in the Brans-Dicke model,
+ * both runs are identical), and should not set shooting_sensitivity_smg.
+ *
+ * Usage: test_shooting_smg input.ini [precision.pre]
+ */
+
+#include "class.h"
+
+/** largest difference allowed between the target and its value in the final background */
+#define _TEST_SHOOTING_TOL_ 1.e-4
+
+/**
+ * Read the input file with the given value of shooting_sensitivity_smg,
+ * compute the background, and return the tuned parameter, the number
+ * of computations of the shooting and the remaining difference to
+ * the target.
+ */
+
+int shooting_one_model(
+                       int argc,
+                       char **argv,
+                       char * sensitivity,
+                       double * parameter,
+                       int * fevals,
+                       double * residual,
+                       double * time,
+                       ErrorMsg errmsg
+                       ) {
+
+  struct precision pr;        /* for precision parameters */
+  struct background ba;       /* for cosmological background */
+  struct thermo th;           /* for thermodynamics */
+  struct perturbs pt;         /* for source functions */
+  struct transfers tr;        /* for transfer functions */
+  struct primordial pm;       /* for primordial spectra */
+  struct spectra sp;          /* for output spectra */
+  struct nonlinear nl;        /* for non-linear spectra */
+  struct lensing le;          /* for lensed spectra */
+  struct output op;           /* for output files */
+  struct file_content fc_input;
+  struct file_content fc_precision;
+  struct file_content fc_sensitivity;
+  struct file_content fc_all;
+  struct file_content fc;
+  double tstart,M_pl_today_smg;
+  int flag;
+
+  class_test(argc < 2,
+             errmsg,
+             "usage: test_shooting_smg input.ini [precision.pre]");
+
+  /** - content of the input files, plus shooting_sensitivity_smg */
+
+  class_call(parser_read_file(argv[1],&fc_input,errmsg),errmsg,errmsg);
+
+  fc_precision.size = 0;
+  if (argc > 2)
+    class_call(parser_read_file(argv[2],&fc_precision,errmsg),errmsg,errmsg);
+
+  class_call(parser_init(&fc_sensitivity,1,fc_input.filename,errmsg),errmsg,errmsg);
+  sprintf(fc_sensitivity.name[0],"shooting_sensitivity_smg");
+  sprintf(fc_sensitivity.value[0],"%s",sensitivity);
+  fc_sensitivity.read[0] = _FALSE_;
+
+  class_call(parser_cat(&fc_input,&fc_precision,&fc_all,errmsg),errmsg,errmsg);
+  class_call(parser_cat(&fc_all,&fc_sensitivity,&fc,errmsg),errmsg,errmsg);
+
+  class_call(parser_read_double(&fc,"M_pl_today_smg",&M_pl_today_smg,&flag,errmsg),errmsg,errmsg);
+
+  /** - shooting */
+
+#ifdef _OPENMP
+  tstart = omp_get_wtime();
+#else
+  tstart = (double)clock()/CLOCKS_PER_SEC;
+#endif
+
+  class_call(input_init(&fc,&pr,&ba,&th,&pt,&tr,&pm,&sp,&nl,&le,&op,errmsg),
+             errmsg,
+             errmsg);
+
+#ifdef _OPENMP
+  *time = omp_get_wtime()-tstart;
+#else
+  *time = (double)clock()/CLOCKS_PER_SEC-tstart;
+#endif
+
+  class_test(ba.shooting_fevals == 0,
+             errmsg,
+             "no shooting for this input file: set Omega_smg or M_pl_today_smg");
+
+  *fevals = ba.shooting_fevals;
+
+  /** - difference to the target in the final background */
+
+  ba.background_verbose = 0;
+  class_call(background_init(&pr,&ba),ba.error_message,errmsg);
+
+  if (flag == _TRUE_) {
+    *parameter = ba.parameters_smg[ba.tuning_index_2_smg];
+    *residual = ba.background_table[(ba.bt_size-1)*ba.bg_size+ba.index_bg_M2_smg]-ba.M_pl_today_smg;
+  }
+  else {
+    *parameter = ba.parameters_smg[ba.tuning_index_smg];
+    *residual = ba.background_table[(ba.bt_size-1)*ba.bg_size+ba.index_bg_rho_smg]/pow(ba.H0,2)-ba.Omega0_smg;
+  }
+
+  class_call(background_free(&ba),ba.error_message,errmsg);
+
+  class_call(parser_free(&fc_input),errmsg,errmsg);
+  class_call(parser_free(&fc_precision),errmsg,errmsg);
+  class_call(parser_free(&fc_sensitivity),errmsg,errmsg);
+  class_call(parser_free(&fc_all),errmsg,errmsg);
+  class_call(parser_free(&fc),errmsg,errmsg);
+
+  return _SUCCESS_;
+
+}
+
+int main(int argc, char **argv) {
+
+  ErrorMsg errmsg;            /* for error messages */
+  double parameter_ref,parameter,residual_ref,residual,time_ref,time;
+  int fevals_ref,fevals;
+
+  if (shooting_one_model(argc,argv,"no",&parameter_ref,&fevals_ref,&residual_ref,&time_ref,errmsg) == _FAILURE_) {
+    printf("\n\nError in shooting without sensitivities \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  if (shooting_one_model(argc,argv,"yes",&parameter,&fevals,&residual,&time,errmsg) == _FAILURE_) {
+    printf("\n\nError in shooting with sensitivities \n=>%s\n",errmsg);
+    return _FAILURE_;
+  }
+
+  printf("%16s %16s %10s %14s %16s\n","shooting","parameter","fevals","time (s)","residual");
+  printf("%16s %16e %10d %14e %16e\n","bracketing",parameter_ref,fevals_ref,time_ref,residual_ref);
+  printf("%16s %16e %10d %14e %16e\n","sensitivities",parameter,fevals,time,residual);
+  printf(" -> relative difference of the parameters: %e\n",fabs(parameter/parameter_ref-1.));
+
+  if ((fabs(residual) > _TEST_SHOOTING_TOL_) || (fevals > fevals_ref)) {
+    printf("FAILED\n");
+    return _FAILURE_;
+  }
+
+  printf("PASSED\n");
+  return _SUCCESS_;
+
+}
@@ -50,7 +50,7 @@ int main(int argc, char **argv) {
     return _FAILURE_;
   }
 
-  if (transfer_init(&pr,&ba,&th,&pt,&nl,&tr) == _FAILURE_) {
+  if (transfer_init(&pr,&ba,&th,&pt,&pm,&nl,&tr) == _FAILURE_) {
     printf("\n\nError in transfer_init \n=>%s\n",tr.error_message);
     return _FAILURE_;
   }
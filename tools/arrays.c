@@ -1141,7 +1141,7 @@ int array_spline_table_columns2(
   double dy_first;
   double dy_last;
 
-  u = malloc((x_size-1) * y_size * sizeof(double));
+  u = buffer_pool_malloc((x_size-1) * y_size * sizeof(double));
   p = malloc(y_size * sizeof(double));
   qn = malloc(y_size * sizeof(double));
   un = malloc(y_size * sizeof(double));
@@ -1253,7 +1253,7 @@ int array_spline_table_columns2(
   }
   free(qn);
   free(p);
-  free(u);
+  buffer_pool_free(u);
   free(un);
 
   return _SUCCESS_;
@@ -0,0 +1,256 @@
+/** @file buffer_pool.c Process-wide pool of large buffers reused across runs
+ *
+ * When many models are computed in the same process (e.g. by the
+ * ClassEngine wrapper inside a Markov chain), each run frees and
+ * allocates again the largest arrays (source functions, transfer
+ * functions, lensing workspace, ...) with exactly the same sizes as
+ * the previous run, as long as precision parameters are unchanged.
+ * Each of these allocations is served by the system with fresh pages,
+ * whose first touch shows up as system time and page faults.
+ *
+ * Buffers allocated with buffer_pool_malloc() and released with
+ * buffer_pool_free() are instead kept in a pool while at least one
+ * client has called buffer_pool_retain(), and handed back to the next
+ * request of a similar size. Without any client, the two functions
+ * behave as malloc() and free(). Calls from different threads are
+ * safe.
+ *
+ * Each client calls buffer_pool_trim() between two of its runs. The
+ * pool is shared by all clients of the process (e.g. several
+ * ClassEngine instances running in parallel), so a buffer is only
+ * given back to the system once it was not reused during a full
+ * generation, i.e. while every client completed at least one run.
+ * This way a change of array sizes does not make the pool grow
+ * indefinitely, but the trim of one client does not throw away the
+ * buffers that another client is about to reuse.
+ */
+
+#include "buffer_pool.h"
+
+/** Number of clients which have called buffer_pool_retain() and not yet buffer_pool_release() */
+static int buffer_pool_clients = 0;
+
+/** Current generation of the pool, incremented once all clients have called buffer_pool_trim() */
+static int buffer_pool_generation = 0;
+
+/** Number of clients which have called buffer_pool_trim() in the current generation */
+static int buffer_pool_trimmed = 0;
+
+/** Head of the list of free buffers kept in the pool */
+static struct buffer_pool_header * buffer_pool_head = NULL;
+
+/**
+ * Allocate a buffer of at least the requested size, either taken from
+ * the pool or obtained from the system. The content of the buffer is
+ * not initialised.
+ *
+ * A pooled buffer is reused if its capacity exceeds the requested size
+ * by at most 25%; the smallest of such buffers is chosen. New large
+ * buffers get a small headroom, such that slightly larger requests in
+ * the next runs (e.g. when the number of sampled times varies by a few
+ * points with cosmological parameters) can still reuse them.
+ *
+ * @param size Input: requested size in bytes
+ * @return pointer to the buffer, or NULL if the allocation failed
+ */
+
+void * buffer_pool_malloc(
+                          size_t size
+                          ) {
+
+  struct buffer_pool_header * header = NULL;
+  struct buffer_pool_header ** previous;
+  struct buffer_pool_header ** best = NULL;
+  size_t capacity;
+
+#pragma omp critical (buffer_pool)
+  {
+    if (size >= _BUFFER_POOL_MIN_SIZE_) {
+      for (previous=&buffer_pool_head; *previous != NULL; previous=&((*previous)->next)) {
+        if (((*previous)->capacity >= size) &&
+            ((*previous)->capacity <= size + size/4) &&
+            ((best == NULL) || ((*previous)->capacity < (*best)->capacity))) {
+          best = previous;
+        }
+      }
+      if (best != NULL) {
+        header = *best;
+        *best = header->next;
+      }
+    }
+  }
+
+  if (header == NULL) {
+
+    capacity = size;
+    if ((size >= _BUFFER_POOL_MIN_SIZE_) && (buffer_pool_clients > 0))
+      capacity += size/16;
+
+    header = malloc(_BUFFER_POOL_HEADER_SIZE_ + capacity);
+    if (header == NULL)
+      return NULL;
+
+    header->capacity = capacity;
+  }
+
+  header->next = NULL;
+
+  return (char*)header + _BUFFER_POOL_HEADER_SIZE_;
+
+}
+
+/**
+ * Release a buffer allocated with buffer_pool_malloc(): keep it in the
+ * pool if at least one client is registered and the buffer is large,
+ * give it back to the system otherwise.
+ *
+ * @param pointer Input: pointer returned by buffer_pool_malloc(), or NULL
+ */
+
+void buffer_pool_free(
+                      void * pointer
+                      ) {
+
+  struct buffer_pool_header * header;
+  short keep = _FALSE_;
+
+  if (pointer == NULL)
+    return;
+
+  header = (struct buffer_pool_header *)((char*)pointer - _BUFFER_POOL_HEADER_SIZE_);
+
+#pragma omp critical (buffer_pool)
+  {
+    if ((buffer_pool_clients > 0) && (header->capacity >= _BUFFER_POOL_MIN_SIZE_)) {
+      header->generation = buffer_pool_generation;
+      header->next = buffer_pool_head;
+      buffer_pool_head = header;
+      keep = _TRUE_;
+    }
+  }
+
+  if (keep == _FALSE_)
+    free(header);
+
+}
+
+/**
+ * End the current generation of the pool: give back to the system the
+ * buffers which were already in the pool at the beginning of this
+ * generation and were not reused since then. Must be called inside
+ * the critical section of the pool.
+ */
+
+static void buffer_pool_next_generation() {
+
+  struct buffer_pool_header ** previous;
+  struct buffer_pool_header * header;
+
+  previous = &buffer_pool_head;
+  while (*previous != NULL) {
+    header = *previous;
+    if (header->generation < buffer_pool_generation) {
+      *previous = header->next;
+      free(header);
+    }
+    else {
+      previous = &(header->next);
+    }
+  }
+  buffer_pool_generation++;
+  buffer_pool_trimmed = 0;
+
+}
+
+/**
+ * Register a client of the pool: from now on and until the matching
+ * call to buffer_pool_release(), large buffers are kept in the pool
+ * when they are freed.
+ *
+ * @param client_generation Output: generation of the client, to be passed to buffer_pool_trim() and buffer_pool_release()
+ * @return the error status
+ */
+
+int buffer_pool_retain(
+                       int * client_generation
+                       ) {
+
+#pragma omp critical (buffer_pool)
+  {
+    buffer_pool_clients++;
+    *client_generation = buffer_pool_generation;
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Unregister a client of the pool. When the last client is gone, all
+ * buffers of the pool are given back to the system.
+ *
+ * @param client_generation Input: generation of the client
+ * @return the error status
+ */
+
+int buffer_pool_release(
+                        int * client_generation
+                        ) {
+
+  struct buffer_pool_header * header;
+
+#pragma omp critical (buffer_pool)
+  {
+    if (buffer_pool_clients > 0) {
+      buffer_pool_clients--;
+      if (*client_generation > buffer_pool_generation)
+        buffer_pool_trimmed--;
+    }
+
+    if (buffer_pool_clients == 0) {
+      while (buffer_pool_head != NULL) {
+        header = buffer_pool_head;
+        buffer_pool_head = header->next;
+        free(header);
+      }
+      buffer_pool_trimmed = 0;
+    }
+    else if (buffer_pool_trimmed >= buffer_pool_clients) {
+      buffer_pool_next_generation();
+    }
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Tell the pool that a client has finished a run. Meant to be called
+ * between two runs of the client, after all its structures of the
+ * previous run have been freed. Once every client has done so, the
+ * buffers which were not reused during the whole generation are given
+ * back to the system, and a new generation starts. Further calls by
+ * the same client in the same generation have no effect.
+ *
+ * @param client_generation Input/output: generation of the client
+ * @return the error status
+ */
+
+int buffer_pool_trim(
+                     int * client_generation
+                     ) {
+
+#pragma omp critical (buffer_pool)
+  {
+    if (*client_generation <= buffer_pool_generation) {
+      buffer_pool_trimmed++;
+      *client_generation = buffer_pool_generation+1;
+    }
+
+    if (buffer_pool_trimmed >= buffer_pool_clients)
+      buffer_pool_next_generation();
+  }
+
+  return _SUCCESS_;
+
+}
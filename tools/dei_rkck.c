@@ -11,6 +11,7 @@ int initialize_generic_integrator(
   /** - Allocate workspace dynamically */
 
   pgi->n = n_dim;
+  pgi->n_error = n_dim;
 
   class_alloc(pgi->yscal,
 	      sizeof(double)*n_dim,
@@ -145,7 +146,7 @@ int rkqs(double *x, double htry, double eps,
 	       pgi->error_message,
 	       pgi->error_message);
     errmax=0.0;
-    for (i=0;i<pgi->n;i++) errmax=MAX(errmax,fabs(pgi->yerr[i]/pgi->yscal[i]));
+    for (i=0;i<pgi->n_error;i++) errmax=MAX(errmax,fabs(pgi->yerr[i]/pgi->yscal[i]));
     errmax /= eps;
     if (errmax <= 1.0) break;
     htemp=_SAFETY_*h*pow(errmax,_PSHRNK_);
@@ -0,0 +1,820 @@
+/** @file emulator.c Local emulator of C_l's and P(k)
+ *
+ * Surrogate model of the C_l's and linear P(k,z) computed by CLASS,
+ * trained on a design of full runs in a box around a fiducial model
+ * (see struct emulator in emulator.h). This file only contains the
+ * numerical part (design, training, prediction, storage in a binary
+ * file): the training runs are performed by the caller, e.g. by
+ * ClassEngine::trainEmulator().
+ */
+
+#include "emulator.h"
+
+/**
+ * Allocate the arrays describing the parameters and the emulated
+ * quantities. The caller must then fill the names and values of the
+ * parameters, the types of C_l's and the grids in k and z.
+ *
+ * @param pem          Input/Output: pointer to emulator structure
+ * @param par_size     Input: number of emulated parameters
+ * @param fixed_size   Input: number of other parameters
+ * @param l_max        Input: largest multipole (smaller than 2 for no C_l's)
+ * @param cl_type_size Input: number of types of C_l's
+ * @param k_size       Input: number of wavenumbers (zero for no P(k,z))
+ * @param z_size       Input: number of redshifts
+ * @return the error status
+ */
+
+int emulator_init(
+                  struct emulator * pem,
+                  int par_size,
+                  int fixed_size,
+                  int l_max,
+                  int cl_type_size,
+                  int k_size,
+                  int z_size
+                  ) {
+
+  class_test(par_size < 1,
+             pem->error_message,
+             "emulator needs at least one parameter");
+
+  class_test((cl_type_size < 0) || (cl_type_size > _EMULATOR_CL_TYPES_),
+             pem->error_message,
+             "wrong number of types of C_l's: %d",cl_type_size);
+
+  if (l_max < 2)
+    cl_type_size = 0;
+  if (k_size < 1)
+    z_size = 0;
+
+  pem->par_size = par_size;
+  pem->fixed_size = fixed_size;
+  pem->l_max = l_max;
+  pem->cl_type_size = cl_type_size;
+  pem->k_size = k_size;
+  pem->z_size = z_size;
+  pem->out_size = cl_type_size*(l_max-1)*(cl_type_size > 0) + k_size*z_size;
+
+  class_test(pem->out_size < 1,
+             pem->error_message,
+             "nothing to emulate: set l_max and types of C_l's, or wavenumbers and redshifts");
+
+  class_alloc(pem->par_name,par_size*sizeof(FileArg),pem->error_message);
+  class_alloc(pem->par_fiducial,par_size*sizeof(double),pem->error_message);
+  class_alloc(pem->par_width,par_size*sizeof(double),pem->error_message);
+  class_alloc(pem->fixed_name,MAX(fixed_size,1)*sizeof(FileArg),pem->error_message);
+  class_alloc(pem->fixed_value,MAX(fixed_size,1)*sizeof(FileArg),pem->error_message);
+  class_alloc(pem->cl_type,_EMULATOR_CL_TYPES_*sizeof(int),pem->error_message);
+  class_alloc(pem->k,MAX(k_size,1)*sizeof(double),pem->error_message);
+  class_alloc(pem->z,MAX(z_size,1)*sizeof(double),pem->error_message);
+  class_alloc(pem->out_fiducial,pem->out_size*sizeof(double),pem->error_message);
+  class_alloc(pem->out_scale,pem->out_size*sizeof(double),pem->error_message);
+
+  pem->train_size = 0;
+  pem->term_size = 1 + par_size + par_size*(par_size+1)/2;
+  pem->pc_size = 0;
+  pem->mean = NULL;
+  pem->pc = NULL;
+  pem->coefficient = NULL;
+  pem->sigma2 = NULL;
+  pem->leverage = NULL;
+  pem->truncation2 = NULL;
+
+  return _SUCCESS_;
+}
+
+/**
+ * Free all memory of the emulator structure.
+ *
+ * @param pem Input: pointer to emulator structure
+ * @return the error status
+ */
+
+int emulator_free(
+                  struct emulator * pem
+                  ) {
+
+  free(pem->par_name);
+  free(pem->par_fiducial);
+  free(pem->par_width);
+  free(pem->fixed_name);
+  free(pem->fixed_value);
+  free(pem->cl_type);
+  free(pem->k);
+  free(pem->z);
+  free(pem->out_fiducial);
+  free(pem->out_scale);
+
+  if (pem->pc_size > 0) {
+    free(pem->mean);
+    free(pem->pc);
+    free(pem->coefficient);
+    free(pem->sigma2);
+    free(pem->leverage);
+    free(pem->truncation2);
+  }
+
+  return _SUCCESS_;
+}
+
+/**
+ * Parameter values of the training runs: the fiducial model first,
+ * then a latin hypercube sampling of the box (each parameter takes
+ * one value in each of train_size-1 equal slices of its range). The
+ * design is pseudo-random but reproducible.
+ *
+ * @param pem        Input: pointer to emulator structure
+ * @param train_size Input: number of training runs
+ * @param design     Output: parameters of the runs, design[index_run*par_size+index_par] (must be already allocated)
+ * @return the error status
+ */
+
+int emulator_design(
+                    struct emulator * pem,
+                    int train_size,
+                    double * design
+                    ) {
+
+  int index_run,index_par,index_swap,swap;
+  int * slice;
+  unsigned long long state = 88172645463325252ULL;
+
+  class_alloc(slice,train_size*sizeof(int),pem->error_message);
+
+  for (index_par=0; index_par<pem->par_size; index_par++)
+    design[index_par] = pem->par_fiducial[index_par];
+
+  for (index_par=0; index_par<pem->par_size; index_par++) {
+
+    /* random permutation of the slices (Fisher-Yates, with a xorshift generator) */
+    for (index_run=0; index_run<train_size-1; index_run++)
+      slice[index_run] = index_run;
+
+    for (index_run=train_size-2; index_run>0; index_run--) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      index_swap = (int)(state % (unsigned long long)(index_run+1));
+      swap = slice[index_run];
+      slice[index_run] = slice[index_swap];
+      slice[index_swap] = swap;
+    }
+
+    /* center of each slice, mapped on [fiducial-width, fiducial+width] */
+    for (index_run=1; index_run<train_size; index_run++)
+      design[index_run*pem->par_size+index_par] = pem->par_fiducial[index_par]
+        + pem->par_width[index_par]*(2.*(slice[index_run-1]+0.5)/(train_size-1)-1.);
+  }
+
+  free(slice);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Train the emulator from the outputs of the runs of a design whose
+ * first run is the fiducial model (as given by emulator_design()).
+ *
+ * @param pem        Input/Output: pointer to emulator structure
+ * @param train_size Input: number of training runs
+ * @param design     Input: parameters of the runs, design[index_run*par_size+index_par]
+ * @param outputs    Input: output vectors of the runs, outputs[index_run*out_size+index_out], with C_l's in any fixed units and ln(P/Mpc^3)
+ * @return the error status
+ */
+
+int emulator_train(
+                   struct emulator * pem,
+                   int train_size,
+                   double * design,
+                   double * outputs
+                   ) {
+
+  int index_run,index_run2,index_par,index_out,index_pc,index_term,index_term2;
+  int index_type,index_type2,index_l,other[2];
+  int out_size = pem->out_size;
+  int term_size = pem->term_size;
+  double * deviation;
+  double * gram;
+  double * eigenvalue;
+  double * eigenvector;
+  double * terms;
+  double * normal;
+  double * projection;
+  double * fit;
+  double sum,total,residual;
+
+  class_test(train_size <= term_size,
+             pem->error_message,
+             "need more training runs (%d) than polynomial terms (%d)",train_size,term_size);
+
+  for (index_par=0; index_par<pem->par_size; index_par++)
+    class_test(design[index_par] != pem->par_fiducial[index_par],
+               pem->error_message,
+               "the first training run should be the fiducial model");
+
+  pem->train_size = train_size;
+
+  /** - scale of each output, from the fiducial run */
+
+  for (index_out=0; index_out<out_size; index_out++)
+    pem->out_fiducial[index_out] = outputs[index_out];
+
+  for (index_type=0; index_type<pem->cl_type_size; index_type++) {
+
+    /* for cross-spectra, find the two auto-spectra */
+    other[0] = other[1] = -1;
+    switch (pem->cl_type[index_type]) {
+    case emu_te: other[0]=emu_tt; other[1]=emu_ee; break;
+    case emu_tp: other[0]=emu_tt; other[1]=emu_pp; break;
+    case emu_ep: other[0]=emu_ee; other[1]=emu_pp; break;
+    default: break;
+    }
+    for (index_run=0; index_run<2; index_run++) {
+      for (index_type2=0; index_type2<pem->cl_type_size; index_type2++)
+        if ((other[index_run] >= 0) && (pem->cl_type[index_type2] == other[index_run]))
+          break;
+      other[index_run] = (index_type2 < pem->cl_type_size) ? index_type2 : -1;
+    }
+
+    for (index_l=2; index_l<=pem->l_max; index_l++) {
+      index_out = index_type*(pem->l_max-1)+index_l-2;
+      if ((other[0] >= 0) && (other[1] >= 0))
+        pem->out_scale[index_out] = sqrt(fabs(pem->out_fiducial[other[0]*(pem->l_max-1)+index_l-2]
+                                              *pem->out_fiducial[other[1]*(pem->l_max-1)+index_l-2]));
+      else
+        pem->out_scale[index_out] = fabs(pem->out_fiducial[index_out]);
+      if (pem->out_scale[index_out] == 0.)
+        pem->out_scale[index_out] = 1.;
+    }
+  }
+
+  for (index_out=pem->cl_type_size*(pem->l_max-1)*(pem->cl_type_size>0); index_out<out_size; index_out++)
+    pem->out_scale[index_out] = 1.;
+
+  /** - rescaled deviations from the fiducial model, and their mean */
+
+  class_alloc(deviation,train_size*out_size*sizeof(double),pem->error_message);
+  class_alloc(pem->mean,out_size*sizeof(double),pem->error_message);
+
+  for (index_out=0; index_out<out_size; index_out++) {
+    sum = 0.;
+    for (index_run=0; index_run<train_size; index_run++) {
+      deviation[index_run*out_size+index_out] =
+        (outputs[index_run*out_size+index_out]-pem->out_fiducial[index_out])/pem->out_scale[index_out];
+      sum += deviation[index_run*out_size+index_out];
+    }
+    pem->mean[index_out] = sum/train_size;
+    for (index_run=0; index_run<train_size; index_run++)
+      deviation[index_run*out_size+index_out] -= pem->mean[index_out];
+  }
+
+  /** - principal components, from the eigenvectors of the (small) matrix of scalar products between runs */
+
+  class_alloc(gram,train_size*train_size*sizeof(double),pem->error_message);
+  class_alloc(eigenvalue,train_size*sizeof(double),pem->error_message);
+  class_alloc(eigenvector,train_size*train_size*sizeof(double),pem->error_message);
+
+  for (index_run=0; index_run<train_size; index_run++) {
+    for (index_run2=0; index_run2<=index_run; index_run2++) {
+      sum = 0.;
+      for (index_out=0; index_out<out_size; index_out++)
+        sum += deviation[index_run*out_size+index_out]*deviation[index_run2*out_size+index_out];
+      gram[index_run*train_size+index_run2] = sum;
+      gram[index_run2*train_size+index_run] = sum;
+    }
+  }
+
+  class_call(emulator_symmetric_eigen(gram,train_size,eigenvalue,eigenvector,pem->error_message),
+             pem->error_message,
+             pem->error_message);
+
+  /* eigenvalues are sorted in decreasing order; keep those above round-off level */
+  total = 0.;
+  for (index_run=0; index_run<train_size; index_run++)
+    total += MAX(eigenvalue[index_run],0.);
+
+  pem->pc_size = 0;
+  while ((pem->pc_size < train_size-1) && (eigenvalue[pem->pc_size] > 1.e-13*total))
+    pem->pc_size++;
+
+  class_test(pem->pc_size == 0,
+             pem->error_message,
+             "the outputs do not depend on the parameters");
+
+  class_alloc(pem->pc,pem->pc_size*out_size*sizeof(double),pem->error_message);
+  class_alloc(projection,train_size*pem->pc_size*sizeof(double),pem->error_message);
+
+  for (index_pc=0; index_pc<pem->pc_size; index_pc++) {
+    for (index_out=0; index_out<out_size; index_out++) {
+      sum = 0.;
+      for (index_run=0; index_run<train_size; index_run++)
+        sum += deviation[index_run*out_size+index_out]*eigenvector[index_run*train_size+index_pc];
+      pem->pc[index_pc*out_size+index_out] = sum/sqrt(eigenvalue[index_pc]);
+    }
+    for (index_run=0; index_run<train_size; index_run++)
+      projection[index_run*pem->pc_size+index_pc] = sqrt(eigenvalue[index_pc])*eigenvector[index_run*train_size+index_pc];
+  }
+
+  /** - error due to the components left out */
+
+  class_alloc(pem->truncation2,out_size*sizeof(double),pem->error_message);
+
+  for (index_out=0; index_out<out_size; index_out++) {
+    sum = 0.;
+    for (index_run=0; index_run<train_size; index_run++) {
+      residual = deviation[index_run*out_size+index_out];
+      for (index_pc=0; index_pc<pem->pc_size; index_pc++)
+        residual -= projection[index_run*pem->pc_size+index_pc]*pem->pc[index_pc*out_size+index_out];
+      sum += residual*residual;
+    }
+    pem->truncation2[index_out] = sum/train_size;
+  }
+
+  /** - least-square fit of the projection on each component by a quadratic polynomial */
+
+  class_alloc(terms,train_size*term_size*sizeof(double),pem->error_message);
+  class_alloc(normal,term_size*term_size*sizeof(double),pem->error_message);
+  class_alloc(fit,term_size*sizeof(double),pem->error_message);
+  class_alloc(pem->leverage,term_size*term_size*sizeof(double),pem->error_message);
+  class_alloc(pem->coefficient,pem->pc_size*term_size*sizeof(double),pem->error_message);
+  class_alloc(pem->sigma2,pem->pc_size*sizeof(double),pem->error_message);
+
+  for (index_run=0; index_run<train_size; index_run++)
+    class_call(emulator_terms(pem,design+index_run*pem->par_size,terms+index_run*term_size),
+               pem->error_message,
+               pem->error_message);
+
+  for (index_term=0; index_term<term_size; index_term++) {
+    for (index_term2=0; index_term2<term_size; index_term2++) {
+      sum = 0.;
+      for (index_run=0; index_run<train_size; index_run++)
+        sum += terms[index_run*term_size+index_term]*terms[index_run*term_size+index_term2];
+      normal[index_term*term_size+index_term2] = sum;
+    }
+  }
+
+  class_call(emulator_matrix_inverse(normal,term_size,pem->leverage,pem->error_message),
+             pem->error_message,
+             pem->error_message);
+
+  for (index_pc=0; index_pc<pem->pc_size; index_pc++) {
+
+    for (index_term=0; index_term<term_size; index_term++) {
+      sum = 0.;
+      for (index_run=0; index_run<train_size; index_run++)
+        sum += terms[index_run*term_size+index_term]*projection[index_run*pem->pc_size+index_pc];
+      fit[index_term] = sum;
+    }
+
+    for (index_term=0; index_term<term_size; index_term++) {
+      sum = 0.;
+      for (index_term2=0; index_term2<term_size; index_term2++)
+        sum += pem->leverage[index_term*term_size+index_term2]*fit[index_term2];
+      pem->coefficient[index_pc*term_size+index_term] = sum;
+    }
+
+    sum = 0.;
+    for (index_run=0; index_run<train_size; index_run++) {
+      residual = projection[index_run*pem->pc_size+index_pc];
+      for (index_term=0; index_term<term_size; index_term++)
+        residual -= pem->coefficient[index_pc*term_size+index_term]*terms[index_run*term_size+index_term];
+      sum += residual*residual;
+    }
+    pem->sigma2[index_pc] = sum/(train_size-term_size);
+  }
+
+  free(fit);
+  free(normal);
+  free(terms);
+  free(projection);
+  free(eigenvector);
+  free(eigenvalue);
+  free(gram);
+  free(deviation);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Emulated output vector and its error at some parameter values.
+ *
+ * @param pem       Input: pointer to trained emulator structure
+ * @param par       Input: values of the emulated parameters
+ * @param output    Output: emulated output vector, in the same units as the training outputs (must be already allocated)
+ * @param error     Output: estimated error on each element, in the same units (must be already allocated)
+ * @param in_range  Output: _TRUE_ if the parameters are inside the box of the training runs
+ * @param max_error Output: largest error on the rescaled outputs (relative error on the C_l's and P(k))
+ * @return the error status
+ */
+
+int emulator_predict(
+                     struct emulator * pem,
+                     double * par,
+                     double * output,
+                     double * error,
+                     short * in_range,
+                     double * max_error
+                     ) {
+
+  int index_par,index_out,index_pc,index_term,index_term2;
+  int out_size = pem->out_size;
+  int term_size = pem->term_size;
+  double * terms;
+  double * projection;
+  double leverage,variance;
+
+  class_test(pem->pc_size == 0,
+             pem->error_message,
+             "emulator not trained");
+
+  *in_range = _TRUE_;
+  for (index_par=0; index_par<pem->par_size; index_par++)
+    if (fabs(par[index_par]-pem->par_fiducial[index_par]) > pem->par_width[index_par]*(1.+1.e-10))
+      *in_range = _FALSE_;
+
+  class_alloc(terms,term_size*sizeof(double),pem->error_message);
+  class_alloc(projection,pem->pc_size*sizeof(double),pem->error_message);
+
+  class_call(emulator_terms(pem,par,terms),
+             pem->error_message,
+             pem->error_message);
+
+  leverage = 0.;
+  for (index_term=0; index_term<term_size; index_term++)
+    for (index_term2=0; index_term2<term_size; index_term2++)
+      leverage += terms[index_term]*pem->leverage[index_term*term_size+index_term2]*terms[index_term2];
+
+  for (index_pc=0; index_pc<pem->pc_size; index_pc++) {
+    projection[index_pc] = 0.;
+    for (index_term=0; index_term<term_size; index_term++)
+      projection[index_pc] += pem->coefficient[index_pc*term_size+index_term]*terms[index_term];
+  }
+
+  *max_error = 0.;
+
+  for (index_out=0; index_out<out_size; index_out++) {
+
+    output[index_out] = pem->mean[index_out];
+    variance = pem->truncation2[index_out];
+
+    for (index_pc=0; index_pc<pem->pc_size; index_pc++) {
+      output[index_out] += projection[index_pc]*pem->pc[index_pc*out_size+index_out];
+      variance += pem->pc[index_pc*out_size+index_out]*pem->pc[index_pc*out_size+index_out]
+        *pem->sigma2[index_pc]*(1.+leverage);
+    }
+
+    *max_error = MAX(*max_error,sqrt(variance));
+
+    output[index_out] = pem->out_fiducial[index_out] + pem->out_scale[index_out]*output[index_out];
+    error[index_out] = pem->out_scale[index_out]*sqrt(variance);
+  }
+
+  free(projection);
+  free(terms);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Terms of the quadratic polynomial at some parameter values: 1, then
+ * each reduced parameter u_i=(p_i-p_i^fid)/width_i, then the products
+ * u_i u_j for i<=j.
+ *
+ * @param pem   Input: pointer to emulator structure
+ * @param par   Input: values of the emulated parameters
+ * @param terms Output: array of size term_size (must be already allocated)
+ * @return the error status
+ */
+
+int emulator_terms(
+                   struct emulator * pem,
+                   double * par,
+                   double * terms
+                   ) {
+
+  int index_par,index_par2,index_term;
+
+  terms[0] = 1.;
+  index_term = 1;
+
+  for (index_par=0; index_par<pem->par_size; index_par++)
+    terms[index_term++] = (par[index_par]-pem->par_fiducial[index_par])/pem->par_width[index_par];
+
+  for (index_par=0; index_par<pem->par_size; index_par++)
+    for (index_par2=index_par; index_par2<pem->par_size; index_par2++)
+      terms[index_term++] = terms[1+index_par]*terms[1+index_par2];
+
+  return _SUCCESS_;
+}
+
+/**
+ * Eigenvalues and eigenvectors of a real symmetric matrix (cyclic
+ * Jacobi method), sorted by decreasing eigenvalue.
+ *
+ * @param matrix        Input: symmetric matrix of size size*size (not modified)
+ * @param size          Input: dimension
+ * @param eigenvalue    Output: eigenvalues (must be already allocated)
+ * @param eigenvector   Output: eigenvectors, eigenvector[index_row*size+index_eigen] (must be already allocated)
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int emulator_symmetric_eigen(
+                             double * matrix,
+                             int size,
+                             double * eigenvalue,
+                             double * eigenvector,
+                             ErrorMsg error_message
+                             ) {
+
+  double * a;
+  int i,j,p,q,sweep,index_max;
+  double off,norm,theta,t,c,s,tau,apq,aip,aiq,vip,viq,swap;
+
+  class_alloc(a,size*size*sizeof(double),error_message);
+
+  norm = 0.;
+  for (i=0; i<size*size; i++) {
+    a[i] = matrix[i];
+    norm += matrix[i]*matrix[i];
+  }
+
+  for (i=0; i<size; i++)
+    for (j=0; j<size; j++)
+      eigenvector[i*size+j] = (i==j) ? 1. : 0.;
+
+  for (sweep=0; sweep<100; sweep++) {
+
+    off = 0.;
+    for (p=0; p<size; p++)
+      for (q=p+1; q<size; q++)
+        off += a[p*size+q]*a[p*size+q];
+
+    if (off <= 1.e-30*norm)
+      break;
+
+    for (p=0; p<size; p++) {
+      for (q=p+1; q<size; q++) {
+
+        apq = a[p*size+q];
+        if (apq == 0.) continue;
+
+        theta = (a[q*size+q]-a[p*size+p])/(2.*apq);
+        t = ((theta >= 0.) ? 1. : -1.)/(fabs(theta)+sqrt(theta*theta+1.));
+        c = 1./sqrt(t*t+1.);
+        s = t*c;
+        tau = s/(1.+c);
+
+        a[p*size+p] -= t*apq;
+        a[q*size+q] += t*apq;
+        a[p*size+q] = a[q*size+p] = 0.;
+
+        for (i=0; i<size; i++) {
+          if ((i != p) && (i != q)) {
+            aip = a[i*size+p];
+            aiq = a[i*size+q];
+            a[i*size+p] = a[p*size+i] = aip - s*(aiq+tau*aip);
+            a[i*size+q] = a[q*size+i] = aiq + s*(aip-tau*aiq);
+          }
+          vip = eigenvector[i*size+p];
+          viq = eigenvector[i*size+q];
+          eigenvector[i*size+p] = vip - s*(viq+tau*vip);
+          eigenvector[i*size+q] = viq + s*(vip-tau*viq);
+        }
+      }
+    }
+  }
+
+  class_test(sweep == 100,
+             error_message,
+             "Jacobi diagonalisation did not converge");
+
+  for (i=0; i<size; i++)
+    eigenvalue[i] = a[i*size+i];
+
+  /* sort by decreasing eigenvalue (selection sort, size is small) */
+  for (i=0; i<size-1; i++) {
+    index_max = i;
+    for (j=i+1; j<size; j++)
+      if (eigenvalue[j] > eigenvalue[index_max])
+        index_max = j;
+    if (index_max != i) {
+      swap = eigenvalue[i];
+      eigenvalue[i] = eigenvalue[index_max];
+      eigenvalue[index_max] = swap;
+      for (j=0; j<size; j++) {
+        swap = eigenvector[j*size+i];
+        eigenvector[j*size+i] = eigenvector[j*size+index_max];
+        eigenvector[j*size+index_max] = swap;
+      }
+    }
+  }
+
+  free(a);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Inverse of a square matrix (Gauss-Jordan elimination with partial
+ * pivoting).
+ *
+ * @param matrix        Input: matrix of size size*size (not modified)
+ * @param size          Input: dimension
+ * @param inverse       Output: inverse matrix (must be already allocated)
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int emulator_matrix_inverse(
+                            double * matrix,
+                            int size,
+                            double * inverse,
+                            ErrorMsg error_message
+                            ) {
+
+  double * a;
+  int i,j,k,index_pivot;
+  double pivot,factor,swap;
+
+  class_alloc(a,size*size*sizeof(double),error_message);
+
+  for (i=0; i<size*size; i++)
+    a[i] = matrix[i];
+
+  for (i=0; i<size; i++)
+    for (j=0; j<size; j++)
+      inverse[i*size+j] = (i==j) ? 1. : 0.;
+
+  for (k=0; k<size; k++) {
+
+    index_pivot = k;
+    for (i=k+1; i<size; i++)
+      if (fabs(a[i*size+k]) > fabs(a[index_pivot*size+k]))
+        index_pivot = i;
+
+    class_test(a[index_pivot*size+k] == 0.,
+               error_message,
+               "singular matrix: the training runs do not constrain all polynomial terms");
+
+    if (index_pivot != k) {
+      for (j=0; j<size; j++) {
+        swap = a[k*size+j]; a[k*size+j] = a[index_pivot*size+j]; a[index_pivot*size+j] = swap;
+        swap = inverse[k*size+j]; inverse[k*size+j] = inverse[index_pivot*size+j]; inverse[index_pivot*size+j] = swap;
+      }
+    }
+
+    pivot = a[k*size+k];
+    for (j=0; j<size; j++) {
+      a[k*size+j] /= pivot;
+      inverse[k*size+j] /= pivot;
+    }
+
+    for (i=0; i<size; i++) {
+      if (i == k) continue;
+      factor = a[i*size+k];
+      if (factor == 0.) continue;
+      for (j=0; j<size; j++) {
+        a[i*size+j] -= factor*a[k*size+j];
+        inverse[i*size+j] -= factor*inverse[k*size+j];
+      }
+    }
+  }
+
+  free(a);
+
+  return _SUCCESS_;
+}
+
+/* write or read count elements, with error message on failure */
+#define emulator_io(function,pointer,count)                                                     \
+  class_test(function(pointer,sizeof(*(pointer)),(count),stream) != (size_t)(count),             \
+             pem->error_message,                                                                 \
+             "could not %s %s in file %s",(#function)[1]=='w' ? "write" : "read",#pointer,filename)
+
+/**
+ * Write a trained emulator in a binary file.
+ *
+ * @param pem      Input: pointer to trained emulator structure
+ * @param filename Input: name of the file
+ * @return the error status
+ */
+
+int emulator_write(
+                   struct emulator * pem,
+                   char * filename
+                   ) {
+
+  FILE * stream;
+  int header[11];
+
+  class_test(pem->pc_size == 0,
+             pem->error_message,
+             "emulator not trained");
+
+  class_open(stream,filename,"wb",pem->error_message);
+
+  header[0] = _EMULATOR_MAGIC_;
+  header[1] = _EMULATOR_VERSION_;
+  header[2] = pem->par_size;
+  header[3] = pem->fixed_size;
+  header[4] = pem->l_max;
+  header[5] = pem->cl_type_size;
+  header[6] = pem->k_size;
+  header[7] = pem->z_size;
+  header[8] = pem->train_size;
+  header[9] = pem->term_size;
+  header[10] = pem->pc_size;
+
+  emulator_io(fwrite,header,11);
+  emulator_io(fwrite,pem->par_name,pem->par_size);
+  emulator_io(fwrite,pem->par_fiducial,pem->par_size);
+  emulator_io(fwrite,pem->par_width,pem->par_size);
+  emulator_io(fwrite,pem->fixed_name,pem->fixed_size);
+  emulator_io(fwrite,pem->fixed_value,pem->fixed_size);
+  emulator_io(fwrite,pem->cl_type,pem->cl_type_size);
+  emulator_io(fwrite,pem->k,pem->k_size);
+  emulator_io(fwrite,pem->z,pem->z_size);
+  emulator_io(fwrite,pem->out_fiducial,pem->out_size);
+  emulator_io(fwrite,pem->out_scale,pem->out_size);
+  emulator_io(fwrite,pem->mean,pem->out_size);
+  emulator_io(fwrite,pem->pc,pem->pc_size*pem->out_size);
+  emulator_io(fwrite,pem->coefficient,pem->pc_size*pem->term_size);
+  emulator_io(fwrite,pem->sigma2,pem->pc_size);
+  emulator_io(fwrite,pem->leverage,pem->term_size*pem->term_size);
+  emulator_io(fwrite,pem->truncation2,pem->out_size);
+
+  fclose(stream);
+
+  return _SUCCESS_;
+}
+
+/**
+ * Read an emulator written by emulator_write(). The structure must
+ * not be initialised before; it must be freed with emulator_free().
+ *
+ * @param pem      Output: pointer to emulator structure
+ * @param filename Input: name of the file
+ * @return the error status
+ */
+
+int emulator_read(
+                  struct emulator * pem,
+                  char * filename
+                  ) {
+
+  FILE * stream;
+  int header[11];
+
+  class_open(stream,filename,"rb",pem->error_message);
+
+  emulator_io(fread,header,11);
+
+  class_test(header[0] != _EMULATOR_MAGIC_,
+             pem->error_message,
+             "%s is not an emulator file",filename);
+
+  class_test(header[1] != _EMULATOR_VERSION_,
+             pem->error_message,
+             "%s has version %d of the emulator format, expected %d",filename,header[1],_EMULATOR_VERSION_);
+
+  class_call(emulator_init(pem,header[2],header[3],header[4],header[5],header[6],header[7]),
+             pem->error_message,
+             pem->error_message);
+
+  class_test((header[9] != pem->term_size) || (header[10] < 1),
+             pem->error_message,
+             "inconsistent header in %s",filename);
+
+  pem->train_size = header[8];
+  pem->pc_size = header[10];
+
+  class_alloc(pem->mean,pem->out_size*sizeof(double),pem->error_message);
+  class_alloc(pem->pc,pem->pc_size*pem->out_size*sizeof(double),pem->error_message);
+  class_alloc(pem->coefficient,pem->pc_size*pem->term_size*sizeof(double),pem->error_message);
+  class_alloc(pem->sigma2,pem->pc_size*sizeof(double),pem->error_message);
+  class_alloc(pem->leverage,pem->term_size*pem->term_size*sizeof(double),pem->error_message);
+  class_alloc(pem->truncation2,pem->out_size*sizeof(double),pem->error_message);
+
+  emulator_io(fread,pem->par_name,pem->par_size);
+  emulator_io(fread,pem->par_fiducial,pem->par_size);
+  emulator_io(fread,pem->par_width,pem->par_size);
+  emulator_io(fread,pem->fixed_name,pem->fixed_size);
+  emulator_io(fread,pem->fixed_value,pem->fixed_size);
+  emulator_io(fread,pem->cl_type,pem->cl_type_size);
+  emulator_io(fread,pem->k,pem->k_size);
+  emulator_io(fread,pem->z,pem->z_size);
+  emulator_io(fread,pem->out_fiducial,pem->out_size);
+  emulator_io(fread,pem->out_scale,pem->out_size);
+  emulator_io(fread,pem->mean,pem->out_size);
+  emulator_io(fread,pem->pc,pem->pc_size*pem->out_size);
+  emulator_io(fread,pem->coefficient,pem->pc_size*pem->term_size);
+  emulator_io(fread,pem->sigma2,pem->pc_size);
+  emulator_io(fread,pem->leverage,pem->term_size*pem->term_size);
+  emulator_io(fread,pem->truncation2,pem->out_size);
+
+  fclose(stream);
+
+  return _SUCCESS_;
+}
@@ -0,0 +1,659 @@
+/** @file fftlog.c FFTLog decompositions and integrals over pairs of spherical Bessel functions
+ *
+ * A function f(k) sampled at N logarithmically spaced wavenumbers
+ * \f$ k_n = k_0 e^{n \Delta} \f$ is decomposed into complex power laws,
+ *
+ * \f[ f(k) = {\rm Re} \sum_{m=0}^{N/2} c_m k^{s_m}, \qquad s_m = b + i \eta_m, \qquad \eta_m = 2 \pi m / (N \Delta) , \f]
+ *
+ * exactly at the sampled points (fftlog_coefficients()). Integrals of
+ * f(k) against two spherical Bessel functions then reduce to the
+ * analytic kernel
+ *
+ * \f[ 4 \pi \int \frac{dk}{k} k^s j_l(k \chi_1) j_l(k \chi_2) = \chi_>^{-s} I_l(s, \chi_</\chi_>) \f]
+ *
+ * with, for \f$ 0 \leq t \leq 1 \f$ and \f$ -2l < {\rm Re}(s) < 2 \f$,
+ *
+ * \f[ I_l(s,t) = 4 \pi \int_0^\infty dx\, x^{s-1} j_l(x) j_l(tx) = \frac{2^{s-1} \pi^2 \Gamma(l+s/2)}{\Gamma((3-s)/2)\Gamma(l+3/2)} t^l {}_2F_1\left(\frac{s-1}{2}, l+\frac{s}{2}; l+\frac{3}{2}; t^2\right) \f]
+ *
+ * (fftlog_bessel_kernel()). Close to t=1, where the hypergeometric
+ * series converges slowly, it is evaluated after a transformation
+ * \f$ t^2 \rightarrow 1-t^2 \f$.
+ *
+ * Integrals of the kernel against the cubic interpolation polynomials
+ * of a function of t on a uniform grid are tabulated once for given
+ * grids by fftlog_kernel_get(), and kept in a process-wide cache
+ * until fftlog_kernel_free() is called.
+ *
+ * Complex arithmetic is only used inside this file: the interface
+ * passes complex numbers as pairs of doubles (real and imaginary
+ * parts), such that the header can be included from C++.
+ */
+
+#include "fftlog.h"
+#include <complex.h>
+
+/** Head of the process-wide list of kernel tables */
+static struct fftlog_kernel * fftlog_kernel_head = NULL;
+
+/**
+ * In-place radix-2 fast Fourier transform,
+ * \f$ x_m \rightarrow \sum_n x_n e^{\pm 2 \pi i m n/N} \f$.
+ *
+ * @param data          Input/Output: complex array, data[2*n]=real part, data[2*n+1]=imaginary part
+ * @param n             Input: number of complex elements (power of two)
+ * @param sign          Input: sign of the exponent (-1 or +1)
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int fftlog_fft(
+               double * data,
+               int n,
+               int sign,
+               ErrorMsg error_message
+               ) {
+
+  int i,j,k,len,half,ia,ib;
+  double wr,wi,wpr,wpi,tr,ti,tmp;
+
+  class_test((n < 2) || ((n & (n-1)) != 0),
+             error_message,
+             "number of points %d should be a power of two",n);
+
+  /** - permute elements in bit-reversed order */
+  for (i=1, j=0; i<n; i++) {
+    k = n >> 1;
+    while (j & k) {
+      j ^= k;
+      k >>= 1;
+    }
+    j |= k;
+    if (i < j) {
+      tmp = data[2*i];   data[2*i]   = data[2*j];   data[2*j]   = tmp;
+      tmp = data[2*i+1]; data[2*i+1] = data[2*j+1]; data[2*j+1] = tmp;
+    }
+  }
+
+  /** - Danielson-Lanczos butterflies */
+  for (len=2; len<=n; len<<=1) {
+    half = len >> 1;
+    wpr = cos(sign*2.*_PI_/len);
+    wpi = sin(sign*2.*_PI_/len);
+    for (i=0; i<n; i+=len) {
+      wr = 1.;
+      wi = 0.;
+      for (k=0; k<half; k++) {
+        ia = 2*(i+k);
+        ib = 2*(i+k+half);
+        tr = wr*data[ib]-wi*data[ib+1];
+        ti = wr*data[ib+1]+wi*data[ib];
+        data[ib] = data[ia]-tr;
+        data[ib+1] = data[ia+1]-ti;
+        data[ia] += tr;
+        data[ia+1] += ti;
+        tmp = wr;
+        wr = tmp*wpr-wi*wpi;
+        wi = tmp*wpi+wi*wpr;
+      }
+    }
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Decompose a real function sampled at \f$ k_n = k_0 e^{n \Delta} \f$
+ * (n=0...N-1) into complex power laws: the coefficients \f$ c_m \f$
+ * are such that \f$ f(k_n) = {\rm Re} \sum_{m=0}^{N/2} c_m k_n^{b+i\eta_m} \f$
+ * with \f$ \eta_m = 2 \pi m/(N \Delta) \f$ (the terms of negative
+ * frequencies are folded into those of positive frequencies, which are
+ * their complex conjugates).
+ *
+ * @param f             Input: sampled values f[n]
+ * @param n             Input: number of samples (power of two)
+ * @param dlnk          Input: step \f$ \Delta \f$ in ln(k)
+ * @param ln_k0         Input: \f$ \ln k_0 \f$
+ * @param bias          Input: real part b of the exponents
+ * @param work          Input: work space of size 2*n
+ * @param coef          Output: coefficients, coef[2*m]=real part, coef[2*m+1]=imaginary part, m=0...n/2
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int fftlog_coefficients(
+                        double * f,
+                        int n,
+                        double dlnk,
+                        double ln_k0,
+                        double bias,
+                        double * work,
+                        double * coef,
+                        ErrorMsg error_message
+                        ) {
+
+  int index_n,index_m;
+  double factor,phase,cr,ci;
+
+  for (index_n=0; index_n<n; index_n++) {
+    work[2*index_n] = f[index_n]*exp(-bias*(ln_k0+index_n*dlnk));
+    work[2*index_n+1] = 0.;
+  }
+
+  class_call(fftlog_fft(work,n,-1,error_message),
+             error_message,
+             error_message);
+
+  for (index_m=0; index_m<=n/2; index_m++) {
+    factor = ((index_m == 0) || (index_m == n/2)) ? 1./n : 2./n;
+    phase = -2.*_PI_*index_m/(n*dlnk)*ln_k0;
+    cr = factor*work[2*index_m];
+    ci = factor*work[2*index_m+1];
+    coef[2*index_m] = cr*cos(phase)-ci*sin(phase);
+    coef[2*index_m+1] = cr*sin(phase)+ci*cos(phase);
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Logarithm of the Gamma function of a complex argument (Lanczos
+ * approximation, with the reflection formula for Re(z)<1/2). The
+ * imaginary part is defined up to a multiple of \f$ 2\pi \f$, which is
+ * irrelevant for products and ratios of Gamma functions.
+ *
+ * @param z Input: argument
+ * @return \f$ \ln \Gamma(z) \f$
+ */
+
+static double complex fftlog_clngamma(
+                                      double complex z
+                                      ) {
+
+  static const double p[9] = {0.99999999999980993,
+                              676.5203681218851,
+                              -1259.1392167224028,
+                              771.32342877765313,
+                              -176.61502916214059,
+                              12.507343278686905,
+                              -0.13857109526572012,
+                              9.9843695780195716e-6,
+                              1.5056327351493116e-7};
+  double complex x,t;
+  int i;
+
+  if (creal(z) < 0.5)
+    return log(_PI_)-clog(csin(_PI_*z))-fftlog_clngamma(1.-z);
+
+  z -= 1.;
+  x = p[0];
+  for (i=1; i<9; i++)
+    x += p[i]/(z+i);
+  t = z+7.5;
+
+  return 0.5*log(2.*_PI_)+(z+0.5)*clog(t)-t+clog(x);
+
+}
+
+/**
+ * Logarithm of the Gamma function of a complex argument, with
+ * arguments and result passed as pairs of doubles.
+ *
+ * @param re     Input: real part of the argument
+ * @param im     Input: imaginary part of the argument
+ * @param result Output: real and imaginary parts of \f$ \ln \Gamma \f$
+ * @return the error status
+ */
+
+int fftlog_lngamma(
+                   double re,
+                   double im,
+                   double * result
+                   ) {
+
+  double complex lng;
+
+  lng = fftlog_clngamma(re+I*im);
+  result[0] = creal(lng);
+  result[1] = cimag(lng);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Gauss hypergeometric series \f$ {}_2F_1(a,b;c;z) \f$ for real
+ * \f$ 0 \leq z < 1 \f$, summed until the terms are decreasing and
+ * negligible.
+ *
+ * @param a             Input: first parameter
+ * @param b             Input: second parameter
+ * @param c             Input: third parameter
+ * @param z             Input: argument
+ * @param result        Output: value of the series
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+static int fftlog_hypergeometric(
+                                 double complex a,
+                                 double complex b,
+                                 double complex c,
+                                 double z,
+                                 double complex * result,
+                                 ErrorMsg error_message
+                                 ) {
+
+  double complex term=1.,sum=1.;
+  int n;
+
+  for (n=0; n<_FFTLOG_SERIES_MAX_; n++) {
+    term *= (a+n)*(b+n)/((c+n)*(n+1.))*z;
+    sum += term;
+    if ((cabs(term) < DBL_EPSILON*(1.-z)*cabs(sum)) &&
+        (cabs((a+n+1.)*(b+n+1.))*z < cabs((c+n+1.)*(n+2.))))
+      break;
+  }
+
+  class_test(n == _FFTLOG_SERIES_MAX_,
+             error_message,
+             "hypergeometric series did not converge for z=%e",z);
+
+  *result = sum;
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Logarithms of the prefactors of the kernel \f$ I_l(s,t) \f$, which do
+ * not depend on t: the prefactor of the series in \f$ t^2 \f$, and those
+ * of the two series in \f$ 1-t^2 \f$.
+ *
+ * @param l     Input: multipole
+ * @param s     Input: exponent
+ * @param ln_p  Output: prefactor of the series in \f$ t^2 \f$
+ * @param ln_a1 Output: prefactor of the regular series in \f$ 1-t^2 \f$
+ * @param ln_a2 Output: prefactor of the series in \f$ 1-t^2 \f$ multiplied by \f$ (1-t^2)^{2-s} \f$
+ * @return the error status
+ */
+
+static int fftlog_kernel_prefactors(
+                                    int l,
+                                    double complex s,
+                                    double complex * ln_p,
+                                    double complex * ln_a1,
+                                    double complex * ln_a2
+                                    ) {
+
+  double complex common,lng_a,lng_b;
+
+  common = (s-1.)*log(2.)+2.*log(_PI_);
+  lng_a = fftlog_clngamma(l+s/2.);
+  lng_b = fftlog_clngamma((3.-s)/2.);
+
+  *ln_p = common+lng_a-lng_b-fftlog_clngamma(l+1.5);
+  *ln_a1 = common+lng_a-fftlog_clngamma(l+2.-s/2.)+fftlog_clngamma(2.-s)-2.*lng_b;
+  *ln_a2 = common-lng_b+fftlog_clngamma(s-2.)-fftlog_clngamma((s-1.)/2.);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Kernel \f$ I_l(s,t) \f$ for given prefactors (see fftlog_kernel_prefactors()).
+ *
+ * @param l             Input: multipole
+ * @param s             Input: exponent
+ * @param ln_p          Input: prefactor of the series in \f$ t^2 \f$
+ * @param ln_a1         Input: prefactor of the regular series in \f$ 1-t^2 \f$
+ * @param ln_a2         Input: prefactor of the other series in \f$ 1-t^2 \f$
+ * @param t             Input: ratio \f$ \chi_</\chi_> \f$, between 0 and 1
+ * @param result        Output: \f$ I_l(s,t) \f$
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+static int fftlog_kernel_value(
+                               int l,
+                               double complex s,
+                               double complex ln_p,
+                               double complex ln_a1,
+                               double complex ln_a2,
+                               double t,
+                               double complex * result,
+                               ErrorMsg error_message
+                               ) {
+
+  double y;
+  double complex f1,f2;
+
+  if (t <= 0.) {
+    *result = (l == 0) ? cexp(ln_p) : 0.;
+    return _SUCCESS_;
+  }
+
+  y = 1.-t*t;
+
+  if ((y <= 0.5) && (y*(l+cabs(s)+1.) <= _FFTLOG_TRANSFORM_)) {
+
+    class_call(fftlog_hypergeometric(l+s/2.,(s-1.)/2.,s-1.,y,&f1,error_message),
+               error_message,
+               error_message);
+
+    *result = cexp(ln_a1+l*log(t))*f1;
+
+    if (y > 0.) {
+
+      class_call(fftlog_hypergeometric((3.-s)/2.,l+2.-s/2.,3.-s,y,&f2,error_message),
+                 error_message,
+                 error_message);
+
+      *result += cexp(ln_a2+l*log(t)+(2.-s)*log(y))*f2;
+    }
+  }
+  else {
+
+    class_call(fftlog_hypergeometric(l+s/2.,(s-1.)/2.,l+1.5,1.-y,&f1,error_message),
+               error_message,
+               error_message);
+
+    *result = cexp(ln_p+l*log(t))*f1;
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Kernel \f$ I_l(s,t) = 4 \pi \int_0^\infty dx\, x^{s-1} j_l(x) j_l(tx) \f$
+ * for \f$ 0 \leq t \leq 1 \f$ and \f$ -2l < {\rm Re}(s) < 2 \f$.
+ *
+ * @param l             Input: multipole
+ * @param s_re          Input: real part of the exponent
+ * @param s_im          Input: imaginary part of the exponent
+ * @param t             Input: ratio \f$ \chi_</\chi_> \f$
+ * @param kernel        Output: real and imaginary parts of the kernel
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int fftlog_bessel_kernel(
+                         int l,
+                         double s_re,
+                         double s_im,
+                         double t,
+                         double * kernel,
+                         ErrorMsg error_message
+                         ) {
+
+  double complex s,ln_p,ln_a1,ln_a2,result;
+
+  class_test((t < 0.) || (t > 1.),
+             error_message,
+             "t=%e should be between 0 and 1",t);
+
+  class_test((s_re <= -2.*l) || (s_re >= 2.),
+             error_message,
+             "the integral diverges for l=%d and Re(s)=%e",l,s_re);
+
+  s = s_re+I*s_im;
+
+  fftlog_kernel_prefactors(l,s,&ln_p,&ln_a1,&ln_a2);
+
+  class_call(fftlog_kernel_value(l,s,ln_p,ln_a1,ln_a2,t,&result,error_message),
+             error_message,
+             error_message);
+
+  kernel[0] = creal(result);
+  kernel[1] = cimag(result);
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Fill the weights of one multipole in a kernel table: for each
+ * exponent \f$ s_m \f$ and each node \f$ t_j = j/M \f$, the integral
+ * over [0,1] of \f$ I_l(s_m,t) \f$ times the function of t which
+ * multiplies the value at \f$ t_j \f$ in the piecewise cubic
+ * interpolation (over the four closest nodes) of a function sampled on
+ * the grid. Each interval is integrated with Gauss-Legendre points,
+ * more numerous when the kernel varies faster; intervals are
+ * integrated from t=1 downwards, and the loop stops when the
+ * contribution of an interval falls below the tolerance times the
+ * largest one.
+ *
+ * @param pfk           Input/Output: kernel table, with allocated weights set to zero
+ * @param index_l       Input: index of the multipole
+ * @param gauss_x       Input: abscissas of Gauss-Legendre rules on [-1,1], gauss_x[n*_FFTLOG_GAUSS_MAX_+i] for n+1 points
+ * @param gauss_w       Input: corresponding weights
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+static int fftlog_kernel_weights(
+                                 struct fftlog_kernel * pfk,
+                                 int index_l,
+                                 double * gauss_x,
+                                 double * gauss_w,
+                                 ErrorMsg error_message
+                                 ) {
+
+  int l,index_m,index_t,index_g,gauss_size,index_stencil,j;
+  double complex s,ln_p,ln_a1,ln_a2,value;
+  double t,u,lagrange[4],interval,interval_max;
+  double * weight;
+
+  l = pfk->l[index_l];
+  pfk->index_t_min[index_l] = pfk->t_size;
+
+  for (index_m=0; index_m<pfk->m_size; index_m++) {
+
+    s = pfk->bias+I*2.*_PI_*index_m/(pfk->k_size*pfk->dlnk);
+
+    fftlog_kernel_prefactors(l,s,&ln_p,&ln_a1,&ln_a2);
+
+    gauss_size = MIN(_FFTLOG_GAUSS_MAX_,4+(int)ceil(2.*(l+cabs(s))/pfk->t_size));
+
+    interval_max = 0.;
+
+    for (index_t=pfk->t_size-1; index_t>=0; index_t--) {
+
+      /* first of the four nodes used for interpolation in this interval */
+      index_stencil = MAX(0,MIN(index_t-1,pfk->t_size-3));
+
+      interval = 0.;
+
+      for (index_g=0; index_g<gauss_size; index_g++) {
+
+        t = (index_t+0.5*(1.+gauss_x[(gauss_size-1)*_FFTLOG_GAUSS_MAX_+index_g]))/pfk->t_size;
+
+        class_call(fftlog_kernel_value(l,s,ln_p,ln_a1,ln_a2,t,&value,error_message),
+                   error_message,
+                   error_message);
+
+        value *= 0.5*gauss_w[(gauss_size-1)*_FFTLOG_GAUSS_MAX_+index_g]/pfk->t_size;
+        interval += cabs(value);
+
+        u = t*pfk->t_size-index_stencil;
+        lagrange[0] = -(u-1.)*(u-2.)*(u-3.)/6.;
+        lagrange[1] = u*(u-2.)*(u-3.)/2.;
+        lagrange[2] = -u*(u-1.)*(u-3.)/2.;
+        lagrange[3] = u*(u-1.)*(u-2.)/6.;
+
+        for (j=0; j<4; j++) {
+          weight = pfk->weight+2*(((index_l*(pfk->t_size+1)+index_stencil+j)*pfk->m_size)+index_m);
+          weight[0] += lagrange[j]*creal(value);
+          weight[1] += lagrange[j]*cimag(value);
+        }
+      }
+
+      pfk->index_t_min[index_l] = MIN(pfk->index_t_min[index_l],index_stencil);
+
+      interval_max = MAX(interval_max,interval);
+      if (interval < pfk->tol*interval_max)
+        break;
+    }
+  }
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Return the table of kernel weights for given grids, computing it
+ * only if this was never done before in the process (see struct
+ * fftlog_kernel). Calls from different threads are safe; the table is
+ * owned by the cache and must not be modified.
+ *
+ * @param k_size        Input: number of sampled wavenumbers (power of two)
+ * @param dlnk          Input: step in ln(k)
+ * @param bias          Input: real part of the exponents
+ * @param t_size        Input: number of intervals of the uniform grid in t over [0,1] (at least 3)
+ * @param tol           Input: relative tolerance for neglecting small values of t
+ * @param l_size        Input: number of multipoles
+ * @param l             Input: list of multipoles
+ * @param kernel        Output: pointer to the table
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int fftlog_kernel_get(
+                      int k_size,
+                      double dlnk,
+                      double bias,
+                      int t_size,
+                      double tol,
+                      int l_size,
+                      int * l,
+                      struct fftlog_kernel ** kernel,
+                      ErrorMsg error_message
+                      ) {
+
+  struct fftlog_kernel * pfk;
+  struct fftlog_kernel * entry;
+  double gauss_x[_FFTLOG_GAUSS_MAX_*_FFTLOG_GAUSS_MAX_];
+  double gauss_w[_FFTLOG_GAUSS_MAX_*_FFTLOG_GAUSS_MAX_];
+  int index_l,gauss_size,abort;
+
+  class_test((k_size < 2) || ((k_size & (k_size-1)) != 0),
+             error_message,
+             "number of wavenumbers %d should be a power of two",k_size);
+
+  class_test(t_size < 3,
+             error_message,
+             "at least three intervals in t are needed for cubic interpolation");
+
+  for (index_l=0; index_l<l_size; index_l++) {
+    class_test((bias <= -2.*l[index_l]) || (bias >= 2.),
+               error_message,
+               "bias %e should be between %d and 2 for l=%d",bias,-2*l[index_l],l[index_l]);
+  }
+
+  *kernel = NULL;
+
+#pragma omp critical (fftlog_kernel)
+  {
+    for (entry=fftlog_kernel_head; entry != NULL; entry=entry->next) {
+      if ((entry->k_size == k_size) && (entry->dlnk == dlnk) && (entry->bias == bias) &&
+          (entry->t_size == t_size) && (entry->tol == tol) && (entry->l_size == l_size) &&
+          (memcmp(entry->l,l,l_size*sizeof(int)) == 0)) {
+        *kernel = entry;
+        break;
+      }
+    }
+  }
+
+  if (*kernel != NULL)
+    return _SUCCESS_;
+
+  /** - the table is not in the cache: compute it */
+
+  class_alloc(pfk,sizeof(struct fftlog_kernel),error_message);
+
+  pfk->k_size = k_size;
+  pfk->dlnk = dlnk;
+  pfk->bias = bias;
+  pfk->m_size = k_size/2+1;
+  pfk->t_size = t_size;
+  pfk->tol = tol;
+  pfk->l_size = l_size;
+
+  class_alloc(pfk->l,l_size*sizeof(int),error_message);
+  memcpy(pfk->l,l,l_size*sizeof(int));
+  class_alloc(pfk->index_t_min,l_size*sizeof(int),error_message);
+  class_calloc(pfk->weight,2*l_size*(t_size+1)*pfk->m_size,sizeof(double),error_message);
+
+  for (gauss_size=1; gauss_size<=_FFTLOG_GAUSS_MAX_; gauss_size++) {
+    class_call(quadrature_gauss_legendre(gauss_x+(gauss_size-1)*_FFTLOG_GAUSS_MAX_,
+                                         gauss_w+(gauss_size-1)*_FFTLOG_GAUSS_MAX_,
+                                         gauss_size,
+                                         DBL_EPSILON,
+                                         error_message),
+               error_message,
+               error_message);
+  }
+
+  abort = _FALSE_;
+
+#pragma omp parallel for schedule (dynamic) shared(pfk,gauss_x,gauss_w,abort) private(index_l)
+
+  for (index_l=l_size-1; index_l>=0; index_l--) {
+
+#pragma omp flush(abort)
+
+    class_call_parallel(fftlog_kernel_weights(pfk,index_l,gauss_x,gauss_w,error_message),
+                        error_message,
+                        error_message);
+  }
+
+  if (abort == _TRUE_) {
+    free(pfk->l);
+    free(pfk->index_t_min);
+    free(pfk->weight);
+    free(pfk);
+    return _FAILURE_;
+  }
+
+  /** - add it to the cache (another thread may have added the same table in the meantime, which does no harm) */
+
+#pragma omp critical (fftlog_kernel)
+  {
+    pfk->next = fftlog_kernel_head;
+    fftlog_kernel_head = pfk;
+  }
+
+  *kernel = pfk;
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Free all kernel tables of the cache. Must not be called while other
+ * threads may use them.
+ *
+ * @return the error status
+ */
+
+int fftlog_kernel_free() {
+
+  struct fftlog_kernel * entry;
+
+#pragma omp critical (fftlog_kernel)
+  {
+    while (fftlog_kernel_head != NULL) {
+      entry = fftlog_kernel_head;
+      fftlog_kernel_head = entry->next;
+      free(entry->l);
+      free(entry->index_t_min);
+      free(entry->weight);
+      free(entry);
+    }
+  }
+
+  return _SUCCESS_;
+
+}
@@ -52,8 +52,8 @@ int hyperspherical_HIS_create(int K,
   class_alloc(pHIS->x,sizeof(double)*nx,error_message);
   class_alloc(pHIS->sinK,sizeof(double)*nx,error_message);
   class_alloc(pHIS->cotK,sizeof(double)*nx,error_message);
-  class_alloc(pHIS->phi,sizeof(double)*nx*nl,error_message);
-  class_alloc(pHIS->dphi,sizeof(double)*nx*nl,error_message);
+  class_alloc_pooled(pHIS->phi,sizeof(double)*nx*nl,error_message);
+  class_alloc_pooled(pHIS->dphi,sizeof(double)*nx*nl,error_message);
 
   //Order needed for trig interpolation: (We are using Taylor's remainder theorem)
   if (0.5*deltax*deltax < _TRIG_PRECISSION_)
@@ -274,8 +274,8 @@ int hyperspherical_HIS_free(HyperInterpStruct *pHIS,
   free(pHIS->x);
   free(pHIS->sinK);
   free(pHIS->cotK);
-  free(pHIS->phi);
-  free(pHIS->dphi);
+  buffer_pool_free(pHIS->phi);
+  buffer_pool_free(pHIS->dphi);
 
   return _SUCCESS_;
 }
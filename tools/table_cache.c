@@ -0,0 +1,220 @@
+/** @file table_cache.c Process-wide cache of tables read from files
+ *
+ * Several modules read tables from files at each run (BBN helium
+ * fraction, global selection function dN/dz and its evolution,
+ * phase-space distribution of non-cold relics) and spline them. When
+ * many models are computed in the same process (e.g. in a Markov
+ * chain), the files are always the same: table_cache_get() reads and
+ * splines each of them only once, and serves later requests from
+ * memory.
+ *
+ * The tables are identified by the reading function, the file name,
+ * and the modification time and size of the file, such that a file
+ * edited between two runs is read again. Each table_cache_get() must
+ * be followed by a table_cache_release() once the caller does not use
+ * the table anymore: the table of an edited file is then removed from
+ * the cache as soon as its last user has released it, while the other
+ * tables stay until table_cache_free() is called (at the end of the
+ * process, or when an engine or python instance is deleted). A run failing before table_cache_release() only delays the
+ * removal of such a table until table_cache_free(). Calls from
+ * different threads are safe.
+ */
+
+#include "table_cache.h"
+
+/** Head of the process-wide list of tables */
+static struct table_cache_entry * table_cache_head = NULL;
+
+/**
+ * Unlink an entry from the list and free it. Must be called inside
+ * the critical section of the cache.
+ *
+ * @param previous Input: entry before the one to remove (NULL for the head of the list)
+ * @param entry    Input: entry to remove
+ */
+
+static void table_cache_remove(
+                               struct table_cache_entry * previous,
+                               struct table_cache_entry * entry
+                               ) {
+
+  if (previous == NULL)
+    table_cache_head = entry->next;
+  else
+    previous->next = entry->next;
+
+  free(entry->table.data);
+  free(entry->filename);
+  free(entry);
+
+}
+
+/**
+ * Return the table built by a given reading function from a given
+ * file, reading the file only if this was never done before (or if
+ * it was modified since). Tables of previous versions of the file
+ * are removed from the cache, or marked as stale if still in use.
+ * The caller must release the table with table_cache_release().
+ *
+ * @param filename      Input: name of the file
+ * @param reader        Input: function reading the file into a table
+ * @param table         Output: pointer to the table (owned by the cache, must not be modified)
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int table_cache_get(
+                    char * filename,
+                    file_table_reader reader,
+                    struct file_table ** table,
+                    ErrorMsg error_message
+                    ) {
+
+  struct stat file_status;
+  struct table_cache_entry * entry;
+  struct table_cache_entry * previous;
+  struct table_cache_entry * next;
+  int status = _SUCCESS_;
+
+  class_test(stat(filename,&file_status) != 0,
+             error_message,
+             "Could not open file %s!",filename);
+
+  *table = NULL;
+
+#pragma omp critical (table_cache)
+  {
+    previous = NULL;
+    for (entry=table_cache_head; entry != NULL; entry=next) {
+      next = entry->next;
+      if ((entry->reader == reader) &&
+          (entry->stale == _FALSE_) &&
+          (strcmp(entry->filename,filename) == 0)) {
+        if ((entry->mtime == file_status.st_mtime) &&
+            (entry->size == file_status.st_size)) {
+          entry->users++;
+          *table = &(entry->table);
+        }
+        else if (entry->users == 0) {
+          /* the file changed and nobody uses the old table */
+          table_cache_remove(previous,entry);
+          continue;
+        }
+        else {
+          /* the file changed: removed by the last table_cache_release() */
+          entry->stale = _TRUE_;
+        }
+      }
+      previous = entry;
+    }
+
+    if (*table == NULL) {
+
+      entry = malloc(sizeof(struct table_cache_entry));
+      if (entry != NULL)
+        entry->filename = malloc((strlen(filename)+1)*sizeof(char));
+
+      if ((entry == NULL) || (entry->filename == NULL)) {
+        sprintf(error_message,"%s(L:%d) : could not allocate cache entry for file %s",__func__,__LINE__,filename);
+        free(entry);
+        status = _FAILURE_;
+      }
+      else if (reader(filename,&(entry->table),error_message) == _FAILURE_) {
+        free(entry->filename);
+        free(entry);
+        status = _FAILURE_;
+      }
+      else {
+        strcpy(entry->filename,filename);
+        entry->reader = reader;
+        entry->mtime = file_status.st_mtime;
+        entry->size = file_status.st_size;
+        entry->users = 1;
+        entry->stale = _FALSE_;
+        entry->next = table_cache_head;
+        table_cache_head = entry;
+        *table = &(entry->table);
+      }
+    }
+  }
+
+  return status;
+
+}
+
+/**
+ * Tell the cache that a table returned by table_cache_get() is not
+ * used anymore by the caller. The table is freed if it was the last
+ * user of a table whose file has changed.
+ *
+ * @param table         Input: table returned by table_cache_get()
+ * @param error_message Output: error message
+ * @return the error status
+ */
+
+int table_cache_release(
+                        struct file_table * table,
+                        ErrorMsg error_message
+                        ) {
+
+  struct table_cache_entry * entry;
+  struct table_cache_entry * previous;
+  int status = _FAILURE_;
+
+#pragma omp critical (table_cache)
+  {
+    previous = NULL;
+    for (entry=table_cache_head; entry != NULL; entry=entry->next) {
+      if (&(entry->table) == table) {
+        entry->users--;
+        if ((entry->stale == _TRUE_) && (entry->users == 0))
+          table_cache_remove(previous,entry);
+        status = _SUCCESS_;
+        break;
+      }
+      previous = entry;
+    }
+  }
+
+  class_test(status == _FAILURE_,
+             error_message,
+             "table not found in the table cache");
+
+  return _SUCCESS_;
+
+}
+
+/**
+ * Free all tables of the cache which are not in use. Tables still in
+ * use are marked as stale, and freed by their last
+ * table_cache_release(). It is thus safe to call this function while
+ * other runs use the cache: their next table_cache_get() only reads
+ * the files again.
+ *
+ * @return the error status
+ */
+
+int table_cache_free() {
+
+  struct table_cache_entry * entry;
+  struct table_cache_entry * previous;
+  struct table_cache_entry * next;
+
+#pragma omp critical (table_cache)
+  {
+    previous = NULL;
+    for (entry=table_cache_head; entry != NULL; entry=next) {
+      next = entry->next;
+      if (entry->users == 0) {
+        table_cache_remove(previous,entry);
+      }
+      else {
+        entry->stale = _TRUE_;
+        previous = entry;
+      }
+    }
+  }
+
+  return _SUCCESS_;
+
+}